@@ -0,0 +1,29 @@
+/* Times the loop of the benchmark module: driver <calls> <repetitions>, prints the fastest run in nanoseconds. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+void bench_loop(long n);
+
+static double now(void) {
+  struct timespec T;
+  clock_gettime(CLOCK_MONOTONIC, &T);
+  return 1e9 * T.tv_sec + T.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  const long Calls = argc > 1 ? atol(argv[1]) : 10000000;
+  const int Repetitions = argc > 2 ? atoi(argv[2]) : 5;
+  double Best = -1;
+  bench_loop(Calls / 10);
+  for (int I = 0; I < Repetitions; ++I) {
+    const double Start = now();
+    bench_loop(Calls);
+    const double Time = now() - Start;
+    if (Best < 0 || Time < Best) {
+      Best = Time;
+    }
+  }
+  printf("%.0f\n", Best);
+  return 0;
+}
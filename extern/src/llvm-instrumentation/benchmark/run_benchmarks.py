@@ -0,0 +1,311 @@
+#!/usr/bin/env python3
+"""
+File: run_benchmarks.py
+License: Part of the PIRA project. Licensed under BSD 3 clause license. See LICENSE.txt file at https://github.com/tudasc/pira
+Description: Benchmarks of the cost of the hooks per call and of the compile time of the plugin.
+
+Writes one JSON object per line and measurement:
+  {"benchmark": "hooks", "hooks": ..., "calls": ..., "ns_per_call": ..., "overhead_ns_per_call": ...}
+  {"benchmark": "compile", "functions": ..., "filter_entries": ..., "seconds": ..., "max_rss_kb": ..., ...}
+"""
+
+import argparse
+import json
+import os
+import platform
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+
+# The loop of the hook benchmark, work is the only instrumented function
+HOOK_MODULE = '''
+define void @work() noinline {
+  call void asm sideeffect "", "~{memory}"()
+  ret void
+}
+
+define void @bench_loop(i64 %n) {
+entry:
+  %empty = icmp sle i64 %n, 0
+  br i1 %empty, label %exit, label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %next, %loop ]
+  call void @work()
+  %next = add i64 %i, 1
+  %done = icmp eq i64 %next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+'''
+
+# name, plugin environment, runtime environment, libraries; None as plugin environment builds without the plugin
+HOOK_VARIANTS = [
+    ('none', None, {}, []),
+    ('cyg-profile', {}, {}, ['stubs']),
+    ('inline-timer', {
+        'PIRA_INSTR_HOOKS': 'inline-timer'
+    }, {}, ['pira_rt']),
+    ('region-id', {
+        'PIRA_INSTR_HOOKS': 'region-id'
+    }, {}, ['pira_rt']),
+    ('cyg-profile+guard-disabled', {
+        'PIRA_INSTR_RUNTIME_GUARDS': '1'
+    }, {
+        'PIRA_RUNTIME_FILTER': 'none'
+    }, ['stubs', 'pira_rt']),
+    ('cyg-profile+guard-enabled', {
+        'PIRA_INSTR_RUNTIME_GUARDS': '1'
+    }, {
+        'PIRA_RUNTIME_FILTER': 'work'
+    }, ['stubs', 'pira_rt']),
+    ('cyg-profile+trace', {}, {}, ['pira_trace', 'pira_rt']),
+    ('region-id+trace', {
+        'PIRA_INSTR_HOOKS': 'region-id'
+    }, {}, ['pira_trace', 'pira_rt']),
+]
+
+
+class Benchmark:
+
+  def __init__(self, args, work_dir: str):
+    self._args = args
+    self._work_dir = work_dir
+    self._llvm_version = self.tool_output([self.tool('llvm-config'), '--version']).strip()
+
+  def tool(self, name: str) -> str:
+    if self._args.llvm_bin:
+      return os.path.join(self._args.llvm_bin, name)
+    return name
+
+  @staticmethod
+  def tool_output(command) -> str:
+    return subprocess.run(command, check=True, stdout=subprocess.PIPE,
+                          universal_newlines=True).stdout
+
+  def path(self, name: str) -> str:
+    return os.path.join(self._work_dir, name)
+
+  def write(self, name: str, content: str) -> str:
+    with open(self.path(name), 'w') as f:
+      f.write(content)
+    return self.path(name)
+
+  def run_measured(self, command, env: dict) -> (float, int):
+    """
+    Runs command with the additional environment variables, returns its wall time and peak memory.
+    The output of the plugin is discarded.
+    """
+    full_env = dict(os.environ)
+    full_env.update(env)
+    start = time.perf_counter()
+    process = subprocess.Popen(command,
+                               env=full_env,
+                               stdout=subprocess.DEVNULL,
+                               stderr=subprocess.DEVNULL)
+    _, status, usage = os.wait4(process.pid, 0)
+    seconds = time.perf_counter() - start
+    process.returncode = os.waitstatus_to_exitcode(status)
+    if process.returncode != 0:
+      raise RuntimeError('Failed: ' + ' '.join(command))
+    return seconds, usage.ru_maxrss
+
+  def record(self, out, entry: dict) -> None:
+    entry['llvm'] = self._llvm_version
+    entry['host'] = platform.node()
+    out.write(json.dumps(entry, sort_keys=True) + '\n')
+    out.flush()
+
+  def opt_command(self, source: str, target: str, with_plugin: bool):
+    command = [self.tool('opt')]
+    if with_plugin:
+      command += ['-load-pass-plugin', self._args.plugin]
+    return command + ['-passes=' + self._args.pipeline, source, '-o', target]
+
+  # Hook overhead
+
+  def build_hook_variant(self, name: str, plugin_env: dict, libraries) -> str:
+    source = self.write('hooks.ll', HOOK_MODULE)
+    bitcode = self.path(name + '.bc')
+    whitelist = self.write('hooks.filt', 'work\n')
+    env = dict(plugin_env or {})
+    env['PIRA_INSTR_FILTER_LIST'] = whitelist
+    self.run_measured(self.opt_command(source, bitcode, plugin_env is not None), env)
+    obj = self.path(name + '.o')
+    self.run_measured(
+        [self.tool('llc'), '-O2', '-filetype=obj', '-relocation-model=pic', bitcode, '-o', obj], {})
+
+    exe = self.path(name + '.exe')
+    command = [self._args.cc, '-O2', os.path.join(BENCH_DIR, 'driver.c'), obj, '-o', exe]
+    if 'stubs' in libraries:
+      command.append(os.path.join(BENCH_DIR, 'stubs.c'))
+    runtime_libraries = [lib for lib in libraries if lib != 'stubs']
+    if runtime_libraries:
+      command += ['-L' + self._args.runtime_dir, '-Wl,-rpath,' + self._args.runtime_dir]
+      command += ['-l' + lib for lib in runtime_libraries]
+    self.run_measured(command, {})
+    return exe
+
+  def run_hooks(self, out) -> None:
+    baseline = None
+    for name, plugin_env, runtime_env, libraries in HOOK_VARIANTS:
+      exe = self.build_hook_variant(name, plugin_env, libraries)
+      env = {
+          'PIRA_TIMER_OUTPUT': self.path(name + '.csv'),
+          'PIRA_TRACE_OUTPUT': self.path(name + '-trace'),
+      }
+      for key, value in runtime_env.items():
+        env[key] = self.write(name + '.filter', value + '\n')
+      full_env = dict(os.environ)
+      full_env.update(env)
+      # The rpath of the executable does not apply to the dependencies of libpira_trace
+      full_env['LD_LIBRARY_PATH'] = self._args.runtime_dir + os.pathsep + full_env.get(
+          'LD_LIBRARY_PATH', '')
+      nanoseconds = float(
+          subprocess.run(
+              [exe, str(self._args.calls), str(self._args.repetitions)],
+              env=full_env,
+              check=True,
+              stdout=subprocess.PIPE,
+              universal_newlines=True).stdout)
+      # The traces grow with the calls, keep the disk usage bounded
+      for f in os.listdir(self._work_dir):
+        if f.startswith(name + '-trace'):
+          os.remove(self.path(f))
+      ns_per_call = nanoseconds / self._args.calls
+      if baseline is None:
+        baseline = ns_per_call
+      self.record(
+          out, {
+              'benchmark': 'hooks',
+              'hooks': name,
+              'calls': self._args.calls,
+              'ns_per_call': ns_per_call,
+              'overhead_ns_per_call': ns_per_call - baseline
+          })
+
+  # Compile time
+
+  def generate_module(self, functions: int) -> str:
+    """
+    A module of functions that call up to two later functions each, stored as bitcode, so that reading
+    the module takes as little of the measured time as possible. The call graph has no cycles, large
+    strongly connected components would dominate the time of the inliner.
+    """
+    bitcode = self.path('module-' + str(functions) + '.bc')
+    if os.path.exists(bitcode):
+      return bitcode
+    source = self.path('module-' + str(functions) + '.ll')
+    with open(source, 'w') as f:
+      for i in range(functions):
+        callees = [c for c in (i + 1, i + 2 + i % 97) if c < functions]
+        calls = ''.join('  call void @f' + str(c) + '(i32 %y)\n' for c in callees)
+        f.write('define void @f' + str(i) + '(i32 %x) {\n'
+                'entry:\n'
+                '  %c = icmp sgt i32 %x, 0\n'
+                '  br i1 %c, label %call, label %exit\n'
+                'call:\n'
+                '  %y = sub i32 %x, 1\n' + calls + '  br label %exit\n'
+                'exit:\n'
+                '  ret void\n'
+                '}\n')
+    subprocess.run([self.tool('llvm-as'), source, '-o', bitcode], check=True)
+    os.remove(source)
+    return bitcode
+
+  def generate_filter(self, functions: int, entries: int) -> (str, int):
+    """
+    A whitelist with entries names, which select every 10th function of the module; the remaining
+    entries name functions that do not exist. Returns the file and the number of selected functions.
+    """
+    selected = min(entries, max(1, functions // 10))
+    whitelist = self.path('filter-' + str(functions) + '-' + str(entries) + '.txt')
+    with open(whitelist, 'w') as f:
+      for i in range(selected):
+        f.write('f' + str(i * 10) + '\n')
+      for i in range(entries - selected):
+        f.write('missing' + str(i) + '\n')
+    return whitelist, selected
+
+  def run_compile(self, out) -> None:
+    for functions in self._args.functions:
+      module = self.generate_module(functions)
+      target = self.path('out.bc')
+      baseline_seconds, baseline_rss = self.run_measured(self.opt_command(module, target, False),
+                                                         {})
+      for entries in self._args.filter_entries:
+        whitelist, selected = self.generate_filter(functions, entries)
+        seconds, rss = self.run_measured(self.opt_command(module, target, True),
+                                         {'PIRA_INSTR_FILTER_LIST': whitelist})
+        self.record(
+            out, {
+                'benchmark': 'compile',
+                'pipeline': self._args.pipeline,
+                'functions': functions,
+                'filter_entries': entries,
+                'instrumented': selected,
+                'seconds': seconds,
+                'baseline_seconds': baseline_seconds,
+                'overhead_seconds': seconds - baseline_seconds,
+                'max_rss_kb': rss,
+                'baseline_max_rss_kb': baseline_rss
+            })
+        os.remove(whitelist)
+
+
+def main() -> int:
+  parser = argparse.ArgumentParser(description='Benchmarks of the PIRA instrumentation plugin')
+  parser.add_argument('--plugin', required=True, help='instrumentationlib.so')
+  parser.add_argument('--runtime-dir',
+                      required=True,
+                      help='Directory of libpira_rt and libpira_trace')
+  parser.add_argument('--llvm-bin', default='', help='Directory of opt, llc and llvm-as')
+  parser.add_argument('--cc', default='cc', help='C compiler to link the hook benchmark')
+  parser.add_argument('--pipeline',
+                      default='default<O1>',
+                      help='Pass pipeline of the compile benchmark')
+  parser.add_argument('--functions',
+                      type=int,
+                      nargs='+',
+                      default=[10000, 100000],
+                      help='Functions of the synthetic modules')
+  parser.add_argument('--filter-entries',
+                      type=int,
+                      nargs='+',
+                      default=[100, 10000, 1000000],
+                      help='Entries of the whitelists')
+  parser.add_argument('--calls', type=int, default=10000000, help='Calls per hook benchmark run')
+  parser.add_argument('--repetitions',
+                      type=int,
+                      default=5,
+                      help='Runs per hook variant, the fastest counts')
+  parser.add_argument('--only', choices=['hooks', 'compile'], help='Run one of the benchmarks')
+  parser.add_argument('--output', default='-', help='File to append the results to')
+  args = parser.parse_args()
+
+  work_dir = tempfile.mkdtemp(prefix='pira-bench-')
+  out = sys.stdout if args.output == '-' else open(args.output, 'a')
+  try:
+    benchmark = Benchmark(args, work_dir)
+    if args.only != 'compile':
+      benchmark.run_hooks(out)
+    if args.only != 'hooks':
+      benchmark.run_compile(out)
+  except (RuntimeError, subprocess.CalledProcessError) as e:
+    print('[pira-benchmark] [Error]: ' + str(e), file=sys.stderr)
+    return 1
+  finally:
+    if out is not sys.stdout:
+      out.close()
+    shutil.rmtree(work_dir)
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,8 @@
+/* Empty cyg-profile hooks: the benchmark measures the cost of the calls alone. */
+__attribute__((noinline)) void __cyg_profile_func_enter(void *Function, void *CallSite) {
+  __asm__ volatile("" ::"r"(Function), "r"(CallSite));
+}
+
+__attribute__((noinline)) void __cyg_profile_func_exit(void *Function, void *CallSite) {
+  __asm__ volatile("" ::"r"(Function), "r"(CallSite));
+}
@@ -0,0 +1,80 @@
+//===- Diagnostics.h - Statistics, remarks and timers of the plugin -------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// The plugin reports what it did through the LLVM infrastructure instead of
+// logging to stderr:
+// - Statistics (-stats) count the instrumented and skipped regions.
+// - Optimization remarks of the pass pira-instrumentation record every
+//   instrumented region and every selected region that was skipped, with the
+//   reason, e.g., clang -Rpass=pira-instrumentation or
+//   -fsave-optimization-record -foptimization-record-passes=pira-instrumentation.
+//   With -instrumentation-remarks-dir, every module writes its remarks to
+//   <source file name>-<hash>.opt.yaml in that directory.
+// - The phases of the plugin are timed in the group "PIRA Instrumentation" of
+//   the -time-passes (clang -ftime-report) report.
+// The log of every inserted hook is only written with -instrumentation-verbose.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_INSTRUMENTATION_DIAGNOSTICS_H
+#define LLVM_INSTRUMENTATION_DIAGNOSTICS_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/DebugLoc.h"
+#include "llvm/Support/Timer.h"
+
+#include <memory>
+
+namespace llvm {
+class Function;
+class LLVMContext;
+class Module;
+class ToolOutputFile;
+}  // namespace llvm
+
+namespace pira {
+
+/// Pass name of the remarks
+extern const char *const RemarksPassName;
+
+/// The kinds of regions in the statistics and remarks
+enum class RegionKind { Function, CallSite, IndirectCallSite, Loop, Parallel, Inlined };
+
+/// Name of the kind in the remarks, e.g., call-site
+llvm::StringRef getRegionKindName(RegionKind Kind);
+
+/// Counts a region named Region that was instrumented in F, and emits a remark at Loc (the function if it is empty).
+void reportInstrumented(llvm::Function &F, RegionKind Kind, llvm::StringRef Region, const llvm::DebugLoc &Loc = {});
+
+/// Counts a selected region in F that was not instrumented, and emits a missed remark with the reason.
+void reportSkipped(llvm::Function &F, RegionKind Kind, llvm::StringRef Region, llvm::StringRef Reason,
+                   const llvm::DebugLoc &Loc = {});
+
+/// Streams the remarks of the plugin for a module to a file of the directory given by -instrumentation-remarks-dir
+/// while it exists. Does nothing if there is no directory, if the compiler already streams remarks, or if the module
+/// was already instrumented, e.g., in a ThinLTO backend.
+class ModuleRemarksFile {
+ public:
+  explicit ModuleRemarksFile(llvm::Module &M);
+  ~ModuleRemarksFile();
+
+ private:
+  llvm::LLVMContext &context;
+  std::unique_ptr<llvm::ToolOutputFile> file;
+};
+
+/// Times a phase of the plugin in the -time-passes report while it exists
+class PhaseTimer {
+ public:
+  PhaseTimer(llvm::StringRef Name, llvm::StringRef Description);
+
+ private:
+  llvm::NamedRegionTimer timer;
+};
+
+}  // namespace pira
+
+#endif  // LLVM_INSTRUMENTATION_DIAGNOSTICS_H
@@ -0,0 +1,45 @@
+//===- Features.h - Per-module static features of the functions -----------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// With -features-dir, every module writes the static features of the functions
+// it defines, which pira-cg-merge combines into the call graph of the program
+// for the analysis:
+//   {"module": "a.cpp", "source": "/abs/path/a.cpp",
+//    "functions": {"_Z3fooi": {"file": "/abs/path/a.cpp", "line": 3,
+//       "systemInclude": false, "instructions": 42, "loopDepth": 2,
+//       "callees": ["_Z3barv"], "indirectCalls": 1, "floatOps": 8,
+//       "intOps": 5, "controlFlowOps": 3, "memoryAccesses": 12}}}
+// The callees include the functions passed as arguments to a call, e.g., the
+// outlined OpenMP parallel regions. The instructions do not include debug
+// intrinsics. The operation counts are static and not weighted by the trip
+// counts. FLOPs are the floating point arithmetic instructions and math
+// intrinsics per vector element, fused multiply-adds count twice. The memory
+// accesses do not include the accesses to local variables, which the
+// optimizer promotes to registers, so that they do not depend on where the
+// pass runs in the pipeline. Functions inlined before the pass ran are not in
+// the call graph.
+//
+// The file name is <source file name>-<hash>.features.json, with the hash
+// taken over the source path and the module identifier.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_INSTRUMENTATION_FEATURES_H
+#define LLVM_INSTRUMENTATION_FEATURES_H
+
+namespace llvm {
+class Module;
+}  // namespace llvm
+
+namespace pira {
+
+/// Writes the features of the functions of M to the directory of -features-dir / PIRA_INSTR_FEATURES_DIR, if one is
+/// set. Called before the module is instrumented.
+void writeFeatures(llvm::Module &M);
+
+}  // namespace pira
+
+#endif  // LLVM_INSTRUMENTATION_FEATURES_H
@@ -0,0 +1,126 @@
+//===- Filter.h - Function and call site filter of the instrumenter -------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// The Score-P filter file follows the Score-P rules: INCLUDE and EXCLUDE rules
+// are evaluated in order and the last matching rule decides. Patterns may use
+// wildcards, MANGLED patterns are matched against the symbol name, all others
+// against the symbol name and the demangled name. Other than in Score-P, a
+// function that no rule matches is not instrumented.
+//
+// Rules with the LOOPS[=<depth>] modifier select the loops of the matching
+// functions instead of the functions themselves:
+//   INCLUDE LOOPS=2 MANGLED _Z6solverv
+// instruments the loops of solver() up to nesting depth 2 as separate regions.
+//
+// Rules with the PARALLEL modifier select the OpenMP parallel regions that the
+// matching functions fork, which the compiler outlines into functions of their
+// own:
+//   INCLUDE PARALLEL MANGLED _Z6solverv
+//
+// The callee INDIRECT selects the calls through function pointers (virtual
+// calls, std::function) of the matching callers:
+//   INCLUDE MANGLED _Z6solverv -> INDIRECT
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_INSTRUMENTATION_FILTER_H
+#define LLVM_INSTRUMENTATION_FILTER_H
+
+#include "FilterIndex.h"
+#include "FilterParser.h"
+#include "GlobMatcher.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pira {
+
+/// Reads a whitelist with one mangled name per line.
+void readWhitelistFile(const std::string &FileName, std::vector<std::string> &Names);
+
+/// Reads the rules of a Score-P filter file in their order.
+void readScorePFilterFile(const std::string &FileName, std::vector<FilterRule> &Rules);
+
+/// Holds the functions and call sites that should be instrumented.
+/// The filter is read once per process: the ThinLTO backends of the linker run in parallel threads and share it.
+class InstrumentationFilter {
+ public:
+  /// Ids of the call site rules whose caller pattern matches a function
+  struct CallSiteRules {
+    llvm::SmallVector<unsigned, 4> ids;
+    bool hasIndexedCallSites{false};
+
+    bool empty() const { return ids.empty() && !hasIndexedCallSites; }
+  };
+
+  /// Returns the filter read from the configured filter index, or whitelist and / or Score-P filter file.
+  static const InstrumentationFilter &get();
+
+  /// Reads the whitelist and the Score-P filter file; empty names are ignored.
+  InstrumentationFilter(const std::string &WhitelistFileName, const std::string &ScorePFileName);
+
+  InstrumentationFilter(const std::vector<std::string> &Whitelist, const std::vector<FilterRule> &Rules);
+
+  /// Answers exact names from the index tables, everything else from the rules stored in the index.
+  explicit InstrumentationFilter(std::unique_ptr<FilterIndex> Index);
+
+  bool isFiltered(llvm::StringRef FuncName) const;
+
+  /// Returns the depth up to which the loops of FuncName should be instrumented, 0 for none.
+  unsigned getLoopDepth(llvm::StringRef FuncName) const;
+
+  /// Whether the OpenMP parallel regions forked by Parent should be instrumented.
+  bool isParallelRegionFiltered(llvm::StringRef Parent) const;
+
+  /// Returns the call site rules that apply to the calls in Caller.
+  CallSiteRules getCallSiteRules(llvm::StringRef Caller) const;
+
+  /// Whether a call to Callee should be instrumented, given the rules of the calling function.
+  bool isCallSiteFiltered(llvm::StringRef Caller, const CallSiteRules &Rules, llvm::StringRef Callee) const;
+
+  /// Whether the indirect calls should be instrumented, given the rules of the calling function.
+  bool isIndirectCallSiteFiltered(const CallSiteRules &Rules) const;
+
+ private:
+  /// Patterns for mangled names and for names that may also match the demangled name.
+  struct NameMatcher {
+    void add(const FilterPattern &Pattern, unsigned Id);
+    int64_t matchLast(llvm::StringRef Name) const;
+    void match(llvm::StringRef Name, llvm::SmallVectorImpl<unsigned> &Ids) const;
+
+    GlobMatcher mangled;
+    GlobMatcher plain;
+  };
+
+  void addRules(const std::vector<FilterRule> &Rules);
+
+  std::unique_ptr<FilterIndex> index;
+
+  llvm::StringSet<> filterList;  // whitelist filter
+
+  NameMatcher functionRules;
+  std::vector<bool> functionRuleIncludes;  // INCLUDE or EXCLUDE, indexed by rule id
+
+  NameMatcher loopRules;
+  std::vector<unsigned> loopRuleDepths;  // 0 for EXCLUDE rules
+
+  NameMatcher parallelRules;
+  std::vector<bool> parallelRuleIncludes;
+
+  NameMatcher callerRules;  // caller and callee patterns of a call site rule share the id
+  NameMatcher calleeRules;
+  std::vector<bool> callSiteRuleIncludes;
+  std::vector<bool> callSiteRuleIndirect;
+};
+
+}  // namespace pira
+
+#endif  // LLVM_INSTRUMENTATION_FILTER_H
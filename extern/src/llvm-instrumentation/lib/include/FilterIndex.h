@@ -0,0 +1,146 @@
+//===- FilterIndex.h - Precompiled, memory-mapped filter ------------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// The index is written once per filter by the pira-filter-index tool and
+// mapped read-only by every compiler process. It holds
+//  - an open addressing hash table of exact symbol names with the final
+//    decision of the filter for that name,
+//  - the same for exact (caller, callee) pairs,
+//  - the remaining rules (wildcards, demangled names, loop and parallel
+//    rules) in their order.
+// Lookups compare StringRefs into the mapping and do not allocate.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_INSTRUMENTATION_FILTERINDEX_H
+#define LLVM_INSTRUMENTATION_FILTERINDEX_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pira {
+
+struct FilterRule;
+
+namespace index {
+
+constexpr char Magic[8] = {'P', 'I', 'R', 'A', 'F', 'I', 'D', 'X'};
+constexpr uint32_t Version = 4;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t functionTableOffset;
+  uint64_t functionTableSize;  // number of buckets, a power of two
+  uint64_t callSiteTableOffset;
+  uint64_t callSiteTableSize;  // number of buckets, a power of two
+  uint64_t ruleOffset;
+  uint64_t numRules;
+  uint64_t stringOffset;
+  uint64_t stringSize;
+};
+
+// Flags of function and call site entries
+constexpr uint32_t Used = 1U << 31;
+constexpr uint32_t Instrument = 1U << 0;
+constexpr uint32_t HasCallSites = 1U << 1;
+
+struct FunctionEntry {
+  uint32_t hash;
+  uint32_t nameOffset;
+  uint32_t nameLength;
+  uint32_t flags;
+};
+
+struct CallSiteEntry {
+  uint32_t hash;
+  uint32_t callerOffset;
+  uint32_t callerLength;
+  uint32_t calleeOffset;
+  uint32_t calleeLength;
+  uint32_t flags;  // Used, Instrument
+};
+
+// Flags of rule entries
+constexpr uint32_t Include = 1U << 0;
+constexpr uint32_t CallSite = 1U << 1;
+constexpr uint32_t PatternMangled = 1U << 2;
+constexpr uint32_t CalleeMangled = 1U << 3;
+constexpr uint32_t Indirect = 1U << 4;
+constexpr uint32_t Parallel = 1U << 5;
+constexpr uint32_t LoopDepthShift = 8;  // The upper bits hold the depth of loop rules
+
+struct RuleEntry {
+  uint32_t flags;
+  uint32_t patternOffset;
+  uint32_t patternLength;
+  uint32_t calleeOffset;
+  uint32_t calleeLength;
+};
+
+}  // namespace index
+
+class FilterIndex {
+ public:
+  /// Maps the index file; prints an error and returns nullptr if it is not a valid index.
+  static std::unique_ptr<FilterIndex> open(const std::string &FileName);
+
+  /// Returns the flags of Name (see the flags in namespace index), or 0 if Name is not in the table.
+  uint32_t lookupFunction(llvm::StringRef Name) const;
+
+  /// Returns the flags of the call site (see the flags in namespace index), or 0 if the pair is not in the table.
+  uint32_t lookupCallSite(llvm::StringRef Caller, llvm::StringRef Callee) const;
+
+  /// The rules that are not answered by the tables.
+  std::vector<FilterRule> getRules() const;
+
+  static uint32_t hashName(llvm::StringRef Name);
+  static uint32_t hashCallSite(llvm::StringRef Caller, llvm::StringRef Callee);
+
+ private:
+  FilterIndex(llvm::sys::fs::mapped_file_region Region);
+  bool validate();
+  llvm::StringRef getString(uint32_t Offset, uint32_t Length) const;
+
+  llvm::sys::fs::mapped_file_region region;
+  const index::Header *header;
+  const index::FunctionEntry *functions{nullptr};
+  const index::CallSiteEntry *callSites{nullptr};
+  const index::RuleEntry *rules{nullptr};
+  const char *strings{nullptr};
+};
+
+/// Builds the tables of an index; exact names must be added with their final decision.
+class FilterIndexWriter {
+ public:
+  void addFunction(llvm::StringRef Name, uint32_t Flags);
+  void addCallSite(llvm::StringRef Caller, llvm::StringRef Callee, bool Instrument);
+  void addRule(const FilterRule &Rule);
+
+  void write(llvm::raw_ostream &OS);
+
+ private:
+  uint32_t intern(llvm::StringRef Str);
+
+  std::vector<index::FunctionEntry> functions;
+  std::vector<index::CallSiteEntry> callSites;
+  std::vector<index::RuleEntry> rules;
+  std::string strings;
+  llvm::StringMap<uint32_t> stringOffsets;
+};
+
+}  // namespace pira
+
+#endif  // LLVM_INSTRUMENTATION_FILTERINDEX_H
@@ -0,0 +1,47 @@
+//===- FilterParser.h - Parser of the Score-P filter file -----------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// The grammar of the Score-P filter file, see Filter.h for its rules. The
+// parser does not depend on LLVM: the runtime of the enable guards reads the
+// same files at program start.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_INSTRUMENTATION_FILTERPARSER_H
+#define LLVM_INSTRUMENTATION_FILTERPARSER_H
+
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace pira {
+
+struct FilterPattern {
+  std::string text;
+  bool mangled{false};
+
+  /// Whether the pattern matches exactly one symbol name.
+  bool isExactSymbol() const { return mangled && text.find_first_of("*?[\\") == std::string::npos; }
+};
+
+/// One pattern of an INCLUDE / EXCLUDE rule, rules with a callee select call sites.
+struct FilterRule {
+  bool include{true};
+  bool isCallSite{false};
+  bool isIndirect{false};  // Call site rule for the indirect calls of the caller, without callee pattern
+  unsigned loopDepth{0};  // Loop rules select the loops up to this depth (outermost is 1), 0 for other rules
+  bool parallel{false};   // Parallel rules select the OpenMP parallel regions forked by the function
+  FilterPattern pattern;  // function or caller
+  FilterPattern callee;
+};
+
+/// Appends the rules of a Score-P filter file in their order. Patterns may continue on the following lines, '#' starts
+/// a comment. Returns false and sets Error if the file is malformed.
+bool parseScorePFilter(std::istream &Input, std::vector<FilterRule> &Rules, std::string &Error);
+
+}  // namespace pira
+
+#endif  // LLVM_INSTRUMENTATION_FILTERPARSER_H
@@ -0,0 +1,73 @@
+//===- GlobMatcher.h - Matches names against many glob patterns at once ---===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// All patterns are compiled into one trie whose edges are literal characters,
+// character classes ('?', '[...]') or '*' loops. Matching a name walks the trie
+// once, so the cost depends on the name length and the wildcards along the
+// walked paths, not on the number of patterns.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_INSTRUMENTATION_GLOBMATCHER_H
+#define LLVM_INSTRUMENTATION_GLOBMATCHER_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+namespace pira {
+
+class GlobMatcher {
+ public:
+  GlobMatcher();
+
+  /// Adds a pattern with fnmatch syntax ('*', '?', '[a-z]', '[!a-z]', '\' escapes). Id is reported on a match.
+  void add(llvm::StringRef Pattern, unsigned Id);
+
+  /// Appends the ids of all patterns matching Name to Ids.
+  void match(llvm::StringRef Name, llvm::SmallVectorImpl<unsigned> &Ids) const;
+
+  /// Returns the largest id of all patterns matching Name, or -1.
+  int64_t matchLast(llvm::StringRef Name) const;
+
+  bool empty() const { return numPatterns == 0; }
+
+ private:
+  static constexpr uint32_t None = UINT32_MAX;
+
+  using CharSet = std::bitset<256>;
+
+  struct Node {
+    uint32_t star{None};      // Node reached through a '*' edge
+    bool isStar{false};       // Node loops on every character
+    std::vector<unsigned> accept;  // Ids of the patterns ending here
+  };
+
+  struct ClassEdge {
+    CharSet chars;
+    uint32_t target;
+  };
+
+  uint32_t addNode();
+  uint32_t getOrAddLiteral(uint32_t From, unsigned char C);
+  uint32_t getOrAddClass(uint32_t From, const CharSet &Chars);
+  uint32_t getOrAddStar(uint32_t From);
+  void addState(uint32_t N, llvm::SmallVectorImpl<uint32_t> &States) const;
+  void run(llvm::StringRef Name, llvm::SmallVectorImpl<uint32_t> &States) const;
+
+  std::vector<Node> nodes;
+  llvm::DenseMap<uint64_t, uint32_t> literalEdges;  // (node << 8 | char) -> node
+  llvm::DenseMap<uint32_t, std::vector<ClassEdge>> classEdges;
+  unsigned numPatterns{0};
+};
+
+}  // namespace pira
+
+#endif  // LLVM_INSTRUMENTATION_GLOBMATCHER_H
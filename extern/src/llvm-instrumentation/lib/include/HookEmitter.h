@@ -0,0 +1,162 @@
+//===- HookEmitter.h - Code emitted at region entry and exit --------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// A hook emitter is created per module. The instrumenter calls emitEntry and
+// emitExit for every instrumented region (function, call site, loop,
+// indirect call site, inlined function or OpenMP parallel region) and
+// finalize once all functions of the module are done, which is where
+// module-level tables are emitted.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_INSTRUMENTATION_HOOKEMITTER_H
+#define LLVM_INSTRUMENTATION_HOOKEMITTER_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/DebugLoc.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class DISubprogram;
+class Function;
+class GlobalVariable;
+class Instruction;
+class Module;
+class Value;
+}  // namespace llvm
+
+namespace pira {
+
+class HookEmitter {
+ public:
+  /// A function, the callee of a call site, a loop, an indirect call site, the inlined body of a function, or the
+  /// function that an OpenMP parallel region was outlined into
+  struct Region {
+    enum class Kind { Function, Loop, IndirectCall, Inlined, Parallel };
+
+    explicit Region(llvm::Function &F);
+    /// A loop, indirect call site, inlined function or parallel region in F; Line is 0 without debug info
+    Region(Kind K, llvm::Function &F, std::string Name, unsigned Line, llvm::Value *Target = nullptr);
+
+    Kind kind;
+    llvm::Function &function;  // For all but functions, the function that contains the region
+    std::string name;
+    unsigned line{0};                         // Source line of all but functions
+    llvm::Value *target{nullptr};             // Called pointer of an indirect call site, resolved at run time
+    llvm::DISubprogram *subprogram{nullptr};  // Debug info of an inlined function, which may no longer exist
+  };
+
+  /// Shared between the entry and the exit hooks of one region
+  struct RegionState {
+    llvm::Value *value{nullptr};
+    unsigned slot{0};
+    llvm::Value *enabled{nullptr};  // Set by GuardedHookEmitter
+  };
+
+  explicit HookEmitter(llvm::Module &M) : module(M) {}
+  virtual ~HookEmitter() = default;
+
+  /// Emits the entry hook of R before IP.
+  virtual RegionState emitEntry(const Region &R, llvm::Instruction *IP, const llvm::DebugLoc &DL) = 0;
+
+  /// Emits the exit hook of R before IP.
+  virtual void emitExit(const Region &R, const RegionState &State, llvm::Instruction *IP,
+                        const llvm::DebugLoc &DL) = 0;
+
+  /// Whether the hooks identify regions by name, which loops and the inlined bodies of functions need.
+  virtual bool supportsNamedRegions() const { return true; }
+
+  /// Rough cost of the entry and the exit hook of one region in instructions, for the overhead budget.
+  virtual double getHookCost() const = 0;
+
+  /// Called once after all functions of the module are instrumented. Returns true if the module was changed.
+  virtual bool finalize() { return false; }
+
+ protected:
+  llvm::Module &module;
+};
+
+/// __cyg_profile_func_enter / __cyg_profile_func_exit with the function address, as -finstrument-functions does.
+class CygProfileHookEmitter : public HookEmitter {
+ public:
+  using HookEmitter::HookEmitter;
+  RegionState emitEntry(const Region &R, llvm::Instruction *IP, const llvm::DebugLoc &DL) override;
+  void emitExit(const Region &R, const RegionState &State, llvm::Instruction *IP, const llvm::DebugLoc &DL) override;
+  bool supportsNamedRegions() const override { return false; }
+  // Two calls, plus the measurement system behind them
+  double getHookCost() const override { return 100; }
+};
+
+/// Reads the cycle counter inline and accumulates calls and cycles in a per-thread slot array, which the runtime
+/// (runtime/, see PiraRuntime.h) allocates on first use and reports at exit.
+class InlineTimerHookEmitter : public HookEmitter {
+ public:
+  using HookEmitter::HookEmitter;
+  RegionState emitEntry(const Region &R, llvm::Instruction *IP, const llvm::DebugLoc &DL) override;
+  void emitExit(const Region &R, const RegionState &State, llvm::Instruction *IP, const llvm::DebugLoc &DL) override;
+  double getHookCost() const override { return 40; }
+  bool finalize() override;
+
+ private:
+  llvm::Value *emitTimestamp(llvm::Instruction *IP, const llvm::DebugLoc &DL);
+  void createModuleGlobals();
+
+  std::vector<std::string> regionNames;  // Indexed by slot
+  llvm::StringMap<unsigned> regionSlots;
+  llvm::GlobalVariable *moduleDesc{nullptr};
+  llvm::GlobalVariable *threadSlots{nullptr};
+};
+
+/// __pira_region_enter / __pira_region_exit with a dense region ID. Every region has an ID slot, which the runtime
+/// fills from a table of (ID slot, name, file, line) in the pira_regions section, so no symbol lookup is needed.
+class RegionIdHookEmitter : public HookEmitter {
+ public:
+  using HookEmitter::HookEmitter;
+  RegionState emitEntry(const Region &R, llvm::Instruction *IP, const llvm::DebugLoc &DL) override;
+  void emitExit(const Region &R, const RegionState &State, llvm::Instruction *IP, const llvm::DebugLoc &DL) override;
+  double getHookCost() const override { return 60; }
+  bool finalize() override;
+
+ private:
+  llvm::GlobalVariable *getIdSlot(const Region &R);
+
+  struct RegionInfo {
+    llvm::GlobalVariable *idSlot;
+    std::string file;
+    unsigned line;
+  };
+  llvm::StringMap<RegionInfo> regions;
+};
+
+/// Wraps the hooks of another emitter in a branch on a per-region enable byte. The bytes live in the pira_guards
+/// section, a table of (enable byte, name) pairs in the pira_guard_names section lets the runtime (see
+/// PiraRuntime.h) set them at startup, before main.
+class GuardedHookEmitter : public HookEmitter {
+ public:
+  GuardedHookEmitter(llvm::Module &M, std::unique_ptr<HookEmitter> Inner);
+  RegionState emitEntry(const Region &R, llvm::Instruction *IP, const llvm::DebugLoc &DL) override;
+  void emitExit(const Region &R, const RegionState &State, llvm::Instruction *IP, const llvm::DebugLoc &DL) override;
+  bool supportsNamedRegions() const override { return inner->supportsNamedRegions(); }
+  double getHookCost() const override { return inner->getHookCost() + 4; }
+  bool finalize() override;
+
+ private:
+  llvm::GlobalVariable *getGuard(llvm::StringRef Name);
+
+  std::unique_ptr<HookEmitter> inner;
+  llvm::StringMap<llvm::GlobalVariable *> guards;
+};
+
+/// Creates the emitter selected by -instrumentation-hooks / PIRA_INSTR_HOOKS, guarded if -runtime-guards is set.
+std::unique_ptr<HookEmitter> createHookEmitter(llvm::Module &M);
+
+}  // namespace pira
+
+#endif  // LLVM_INSTRUMENTATION_HOOKEMITTER_H
@@ -0,0 +1,66 @@
+//===- Instrumenter.h - Filtered entry / exit instrumentation -------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_INSTRUMENTATION_INSTRUMENTER_H
+#define LLVM_INSTRUMENTATION_INSTRUMENTER_H
+
+#include "Filter.h"
+#include "HookEmitter.h"
+#include "OverheadBudget.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+class CallBase;
+class Function;
+}  // namespace llvm
+
+namespace pira {
+
+/// Function attribute that marks a function as already processed. The plugin is registered at several points of
+/// the pipeline (compile time and ThinLTO backend) and must not instrument a function twice.
+constexpr const char *InstrumentedAttr = "pira-instrumented";
+
+bool instrumentFunction(llvm::Function &F, bool PostInlining, HookEmitter &Hooks);
+
+/// Returns the calls of F that call site rules may select, i.e., direct calls to functions other than intrinsics and
+/// indirect calls. Collect them before F gets any hooks, whose calls would otherwise be instrumented, too.
+llvm::SmallVector<llvm::CallBase *, 16> getCallSites(llvm::Function &F);
+
+/// Instruments the calls out of CallSites to every callee for which ShouldInstrument returns true, and the indirect
+/// calls if InstrumentIndirect is set. With OutsideLoopsOnly, the calls in loops are skipped.
+bool instrumentateCallSites(llvm::Function &F, llvm::ArrayRef<llvm::CallBase *> CallSites,
+                            llvm::function_ref<bool(llvm::StringRef)> ShouldInstrument, bool InstrumentIndirect,
+                            HookEmitter &Hooks, bool OutsideLoopsOnly = false);
+
+/// Instruments the loops of F up to nesting depth MaxDepth (outermost loops have depth 1) as separate regions,
+/// named <function>:<line of the loop>. The entry hook goes to the loop preheader, the exit hooks to the exit blocks.
+bool instrumentLoops(llvm::Function &F, unsigned MaxDepth, HookEmitter &Hooks);
+
+/// Instruments the bodies of the functions inlined into F for which ShouldInstrument returns true, found by the
+/// inlined scopes of their debug locations. Each inlined call is a region named after the callee.
+bool instrumentInlinedFunctions(llvm::Function &F, llvm::function_ref<bool(llvm::StringRef)> ShouldInstrument,
+                                HookEmitter &Hooks);
+
+/// Instruments F as an OpenMP parallel region if the compiler outlined one into F and Filter selects the parallel
+/// regions of the function that forks it. Every thread of the team runs F, so each thread measures its own
+/// participation. The region is named <parent>:<line>:omp_parallel after the outermost function that is not itself
+/// a parallel region, or <parent>:omp_parallel.<fork> without debug info, where fork numbers the forks of each
+/// enclosing function in program order, e.g., 0.1 for the second region nested in the first.
+bool instrumentParallelRegion(llvm::Function &F, const InstrumentationFilter &Filter, HookEmitter &Hooks);
+
+/// Applies the function, loop, parallel region and call site instrumentation selected by Filter to F, and after
+/// inlining the one of the inlined functions selected by Filter. Budget (may be null) skips or downgrades too cheap
+/// functions. Shared by the legacy and the new pass manager passes.
+bool runFilteringInstrumentation(llvm::Function &F, const InstrumentationFilter &Filter, HookEmitter &Hooks,
+                                 OverheadBudget *Budget, bool PostInlining = false);
+
+}  // namespace pira
+
+#endif  // LLVM_INSTRUMENTATION_INSTRUMENTER_H
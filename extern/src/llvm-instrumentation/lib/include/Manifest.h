@@ -0,0 +1,39 @@
+//===- Manifest.h - Per-module record of the matched filter entries -------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// With -manifest-dir, every module writes a manifest of the names in it that a
+// filter entry can select, and of those that the current filter matched:
+//   {"module": "a.cpp", "source": "/abs/path/a.cpp",
+//    "matched": ["_Z3foov"], "names": ["_Z3foov", "_Z3barv", "main"]}
+// The names are the functions defined and called in the module, and the
+// functions whose bodies were inlined into it. The instrumentation of the
+// module can only change if the filter selects another subset of its names,
+// which lets PIRA rebuild only the modules that a new whitelist affects.
+//
+// The file name is <source file name>-<hash>.json, with the hash taken over
+// the source path and the names: a source compiled into several objects with
+// different names writes one manifest per variant.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_INSTRUMENTATION_MANIFEST_H
+#define LLVM_INSTRUMENTATION_MANIFEST_H
+
+namespace llvm {
+class Module;
+}  // namespace llvm
+
+namespace pira {
+
+class InstrumentationFilter;
+
+/// Writes the manifest of M to the directory of -manifest-dir / PIRA_INSTR_MANIFEST_DIR, if one is set. Called before
+/// the module is instrumented.
+void writeManifest(const llvm::Module &M, const InstrumentationFilter &Filter);
+
+}  // namespace pira
+
+#endif  // LLVM_INSTRUMENTATION_MANIFEST_H
@@ -0,0 +1,88 @@
+//===- Options.h - Command line options of the instrumentation plugin -----===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// The plugin is configured through -mllvm options when it is loaded by clang.
+// When it runs inside a ThinLTO backend of the linker, the -mllvm options of
+// the compile step are not available, hence every option can also be given as
+// an environment variable.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_INSTRUMENTATION_OPTIONS_H
+#define LLVM_INSTRUMENTATION_OPTIONS_H
+
+#include "llvm/Support/CommandLine.h"
+
+#include <string>
+
+namespace pira {
+
+extern llvm::cl::opt<std::string> WhitelistFile;
+extern llvm::cl::opt<std::string> ConfigFileScoreP;
+extern llvm::cl::opt<std::string> FilterIndexFile;
+extern llvm::cl::opt<std::string> InstrumentationHooks;
+extern llvm::cl::opt<bool> RuntimeGuards;
+extern llvm::cl::opt<std::string> InstrumentationPlacement;
+extern llvm::cl::opt<std::string> OverheadBudgetPercent;
+extern llvm::cl::opt<std::string> OverheadReportFile;
+extern llvm::cl::opt<std::string> ManifestDirectory;
+extern llvm::cl::opt<std::string> RemarksDirectory;
+extern llvm::cl::opt<std::string> FeaturesDirectory;
+extern llvm::cl::opt<bool> Verbose;
+
+/// Position of the instrumentation in the optimization pipeline
+enum class Placement { Early, PostInline, OptimizerLast };
+
+/// Returns the value of Opt if it was set, otherwise the value of the environment variable EnvVar (or "").
+std::string getOptionOrEnv(const llvm::cl::opt<std::string> &Opt, const char *EnvVar);
+
+/// The whitelist file, taken from -filter-list or PIRA_INSTR_FILTER_LIST.
+std::string getWhitelistFile();
+
+/// The Score-P filter file, taken from -score-p-filter or PIRA_INSTR_SCOREP_FILTER.
+std::string getScorePFilterFile();
+
+/// The precompiled filter index, taken from -filter-index or PIRA_INSTR_FILTER_INDEX.
+std::string getFilterIndexFile();
+
+/// The kind of the inserted hooks (cyg-profile, inline-timer, region-id), taken from -instrumentation-hooks or
+/// PIRA_INSTR_HOOKS.
+std::string getInstrumentationHooks();
+
+/// Whether the hooks are guarded by a per-function enable byte, taken from -runtime-guards or
+/// PIRA_INSTR_RUNTIME_GUARDS (any value but 0).
+bool useRuntimeGuards();
+
+/// The position of the instrumentation (early, post-inline, optimizer-last), taken from -instrumentation-placement or
+/// PIRA_INSTR_PLACEMENT.
+Placement getInstrumentationPlacement();
+
+/// The overhead budget in percent of the estimated cost of a call, taken from -overhead-budget or
+/// PIRA_INSTR_OVERHEAD_BUDGET; 0 if there is none.
+double getOverheadBudget();
+
+/// The report of the functions pruned by the overhead budget, taken from -overhead-report or
+/// PIRA_INSTR_OVERHEAD_REPORT.
+std::string getOverheadReportFile();
+
+/// The directory of the per-module manifests of the filter entries, taken from -manifest-dir or
+/// PIRA_INSTR_MANIFEST_DIR.
+std::string getManifestDirectory();
+
+/// The directory of the per-module remark files, taken from -instrumentation-remarks-dir or PIRA_INSTR_REMARKS_DIR.
+std::string getRemarksDirectory();
+
+/// The directory of the per-module static features of the functions, taken from -features-dir or
+/// PIRA_INSTR_FEATURES_DIR.
+std::string getFeaturesDirectory();
+
+/// Whether every inserted hook is logged to stderr, taken from -instrumentation-verbose or PIRA_INSTR_VERBOSE (any
+/// value but 0).
+bool isVerbose();
+
+}  // namespace pira
+
+#endif  // LLVM_INSTRUMENTATION_OPTIONS_H
@@ -0,0 +1,75 @@
+//===- OverheadBudget.h - Static pruning of too cheap functions -----------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// Estimates per function of a module how expensive a call is, in IR
+// instructions, with the instructions in loops weighted by their nesting
+// depth. If the hooks of a selected function would cost more than the budget
+// (in percent of that estimate) and the function is likely called often, i.e.,
+// from a loop in this module or, for leaf functions, from other modules, it is
+// not instrumented:
+//  - leaf functions are dropped,
+//  - other functions are downgraded to their call sites outside of loops in
+//    this module; the estimate misses the time of their callees.
+// The decisions are appended to a report, one JSON object per line.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_INSTRUMENTATION_OVERHEADBUDGET_H
+#define LLVM_INSTRUMENTATION_OVERHEADBUDGET_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class Function;
+class Module;
+}  // namespace llvm
+
+namespace pira {
+
+class OverheadBudget {
+ public:
+  enum class Decision { Keep, Drop, Downgrade };
+
+  /// Budget in percent of the estimated cost of a call, HookCost is the estimated cost of the hooks of one region.
+  OverheadBudget(llvm::Module &M, double Budget, double HookCost);
+
+  /// The decision for a function that the filter selects. Functions without a body in this module are kept.
+  Decision decide(llvm::StringRef Name);
+
+  /// Appends the functions that were not kept to the report file, if one is set.
+  void writeReport() const;
+
+ private:
+  struct Estimate {
+    double cost{0};
+    unsigned callSiteDepth{0};  // Deepest loop nesting of a call site in this module
+    bool unknownCallers{false};
+    bool leaf{true};
+    Decision decision{Decision::Keep};
+  };
+
+  void estimateCallSites();
+  Estimate estimate(llvm::Function &F) const;
+
+  llvm::Module &module;
+  double budget;
+  double hookCost;
+  llvm::StringMap<unsigned> callSiteDepths;
+  llvm::StringMap<Estimate> estimates;
+  std::vector<std::string> order;  // Decided functions in order, for a stable report
+};
+
+/// Creates the budget of -overhead-budget / PIRA_INSTR_OVERHEAD_BUDGET, nullptr if there is none.
+std::unique_ptr<OverheadBudget> createOverheadBudget(llvm::Module &M, double HookCost);
+
+}  // namespace pira
+
+#endif  // LLVM_INSTRUMENTATION_OVERHEADBUDGET_H
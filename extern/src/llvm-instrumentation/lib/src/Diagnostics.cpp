@@ -0,0 +1,156 @@
+//===- Diagnostics.cpp - Statistics, remarks and timers of the plugin -----===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#include "Diagnostics.h"
+#include "Instrumenter.h"
+#include "Options.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LLVMRemarkStreamer.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/Remarks/RemarkStreamer.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/xxhash.h"
+
+#include <iostream>
+#include <string>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "pira-instrumentation"
+
+STATISTIC(NumFunctions, "Number of instrumented functions");
+STATISTIC(NumCallSites, "Number of instrumented call sites");
+STATISTIC(NumIndirectCallSites, "Number of instrumented indirect call sites");
+STATISTIC(NumLoops, "Number of instrumented loops");
+STATISTIC(NumParallelRegions, "Number of instrumented OpenMP parallel regions");
+STATISTIC(NumInlined, "Number of instrumented inlined function bodies");
+STATISTIC(NumSkipped, "Number of selected regions that were not instrumented");
+
+namespace pira {
+
+const char *const RemarksPassName = DEBUG_TYPE;
+
+namespace {
+
+Statistic &getCounter(RegionKind Kind) {
+  switch (Kind) {
+    case RegionKind::Function:
+      return NumFunctions;
+    case RegionKind::CallSite:
+      return NumCallSites;
+    case RegionKind::IndirectCallSite:
+      return NumIndirectCallSites;
+    case RegionKind::Loop:
+      return NumLoops;
+    case RegionKind::Parallel:
+      return NumParallelRegions;
+    case RegionKind::Inlined:
+      return NumInlined;
+  }
+  llvm_unreachable("Unknown region kind");
+}
+
+/// A remark at Loc, or at the start of F if there is no location
+template <typename RemarkT>
+RemarkT createRemark(StringRef Name, Function &F, const DebugLoc &Loc) {
+  if (Loc) {
+    return RemarkT(RemarksPassName, Name, Loc, &F.getEntryBlock());
+  }
+  return RemarkT(RemarksPassName, Name, &F);
+}
+
+}  // namespace
+
+StringRef getRegionKindName(RegionKind Kind) {
+  switch (Kind) {
+    case RegionKind::Function:
+      return "function";
+    case RegionKind::CallSite:
+      return "call-site";
+    case RegionKind::IndirectCallSite:
+      return "indirect-call-site";
+    case RegionKind::Loop:
+      return "loop";
+    case RegionKind::Parallel:
+      return "parallel";
+    case RegionKind::Inlined:
+      return "inlined";
+  }
+  llvm_unreachable("Unknown region kind");
+}
+
+void reportInstrumented(Function &F, RegionKind Kind, StringRef Region, const DebugLoc &Loc) {
+  ++getCounter(Kind);
+  // Only builds the remark if remarks are requested
+  OptimizationRemarkEmitter ORE(&F);
+  ORE.emit([&]() {
+    return createRemark<OptimizationRemark>("Instrumented", F, Loc)
+           << "instrumented " << ore::NV("Kind", getRegionKindName(Kind)) << " " << ore::NV("Region", Region);
+  });
+}
+
+void reportSkipped(Function &F, RegionKind Kind, StringRef Region, StringRef Reason, const DebugLoc &Loc) {
+  ++NumSkipped;
+  OptimizationRemarkEmitter ORE(&F);
+  ORE.emit([&]() {
+    return createRemark<OptimizationRemarkMissed>("Skipped", F, Loc)
+           << "skipped " << ore::NV("Kind", getRegionKindName(Kind)) << " " << ore::NV("Region", Region) << ": "
+           << ore::NV("Reason", Reason);
+  });
+}
+
+ModuleRemarksFile::ModuleRemarksFile(Module &M) : context(M.getContext()) {
+  const auto Directory = getRemarksDirectory();
+  if (Directory.empty() || context.getMainRemarkStreamer() ||
+      any_of(M, [](const Function &F) { return F.hasFnAttribute(InstrumentedAttr); })) {
+    return;
+  }
+  if (auto EC = sys::fs::create_directories(Directory)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Remarks directory (" << Directory << ") can not be created: "
+              << EC.message() << std::endl;
+    exit(-1);
+  }
+  // Named like the manifests, a source compiled into several objects writes one file per object
+  SmallString<256> Source(M.getSourceFileName());
+  sys::fs::make_absolute(Source);
+  SmallString<256> File(Directory);
+  sys::path::append(File, sys::path::filename(Source) + "-" +
+                              utohexstr(xxHash64(Source.str().str() + "\n" + M.getModuleIdentifier())) +
+                              ".opt.yaml");
+  auto RemarksFile = setupLLVMOptimizationRemarks(context, File, RemarksPassName, "yaml", false);
+  if (!RemarksFile) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Remarks (" << File.str().str()
+              << ") can not be written: " << toString(RemarksFile.takeError()) << std::endl;
+    exit(-1);
+  }
+  file = std::move(*RemarksFile);
+}
+
+ModuleRemarksFile::~ModuleRemarksFile() {
+  if (!file) {
+    return;
+  }
+  // The streamers refer to the file, later passes must not use them
+  context.setLLVMRemarkStreamer(nullptr);
+  context.setMainRemarkStreamer(nullptr);
+  file->keep();
+}
+
+PhaseTimer::PhaseTimer(StringRef Name, StringRef Description)
+    : timer(Name, Description, "pira-instrumentation", "PIRA Instrumentation", TimePassesIsEnabled) {}
+
+}  // namespace pira
@@ -0,0 +1,219 @@
+//===- Features.cpp - Per-module static features of the functions ---------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#include "Features.h"
+#include "Instrumenter.h"
+#include "Options.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace pira {
+
+namespace {
+
+struct FunctionFeatures {
+  int64_t instructions{0};
+  int64_t loopDepth{0};
+  int64_t indirectCalls{0};
+  int64_t floatOps{0};
+  int64_t intOps{0};
+  int64_t controlFlowOps{0};
+  int64_t memoryAccesses{0};
+  StringSet<> callees;
+};
+
+/// Number of elements of a (vector) value of type Ty
+int64_t getNumElements(Type *Ty) {
+  if (auto *VT = dyn_cast<FixedVectorType>(Ty)) {
+    return VT->getNumElements();
+  }
+  return 1;
+}
+
+/// Accesses to local variables are not counted, see Features.h
+bool isLocalAccess(const Value *Pointer) { return isa<AllocaInst>(getUnderlyingObject(Pointer)); }
+
+void addCall(const CallBase &CB, FunctionFeatures &Features) {
+  if (CB.isInlineAsm()) {
+    return;
+  }
+  const auto *Callee = dyn_cast<Function>(CB.getCalledOperand()->stripPointerCasts());
+  if (!Callee) {
+    ++Features.indirectCalls;
+    return;
+  }
+  if (const auto *MI = dyn_cast<MemIntrinsic>(&CB)) {
+    Features.memoryAccesses += isa<MemTransferInst>(MI) ? 2 : 1;
+    return;
+  }
+  if (!Callee->isIntrinsic()) {
+    Features.callees.insert(Callee->getName());
+    // Callbacks, e.g., the outlined parallel regions passed to __kmpc_fork_call, are called through the callee
+    for (const Value *Arg : CB.args()) {
+      if (const auto *Callback = dyn_cast<Function>(Arg->stripPointerCasts())) {
+        Features.callees.insert(Callback->getName());
+      }
+    }
+    return;
+  }
+  // Math intrinsics, e.g., llvm.sqrt or llvm.fmuladd
+  if (CB.getType()->isFPOrFPVectorTy()) {
+    const auto ID = Callee->getIntrinsicID();
+    const int64_t Ops = ID == Intrinsic::fma || ID == Intrinsic::fmuladd ? 2 : 1;
+    Features.floatOps += Ops * getNumElements(CB.getType());
+  }
+}
+
+FunctionFeatures collectFeatures(Function &F) {
+  FunctionFeatures Features;
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+  for (BasicBlock &BB : F) {
+    Features.loopDepth = std::max<int64_t>(Features.loopDepth, LI.getLoopDepth(&BB));
+    for (Instruction &I : BB) {
+      if (isa<DbgInfoIntrinsic>(I)) {
+        continue;
+      }
+      ++Features.instructions;
+      if (const auto *CB = dyn_cast<CallBase>(&I)) {
+        addCall(*CB, Features);
+      } else if (isa<BinaryOperator>(I) || isa<UnaryOperator>(I)) {
+        if (I.getType()->isFPOrFPVectorTy()) {
+          Features.floatOps += getNumElements(I.getType());
+        } else if (I.getType()->isIntOrIntVectorTy()) {
+          Features.intOps += getNumElements(I.getType());
+        }
+      } else if (const Value *Pointer = getLoadStorePointerOperand(&I)) {
+        Features.memoryAccesses += isLocalAccess(Pointer) ? 0 : 1;
+      } else if (const auto *RMW = dyn_cast<AtomicRMWInst>(&I)) {
+        Features.memoryAccesses += isLocalAccess(RMW->getPointerOperand()) ? 0 : 1;
+      } else if (const auto *CmpXchg = dyn_cast<AtomicCmpXchgInst>(&I)) {
+        Features.memoryAccesses += isLocalAccess(CmpXchg->getPointerOperand()) ? 0 : 1;
+      } else if (const auto *Br = dyn_cast<BranchInst>(&I)) {
+        Features.controlFlowOps += Br->isConditional() ? 1 : 0;
+      } else if (isa<SwitchInst>(I) || isa<IndirectBrInst>(I)) {
+        ++Features.controlFlowOps;
+      }
+    }
+  }
+  return Features;
+}
+
+/// Headers of the system and of the C++ standard library
+bool isSystemFile(StringRef File) { return File.startswith("/usr/include/") || File.contains("/include/c++/"); }
+
+json::Object toJSON(const Function &F, const FunctionFeatures &Features, StringRef Source) {
+  SmallString<256> File(Source);
+  int64_t Line = 0;
+  if (const DISubprogram *SP = F.getSubprogram()) {
+    File = SP->getFilename();
+    if (sys::path::is_relative(File)) {
+      File = SP->getDirectory();
+      sys::path::append(File, SP->getFilename());
+    }
+    sys::path::remove_dots(File, true);
+    Line = SP->getLine();
+  }
+  std::vector<std::string> Sorted;
+  for (const auto &Entry : Features.callees) {
+    Sorted.push_back(Entry.getKey().str());
+  }
+  std::sort(Sorted.begin(), Sorted.end());
+  json::Array Callees;
+  for (auto &Callee : Sorted) {
+    Callees.push_back(std::move(Callee));
+  }
+  return json::Object{{"file", File.str().str()},
+                      {"line", Line},
+                      {"systemInclude", isSystemFile(File)},
+                      {"instructions", Features.instructions},
+                      {"loopDepth", Features.loopDepth},
+                      {"callees", std::move(Callees)},
+                      {"indirectCalls", Features.indirectCalls},
+                      {"floatOps", Features.floatOps},
+                      {"intOps", Features.intOps},
+                      {"controlFlowOps", Features.controlFlowOps},
+                      {"memoryAccesses", Features.memoryAccesses}};
+}
+
+}  // namespace
+
+void writeFeatures(Module &M) {
+  const auto Directory = getFeaturesDirectory();
+  if (Directory.empty()) {
+    return;
+  }
+  // As the manifest, written by the first run of the pass only
+  if (any_of(M, [](const Function &F) { return F.hasFnAttribute(InstrumentedAttr); })) {
+    return;
+  }
+  SmallString<256> Source(M.getSourceFileName());
+  sys::fs::make_absolute(Source);
+  sys::path::remove_dots(Source, true);
+
+  json::Object Functions;
+  for (Function &F : M) {
+    if (F.isDeclaration() || F.hasAvailableExternallyLinkage()) {
+      continue;
+    }
+    Functions[F.getName()] = toJSON(F, collectFeatures(F), Source);
+  }
+  json::Object Features{
+      {"module", M.getModuleIdentifier()}, {"source", Source.str()}, {"functions", std::move(Functions)}};
+
+  if (auto EC = sys::fs::create_directories(Directory)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Features directory (" << Directory << ") can not be created: "
+              << EC.message() << std::endl;
+    exit(-1);
+  }
+  SmallString<256> File(Directory);
+  sys::path::append(File, sys::path::filename(Source) + "-" +
+                              utohexstr(xxHash64(Source.str().str() + "\n" + M.getModuleIdentifier())) +
+                              ".features.json");
+  // Written to a temporary file first, see writeManifest
+  SmallString<256> Temporary;
+  int FD;
+  if (auto EC = sys::fs::createUniqueFile(File + ".%%%%%%", FD, Temporary)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Features (" << File.str().str() << ") can not be written: "
+              << EC.message() << std::endl;
+    exit(-1);
+  }
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << json::Value(std::move(Features)) << "\n";
+  }
+  if (auto EC = sys::fs::rename(Temporary, File)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Features (" << File.str().str() << ") can not be written: "
+              << EC.message() << std::endl;
+    exit(-1);
+  }
+}
+
+}  // namespace pira
@@ -0,0 +1,225 @@
+//===- Filter.cpp - Function and call site filter of the instrumenter -----===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#include "Filter.h"
+#include "Options.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Demangle/Demangle.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+using namespace llvm;
+
+namespace pira {
+
+void readWhitelistFile(const std::string &FileName, std::vector<std::string> &Names) {
+  if (!sys::fs::exists(FileName)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Filter file (" << FileName << ") does not exist." << std::endl;
+    exit(-1);
+  }
+  std::ifstream filter(FileName);
+  for (std::string in; std::getline(filter, in);) {
+    Names.push_back(in);
+  }
+}
+
+void readScorePFilterFile(const std::string &FileName, std::vector<FilterRule> &Rules) {
+  if (!sys::fs::exists(FileName)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Filter file (" << FileName << ") does not exist." << std::endl;
+    exit(-1);
+  }
+  std::ifstream filter(FileName);
+  std::string Error;
+  if (!parseScorePFilter(filter, Rules, Error)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: " << Error << std::endl;
+    exit(-1);
+  }
+}
+
+const InstrumentationFilter &InstrumentationFilter::get() {
+  // Initialization of function-local statics is thread-safe, which matters for the ThinLTO backend threads.
+  static const InstrumentationFilter Filter = []() {
+    const auto IndexFile = getFilterIndexFile();
+    if (!IndexFile.empty()) {
+      if (sys::fs::exists(IndexFile)) {
+        if (auto Index = FilterIndex::open(IndexFile)) {
+          return InstrumentationFilter(std::move(Index));
+        }
+        exit(-1);
+      }
+      std::cerr << "[LLVMInstrumentor] [Warning]: Filter index (" << IndexFile
+                << ") does not exist, using the filter files." << std::endl;
+    }
+    const auto WhitelistFileName = getWhitelistFile();
+    const auto ScorePFileName = getScorePFilterFile();
+    if (WhitelistFileName.empty() && ScorePFileName.empty() && useRuntimeGuards()) {
+      // The selection happens at run time, every function gets guarded hooks
+      FilterRule All;
+      All.pattern = {"*", true};
+      return InstrumentationFilter({}, {All});
+    }
+    if (WhitelistFileName.empty() && ScorePFileName.empty() && !getFeaturesDirectory().empty()) {
+      // Only writes the features, e.g., in the uninstrumented build
+      return InstrumentationFilter(std::vector<std::string>{}, std::vector<FilterRule>{});
+    }
+    return InstrumentationFilter(WhitelistFileName, ScorePFileName);
+  }();
+  return Filter;
+}
+
+InstrumentationFilter::InstrumentationFilter(const std::string &WhitelistFileName, const std::string &ScorePFileName) {
+  if (WhitelistFileName.empty() && ScorePFileName.empty()) {
+    report_fatal_error(Twine("No instrumentation configuration in plugin"));
+  }
+  if (!WhitelistFileName.empty()) {
+    std::vector<std::string> Names;
+    readWhitelistFile(WhitelistFileName, Names);
+    for (const auto &Name : Names) {
+      filterList.insert(Name);
+    }
+  }
+  if (!ScorePFileName.empty()) {
+    std::vector<FilterRule> Rules;
+    readScorePFilterFile(ScorePFileName, Rules);
+    addRules(Rules);
+  } else {
+    std::cerr << "[LLVMInstrumentor] [Warning]: Scorep-P file empty" << std::endl;
+  }
+}
+
+InstrumentationFilter::InstrumentationFilter(const std::vector<std::string> &Whitelist,
+                                             const std::vector<FilterRule> &Rules) {
+  for (const auto &Name : Whitelist) {
+    filterList.insert(Name);
+  }
+  addRules(Rules);
+}
+
+InstrumentationFilter::InstrumentationFilter(std::unique_ptr<FilterIndex> Index) : index(std::move(Index)) {
+  addRules(index->getRules());
+}
+
+void InstrumentationFilter::addRules(const std::vector<FilterRule> &Rules) {
+  for (const auto &Rule : Rules) {
+    if (Rule.isCallSite) {
+      const unsigned id = callSiteRuleIncludes.size();
+      callSiteRuleIncludes.push_back(Rule.include);
+      callSiteRuleIndirect.push_back(Rule.isIndirect);
+      callerRules.add(Rule.pattern, id);
+      if (!Rule.isIndirect) {
+        calleeRules.add(Rule.callee, id);
+      }
+    } else if (Rule.loopDepth > 0) {
+      const unsigned id = loopRuleDepths.size();
+      loopRuleDepths.push_back(Rule.include ? Rule.loopDepth : 0);
+      loopRules.add(Rule.pattern, id);
+    } else if (Rule.parallel) {
+      const unsigned id = parallelRuleIncludes.size();
+      parallelRuleIncludes.push_back(Rule.include);
+      parallelRules.add(Rule.pattern, id);
+    } else {
+      const unsigned id = functionRuleIncludes.size();
+      functionRuleIncludes.push_back(Rule.include);
+      functionRules.add(Rule.pattern, id);
+    }
+  }
+}
+
+void InstrumentationFilter::NameMatcher::add(const FilterPattern &Pattern, unsigned Id) {
+  (Pattern.mangled ? mangled : plain).add(Pattern.text, Id);
+}
+
+int64_t InstrumentationFilter::NameMatcher::matchLast(StringRef Name) const {
+  auto Last = std::max(mangled.matchLast(Name), plain.matchLast(Name));
+  if (!plain.empty() && Name.startswith("_Z")) {
+    Last = std::max(Last, plain.matchLast(demangle(Name.str())));
+  }
+  return Last;
+}
+
+void InstrumentationFilter::NameMatcher::match(StringRef Name, SmallVectorImpl<unsigned> &Ids) const {
+  mangled.match(Name, Ids);
+  plain.match(Name, Ids);
+  if (!plain.empty() && Name.startswith("_Z")) {
+    plain.match(demangle(Name.str()), Ids);
+  }
+}
+
+bool InstrumentationFilter::isFiltered(StringRef FuncName) const {
+  if (index) {
+    // Exact names carry the final decision of all rules
+    if (const auto Flags = index->lookupFunction(FuncName)) {
+      return Flags & index::Instrument;
+    }
+  }
+  if (filterList.count(FuncName)) {
+    return true;
+  }
+  const auto Rule = functionRules.matchLast(FuncName);
+  return Rule >= 0 && functionRuleIncludes[Rule];
+}
+
+unsigned InstrumentationFilter::getLoopDepth(StringRef FuncName) const {
+  if (loopRuleDepths.empty()) {
+    return 0;
+  }
+  const auto Rule = loopRules.matchLast(FuncName);
+  return Rule >= 0 ? loopRuleDepths[Rule] : 0;
+}
+
+bool InstrumentationFilter::isParallelRegionFiltered(StringRef Parent) const {
+  if (parallelRuleIncludes.empty()) {
+    return false;
+  }
+  const auto Rule = parallelRules.matchLast(Parent);
+  return Rule >= 0 && parallelRuleIncludes[Rule];
+}
+
+InstrumentationFilter::CallSiteRules InstrumentationFilter::getCallSiteRules(StringRef Caller) const {
+  CallSiteRules Rules;
+  if (index) {
+    Rules.hasIndexedCallSites = index->lookupFunction(Caller) & index::HasCallSites;
+  }
+  callerRules.match(Caller, Rules.ids);
+  llvm::sort(Rules.ids);
+  Rules.ids.erase(std::unique(Rules.ids.begin(), Rules.ids.end()), Rules.ids.end());
+  return Rules;
+}
+
+bool InstrumentationFilter::isCallSiteFiltered(StringRef Caller, const CallSiteRules &Rules, StringRef Callee) const {
+  if (Rules.hasIndexedCallSites) {
+    if (const auto Flags = index->lookupCallSite(Caller, Callee)) {
+      return Flags & index::Instrument;
+    }
+  }
+  SmallVector<unsigned, 4> CalleeMatches;
+  calleeRules.match(Callee, CalleeMatches);
+  int64_t Last = -1;
+  for (const auto Id : CalleeMatches) {
+    if (Id > Last && std::binary_search(Rules.ids.begin(), Rules.ids.end(), Id)) {
+      Last = Id;
+    }
+  }
+  return Last >= 0 && callSiteRuleIncludes[Last];
+}
+
+bool InstrumentationFilter::isIndirectCallSiteFiltered(const CallSiteRules &Rules) const {
+  // Indirect calls match only the INDIRECT rules, the ids are sorted
+  for (auto It = Rules.ids.rbegin(); It != Rules.ids.rend(); ++It) {
+    if (callSiteRuleIndirect[*It]) {
+      return callSiteRuleIncludes[*It];
+    }
+  }
+  return false;
+}
+
+}  // namespace pira
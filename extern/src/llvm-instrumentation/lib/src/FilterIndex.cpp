@@ -0,0 +1,244 @@
+//===- FilterIndex.cpp - Precompiled, memory-mapped filter ----------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#include "FilterIndex.h"
+#include "Filter.h"
+
+#include "llvm/Support/xxhash.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace llvm;
+
+namespace pira {
+
+using namespace index;
+
+namespace {
+template <typename T>
+const T *at(const char *Base, uint64_t Offset) {
+  // The writer aligns all tables to 8 bytes, the mapping is page aligned
+  return reinterpret_cast<const T *>(static_cast<const void *>(Base + Offset));
+}
+
+uint64_t nextPowerOfTwo(uint64_t N) {
+  uint64_t P = 1;
+  while (P < N) {
+    P <<= 1;
+  }
+  return P;
+}
+
+void alignTo8(raw_ostream &OS, uint64_t &Pos) {
+  while (Pos % 8 != 0) {
+    OS << '\0';
+    ++Pos;
+  }
+}
+}  // namespace
+
+uint32_t FilterIndex::hashName(StringRef Name) { return static_cast<uint32_t>(xxHash64(Name)); }
+
+uint32_t FilterIndex::hashCallSite(StringRef Caller, StringRef Callee) {
+  return static_cast<uint32_t>(xxHash64(Caller) ^ (xxHash64(Callee) * 0x9E3779B97F4A7C15ULL));
+}
+
+std::unique_ptr<FilterIndex> FilterIndex::open(const std::string &FileName) {
+  uint64_t Size = 0;
+  if (sys::fs::file_size(FileName, Size) || Size < sizeof(Header)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Filter index (" << FileName << ") can not be read." << std::endl;
+    return nullptr;
+  }
+  auto FD = sys::fs::openNativeFileForRead(FileName);
+  if (!FD) {
+    consumeError(FD.takeError());
+    std::cerr << "[LLVMInstrumentor] [Error]: Filter index (" << FileName << ") can not be opened." << std::endl;
+    return nullptr;
+  }
+  std::error_code EC;
+  sys::fs::mapped_file_region Region(*FD, sys::fs::mapped_file_region::readonly, Size, 0, EC);
+  sys::fs::closeFile(*FD);
+  if (EC) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Filter index (" << FileName << ") can not be mapped: " << EC.message()
+              << std::endl;
+    return nullptr;
+  }
+  std::unique_ptr<FilterIndex> Index(new FilterIndex(std::move(Region)));
+  if (!Index->validate()) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Filter index (" << FileName << ") is invalid or of another version."
+              << std::endl;
+    return nullptr;
+  }
+  return Index;
+}
+
+FilterIndex::FilterIndex(sys::fs::mapped_file_region Region)
+    : region(std::move(Region)), header(at<Header>(region.const_data(), 0)) {}
+
+bool FilterIndex::validate() {
+  const uint64_t Size = region.size();
+  if (std::memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version) {
+    return false;
+  }
+  auto InBounds = [Size](uint64_t Offset, uint64_t Count, uint64_t EntrySize) {
+    return Offset % 8 == 0 && Offset <= Size && Count <= (Size - Offset) / EntrySize;
+  };
+  auto IsPowerOfTwo = [](uint64_t N) { return N != 0 && (N & (N - 1)) == 0; };
+  if (!IsPowerOfTwo(header->functionTableSize) || !IsPowerOfTwo(header->callSiteTableSize) ||
+      !InBounds(header->functionTableOffset, header->functionTableSize, sizeof(FunctionEntry)) ||
+      !InBounds(header->callSiteTableOffset, header->callSiteTableSize, sizeof(CallSiteEntry)) ||
+      !InBounds(header->ruleOffset, header->numRules, sizeof(RuleEntry)) ||
+      !InBounds(header->stringOffset, header->stringSize, 1)) {
+    return false;
+  }
+  functions = at<FunctionEntry>(region.const_data(), header->functionTableOffset);
+  callSites = at<CallSiteEntry>(region.const_data(), header->callSiteTableOffset);
+  rules = at<RuleEntry>(region.const_data(), header->ruleOffset);
+  strings = region.const_data() + header->stringOffset;
+  return true;
+}
+
+StringRef FilterIndex::getString(uint32_t Offset, uint32_t Length) const {
+  // Checked here instead of in validate(), which would touch every page of the mapping
+  if (static_cast<uint64_t>(Offset) + Length > header->stringSize) {
+    return StringRef();
+  }
+  return StringRef(strings + Offset, Length);
+}
+
+uint32_t FilterIndex::lookupFunction(StringRef Name) const {
+  const uint32_t Hash = hashName(Name);
+  const uint64_t Mask = header->functionTableSize - 1;
+  // The table is at most half full, probing reaches an empty bucket long before the bound
+  for (uint64_t i = Hash & Mask, n = 0; n <= Mask; i = (i + 1) & Mask, ++n) {
+    const auto &E = functions[i];
+    if (!(E.flags & Used)) {
+      return 0;
+    }
+    if (E.hash == Hash && getString(E.nameOffset, E.nameLength) == Name) {
+      return E.flags;
+    }
+  }
+  return 0;
+}
+
+uint32_t FilterIndex::lookupCallSite(StringRef Caller, StringRef Callee) const {
+  const uint32_t Hash = hashCallSite(Caller, Callee);
+  const uint64_t Mask = header->callSiteTableSize - 1;
+  for (uint64_t i = Hash & Mask, n = 0; n <= Mask; i = (i + 1) & Mask, ++n) {
+    const auto &E = callSites[i];
+    if (!(E.flags & Used)) {
+      return 0;
+    }
+    if (E.hash == Hash && getString(E.callerOffset, E.callerLength) == Caller &&
+        getString(E.calleeOffset, E.calleeLength) == Callee) {
+      return E.flags;
+    }
+  }
+  return 0;
+}
+
+std::vector<FilterRule> FilterIndex::getRules() const {
+  std::vector<FilterRule> Result;
+  Result.reserve(header->numRules);
+  for (uint64_t i = 0; i < header->numRules; ++i) {
+    const auto &E = rules[i];
+    FilterRule Rule;
+    Rule.include = E.flags & Include;
+    Rule.isCallSite = E.flags & CallSite;
+    Rule.isIndirect = E.flags & Indirect;
+    Rule.loopDepth = E.flags >> LoopDepthShift;
+    Rule.parallel = E.flags & Parallel;
+    Rule.pattern = {getString(E.patternOffset, E.patternLength).str(), (E.flags & PatternMangled) != 0};
+    Rule.callee = {getString(E.calleeOffset, E.calleeLength).str(), (E.flags & CalleeMangled) != 0};
+    Result.push_back(std::move(Rule));
+  }
+  return Result;
+}
+
+uint32_t FilterIndexWriter::intern(StringRef Str) {
+  const auto It = stringOffsets.insert({Str, static_cast<uint32_t>(strings.size())});
+  if (It.second) {
+    strings.append(Str.begin(), Str.end());
+  }
+  return It.first->second;
+}
+
+void FilterIndexWriter::addFunction(StringRef Name, uint32_t Flags) {
+  functions.push_back({FilterIndex::hashName(Name), intern(Name), static_cast<uint32_t>(Name.size()), Flags | Used});
+}
+
+void FilterIndexWriter::addCallSite(StringRef Caller, StringRef Callee, bool Instrument) {
+  callSites.push_back({FilterIndex::hashCallSite(Caller, Callee), intern(Caller), static_cast<uint32_t>(Caller.size()),
+                       intern(Callee), static_cast<uint32_t>(Callee.size()),
+                       Used | (Instrument ? index::Instrument : 0U)});
+}
+
+void FilterIndexWriter::addRule(const FilterRule &Rule) {
+  uint32_t Flags = (Rule.include ? Include : 0U) | (Rule.isCallSite ? CallSite : 0U) |
+                   (Rule.pattern.mangled ? PatternMangled : 0U) | (Rule.callee.mangled ? CalleeMangled : 0U) |
+                   (Rule.isIndirect ? Indirect : 0U) | (Rule.parallel ? Parallel : 0U) |
+                   (Rule.loopDepth << LoopDepthShift);
+  rules.push_back({Flags, intern(Rule.pattern.text), static_cast<uint32_t>(Rule.pattern.text.size()),
+                   intern(Rule.callee.text), static_cast<uint32_t>(Rule.callee.text.size())});
+}
+
+void FilterIndexWriter::write(raw_ostream &OS) {
+  // Load factor of at most 1/2
+  std::vector<FunctionEntry> FunctionTable(nextPowerOfTwo(2 * functions.size() + 1), FunctionEntry{0, 0, 0, 0});
+  for (const auto &E : functions) {
+    const uint64_t Mask = FunctionTable.size() - 1;
+    uint64_t i = E.hash & Mask;
+    while (FunctionTable[i].flags & Used) {
+      i = (i + 1) & Mask;
+    }
+    FunctionTable[i] = E;
+  }
+  std::vector<CallSiteEntry> CallSiteTable(nextPowerOfTwo(2 * callSites.size() + 1), CallSiteEntry{0, 0, 0, 0, 0, 0});
+  for (const auto &E : callSites) {
+    const uint64_t Mask = CallSiteTable.size() - 1;
+    uint64_t i = E.hash & Mask;
+    while (CallSiteTable[i].flags & Used) {
+      i = (i + 1) & Mask;
+    }
+    CallSiteTable[i] = E;
+  }
+
+  Header H;
+  std::memset(&H, 0, sizeof(H));
+  std::memcpy(H.magic, Magic, sizeof(Magic));
+  H.version = Version;
+  uint64_t Pos = sizeof(Header);
+  H.functionTableOffset = Pos;
+  H.functionTableSize = FunctionTable.size();
+  Pos += FunctionTable.size() * sizeof(FunctionEntry);
+  H.callSiteTableOffset = Pos;
+  H.callSiteTableSize = CallSiteTable.size();
+  Pos += CallSiteTable.size() * sizeof(CallSiteEntry);
+  Pos = (Pos + 7) / 8 * 8;
+  H.ruleOffset = Pos;
+  H.numRules = rules.size();
+  Pos += rules.size() * sizeof(RuleEntry);
+  Pos = (Pos + 7) / 8 * 8;
+  H.stringOffset = Pos;
+  H.stringSize = strings.size();
+
+  uint64_t Written = 0;
+  auto WriteRaw = [&OS, &Written](const void *Data, size_t Size) {
+    OS.write(static_cast<const char *>(Data), Size);
+    Written += Size;
+  };
+  WriteRaw(&H, sizeof(H));
+  WriteRaw(FunctionTable.data(), FunctionTable.size() * sizeof(FunctionEntry));
+  WriteRaw(CallSiteTable.data(), CallSiteTable.size() * sizeof(CallSiteEntry));
+  alignTo8(OS, Written);
+  WriteRaw(rules.data(), rules.size() * sizeof(RuleEntry));
+  alignTo8(OS, Written);
+  WriteRaw(strings.data(), strings.size());
+}
+
+}  // namespace pira
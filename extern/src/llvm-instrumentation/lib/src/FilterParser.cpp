@@ -0,0 +1,176 @@
+//===- FilterParser.cpp - Parser of the Score-P filter file ---------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#include "FilterParser.h"
+
+#include <string_view>
+
+namespace pira {
+
+bool parseScorePFilter(std::istream &filter, std::vector<FilterRule> &Rules, std::string &Error) {
+  std::string linebuffer;
+  std::string_view linebuffer_view;
+  bool failed = false;
+
+  /// Keeps the first error, the parser stops at the next token
+  auto fail = [&failed, &Error](const std::string &message) {
+    if (!failed) {
+      Error = message;
+      failed = true;
+    }
+  };
+
+  enum class ParserState {
+    Normal /*Content without special meaning*/,
+    Block /*Func filter block*/,
+    Rule /*INCLUDE or EXCLUDE rule that has no item yet*/,
+    RuleFinished /*rule that can be finished*/,
+  };
+
+  /// Returns the next token in the filter file as the parameter out.
+  /// Skips all whitespace and comments, returns false if no token exists
+  auto get_next_token = [&filter, &linebuffer, &linebuffer_view, &fail](std::string_view &out, ParserState state) {
+    const std::string whitespace = " \t\r";
+    auto first_not_whitespace = linebuffer_view.find_first_not_of(whitespace);
+    while (first_not_whitespace == std::string_view::npos || linebuffer_view[first_not_whitespace] == '#') {
+      if (!std::getline(filter, linebuffer)) {
+        if (state != ParserState::Normal) {
+          fail("Unexpected ending in filter file.");
+        }
+        return false;
+      }
+      linebuffer_view = linebuffer;
+      first_not_whitespace = linebuffer_view.find_first_not_of(whitespace);
+    }
+    // Skip whitespace and commets
+    linebuffer_view.remove_prefix(first_not_whitespace);
+    auto endtoken = linebuffer_view.find_first_of(" \t\r#");
+    if (endtoken == std::string_view::npos) {
+      endtoken = linebuffer_view.length();
+    }
+    out = std::string_view(linebuffer_view.data(), endtoken);
+    linebuffer_view.remove_prefix(endtoken);
+    return true;
+  };
+
+  auto parser_error = [&fail](std::string_view token) {
+    fail("Unexpected token \"" + std::string(token) + "\" in filter file.");
+  };
+
+  auto is_keyword = [](std::string_view token) {
+    return token == "SCOREP_REGION_NAMES_BEGIN" || token == "SCOREP_REGION_NAMES_END" || token == "INCLUDE" ||
+           token == "EXCLUDE" || token == "MANGLED" || token == "->" || token == "LOOPS" || token == "PARALLEL" ||
+           token.substr(0, 6) == "LOOPS=";
+  };
+
+  /// LOOPS or LOOPS=<depth>, returns the depth or 0 if token is no loop modifier
+  auto get_loop_depth = [&parser_error](std::string_view token) -> unsigned {
+    if (token == "LOOPS") {
+      return 1;
+    }
+    if (token.substr(0, 6) != "LOOPS=") {
+      return 0;
+    }
+    const std::string depth(token.substr(6));
+    if (depth.empty() || depth.size() > 3 || depth.find_first_not_of("0123456789") != std::string::npos ||
+        std::stoul(depth) == 0) {
+      parser_error(token);
+      return 0;
+    }
+    return std::stoul(depth);
+  };
+
+  ParserState state = ParserState::Normal;
+  bool include = true;
+  bool rule_mangled = false;
+  unsigned rule_loop_depth = 0;
+  bool rule_parallel = false;
+
+  std::string_view token;
+  while (!failed && (state == ParserState::RuleFinished || get_next_token(token, state))) {
+    if (token == "SCOREP_REGION_NAMES_BEGIN") {
+      if (state == ParserState::Normal) {
+        state = ParserState::Block;
+      } else {
+        parser_error(token);
+      }
+    } else if (token == "SCOREP_REGION_NAMES_END") {
+      if (state == ParserState::Block || state == ParserState::RuleFinished) {
+        state = ParserState::Normal;
+      } else {
+        parser_error(token);
+      }
+    } else if (token == "INCLUDE" || token == "EXCLUDE") {
+      if (state == ParserState::Block || state == ParserState::RuleFinished) {
+        state = ParserState::Rule;
+        include = token == "INCLUDE";
+        rule_mangled = false;
+        rule_loop_depth = 0;
+        rule_parallel = false;
+      } else {
+        parser_error(token);
+      }
+    } else if (token == "MANGLED" && state == ParserState::Rule && !rule_mangled) {
+      // INCLUDE MANGLED <patterns>
+      rule_mangled = true;
+    } else if (state == ParserState::Rule && rule_loop_depth == 0 && !rule_parallel && get_loop_depth(token) > 0) {
+      // INCLUDE LOOPS=<depth> [MANGLED] <patterns>
+      rule_loop_depth = get_loop_depth(token);
+    } else if (token == "PARALLEL" && state == ParserState::Rule && rule_loop_depth == 0 && !rule_parallel) {
+      // INCLUDE PARALLEL [MANGLED] <patterns>
+      rule_parallel = true;
+    } else {
+      if (state != ParserState::Rule && state != ParserState::RuleFinished) {
+        parser_error(token);
+      }
+      // Helper function to parse a pattern. sets token to the next token
+      auto get_pattern = [&]() {
+        if (is_keyword(token)) {
+          parser_error(token);
+        }
+        FilterPattern pattern{std::string(token), rule_mangled};
+        // Look ahead one token to check for the "<name> MANGLED <mangled name>" form
+        get_next_token(token, state);
+        if (token == "MANGLED") {
+          get_next_token(token, state);
+          if (is_keyword(token)) {
+            parser_error(token);
+          }
+          pattern = {std::string(token), true};
+          get_next_token(token, state);
+        }
+        return pattern;
+      };
+      FilterRule rule;
+      rule.include = include;
+      rule.loopDepth = rule_loop_depth;
+      rule.parallel = rule_parallel;
+      rule.pattern = get_pattern();
+      if (token == "->") {
+        if (rule_loop_depth > 0 || rule_parallel) {
+          parser_error(token);
+        }
+        get_next_token(token, state);
+        rule.isCallSite = true;
+        if (token == "INDIRECT") {
+          // caller -> INDIRECT
+          rule.isIndirect = true;
+          get_next_token(token, state);
+        } else {
+          rule.callee = get_pattern();
+        }
+      }
+      Rules.push_back(std::move(rule));
+      state = ParserState::RuleFinished;
+    }
+  }
+  if (state != ParserState::Normal) {
+    fail("Unexpected ending in filter file.");
+  }
+  return !failed;
+}
+
+}  // namespace pira
@@ -0,0 +1,173 @@
+//===- GlobMatcher.cpp - Matches names against many glob patterns at once -===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#include "GlobMatcher.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+namespace pira {
+
+GlobMatcher::GlobMatcher() { addNode(); }
+
+uint32_t GlobMatcher::addNode() {
+  nodes.emplace_back();
+  return nodes.size() - 1;
+}
+
+uint32_t GlobMatcher::getOrAddLiteral(uint32_t From, unsigned char C) {
+  const uint64_t Key = (static_cast<uint64_t>(From) << 8) | C;
+  const auto E = literalEdges.find(Key);
+  if (E != literalEdges.end()) {
+    return E->second;
+  }
+  const auto To = addNode();
+  literalEdges[Key] = To;
+  return To;
+}
+
+uint32_t GlobMatcher::getOrAddClass(uint32_t From, const CharSet &Chars) {
+  auto &Edges = classEdges[From];
+  for (const auto &E : Edges) {
+    if (E.chars == Chars) {
+      return E.target;
+    }
+  }
+  const auto To = addNode();
+  Edges.push_back({Chars, To});
+  return To;
+}
+
+uint32_t GlobMatcher::getOrAddStar(uint32_t From) {
+  // "a**b" is the same as "a*b"
+  if (nodes[From].isStar) {
+    return From;
+  }
+  if (nodes[From].star == None) {
+    const auto To = addNode();
+    nodes[To].isStar = true;
+    nodes[From].star = To;
+  }
+  return nodes[From].star;
+}
+
+void GlobMatcher::add(StringRef Pattern, unsigned Id) {
+  uint32_t Cur = 0;
+  for (size_t i = 0; i < Pattern.size(); ++i) {
+    const char C = Pattern[i];
+    if (C == '*') {
+      Cur = getOrAddStar(Cur);
+    } else if (C == '?') {
+      Cur = getOrAddClass(Cur, CharSet().set());
+    } else if (C == '\\' && i + 1 < Pattern.size()) {
+      Cur = getOrAddLiteral(Cur, Pattern[++i]);
+    } else if (C == '[') {
+      // Parse a bracket expression, an unterminated one is taken literally
+      size_t j = i + 1;
+      const bool Negate = j < Pattern.size() && (Pattern[j] == '!' || Pattern[j] == '^');
+      if (Negate) {
+        ++j;
+      }
+      CharSet Chars;
+      bool First = true;
+      for (; j < Pattern.size() && (First || Pattern[j] != ']'); ++j, First = false) {
+        unsigned char Lo = Pattern[j];
+        if (Lo == '\\' && j + 1 < Pattern.size()) {
+          Lo = Pattern[++j];
+        }
+        unsigned char Hi = Lo;
+        if (j + 2 < Pattern.size() && Pattern[j + 1] == '-' && Pattern[j + 2] != ']') {
+          Hi = Pattern[j + 2];
+          j += 2;
+        }
+        for (unsigned Ch = Lo; Ch <= Hi; ++Ch) {
+          Chars.set(Ch);
+        }
+      }
+      if (j >= Pattern.size()) {
+        Cur = getOrAddLiteral(Cur, C);
+        continue;
+      }
+      Cur = getOrAddClass(Cur, Negate ? ~Chars : Chars);
+      i = j;
+    } else {
+      Cur = getOrAddLiteral(Cur, C);
+    }
+  }
+  nodes[Cur].accept.push_back(Id);
+  ++numPatterns;
+}
+
+void GlobMatcher::addState(uint32_t N, SmallVectorImpl<uint32_t> &States) const {
+  if (std::find(States.begin(), States.end(), N) != States.end()) {
+    return;
+  }
+  States.push_back(N);
+  // A '*' also matches the empty string
+  if (nodes[N].star != None) {
+    addState(nodes[N].star, States);
+  }
+}
+
+void GlobMatcher::run(StringRef Name, SmallVectorImpl<uint32_t> &States) const {
+  SmallVector<uint32_t, 8> Next;
+  States.clear();
+  addState(0, States);
+  for (const char C : Name) {
+    const unsigned char UC = C;
+    Next.clear();
+    for (const auto S : States) {
+      if (nodes[S].isStar) {
+        addState(S, Next);
+      }
+      const auto L = literalEdges.find((static_cast<uint64_t>(S) << 8) | UC);
+      if (L != literalEdges.end()) {
+        addState(L->second, Next);
+      }
+      const auto CE = classEdges.find(S);
+      if (CE != classEdges.end()) {
+        for (const auto &E : CE->second) {
+          if (E.chars.test(UC)) {
+            addState(E.target, Next);
+          }
+        }
+      }
+    }
+    States.swap(Next);
+    if (States.empty()) {
+      return;
+    }
+  }
+}
+
+void GlobMatcher::match(StringRef Name, SmallVectorImpl<unsigned> &Ids) const {
+  if (empty()) {
+    return;
+  }
+  SmallVector<uint32_t, 8> States;
+  run(Name, States);
+  for (const auto S : States) {
+    Ids.append(nodes[S].accept.begin(), nodes[S].accept.end());
+  }
+}
+
+int64_t GlobMatcher::matchLast(StringRef Name) const {
+  int64_t Last = -1;
+  if (empty()) {
+    return Last;
+  }
+  SmallVector<uint32_t, 8> States;
+  run(Name, States);
+  for (const auto S : States) {
+    for (const auto Id : nodes[S].accept) {
+      Last = std::max<int64_t>(Last, Id);
+    }
+  }
+  return Last;
+}
+
+}  // namespace pira
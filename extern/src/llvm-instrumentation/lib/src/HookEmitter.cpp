@@ -0,0 +1,420 @@
+//===- HookEmitter.cpp - Code emitted at region entry and exit ------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#include "HookEmitter.h"
+#include "Options.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Type.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+#include <iostream>
+#include <tuple>
+#include <utility>
+
+using namespace llvm;
+
+namespace pira {
+
+HookEmitter::Region::Region(Function &F) : kind(Kind::Function), function(F), name(F.getName().str()) {}
+
+HookEmitter::Region::Region(Kind K, Function &F, std::string Name, unsigned Line, Value *Target)
+    : kind(K), function(F), name(std::move(Name)), line(Line), target(Target) {}
+
+static void insertCall(Value *CurFn, StringRef Func, Instruction *InsertionPt, DebugLoc DL) {
+  Module &M = *InsertionPt->getParent()->getParent()->getParent();
+  LLVMContext &C = InsertionPt->getParent()->getContext();
+
+  if (Func == "mcount" || Func == ".mcount" || Func == "llvm.arm.gnu.eabi.mcount" || Func == "\01_mcount" ||
+      Func == "\01mcount" || Func == "__mcount" || Func == "_mcount" || Func == "__cyg_profile_func_enter_bare") {
+    FunctionCallee Fn = M.getOrInsertFunction(Func, Type::getVoidTy(C));
+    CallInst *Call = CallInst::Create(Fn, "", InsertionPt);
+    Call->setDebugLoc(DL);
+    return;
+  }
+
+  if (Func == "__cyg_profile_func_enter" || Func == "__cyg_profile_func_exit") {
+    Type *ArgTypes[] = {Type::getInt8PtrTy(C), Type::getInt8PtrTy(C)};
+
+    FunctionCallee Fn = M.getOrInsertFunction(Func, FunctionType::get(Type::getVoidTy(C), ArgTypes, false));
+
+    Instruction *RetAddr =
+        CallInst::Create(Intrinsic::getDeclaration(&M, Intrinsic::returnaddress),
+                         ArrayRef<Value *>(ConstantInt::get(Type::getInt32Ty(C), 0)), "", InsertionPt);
+    RetAddr->setDebugLoc(DL);
+
+    // Indirect call sites pass the called pointer
+    Value *Callee;
+    if (auto *Const = dyn_cast<Constant>(CurFn))
+      Callee = ConstantExpr::getBitCast(Const, Type::getInt8PtrTy(C));
+    else
+      Callee = CastInst::CreatePointerCast(CurFn, Type::getInt8PtrTy(C), "", InsertionPt);
+    Value *Args[] = {Callee, RetAddr};
+
+    CallInst *Call = CallInst::Create(Fn, ArrayRef<Value *>(Args), "", InsertionPt);
+    Call->setDebugLoc(DL);
+    return;
+  }
+
+  // We only know how to call a fixed set of instrumentation functions, because
+  // they all expect different arguments, etc.
+  report_fatal_error(Twine("Unknown instrumentation function: '") + Func + "'");
+}
+
+HookEmitter::RegionState CygProfileHookEmitter::emitEntry(const Region &R, Instruction *IP, const DebugLoc &DL) {
+  insertCall(R.target ? R.target : &R.function, "__cyg_profile_func_enter", IP, DL);
+  return {};
+}
+
+void CygProfileHookEmitter::emitExit(const Region &R, const RegionState &, Instruction *IP, const DebugLoc &DL) {
+  insertCall(R.target ? R.target : &R.function, "__cyg_profile_func_exit", IP, DL);
+}
+
+// Must match the structures in runtime/include/PiraRuntime.h
+constexpr uint32_t TimerABIVersion = 1;
+constexpr uint32_t TimerClockCycles = 0;
+constexpr uint32_t TimerClockNanoseconds = 1;
+
+// Before the constructors of the instrumented code
+constexpr int SectionCtorPriority = 2;
+
+static Constant *createPrivateString(Module &M, StringRef Str, const Twine &Name) {
+  auto *Data = ConstantDataArray::getString(M.getContext(), Str);
+  auto *GV = new GlobalVariable(M, Data->getType(), /*isConstant=*/true, GlobalValue::PrivateLinkage, Data, Name);
+  GV->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+  return ConstantExpr::getPointerCast(GV, Type::getInt8PtrTy(M.getContext()));
+}
+
+/// Places the entries of this module in Section and registers a constructor that passes the bounds of the section
+/// to InitName. The linker defines the bounds; one constructor per executable / shared library is kept, as with the
+/// sanitizer coverage tables.
+static void createSectionTable(Module &M, StructType *EntryTy, ArrayRef<Constant *> Entries, StringRef Section,
+                               StringRef CtorName, StringRef InitName) {
+  auto *TableTy = ArrayType::get(EntryTy, Entries.size());
+  auto *Table = new GlobalVariable(M, TableTy, /*isConstant=*/true, GlobalValue::PrivateLinkage,
+                                   ConstantArray::get(TableTy, Entries), "__" + Section + "_table");
+  Table->setSection(Section);
+  // The tables of all modules must be contiguous in the section, i.e., without additional alignment
+  Table->setAlignment(MaybeAlign(M.getDataLayout().getPointerABIAlignment(0)));
+  // Only referenced through the section bounds
+  appendToCompilerUsed(M, {Table});
+
+  auto getBound = [&](const Twine &Name) {
+    auto *Bound = M.getNamedGlobal(Name.str());
+    if (!Bound) {
+      Bound = new GlobalVariable(M, EntryTy, /*isConstant=*/false, GlobalValue::ExternalLinkage, nullptr, Name);
+      Bound->setVisibility(GlobalValue::HiddenVisibility);
+    }
+    return Bound;
+  };
+  auto *EntryPtrTy = EntryTy->getPointerTo();
+  Function *Ctor;
+  std::tie(Ctor, std::ignore) =
+      createSanitizerCtorAndInitFunctions(M, CtorName, InitName, {EntryPtrTy, EntryPtrTy},
+                                          {getBound("__start_" + Section), getBound("__stop_" + Section)});
+  if (Triple(M.getTargetTriple()).supportsCOMDAT()) {
+    Ctor->setComdat(M.getOrInsertComdat(Ctor->getName()));
+    appendToGlobalCtors(M, Ctor, SectionCtorPriority, Ctor);
+  } else {
+    appendToGlobalCtors(M, Ctor, SectionCtorPriority);
+  }
+}
+
+static StructType *getTimerSlotType(LLVMContext &C) {
+  // { calls, ticks }
+  return StructType::get(Type::getInt64Ty(C), Type::getInt64Ty(C));
+}
+
+static StructType *getTimerModuleType(LLVMContext &C) {
+  // { version, clock, number of regions, region names, module name }
+  auto *I32 = Type::getInt32Ty(C);
+  auto *I8Ptr = Type::getInt8PtrTy(C);
+  return StructType::get(I32, I32, I32, I8Ptr->getPointerTo(), I8Ptr);
+}
+
+static bool hasCycleCounter(const Module &M) { return Triple(M.getTargetTriple()).isX86(); }
+
+void InlineTimerHookEmitter::createModuleGlobals() {
+  if (moduleDesc) {
+    return;
+  }
+  auto &C = module.getContext();
+  // The initializer is set in finalize, when the number of regions is known
+  moduleDesc = new GlobalVariable(module, getTimerModuleType(C), /*isConstant=*/false, GlobalValue::PrivateLinkage,
+                                  nullptr, "__pira_timer_module");
+  // Initial exec: the access is a single load relative to the thread pointer. Shared libraries with this model need
+  // a few bytes of the static TLS surplus of the loader, which is enough for the 8 bytes per module.
+  auto *SlotPtrTy = getTimerSlotType(C)->getPointerTo();
+  threadSlots = new GlobalVariable(module, SlotPtrTy, /*isConstant=*/false, GlobalValue::PrivateLinkage,
+                                   ConstantPointerNull::get(SlotPtrTy), "__pira_timer_slots", nullptr,
+                                   GlobalValue::InitialExecTLSModel);
+}
+
+Value *InlineTimerHookEmitter::emitTimestamp(Instruction *IP, const DebugLoc &DL) {
+  IRBuilder<> IRB(IP);
+  IRB.SetCurrentDebugLocation(DL);
+  if (hasCycleCounter(module)) {
+    return IRB.CreateCall(Intrinsic::getDeclaration(&module, Intrinsic::readcyclecounter), {}, "pira.ts");
+  }
+  auto Now = module.getOrInsertFunction("__pira_timer_now", IRB.getInt64Ty());
+  return IRB.CreateCall(Now, {}, "pira.ts");
+}
+
+HookEmitter::RegionState InlineTimerHookEmitter::emitEntry(const Region &R, Instruction *IP, const DebugLoc &DL) {
+  if (R.kind == Region::Kind::IndirectCall) {
+    return {emitTimestamp(IP, DL), 0};
+  }
+  createModuleGlobals();
+  // One slot per region name: call sites of the same callee share the slot
+  auto Slot = regionSlots.insert({R.name, static_cast<unsigned>(regionNames.size())});
+  if (Slot.second) {
+    regionNames.push_back(R.name);
+  }
+  // The timestamp dominates every exit of the region, no stack slot is needed
+  return {emitTimestamp(IP, DL), Slot.first->getValue()};
+}
+
+void InlineTimerHookEmitter::emitExit(const Region &R, const RegionState &State, Instruction *IP, const DebugLoc &DL) {
+  auto &C = module.getContext();
+  auto *SlotTy = getTimerSlotType(C);
+
+  Value *End = emitTimestamp(IP, DL);
+  IRBuilder<> IRB(IP);
+  IRB.SetCurrentDebugLocation(DL);
+  Value *Elapsed = IRB.CreateSub(End, State.value, "pira.elapsed");
+
+  if (R.kind == Region::Kind::IndirectCall) {
+    // The slot depends on the target, which only the runtime can resolve
+    auto Indirect = module.getOrInsertFunction("__pira_timer_indirect", IRB.getVoidTy(), IRB.getInt8PtrTy(),
+                                               IRB.getInt8PtrTy(), IRB.getInt64Ty(), IRB.getInt32Ty());
+    const uint32_t Clock = hasCycleCounter(module) ? TimerClockCycles : TimerClockNanoseconds;
+    IRB.CreateCall(Indirect, {createPrivateString(module, R.name, "__pira_timer_site"),
+                              IRB.CreatePointerCast(R.target, IRB.getInt8PtrTy()), Elapsed, IRB.getInt32(Clock)});
+    return;
+  }
+  LoadInst *Slots = IRB.CreateLoad(SlotTy->getPointerTo(), threadSlots, "pira.slots");
+
+  // The first event of a thread in this module registers the slot array with the runtime
+  Value *IsNull = IRB.CreateIsNull(Slots);
+  auto *Then = SplitBlockAndInsertIfThen(IsNull, IP, false, MDBuilder(C).createBranchWeights(1, 1U << 20));
+  IRBuilder<> ThenIRB(Then);
+  ThenIRB.SetCurrentDebugLocation(DL);
+  auto Register = module.getOrInsertFunction("__pira_timer_register", SlotTy->getPointerTo(),
+                                             getTimerModuleType(C)->getPointerTo());
+  Value *Registered = ThenIRB.CreateCall(Register, {moduleDesc}, "pira.slots.new");
+  ThenIRB.CreateStore(Registered, threadSlots);
+
+  IRB.SetInsertPoint(IP);
+  PHINode *SlotArray = IRB.CreatePHI(SlotTy->getPointerTo(), 2, "pira.slots.phi");
+  SlotArray->addIncoming(Slots, Slots->getParent());
+  SlotArray->addIncoming(Registered, Then->getParent());
+
+  Value *Slot = IRB.CreateConstInBoundsGEP1_32(SlotTy, SlotArray, State.slot);
+  Value *CallsPtr = IRB.CreateStructGEP(SlotTy, Slot, 0);
+  Value *TicksPtr = IRB.CreateStructGEP(SlotTy, Slot, 1);
+  IRB.CreateStore(IRB.CreateAdd(IRB.CreateLoad(IRB.getInt64Ty(), CallsPtr), IRB.getInt64(1)), CallsPtr);
+  IRB.CreateStore(IRB.CreateAdd(IRB.CreateLoad(IRB.getInt64Ty(), TicksPtr), Elapsed), TicksPtr);
+}
+
+bool InlineTimerHookEmitter::finalize() {
+  if (!moduleDesc) {
+    return false;
+  }
+  auto &C = module.getContext();
+  auto *I8Ptr = Type::getInt8PtrTy(C);
+  auto *I32 = Type::getInt32Ty(C);
+
+  std::vector<Constant *> Names;
+  Names.reserve(regionNames.size());
+  for (const auto &Name : regionNames) {
+    Names.push_back(createPrivateString(module, Name, "__pira_timer_name"));
+  }
+  auto *NamesTy = ArrayType::get(I8Ptr, Names.size());
+  auto *NameTable = new GlobalVariable(module, NamesTy, /*isConstant=*/true, GlobalValue::PrivateLinkage,
+                                       ConstantArray::get(NamesTy, Names), "__pira_timer_names");
+
+  const uint32_t Clock = hasCycleCounter(module) ? TimerClockCycles : TimerClockNanoseconds;
+  moduleDesc->setInitializer(ConstantStruct::get(
+      getTimerModuleType(C),
+      {ConstantInt::get(I32, TimerABIVersion), ConstantInt::get(I32, Clock), ConstantInt::get(I32, Names.size()),
+       ConstantExpr::getPointerCast(NameTable, I8Ptr->getPointerTo()),
+       createPrivateString(module, module.getModuleIdentifier(), "__pira_timer_module_name")}));
+  return true;
+}
+
+// Region ID of regions that are not registered (yet)
+constexpr uint32_t InvalidRegionId = ~0U;
+
+GlobalVariable *RegionIdHookEmitter::getIdSlot(const Region &R) {
+  auto &Entry = regions[R.name];
+  if (!Entry.idSlot) {
+    auto *I32 = Type::getInt32Ty(module.getContext());
+    Entry.idSlot = new GlobalVariable(module, I32, /*isConstant=*/false, GlobalValue::PrivateLinkage,
+                                      ConstantInt::get(I32, InvalidRegionId), "__pira_region_id");
+    // Declarations of called functions usually have no debug info
+    if (auto *SP = R.subprogram ? R.subprogram : R.function.getSubprogram()) {
+      SmallString<128> File(SP->getFilename());
+      if (!SP->getDirectory().empty() && !sys::path::is_absolute(File)) {
+        File = SP->getDirectory();
+        sys::path::append(File, SP->getFilename());
+      }
+      Entry.file = File.str().str();
+      Entry.line = R.kind == Region::Kind::Function ? SP->getLine() : R.line;
+    }
+  }
+  return Entry.idSlot;
+}
+
+HookEmitter::RegionState RegionIdHookEmitter::emitEntry(const Region &R, Instruction *IP, const DebugLoc &DL) {
+  IRBuilder<> IRB(IP);
+  IRB.SetCurrentDebugLocation(DL);
+  auto Enter = module.getOrInsertFunction("__pira_region_enter", IRB.getVoidTy(), IRB.getInt32Ty());
+  // The ID is loaded once, the exit hook reuses it
+  Value *Id;
+  if (R.kind == Region::Kind::IndirectCall) {
+    // One region per target, assigned by the runtime
+    auto Indirect = module.getOrInsertFunction("__pira_region_indirect", IRB.getInt32Ty(), IRB.getInt8PtrTy(),
+                                               IRB.getInt8PtrTy());
+    Id = IRB.CreateCall(Indirect,
+                        {createPrivateString(module, R.name, "__pira_region_site"),
+                         IRB.CreatePointerCast(R.target, IRB.getInt8PtrTy())},
+                        "pira.region");
+  } else {
+    Id = IRB.CreateLoad(IRB.getInt32Ty(), getIdSlot(R), "pira.region");
+  }
+  IRB.CreateCall(Enter, {Id});
+  return {Id, 0};
+}
+
+void RegionIdHookEmitter::emitExit(const Region &, const RegionState &State, Instruction *IP, const DebugLoc &DL) {
+  IRBuilder<> IRB(IP);
+  IRB.SetCurrentDebugLocation(DL);
+  auto Exit = module.getOrInsertFunction("__pira_region_exit", IRB.getVoidTy(), IRB.getInt32Ty());
+  IRB.CreateCall(Exit, {State.value});
+}
+
+bool RegionIdHookEmitter::finalize() {
+  if (regions.empty()) {
+    return false;
+  }
+  auto &C = module.getContext();
+  auto *I8Ptr = Type::getInt8PtrTy(C);
+  auto *I32 = Type::getInt32Ty(C);
+  // { ID slot, name, file, line }
+  auto *EntryTy = StructType::get(I32->getPointerTo(), I8Ptr, I8Ptr, I32);
+
+  std::vector<Constant *> Entries;
+  for (const auto &R : regions) {
+    const auto &Region = R.getValue();
+    Entries.push_back(ConstantStruct::get(EntryTy, {Region.idSlot,
+                                                    createPrivateString(module, R.getKey(), "__pira_region_name"),
+                                                    createPrivateString(module, Region.file, "__pira_region_file"),
+                                                    ConstantInt::get(I32, Region.line)}));
+  }
+  createSectionTable(module, EntryTy, Entries, "pira_regions", "pira.regions_ctor", "__pira_regions_init");
+  return true;
+}
+
+GuardedHookEmitter::GuardedHookEmitter(Module &M, std::unique_ptr<HookEmitter> Inner)
+    : HookEmitter(M), inner(std::move(Inner)) {}
+
+GlobalVariable *GuardedHookEmitter::getGuard(StringRef Name) {
+  auto &Guard = guards[Name];
+  if (!Guard) {
+    auto *I8 = Type::getInt8Ty(module.getContext());
+    // Enabled until the runtime says otherwise, e.g., if the runtime filter is not set
+    Guard = new GlobalVariable(module, I8, /*isConstant=*/false, GlobalValue::PrivateLinkage, ConstantInt::get(I8, 1),
+                               "__pira_guard");
+    Guard->setSection("pira_guards");
+  }
+  return Guard;
+}
+
+HookEmitter::RegionState GuardedHookEmitter::emitEntry(const Region &R, Instruction *IP, const DebugLoc &DL) {
+  // Splitting the entry block must not move the static allocas out of it
+  if (IP->getParent() == &IP->getFunction()->getEntryBlock()) {
+    while (isa<AllocaInst>(IP)) {
+      IP = IP->getNextNode();
+    }
+  }
+  BasicBlock *Head = IP->getParent();
+  IRBuilder<> IRB(IP);
+  IRB.SetCurrentDebugLocation(DL);
+  Value *Enabled = IRB.CreateICmpNE(IRB.CreateLoad(IRB.getInt8Ty(), getGuard(R.name), "pira.guard"),
+                                    IRB.getInt8(0), "pira.enabled");
+  auto *Then = SplitBlockAndInsertIfThen(Enabled, IP, false);
+  auto State = inner->emitEntry(R, Then, DL);
+  if (State.value) {
+    IRB.SetInsertPoint(IP);
+    PHINode *Value = IRB.CreatePHI(State.value->getType(), 2);
+    Value->addIncoming(State.value, Then->getParent());
+    Value->addIncoming(Constant::getNullValue(State.value->getType()), Head);
+    State.value = Value;
+  }
+  // The guard is read once, entry and exit hooks of a region always run together
+  State.enabled = Enabled;
+  return State;
+}
+
+void GuardedHookEmitter::emitExit(const Region &R, const RegionState &State, Instruction *IP, const DebugLoc &DL) {
+  auto *Then = SplitBlockAndInsertIfThen(State.enabled, IP, false);
+  inner->emitExit(R, State, Then, DL);
+}
+
+bool GuardedHookEmitter::finalize() {
+  const bool Changed = inner->finalize();
+  if (guards.empty()) {
+    return Changed;
+  }
+  auto &C = module.getContext();
+  auto *I8Ptr = Type::getInt8PtrTy(C);
+  auto *EntryTy = StructType::get(I8Ptr, I8Ptr);
+
+  std::vector<Constant *> Entries;
+  for (const auto &Guard : guards) {
+    Entries.push_back(ConstantStruct::get(
+        EntryTy, {Guard.getValue(), createPrivateString(module, Guard.getKey(), "__pira_guard_name")}));
+  }
+  createSectionTable(module, EntryTy, Entries, "pira_guard_names", "pira.guards_ctor", "__pira_guards_init");
+  return true;
+}
+
+std::unique_ptr<HookEmitter> createHookEmitter(Module &M) {
+  const auto Kind = getInstrumentationHooks();
+  std::unique_ptr<HookEmitter> Hooks;
+  if (Kind.empty() || Kind == "cyg-profile") {
+    Hooks = std::make_unique<CygProfileHookEmitter>(M);
+  } else if (Kind == "inline-timer") {
+    Hooks = std::make_unique<InlineTimerHookEmitter>(M);
+  } else if (Kind == "region-id") {
+    Hooks = std::make_unique<RegionIdHookEmitter>(M);
+  } else {
+    std::cerr << "[LLVMInstrumentor] [Error]: Unknown instrumentation hooks '" << Kind
+              << "', expected cyg-profile, inline-timer or region-id" << std::endl;
+    exit(-1);
+  }
+  if (useRuntimeGuards()) {
+    return std::make_unique<GuardedHookEmitter>(M, std::move(Hooks));
+  }
+  return Hooks;
+}
+
+}  // namespace pira
@@ -1,383 +1,275 @@
-//===- EntryExitInstrumenter.cpp - Function Entry/Exit Instrumentation ----===//
+//===- InstrumentationLib.cpp - Filtered instrumentation plugin -----------===//
 //
-// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
-// See https://llvm.org/LICENSE.txt for license information.
-// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+// This file is shipped as part of the PIRA project
 //
-//===----------------------------------------------------------------------===//
-//
-// This version is shipped as part of the PIRA project
-// 
 // Modifications 2019 - 2020
 //
 // Jan-Patrick Lehr
 // Jonas Rickert
 //
+//===----------------------------------------------------------------------===//
+//
+// Registers the filtering instrumenter with the legacy pass manager (clang -Xclang -load) and, via
+// llvmGetPassPluginInfo, with the new pass manager (clang -fpass-plugin, opt -load-pass-plugin and the ThinLTO
+// backends of lld --load-pass-plugin). -instrumentation-placement selects where in the pipeline it runs.
 //
+//===----------------------------------------------------------------------===//
+
+#include "Diagnostics.h"
+#include "Features.h"
+#include "Filter.h"
+#include "HookEmitter.h"
+#include "Instrumenter.h"
+#include "Manifest.h"
+#include "Options.h"
+#include "OverheadBudget.h"
 
 #include "llvm/Analysis/GlobalsModRef.h"
-#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/Function.h"
-#include "llvm/IR/Instructions.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
-#include "llvm/IR/Type.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/Pass.h"
-#include "llvm/Support/CommandLine.h"
-#include "llvm/Support/FileSystem.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
-#include "llvm/Transforms/Utils.h"
-#include "llvm/Transforms/Utils/EntryExitInstrumenter.h"
 
-#include <fstream>
-#include <iostream>
-#include <string>
-#include <string_view>
-#include <unordered_set>
+#include <memory>
 
 using namespace llvm;
+using namespace pira;
 
-cl::opt<std::string> WhitelistFile("filter-list", cl::desc("Input file w/ mangled names"), cl::value_desc("filename"));
-cl::opt<std::string> ConfigFileScoreP("score-p-filter", cl::desc("Score-P filter"), cl::value_desc("filename"));
-
-static void insertCall(Function &CurFn, StringRef Func, Instruction *InsertionPt, DebugLoc DL) {
-  Module &M = *InsertionPt->getParent()->getParent()->getParent();
-  LLVMContext &C = InsertionPt->getParent()->getContext();
-
-  if (Func == "mcount" || Func == ".mcount" || Func == "llvm.arm.gnu.eabi.mcount" || Func == "\01_mcount" ||
-      Func == "\01mcount" || Func == "__mcount" || Func == "_mcount" || Func == "__cyg_profile_func_enter_bare") {
-    FunctionCallee Fn = M.getOrInsertFunction(Func, Type::getVoidTy(C));
-    CallInst *Call = CallInst::Create(Fn, "", InsertionPt);
-    Call->setDebugLoc(DL);
-    return;
-  }
-
-  if (Func == "__cyg_profile_func_enter" || Func == "__cyg_profile_func_exit") {
-    Type *ArgTypes[] = {Type::getInt8PtrTy(C), Type::getInt8PtrTy(C)};
-
-    FunctionCallee Fn = M.getOrInsertFunction(Func, FunctionType::get(Type::getVoidTy(C), ArgTypes, false));
-
-    Instruction *RetAddr =
-        CallInst::Create(Intrinsic::getDeclaration(&M, Intrinsic::returnaddress),
-                         ArrayRef<Value *>(ConstantInt::get(Type::getInt32Ty(C), 0)), "", InsertionPt);
-    RetAddr->setDebugLoc(DL);
-
-    Value *Args[] = {ConstantExpr::getBitCast(&CurFn, Type::getInt8PtrTy(C)), RetAddr};
-
-    CallInst *Call = CallInst::Create(Fn, ArrayRef<Value *>(Args), "", InsertionPt);
-    Call->setDebugLoc(DL);
-    return;
-  }
+namespace {
 
-  // We only know how to call a fixed set of instrumentation functions, because
-  // they all expect different arguments, etc.
-  report_fatal_error(Twine("Unknown instrumentation function: '") + Func + "'");
+/// The filter, which is read by the first call
+const InstrumentationFilter &getFilter() {
+  PhaseTimer Timer("filter", "Read the filter");
+  return InstrumentationFilter::get();
 }
 
-static bool instrumentFunction(Function &F, bool PostInlining) {
-  StringRef EntryAttr = PostInlining ? "instrument-function-entry-inlined" : "instrument-function-entry";
-
-  StringRef ExitAttr = PostInlining ? "instrument-function-exit-inlined" : "instrument-function-exit";
-
-  StringRef EntryFunc = "__cyg_profile_func_enter";
-  StringRef ExitFunc = "__cyg_profile_func_exit";
-
-  bool Changed = false;
-
-  // If the attribute is specified, insert instrumentation and then "consume"
-  // the attribute so that it's not inserted again if the pass should happen to
-  // run later for some reason.
-
-  if (!EntryFunc.empty()) {
-    std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Entry Instrumentation" << std::endl;
-    DebugLoc DL;
-    if (auto SP = F.getSubprogram())
-      DL = DebugLoc::get(SP->getScopeLine(), 0, SP);
-
-    insertCall(F, EntryFunc, &*F.begin()->getFirstInsertionPt(), DL);
-    Changed = true;
-    F.removeAttribute(AttributeList::FunctionIndex, EntryAttr);
-  }
-
-  if (!ExitFunc.empty()) {
-    std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Exit Instrumentation" << std::endl;
-    for (BasicBlock &BB : F) {
-      Instruction *T = BB.getTerminator();
-      if (!isa<ReturnInst>(T))
-        continue;
-
-      // If T is preceded by a musttail call, that's the real terminator.
-      Instruction *Prev = T->getPrevNode();
-      if (BitCastInst *BCI = dyn_cast_or_null<BitCastInst>(Prev))
-        Prev = BCI->getPrevNode();
-      if (CallInst *CI = dyn_cast_or_null<CallInst>(Prev)) {
-        if (CI->isMustTailCall())
-          T = CI;
-      }
-
-      DebugLoc DL;
-      if (DebugLoc TerminatorDL = T->getDebugLoc())
-        DL = TerminatorDL;
-      else if (auto SP = F.getSubprogram())
-        DL = DebugLoc::get(0, 0, SP);
-
-      insertCall(F, ExitFunc, T, DL);
-      Changed = true;
+struct FilteringEntryExitInstrumenter : public FunctionPass {
+  static char ID;
+  FilteringEntryExitInstrumenter() : FunctionPass(ID), filter(getFilter()) {}
+  void getAnalysisUsage(AnalysisUsage &AU) const override { AU.addPreserved<GlobalsAAWrapperPass>(); }
+  bool doInitialization(Module &M) override {
+    remarks = std::make_unique<ModuleRemarksFile>(M);
+    {
+      PhaseTimer Timer("manifest", "Write the manifest");
+      writeManifest(M, filter);
     }
-    F.removeAttribute(AttributeList::FunctionIndex, ExitAttr);
+    {
+      PhaseTimer Timer("features", "Write the function features");
+      writeFeatures(M);
+    }
+    hooks = createHookEmitter(M);
+    budget = createOverheadBudget(M, hooks->getHookCost());
+    return false;
   }
-
-  return Changed;
-}
-
-static bool instrumentateCallSites(Function &F, const std::unordered_set<std::string> &CallsToInstrument,
-                                   bool PostInlining) {
-  StringRef CallSiteEntryFunc = "__cyg_profile_func_enter";
-  StringRef CallSiteExitFunc = "__cyg_profile_func_exit";
-
-  bool Changed = false;
-  for (BasicBlock &BB : F) {
-    for (Instruction &I : BB) {
-      if (auto *Call = dyn_cast<CallInst>(&I)) {
-        if (auto *CalledFunc = Call->getCalledFunction()) {
-          if (CallsToInstrument.find(CalledFunc->getName().str()) != CallsToInstrument.end()) {
-            if (!CallSiteEntryFunc.empty()) {
-              std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Call Site Entry Instrumentation" << std::endl;
-              DebugLoc DL = Call->getDebugLoc();
-              insertCall(*CalledFunc, CallSiteEntryFunc, Call, DL);
-              Changed = true;
-            }
-            if (!CallSiteExitFunc.empty()) {
-              std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Call Site Exit Instrumentation" << std::endl;
-              if (Call->isMustTailCall()) {
-                std::cerr << "[LLVMInstrumentor] [Error]: Can not insert call site instrumentation in function "
-                          << Call->getName().str() << " because is is declared as \"must tail call\"" << std::endl;
-                exit(-1);
-              }
-              DebugLoc DL = Call->getDebugLoc();
-              insertCall(*CalledFunc, CallSiteExitFunc, Call->getNextNode(), DL);
-              Changed = true;
-            }
-          }
-        }
-      } else if (auto *Invoke = dyn_cast<InvokeInst>(&I)) {
-        if (auto *CalledFunc = Invoke->getCalledFunction()) {
-          if (CallsToInstrument.find(CalledFunc->getName().str()) != CallsToInstrument.end()) {
-            if (!CallSiteEntryFunc.empty()) {
-              std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Call Site Entry Instrumentation" << std::endl;
-              DebugLoc DL = Invoke->getDebugLoc();
-              insertCall(*CalledFunc, CallSiteEntryFunc, Invoke, DL);
-              Changed = true;
-            }
-            if (!CallSiteExitFunc.empty()) {
-              std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Call Site Exit Instrumentation" << std::endl;
-              DebugLoc DL = Invoke->getDebugLoc();
-              auto IP = &*Invoke->getNormalDest()->getFirstInsertionPt();
-              insertCall(*CalledFunc, CallSiteExitFunc, IP, DL);
-              Changed = true;
-            }
-          }
-        }
-      }
+  bool runOnFunction(Function &F) override {
+    PhaseTimer Timer("instrument", "Insert the hooks");
+    return runFilteringInstrumentation(F, filter, *hooks, budget.get());
+  }
+  bool doFinalization(Module &) override {
+    bool Changed;
+    {
+      PhaseTimer Timer("finalize", "Emit the module tables");
+      Changed = hooks->finalize();
+    }
+    hooks.reset();
+    if (budget) {
+      budget->writeReport();
+      budget.reset();
     }
+    remarks.reset();
+    return Changed;
   }
-  return Changed;
-}
+  StringRef getPassName() const override { return "Filtering Entry Exit Instrumentation"; }
 
-namespace {
+  const InstrumentationFilter &filter;
+  std::unique_ptr<HookEmitter> hooks;
+  std::unique_ptr<OverheadBudget> budget;
+  std::unique_ptr<ModuleRemarksFile> remarks;
+};
+char FilteringEntryExitInstrumenter::ID = 0;
 
-struct FilteringEntryExitInstrumenter : public FunctionPass {
+/// Runs after the inliner, additionally instruments the inlined bodies of the selected functions. It is a module pass:
+/// nested in the module pipeline, a function pass would only be finalized after the passes that follow it, which
+/// could then fold the loads of the module-level tables.
+struct FilteringPostInlineEntryExitInstrumenter : public ModulePass {
   static char ID;
-  FilteringEntryExitInstrumenter() : FunctionPass(ID) {
-    // initializeEntryExitInstrumenterPass(*PassRegistry::getPassRegistry());
-    if (WhitelistFile.empty() && ConfigFileScoreP.empty()) {
-      report_fatal_error(Twine("No instrumentation configuration in plugin"));
+  FilteringPostInlineEntryExitInstrumenter() : ModulePass(ID) {}
+  void getAnalysisUsage(AnalysisUsage &AU) const override { AU.addPreserved<GlobalsAAWrapperPass>(); }
+  bool runOnModule(Module &M) override {
+    const auto &Filter = getFilter();
+    ModuleRemarksFile Remarks(M);
+    {
+      PhaseTimer Timer("manifest", "Write the manifest");
+      writeManifest(M, Filter);
     }
-    if (!WhitelistFile.empty()) {
-      if (!sys::fs::exists(WhitelistFile.c_str())) {
-        std::cerr << "[LLVMInstrumentor] [Error]: Filter file (" << WhitelistFile.c_str() << ") does not exist."
-                  << std::endl;
-        exit(-1);
-      } else {
-        std::ifstream filter(WhitelistFile.c_str());
-        for (std::string in; std::getline(filter, in);) {
-          filterList.insert(in);
-        }
+    {
+      PhaseTimer Timer("features", "Write the function features");
+      writeFeatures(M);
+    }
+    auto Hooks = createHookEmitter(M);
+    auto Budget = createOverheadBudget(M, Hooks->getHookCost());
+    bool Changed = false;
+    {
+      PhaseTimer Timer("instrument", "Insert the hooks");
+      for (auto &F : M) {
+        Changed = runFilteringInstrumentation(F, Filter, *Hooks, Budget.get(), true) || Changed;
       }
     }
+    if (Budget) {
+      Budget->writeReport();
+    }
+    PhaseTimer Timer("finalize", "Emit the module tables");
+    return Hooks->finalize() || Changed;
+  }
+  StringRef getPassName() const override { return "Filtering Post-Inline Entry Exit Instrumentation"; }
+};
+char FilteringPostInlineEntryExitInstrumenter::ID = 0;
 
-    if (!ConfigFileScoreP.empty()) {
-      if (!sys::fs::exists(ConfigFileScoreP.c_str())) {
-        std::cerr << "[LLVMInstrumentor] [Error]: Filter file (" << WhitelistFile.c_str() << ") does not exist."
-                  << std::endl;
-        exit(-1);
-      } else {
-        std::ifstream filter(ConfigFileScoreP.c_str());
-        std::string linebuffer;
-        std::string_view linebuffer_view;
-
-        enum class ParserState {
-          Normal /*Content without special meaning*/,
-          Block /*Func filter block*/,
-          Include /*include directive that has no item yet*/,
-          IncludeFinished /*include directive that can be finished*/,
-        };
-
-        /// Returns the next token in the filter file as the parameter out.
-        /// Skips all whitespace and comments, returns false if no token exists
-        auto get_next_token = [&filter, &linebuffer, &linebuffer_view](std::string_view &out, ParserState state) {
-          const std::string whitespace = " \t\r";
-          auto first_not_whitespace = linebuffer_view.find_first_not_of(whitespace);
-          while (first_not_whitespace == std::string_view::npos || linebuffer_view[first_not_whitespace] == '#') {
-            if (!std::getline(filter, linebuffer)) {
-              if (state != ParserState::Normal) {
-                std::cerr << "[LLVMInstrumentor] [Error]: Unexpected ending "
-                             "in filter file."
-                          << std::endl;
-                exit(-1);
-              }
-              return false;
-            }
-            linebuffer_view = linebuffer;
-            first_not_whitespace = linebuffer_view.find_first_not_of(whitespace);
-          }
-          // Skip whitespace and commets
-          linebuffer_view.remove_prefix(first_not_whitespace);
-          auto endtoken = linebuffer_view.find_first_of(" \t\r#");
-          if (endtoken == std::string_view::npos) {
-            endtoken = linebuffer_view.length();
-          }
-          out = std::string_view(linebuffer_view.data(), endtoken);
-          // std::cerr << "Token: \"" << out << "\"" << std::endl;
-          linebuffer_view.remove_prefix(endtoken);
-          return true;
-        };
-
-        auto parser_error = [](std::string_view token) {
-          std::cerr << "[LLVMInstrumentor] [Error]: Unexpected token \"" << token << "\" in filter file." << std::endl;
-          exit(-1);
-        };
-
-        ParserState state = ParserState::Normal;
-
-        std::string_view token;
-        while (state == ParserState::IncludeFinished || get_next_token(token, state)) {
-          if (token == "SCOREP_REGION_NAMES_BEGIN") {
-            if (state == ParserState::Normal) {
-              state = ParserState::Block;
-            } else {
-              parser_error(token);
-            }
-          } else if (token == "SCOREP_REGION_NAMES_END") {
-            if (state == ParserState::Block || state == ParserState::IncludeFinished) {
-              state = ParserState::Normal;
-            } else {
-              parser_error(token);
-            }
-          } else if (token == "INCLUDE") {
-            if (state == ParserState::Block || state == ParserState::IncludeFinished) {
-              state = ParserState::Include;
-            } else {
-              parser_error(token);
-            }
-          } else {
-            if (state != ParserState::Include) {
-              parser_error(token);
-            }
-            // Helper function to parse a function name. sets token to the next token
-            auto get_func_name = [&]() {
-              // Function to check if a string contains an unsupported wildcard
-              auto warn_unsupported_wildcard = [](const std::string &name) {
-                const auto start_wildcard = name.find_first_of("*?[]");
-                if (start_wildcard != std::string::npos) {
-                  std::cerr << "[LLVMInstrumentor] [Warning]: Unsupported "
-                               "wildcard in \""
-                            << name << "\"" << std::endl;
-                }
-              };
-
-              std::string prev_token(token);
-              // Look ahead one token to check if we need to handle a mangeled name
-              get_next_token(token, state);
-              if (token != "MANGLED") {
-                warn_unsupported_wildcard(prev_token);
-                return prev_token;
-              } else {
-                // Skip MANGLED keyword
-                get_next_token(token, state);
-                prev_token = token;
-                get_next_token(token, state);
-                warn_unsupported_wildcard(prev_token);
-                return prev_token;
-              }
-            };
-            const auto fname = get_func_name();
-            if (token == "->") {
-              get_next_token(token, state);
-              const auto called_function = get_func_name();
-              const auto csli = callSiteList.find(fname);
-              if (csli != callSiteList.end()) {
-                csli->second.insert(called_function);
-              } else {
-                std::unordered_set<std::string> called_func_set;
-                called_func_set.insert(called_function);
-                callSiteList.insert({fname, called_func_set});
-              }
-            } else {
-              filterList.insert(fname);
-            }
-            state = ParserState::IncludeFinished;
-          }
-        }
-        if (state != ParserState::Normal) {
-          std::cerr << "[LLVMInstrumentor] [Error]: Unexpected ending "
-                       "in filter file."
-                    << std::endl;
-          exit(-1);
-        }
+/// New pass manager version of FilteringEntryExitInstrumenter and FilteringPostInlineEntryExitInstrumenter. It is a
+/// module pass, because the hook emitter creates module-level tables once all functions are instrumented.
+struct FilteringEntryExitInstrumenterPass : public PassInfoMixin<FilteringEntryExitInstrumenterPass> {
+  explicit FilteringEntryExitInstrumenterPass(bool PostInlining = false) : postInlining(PostInlining) {}
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &) {
+    const auto &Filter = getFilter();
+    ModuleRemarksFile Remarks(M);
+    {
+      PhaseTimer Timer("manifest", "Write the manifest");
+      writeManifest(M, Filter);
+    }
+    {
+      PhaseTimer Timer("features", "Write the function features");
+      writeFeatures(M);
+    }
+    auto Hooks = createHookEmitter(M);
+    auto Budget = createOverheadBudget(M, Hooks->getHookCost());
+    bool Changed = false;
+    {
+      PhaseTimer Timer("instrument", "Insert the hooks");
+      for (auto &F : M) {
+        Changed = runFilteringInstrumentation(F, Filter, *Hooks, Budget.get(), postInlining) || Changed;
       }
-    } else {
-      std::cerr << "[LLVMInstrumentor] [Warning]: Scorep-P file empty" << std::endl;
     }
-  }
-  void getAnalysisUsage(AnalysisUsage &AU) const override { AU.addPreserved<GlobalsAAWrapperPass>(); }
-  bool isFiltered(Function &F) const { return filterList.find(F.getName().str()) != filterList.end(); }
-  bool runOnFunction(Function &F) override {
-    bool changed = false;
-    if (isFiltered(F)) {
-      std::cerr << "[LLVMInstrumentor] [DEBUG]: Running on " + F.getName().str() << std::endl;
-      changed = ::instrumentFunction(F, false);
+    if (Budget) {
+      Budget->writeReport();
     }
-    const auto c = callSiteList.find(F.getName());
-    if (c != callSiteList.end()) {
-      std::cerr << "[LLVMInstrumentor] [DEBUG]: Running call site instrumentation on " + F.getName().str() << std::endl;
-      changed = ::instrumentateCallSites(F, c->second, false) || changed;
+    {
+      PhaseTimer Timer("finalize", "Emit the module tables");
+      Hooks->finalize();
     }
-    return changed;
+    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
   }
-  StringRef getPassName() const override { return "Filtering Entry Exit Instrumentation"; }
+  // Instrument optnone functions, too (-O0 builds).
+  static bool isRequired() { return true; }
 
-  std::unordered_set<std::string> filterList;  // whitelist filter
-  std::unordered_map<std::string, std::unordered_set<std::string>>
-      callSiteList;  // List of all call sites that should be instrumented
+  bool postInlining;
 };
-char FilteringEntryExitInstrumenter::ID = 0;
+}  // namespace
 
-struct FilteringPostInlineEntryExitInstrumenter : public FunctionPass {
-  static char ID;
-  FilteringPostInlineEntryExitInstrumenter() : FunctionPass(ID) {
-    // initializePostInlineEntryExitInstrumenterPass(
-    //*PassRegistry::getPassRegistry());
+// The passes are registered at every supported extension point, the callbacks run once the options are parsed and
+// add them only at the selected placement.
+static void registerFilteringEEInstrumenter(const PassManagerBuilder &, llvm::legacy::PassManagerBase &PM) {
+  if (getInstrumentationPlacement() == Placement::Early) {
+    PM.add(new FilteringEntryExitInstrumenter());
   }
-  void getAnalysisUsage(AnalysisUsage &AU) const override { AU.addPreserved<GlobalsAAWrapperPass>(); }
-  bool runOnFunction(Function &F) override { return ::instrumentFunction(F, true); }
-};
-char FilteringPostInlineEntryExitInstrumenter::ID = 0;
-}  // namespace
+}
+
+static void registerFilteringPostInlineEEInstrumenter(const PassManagerBuilder &, llvm::legacy::PassManagerBase &PM) {
+  if (getInstrumentationPlacement() == Placement::PostInline) {
+    PM.add(new FilteringPostInlineEntryExitInstrumenter());
+  }
+}
+
+static void registerFilteringOptimizerLastEEInstrumenter(const PassManagerBuilder &,
+                                                         llvm::legacy::PassManagerBase &PM) {
+  if (getInstrumentationPlacement() == Placement::OptimizerLast) {
+    PM.add(new FilteringPostInlineEntryExitInstrumenter());
+  }
+}
 
-static void registerFilteringEEInstrumenter(const PassManagerBuilder &b, llvm::legacy::PassManagerBase &PM) {
-  PM.add(new FilteringEntryExitInstrumenter());
+// The later extension points are not part of the -O0 pipeline, which only inlines always_inline functions
+static void registerFilteringO0EEInstrumenter(const PassManagerBuilder &, llvm::legacy::PassManagerBase &PM) {
+  if (getInstrumentationPlacement() != Placement::Early) {
+    PM.add(new FilteringPostInlineEntryExitInstrumenter());
+  }
 }
 
 static RegisterStandardPasses RegisterFilteringEEINstrumenter(PassManagerBuilder::EP_EarlyAsPossible,
                                                               registerFilteringEEInstrumenter);
+// EP_ModuleOptimizerEarly runs before the inliner, EP_VectorizerStart is the first module-level point after it
+static RegisterStandardPasses RegisterFilteringPostInlineEEInstrumenter(PassManagerBuilder::EP_VectorizerStart,
+                                                                        registerFilteringPostInlineEEInstrumenter);
+static RegisterStandardPasses RegisterFilteringOptimizerLastEEInstrumenter(
+    PassManagerBuilder::EP_OptimizerLast, registerFilteringOptimizerLastEEInstrumenter);
+static RegisterStandardPasses RegisterFilteringO0EEInstrumenter(PassManagerBuilder::EP_EnabledOnOptLevel0,
+                                                                registerFilteringO0EEInstrumenter);
+
+#if LLVM_VERSION_MAJOR >= 12
+// Set while a pipeline is built whose pipeline start extension point already added the early pass. Pipelines are
+// built one at a time per thread, the ThinLTO backends of the linker build theirs in parallel threads.
+static thread_local bool EarlyPassAtPipelineStart = false;
+#endif
+
+static void registerFilteringEEInstrumenterPass(PassBuilder &PB) {
+  PB.registerPipelineParsingCallback(
+      [](StringRef Name, ModulePassManager &MPM, ArrayRef<PassBuilder::PipelineElement>) {
+        if (Name == "filtering-instrumenter") {
+          MPM.addPass(FilteringEntryExitInstrumenterPass());
+          return true;
+        }
+        if (Name == "filtering-post-inline-instrumenter") {
+          MPM.addPass(FilteringEntryExitInstrumenterPass(true));
+          return true;
+        }
+        return false;
+      });
+  // Compile time: same position as EP_EarlyAsPossible in the legacy pass manager.
+  // The optimization level is only passed to the callback since LLVM 12.
+  PB.registerPipelineStartEPCallback([](ModulePassManager &MPM, auto...) {
+    if (getInstrumentationPlacement() == Placement::Early) {
+      MPM.addPass(FilteringEntryExitInstrumenterPass());
+#if LLVM_VERSION_MAJOR >= 12
+      EarlyPassAtPipelineStart = true;
+#endif
+    }
+  });
+#if LLVM_VERSION_MAJOR >= 12
+  // The pipeline start extension point is not part of the (Thin)LTO backend pipelines. The early simplification
+  // extension point is, and it runs before the post-link inliner. Every pipeline that starts with the pipeline start
+  // extension point reaches the early simplification one later, which then adds nothing.
+  PB.registerPipelineEarlySimplificationEPCallback([](ModulePassManager &MPM, auto) {
+    if (EarlyPassAtPipelineStart) {
+      EarlyPassAtPipelineStart = false;
+      return;
+    }
+    if (getInstrumentationPlacement() == Placement::Early) {
+      MPM.addPass(FilteringEntryExitInstrumenterPass());
+    }
+  });
+#endif
+#if LLVM_VERSION_MAJOR >= 15
+  // After the inliner, before the vectorizers
+  PB.registerOptimizerEarlyEPCallback([](ModulePassManager &MPM, auto) {
+    if (getInstrumentationPlacement() == Placement::PostInline) {
+      MPM.addPass(FilteringEntryExitInstrumenterPass(true));
+    }
+  });
+#endif
+  // Part of the -O0 and the (Thin)LTO backend pipelines, too. Before LLVM 15 also the post-inline position, there is
+  // no extension point between the inliner and the vectorizers for module passes.
+  PB.registerOptimizerLastEPCallback([](ModulePassManager &MPM, auto...) {
+    const auto Position = getInstrumentationPlacement();
+    if (Position == Placement::OptimizerLast ||
+        (LLVM_VERSION_MAJOR < 15 && Position == Placement::PostInline)) {
+      MPM.addPass(FilteringEntryExitInstrumenterPass(true));
+    }
+  });
+}
+
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "FilteringInstrumenter", LLVM_VERSION_STRING, registerFilteringEEInstrumenterPass};
+}
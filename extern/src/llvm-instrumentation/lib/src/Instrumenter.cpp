@@ -0,0 +1,637 @@
+//===- EntryExitInstrumenter.cpp - Function Entry/Exit Instrumentation ----===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This version is shipped as part of the PIRA project
+//
+// Modifications 2019 - 2020
+//
+// Jan-Patrick Lehr
+// Jonas Rickert
+//
+//
+
+#include "Instrumenter.h"
+#include "Diagnostics.h"
+#include "Options.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace pira {
+
+/// Name of a loop or indirect call site in F: <function>:<line>, or <function>:<Fallback> without debug info. Regions
+/// on the same line, e.g., from macros, get a running number.
+static std::string getSourceRegionName(Function &F, unsigned Line, StringRef Fallback, StringMap<unsigned> &Counts) {
+  std::string Name = F.getName().str() + ":" + (Line ? std::to_string(Line) : Fallback.str());
+  if (const auto Count = Counts[Name]++) {
+    Name += "." + std::to_string(Count);
+  }
+  return Name;
+}
+
+/// Emits the entry hook of Region at the start of F and its exit hooks before every return of F.
+static void emitFunctionHooks(Function &F, const HookEmitter::Region &Region, HookEmitter &Hooks) {
+  if (isVerbose()) {
+    std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Entry Instrumentation" << std::endl;
+  }
+  DebugLoc EntryDL;
+  if (auto SP = F.getSubprogram())
+    EntryDL = DILocation::get(SP->getContext(), SP->getScopeLine(), 0, SP);
+  const HookEmitter::RegionState State = Hooks.emitEntry(Region, &*F.begin()->getFirstInsertionPt(), EntryDL);
+
+  if (isVerbose()) {
+    std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Exit Instrumentation" << std::endl;
+  }
+  // Collect first: hooks may split blocks
+  SmallVector<BasicBlock *, 8> Exits;
+  for (BasicBlock &BB : F) {
+    if (isa<ReturnInst>(BB.getTerminator())) {
+      Exits.push_back(&BB);
+    }
+  }
+  for (BasicBlock *BB : Exits) {
+    Instruction *T = BB->getTerminator();
+
+    // If T is preceded by a musttail call, that's the real terminator.
+    Instruction *Prev = T->getPrevNode();
+    if (BitCastInst *BCI = dyn_cast_or_null<BitCastInst>(Prev))
+      Prev = BCI->getPrevNode();
+    if (CallInst *CI = dyn_cast_or_null<CallInst>(Prev)) {
+      if (CI->isMustTailCall())
+        T = CI;
+    }
+
+    DebugLoc DL;
+    if (DebugLoc TerminatorDL = T->getDebugLoc())
+      DL = TerminatorDL;
+    else if (auto SP = F.getSubprogram())
+      DL = DILocation::get(SP->getContext(), 0, 0, SP);
+
+    Hooks.emitExit(Region, State, T, DL);
+  }
+}
+
+bool instrumentFunction(Function &F, bool PostInlining, HookEmitter &Hooks) {
+  StringRef EntryAttr = PostInlining ? "instrument-function-entry-inlined" : "instrument-function-entry";
+
+  StringRef ExitAttr = PostInlining ? "instrument-function-exit-inlined" : "instrument-function-exit";
+
+  // Insert instrumentation and then "consume" the attributes so that it's not inserted again if the pass should
+  // happen to run later for some reason.
+  emitFunctionHooks(F, HookEmitter::Region(F), Hooks);
+  reportInstrumented(F, RegionKind::Function, F.getName());
+  F.removeFnAttr(EntryAttr);
+  F.removeFnAttr(ExitAttr);
+  return true;
+}
+
+/// The function outlined from the parallel region that Call forks, if Call is a fork of the LLVM OpenMP runtime
+static const Function *getForkedFunction(const CallBase &Call) {
+  const Function *Callee = Call.getCalledFunction();
+  if (!Callee || Call.arg_size() < 3 ||
+      (Callee->getName() != "__kmpc_fork_call" && Callee->getName() != "__kmpc_fork_teams")) {
+    return nullptr;
+  }
+  return dyn_cast<Function>(Call.getArgOperand(2)->stripPointerCasts());
+}
+
+/// The call that forks the parallel region outlined into F, nullptr if F is no outlined region
+static const CallBase *getParallelFork(const Function &F) {
+  if (!F.hasLocalLinkage()) {
+    return nullptr;
+  }
+  // The fork passes the function, with typed pointers through a bitcast
+  SmallVector<const User *, 4> Users(F.users());
+  for (size_t I = 0; I < Users.size(); ++I) {
+    if (isa<ConstantExpr>(Users[I])) {
+      Users.append(Users[I]->user_begin(), Users[I]->user_end());
+    } else if (const auto *Call = dyn_cast<CallBase>(Users[I])) {
+      if (getForkedFunction(*Call) == &F) {
+        return Call;
+      }
+    }
+  }
+  return nullptr;
+}
+
+bool instrumentParallelRegion(Function &F, const InstrumentationFilter &Filter, HookEmitter &Hooks) {
+  // Nested regions are outlined into the function of the enclosing region, walk up to the function of the user
+  const Function *Parent = &F;
+  std::string Position;
+  SmallPtrSet<const Function *, 4> Visited{&F};
+  while (const CallBase *Fork = getParallelFork(*Parent)) {
+    Parent = Fork->getFunction();
+    if (!Visited.insert(Parent).second) {
+      return false;
+    }
+    unsigned Index = 0;
+    for (const BasicBlock &BB : *Parent) {
+      for (const Instruction &I : BB) {
+        if (&I == Fork) {
+          break;
+        }
+        const auto *Call = dyn_cast<CallBase>(&I);
+        if (Call && getForkedFunction(*Call)) {
+          ++Index;
+        }
+      }
+      if (Fork->getParent() == &BB) {
+        break;
+      }
+    }
+    Position = std::to_string(Index) + (Position.empty() ? "" : "." + Position);
+  }
+  if (Parent == &F || !Filter.isParallelRegionFiltered(Parent->getName())) {
+    return false;
+  }
+  if (!Hooks.supportsNamedRegions()) {
+    std::cerr << "[LLVMInstrumentor] [Warning]: The instrumentation hooks can not instrument parallel regions, "
+                 "skipping a parallel region of "
+              << Parent->getName().str() << std::endl;
+    reportSkipped(F, RegionKind::Parallel, Parent->getName(), "the hooks have no region names");
+    return false;
+  }
+  // The debug info of the outlined function starts at the structured block of the directive
+  const unsigned Line = F.getSubprogram() ? F.getSubprogram()->getLine() : 0;
+  const auto Name = Parent->getName().str() + ":" +
+                    (Line ? std::to_string(Line) + ":omp_parallel" : "omp_parallel." + Position);
+  if (isVerbose()) {
+    std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Parallel Region Instrumentation for " << Name << std::endl;
+  }
+  emitFunctionHooks(F, HookEmitter::Region(HookEmitter::Region::Kind::Parallel, F, Name, Line), Hooks);
+  reportInstrumented(F, RegionKind::Parallel, Name);
+  return true;
+}
+
+SmallVector<CallBase *, 16> getCallSites(Function &F) {
+  SmallVector<CallBase *, 16> CallSites;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      auto *Call = dyn_cast<CallBase>(&I);
+      if (!Call || (!isa<CallInst>(Call) && !isa<InvokeInst>(Call))) {
+        continue;
+      }
+      auto *CalledFunc = Call->getCalledFunction();
+      if ((CalledFunc && !CalledFunc->isIntrinsic()) || Call->isIndirectCall()) {
+        CallSites.push_back(Call);
+      }
+    }
+  }
+  return CallSites;
+}
+
+bool instrumentateCallSites(Function &F, ArrayRef<CallBase *> Candidates,
+                            function_ref<bool(StringRef)> ShouldInstrument, bool InstrumentIndirect, HookEmitter &Hooks,
+                            bool OutsideLoopsOnly) {
+  StringRef CallSiteEntryFunc = "__cyg_profile_func_enter";
+  StringRef CallSiteExitFunc = "__cyg_profile_func_exit";
+
+  std::unique_ptr<DominatorTree> DT;
+  std::unique_ptr<LoopInfo> LI;
+  if (OutsideLoopsOnly) {
+    DT = std::make_unique<DominatorTree>(F);
+    LI = std::make_unique<LoopInfo>(*DT);
+  }
+
+  SmallVector<CallBase *, 16> CallSites;
+  for (CallBase *Call : Candidates) {
+    if (LI && LI->getLoopFor(Call->getParent())) {
+      continue;
+    }
+    auto *CalledFunc = Call->getCalledFunction();
+    if ((CalledFunc && ShouldInstrument(CalledFunc->getName())) || (InstrumentIndirect && Call->isIndirectCall())) {
+      CallSites.push_back(Call);
+    }
+  }
+
+  // Indirect call sites are named <caller>:<line>->*, the runtime puts the target in place of the *
+  StringMap<unsigned> IndirectNameCounts;
+  auto getRegion = [&](CallBase *CB) {
+    if (auto *CalledFunc = CB->getCalledFunction()) {
+      return HookEmitter::Region(*CalledFunc);
+    }
+    const unsigned Line = CB->getDebugLoc() ? CB->getDebugLoc().getLine() : 0;
+    const auto Name = getSourceRegionName(F, Line, "call", IndirectNameCounts) + "->*";
+    return HookEmitter::Region(HookEmitter::Region::Kind::IndirectCall, F, Name, Line, CB->getCalledOperand());
+  };
+
+  bool Changed = false;
+  for (CallBase *CB : CallSites) {
+    const HookEmitter::Region Callee = getRegion(CB);
+    reportInstrumented(F, Callee.kind == HookEmitter::Region::Kind::IndirectCall ? RegionKind::IndirectCallSite
+                                                                                 : RegionKind::CallSite,
+                       Callee.name, CB->getDebugLoc());
+    HookEmitter::RegionState State;
+    if (auto *Call = dyn_cast<CallInst>(CB)) {
+      if (!CallSiteEntryFunc.empty()) {
+        if (isVerbose()) {
+          std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Call Site Entry Instrumentation" << std::endl;
+        }
+        DebugLoc DL = Call->getDebugLoc();
+        State = Hooks.emitEntry(Callee, Call, DL);
+        Changed = true;
+      }
+      if (!CallSiteExitFunc.empty()) {
+        if (isVerbose()) {
+          std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Call Site Exit Instrumentation" << std::endl;
+        }
+        if (Call->isMustTailCall()) {
+          std::cerr << "[LLVMInstrumentor] [Error]: Can not insert call site instrumentation in function "
+                    << Call->getName().str() << " because is is declared as \"must tail call\"" << std::endl;
+          exit(-1);
+        }
+        DebugLoc DL = Call->getDebugLoc();
+        Hooks.emitExit(Callee, State, Call->getNextNode(), DL);
+        Changed = true;
+      }
+    } else if (auto *Invoke = dyn_cast<InvokeInst>(CB)) {
+      if (!CallSiteEntryFunc.empty()) {
+        if (isVerbose()) {
+          std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Call Site Entry Instrumentation" << std::endl;
+        }
+        DebugLoc DL = Invoke->getDebugLoc();
+        State = Hooks.emitEntry(Callee, Invoke, DL);
+        Changed = true;
+      }
+      if (!CallSiteExitFunc.empty()) {
+        if (isVerbose()) {
+          std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Call Site Exit Instrumentation" << std::endl;
+        }
+        DebugLoc DL = Invoke->getDebugLoc();
+        // The exit must only run after this invoke, and the entry state must dominate it
+        if (!Invoke->getNormalDest()->getSinglePredecessor()) {
+          SplitEdge(Invoke->getParent(), Invoke->getNormalDest());
+        }
+        auto IP = &*Invoke->getNormalDest()->getFirstInsertionPt();
+        Hooks.emitExit(Callee, State, IP, DL);
+        Changed = true;
+      }
+    }
+  }
+  return Changed;
+}
+
+bool instrumentLoops(Function &F, unsigned MaxDepth, HookEmitter &Hooks) {
+  if (!Hooks.supportsNamedRegions()) {
+    std::cerr << "[LLVMInstrumentor] [Warning]: The instrumentation hooks can not instrument loops, skipping the "
+                 "loops of "
+              << F.getName().str() << std::endl;
+    reportSkipped(F, RegionKind::Loop, F.getName(), "the hooks have no region names");
+    return false;
+  }
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+
+  // Dedicated preheaders and exit blocks: the entry hook runs once per execution of the loop, the exit hooks only
+  // when leaving it. Simplifying a loop simplifies its subloops, too.
+  bool Changed = false;
+  SmallVector<Loop *, 8> TopLevelLoops(LI.begin(), LI.end());
+  for (Loop *L : TopLevelLoops) {
+    Changed = simplifyLoop(L, &DT, &LI, nullptr, nullptr, nullptr, /*PreserveLCSSA=*/false) || Changed;
+  }
+
+  struct LoopRegion {
+    HookEmitter::Region region;
+    Instruction *entry;
+    SmallVector<BasicBlock *, 4> exits;
+    DebugLoc loc;
+  };
+  std::vector<LoopRegion> Regions;
+  StringMap<unsigned> NameCounts;
+  for (Loop *L : LI.getLoopsInPreorder()) {
+    if (L->getLoopDepth() > MaxDepth) {
+      continue;
+    }
+    SmallVector<BasicBlock *, 4> Exits;
+    L->getUniqueExitBlocks(Exits);
+    // Preheaders and exits can not be formed for indirect branches, exits without insertion point are EH dispatch
+    // blocks; loops without exits never end.
+    if (!L->getLoopPreheader() || !L->hasDedicatedExits() || Exits.empty() ||
+        llvm::any_of(Exits, [](BasicBlock *BB) { return BB->getFirstInsertionPt() == BB->end(); })) {
+      if (isVerbose()) {
+        std::cerr << "[LLVMInstrumentor] [Warning]: Can not instrument a loop in " << F.getName().str() << std::endl;
+      }
+      reportSkipped(F, RegionKind::Loop, F.getName(), "no preheader or exit blocks", L->getStartLoc());
+      continue;
+    }
+    DebugLoc Loc = L->getStartLoc();
+    const unsigned Line = Loc ? Loc.getLine() : 0;
+    if (!Loc) {
+      if (auto SP = F.getSubprogram())
+        Loc = DILocation::get(SP->getContext(), 0, 0, SP);
+    }
+    const auto Name = getSourceRegionName(F, Line, "loop", NameCounts);
+    Regions.push_back({HookEmitter::Region(HookEmitter::Region::Kind::Loop, F, Name, Line),
+                       L->getLoopPreheader()->getTerminator(), Exits, Loc});
+  }
+
+  // Entry hooks go to the end of the preheaders, exit hooks to the front of the exit blocks, so an exit block that is
+  // the preheader of the next loop leaves before it enters. Exit blocks shared by nested loops get the outer exit
+  // hooks first, which puts them behind the inner ones.
+  std::vector<HookEmitter::RegionState> States;
+  for (auto &R : Regions) {
+    if (isVerbose()) {
+      std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Loop Entry Instrumentation for " << R.region.name
+                << std::endl;
+    }
+    reportInstrumented(F, RegionKind::Loop, R.region.name, R.loc);
+    States.push_back(Hooks.emitEntry(R.region, R.entry, R.loc));
+  }
+  for (size_t I = 0; I < Regions.size(); ++I) {
+    if (isVerbose()) {
+      std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Loop Exit Instrumentation for " << Regions[I].region.name
+                << std::endl;
+    }
+    for (BasicBlock *Exit : Regions[I].exits) {
+      Hooks.emitExit(Regions[I].region, States[I], &*Exit->getFirstInsertionPt(), Regions[I].loc);
+    }
+  }
+  return Changed || !Regions.empty();
+}
+
+/// Whether every path from From reaches To before it returns or gets back to From. Paths that end the program or
+/// unwind the stack are ignored, they skip the exit hooks of the function, too.
+static bool reachesOnAllPaths(BasicBlock *From, BasicBlock *To) {
+  SmallPtrSet<BasicBlock *, 16> Visited;
+  SmallVector<BasicBlock *, 16> Worklist{From};
+  while (!Worklist.empty()) {
+    BasicBlock *BB = Worklist.pop_back_val();
+    if (BB == To || !Visited.insert(BB).second) {
+      continue;
+    }
+    if (isa<ReturnInst>(BB->getTerminator())) {
+      return false;
+    }
+    for (BasicBlock *Succ : successors(BB)) {
+      if (Succ == From) {
+        return false;
+      }
+      Worklist.push_back(Succ);
+    }
+  }
+  return true;
+}
+
+bool instrumentInlinedFunctions(Function &F, function_ref<bool(StringRef)> ShouldInstrument, HookEmitter &Hooks) {
+  // The inliner gives every inlined call a distinct inlinedAt location, which identifies the inlined body
+  struct InlinedBody {
+    DISubprogram *callee{nullptr};
+    DebugLoc callSite;
+    unsigned depth{0};  // Number of enclosing inlined bodies
+    SmallVector<Instruction *, 16> instructions;
+  };
+  MapVector<const DILocation *, InlinedBody> Bodies;
+  for (BasicBlock &BB : F) {
+    // Blocks that end the program do not need exit hooks, and would leave the body without a common exit
+    if (isa<UnreachableInst>(BB.getTerminator())) {
+      continue;
+    }
+    for (Instruction &I : BB) {
+      if (isa<DbgInfoIntrinsic>(I) || !I.getDebugLoc()) {
+        continue;
+      }
+      SmallVector<std::pair<DISubprogram *, const DILocation *>, 4> Scopes;  // Innermost first
+      const DILocation *Loc = I.getDebugLoc().get();
+      while (const DILocation *CallSite = Loc->getInlinedAt()) {
+        Scopes.push_back({Loc->getScope()->getSubprogram(), CallSite});
+        Loc = CallSite;
+      }
+      for (unsigned Depth = 0; Depth < Scopes.size(); ++Depth) {
+        const auto &Scope = Scopes[Scopes.size() - 1 - Depth];
+        auto &Body = Bodies[Scope.second];
+        if (Body.instructions.empty()) {
+          Body.callee = Scope.first;
+          Body.callSite = DebugLoc(Scope.second);
+          Body.depth = Depth;
+        }
+        Body.instructions.push_back(&I);
+      }
+    }
+  }
+
+  struct InlinedRegion {
+    HookEmitter::Region region;
+    Instruction *entry;
+    Instruction *exit;
+    DebugLoc loc;
+    unsigned depth;
+  };
+  std::vector<InlinedRegion> Regions;
+  DominatorTree DT(F);
+  PostDominatorTree PDT(F);
+  LoopInfo LI(DT);
+  for (auto &Entry : Bodies) {
+    auto &Body = Entry.second;
+    const StringRef Name = Body.callee->getLinkageName().empty() ? Body.callee->getName()
+                                                                  : Body.callee->getLinkageName();
+    if (!ShouldInstrument(Name)) {
+      continue;
+    }
+    // The cyg-profile hooks need the address of the function, which only exists if it was kept
+    auto *Callee = F.getParent()->getFunction(Name);
+    if (!Hooks.supportsNamedRegions() && !Callee) {
+      if (isVerbose()) {
+        std::cerr << "[LLVMInstrumentor] [Warning]: The instrumentation hooks can not instrument the inlined body of "
+                  << Name.str() << " in " << F.getName().str() << std::endl;
+      }
+      reportSkipped(F, RegionKind::Inlined, Name, "the hooks need the address of the function", Body.callSite);
+      continue;
+    }
+    // The body is entered in the block that dominates all of its blocks and left in its last block, or else in the one
+    // that post-dominates them. Both blocks must run equally often, which optimizations that move code out of the
+    // body may prevent.
+    BasicBlock *EntryBB = Body.instructions.front()->getParent();
+    BasicBlock *CommonExitBB = EntryBB;
+    for (Instruction *I : Body.instructions) {
+      EntryBB = DT.findNearestCommonDominator(EntryBB, I->getParent());
+      CommonExitBB = CommonExitBB ? PDT.findNearestCommonDominator(CommonExitBB, I->getParent()) : nullptr;
+    }
+    auto IsEquivalent = [&](BasicBlock *ExitBB) {
+      return ExitBB && DT.dominates(EntryBB, ExitBB) && LI.getLoopFor(EntryBB) == LI.getLoopFor(ExitBB) &&
+             reachesOnAllPaths(EntryBB, ExitBB);
+    };
+    BasicBlock *ExitBB = Body.instructions.back()->getParent();
+    if (!IsEquivalent(ExitBB)) {
+      ExitBB = CommonExitBB;
+    }
+    if (!IsEquivalent(ExitBB)) {
+      if (isVerbose()) {
+        std::cerr << "[LLVMInstrumentor] [Warning]: Can not instrument the inlined body of " << Name.str() << " in "
+                  << F.getName().str() << std::endl;
+      }
+      reportSkipped(F, RegionKind::Inlined, Name, "no single entry and exit", Body.callSite);
+      continue;
+    }
+    auto First = llvm::find_if(Body.instructions, [EntryBB](Instruction *I) { return I->getParent() == EntryBB; });
+    Instruction *EntryIP = First != Body.instructions.end() ? *First : EntryBB->getTerminator();
+    auto Last = llvm::find_if(llvm::reverse(Body.instructions),
+                              [ExitBB](Instruction *I) { return I->getParent() == ExitBB; });
+    Instruction *ExitIP = nullptr;
+    if (Last != Body.instructions.rend()) {
+      ExitIP = (*Last)->isTerminator() ? *Last : (*Last)->getNextNode();
+    }
+    if (!ExitIP || isa<PHINode>(ExitIP) || ExitIP->isEHPad()) {
+      ExitIP = ExitBB->getFirstInsertionPt() != ExitBB->end() ? &*ExitBB->getFirstInsertionPt() : nullptr;
+    }
+    if (isa<PHINode>(EntryIP) || EntryIP->isEHPad()) {
+      EntryIP = EntryBB->getFirstInsertionPt() != EntryBB->end() ? &*EntryBB->getFirstInsertionPt() : nullptr;
+    }
+    // In a block that is both, the entry must come first
+    bool Ordered = EntryIP && ExitIP;
+    if (Ordered && EntryBB == ExitBB) {
+      Ordered = false;
+      for (Instruction *I = EntryIP; I && !Ordered; I = I->getNextNode()) {
+        Ordered = I == ExitIP;
+      }
+    }
+    if (!Ordered) {
+      if (isVerbose()) {
+        std::cerr << "[LLVMInstrumentor] [Warning]: Can not instrument the inlined body of " << Name.str() << " in "
+                  << F.getName().str() << std::endl;
+      }
+      reportSkipped(F, RegionKind::Inlined, Name, "no single entry and exit", Body.callSite);
+      continue;
+    }
+    if (Hooks.supportsNamedRegions()) {
+      HookEmitter::Region Region(HookEmitter::Region::Kind::Inlined, F, Name.str(), Body.callee->getLine());
+      Region.subprogram = Body.callee;
+      Regions.push_back({std::move(Region), EntryIP, ExitIP, Body.callSite, Body.depth});
+    } else {
+      Regions.push_back({HookEmitter::Region(*Callee), EntryIP, ExitIP, Body.callSite, Body.depth});
+    }
+  }
+  if (Regions.empty()) {
+    return false;
+  }
+
+  // Where one inlined body ends and the next one starts, the exit hooks must come first. The exit hooks of a position
+  // go before a first marker, the entry hooks before a second one behind it.
+  DenseMap<Instruction *, std::pair<Instruction *, Instruction *>> Markers;
+  auto getMarkers = [&Markers](Instruction *IP) {
+    auto &M = Markers[IP];
+    if (!M.first) {
+      auto *Ty = Type::getInt8PtrTy(IP->getContext());
+      M.first = CastInst::Create(Instruction::BitCast, UndefValue::get(Ty), Ty, "", IP);
+      M.second = CastInst::Create(Instruction::BitCast, UndefValue::get(Ty), Ty, "", IP);
+    }
+    return M;
+  };
+  for (auto &R : Regions) {
+    getMarkers(R.entry);
+    getMarkers(R.exit);
+  }
+  // Enclosing bodies enter first and leave last
+  std::vector<size_t> Order(Regions.size());
+  std::iota(Order.begin(), Order.end(), 0);
+  std::stable_sort(Order.begin(), Order.end(), [&](size_t A, size_t B) { return Regions[A].depth < Regions[B].depth; });
+  std::vector<HookEmitter::RegionState> States(Regions.size());
+  for (size_t I : Order) {
+    auto &R = Regions[I];
+    if (isVerbose()) {
+      std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Inlined Entry Instrumentation for " << R.region.name
+                << std::endl;
+    }
+    reportInstrumented(F, RegionKind::Inlined, R.region.name, R.loc);
+    States[I] = Hooks.emitEntry(R.region, Markers[R.entry].second, R.loc);
+  }
+  for (auto It = Order.rbegin(); It != Order.rend(); ++It) {
+    auto &R = Regions[*It];
+    if (isVerbose()) {
+      std::cerr << "[LLVMInstrumentor] [DEBUG]: Inserting Inlined Exit Instrumentation for " << R.region.name
+                << std::endl;
+    }
+    Hooks.emitExit(R.region, States[*It], Markers[R.exit].first, R.loc);
+  }
+  for (auto &M : Markers) {
+    M.second.first->eraseFromParent();
+    M.second.second->eraseFromParent();
+  }
+  return true;
+}
+
+bool runFilteringInstrumentation(Function &F, const InstrumentationFilter &Filter, HookEmitter &Hooks,
+                                 OverheadBudget *Budget, bool PostInlining) {
+  if (F.isDeclaration() || F.hasFnAttribute(InstrumentedAttr)) {
+    return false;
+  }
+  bool changed = false;
+  auto IsFiltered = [&](StringRef Name) {
+    return Filter.isFiltered(Name) && (!Budget || Budget->decide(Name) == OverheadBudget::Decision::Keep);
+  };
+  // Before any hooks: with wildcard callee patterns, the calls of the hooks would match, too, and the budget would
+  // count them as calls of F
+  const auto CallSites = getCallSites(F);
+  const bool InstrumentF = IsFiltered(F.getName());
+  // First, while the blocks are not split by other hooks
+  if (PostInlining) {
+    changed = instrumentInlinedFunctions(F, IsFiltered, Hooks);
+  }
+  // Before the function hooks: loop exit hooks that share a block with a return run before the function exit hook
+  if (const auto LoopDepth = Filter.getLoopDepth(F.getName())) {
+    if (isVerbose()) {
+      std::cerr << "[LLVMInstrumentor] [DEBUG]: Running loop instrumentation on " + F.getName().str() << std::endl;
+    }
+    changed = instrumentLoops(F, LoopDepth, Hooks) || changed;
+  }
+  // Before the function hooks, so that a selected outlined function encloses its parallel region
+  changed = instrumentParallelRegion(F, Filter, Hooks) || changed;
+  if (InstrumentF) {
+    if (isVerbose()) {
+      std::cerr << "[LLVMInstrumentor] [DEBUG]: Running on " + F.getName().str() << std::endl;
+    }
+    changed = instrumentFunction(F, PostInlining, Hooks) || changed;
+  }
+  const auto CallSiteRules = Filter.getCallSiteRules(F.getName());
+  if (!CallSiteRules.empty()) {
+    if (isVerbose()) {
+      std::cerr << "[LLVMInstrumentor] [DEBUG]: Running call site instrumentation on " + F.getName().str() << std::endl;
+    }
+    auto ShouldInstrument = [&](StringRef Callee) {
+      return Filter.isCallSiteFiltered(F.getName(), CallSiteRules, Callee);
+    };
+    const bool InstrumentIndirect = Filter.isIndirectCallSiteFiltered(CallSiteRules);
+    changed = instrumentateCallSites(F, CallSites, ShouldInstrument, InstrumentIndirect, Hooks) || changed;
+  }
+  if (Budget) {
+    // Downgraded functions are measured at their call sites outside of loops, unless a call site rule selects them
+    auto IsDowngraded = [&](StringRef Callee) {
+      return Filter.isFiltered(Callee) && Budget->decide(Callee) == OverheadBudget::Decision::Downgrade &&
+             (CallSiteRules.empty() || !Filter.isCallSiteFiltered(F.getName(), CallSiteRules, Callee));
+    };
+    changed =
+        instrumentateCallSites(F, CallSites, IsDowngraded, false, Hooks, /*OutsideLoopsOnly=*/true) || changed;
+  }
+  if (changed) {
+    F.addFnAttr(InstrumentedAttr);
+  }
+  return changed;
+}
+
+}  // namespace pira
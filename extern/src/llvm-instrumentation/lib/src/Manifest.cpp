@@ -0,0 +1,132 @@
+//===- Manifest.cpp - Per-module record of the matched filter entries -----===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#include "Manifest.h"
+#include "Filter.h"
+#include "Instrumenter.h"
+#include "Options.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace pira {
+
+namespace {
+
+/// The names of M that a filter entry can select, sorted
+std::vector<std::string> collectNames(const Module &M) {
+  StringSet<> Names;
+  for (const Function &F : M) {
+    if (F.isDeclaration()) {
+      continue;
+    }
+    Names.insert(F.getName());
+    for (const BasicBlock &BB : F) {
+      for (const Instruction &I : BB) {
+        if (const auto *CB = dyn_cast<CallBase>(&I)) {
+          if (const Function *Callee = CB->getCalledFunction()) {
+            if (!Callee->isIntrinsic()) {
+              Names.insert(Callee->getName());
+            }
+          }
+        }
+        // Bodies of inlined functions, named as in instrumentInlinedFunctions
+        const DILocation *Loc = I.getDebugLoc().get();
+        for (; Loc && Loc->getInlinedAt(); Loc = Loc->getInlinedAt()) {
+          if (const DISubprogram *SP = Loc->getScope()->getSubprogram()) {
+            Names.insert(SP->getLinkageName().empty() ? SP->getName() : SP->getLinkageName());
+          }
+        }
+      }
+    }
+  }
+  std::vector<std::string> Sorted;
+  Sorted.reserve(Names.size());
+  for (const auto &Entry : Names) {
+    Sorted.push_back(Entry.getKey().str());
+  }
+  std::sort(Sorted.begin(), Sorted.end());
+  return Sorted;
+}
+
+}  // namespace
+
+void writeManifest(const Module &M, const InstrumentationFilter &Filter) {
+  const auto Directory = getManifestDirectory();
+  if (Directory.empty()) {
+    return;
+  }
+  // The pass runs at several extension points, and again in the ThinLTO backends: the first run writes the manifest,
+  // later runs would add the names of the hooks
+  if (any_of(M, [](const Function &F) { return F.hasFnAttribute(InstrumentedAttr); })) {
+    return;
+  }
+  // The plugin runs in the working directory of the compiler, in which a relative source path is valid
+  SmallString<256> Source(M.getSourceFileName());
+  sys::fs::make_absolute(Source);
+  sys::path::remove_dots(Source, true);
+
+  const auto Names = collectNames(M);
+  json::Array Matched;
+  json::Array AllNames;
+  std::string HashInput = Source.str().str();
+  for (const auto &Name : Names) {
+    if (Filter.isFiltered(Name) || Filter.getLoopDepth(Name) || Filter.isParallelRegionFiltered(Name) ||
+        !Filter.getCallSiteRules(Name).empty()) {
+      Matched.push_back(Name);
+    }
+    AllNames.push_back(Name);
+    HashInput += '\n' + Name;
+  }
+  json::Object Manifest{{"module", M.getModuleIdentifier()},
+                        {"source", Source.str()},
+                        {"matched", std::move(Matched)},
+                        {"names", std::move(AllNames)}};
+
+  if (auto EC = sys::fs::create_directories(Directory)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Manifest directory (" << Directory << ") can not be created: "
+              << EC.message() << std::endl;
+    exit(-1);
+  }
+  SmallString<256> File(Directory);
+  sys::path::append(File, sys::path::filename(Source) + "-" + utohexstr(xxHash64(HashInput)) + ".json");
+  // Written to a temporary file first: other compiler processes of a parallel build may write the same manifest
+  SmallString<256> Temporary;
+  int FD;
+  if (auto EC = sys::fs::createUniqueFile(File + ".%%%%%%", FD, Temporary)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Manifest (" << File.str().str() << ") can not be written: "
+              << EC.message() << std::endl;
+    exit(-1);
+  }
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << json::Value(std::move(Manifest)) << "\n";
+  }
+  if (auto EC = sys::fs::rename(Temporary, File)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Manifest (" << File.str().str() << ") can not be written: "
+              << EC.message() << std::endl;
+    exit(-1);
+  }
+}
+
+}  // namespace pira
@@ -0,0 +1,116 @@
+//===- Options.cpp - Command line options of the instrumentation plugin ---===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#include "Options.h"
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdlib>
+#include <iostream>
+
+using namespace llvm;
+
+namespace pira {
+
+cl::opt<std::string> WhitelistFile("filter-list", cl::desc("Input file w/ mangled names"), cl::value_desc("filename"));
+cl::opt<std::string> ConfigFileScoreP("score-p-filter", cl::desc("Score-P filter"), cl::value_desc("filename"));
+cl::opt<std::string> FilterIndexFile("filter-index", cl::desc("Filter index built by pira-filter-index"),
+                                     cl::value_desc("filename"));
+cl::opt<std::string> InstrumentationHooks(
+    "instrumentation-hooks", cl::desc("Inserted hooks: cyg-profile (default), inline-timer or region-id"),
+    cl::value_desc("kind"));
+cl::opt<bool> RuntimeGuards("runtime-guards", cl::desc("Guard the hooks of every region by an enable byte"));
+cl::opt<std::string> InstrumentationPlacement(
+    "instrumentation-placement",
+    cl::desc("Position in the pipeline: early (default), post-inline or optimizer-last"), cl::value_desc("position"));
+cl::opt<std::string> OverheadBudgetPercent("overhead-budget",
+                                           cl::desc("Skip functions whose hooks cost more than this share of a call"),
+                                           cl::value_desc("percent"));
+cl::opt<std::string> OverheadReportFile("overhead-report", cl::desc("Report of the functions skipped by the budget"),
+                                        cl::value_desc("filename"));
+cl::opt<std::string> ManifestDirectory("manifest-dir", cl::desc("Directory of the per-module filter manifests"),
+                                       cl::value_desc("directory"));
+cl::opt<std::string> RemarksDirectory("instrumentation-remarks-dir",
+                                      cl::desc("Directory of the per-module instrumentation remarks"),
+                                      cl::value_desc("directory"));
+cl::opt<std::string> FeaturesDirectory("features-dir", cl::desc("Directory of the per-module static function features"),
+                                       cl::value_desc("directory"));
+cl::opt<bool> Verbose("instrumentation-verbose", cl::desc("Log every inserted hook to stderr"));
+
+std::string getOptionOrEnv(const cl::opt<std::string> &Opt, const char *EnvVar) {
+  if (!Opt.empty()) {
+    return Opt;
+  }
+  if (const char *Value = std::getenv(EnvVar)) {
+    return Value;
+  }
+  return "";
+}
+
+std::string getWhitelistFile() { return getOptionOrEnv(WhitelistFile, "PIRA_INSTR_FILTER_LIST"); }
+
+std::string getScorePFilterFile() { return getOptionOrEnv(ConfigFileScoreP, "PIRA_INSTR_SCOREP_FILTER"); }
+
+std::string getFilterIndexFile() { return getOptionOrEnv(FilterIndexFile, "PIRA_INSTR_FILTER_INDEX"); }
+
+std::string getInstrumentationHooks() { return getOptionOrEnv(InstrumentationHooks, "PIRA_INSTR_HOOKS"); }
+
+bool useRuntimeGuards() {
+  if (RuntimeGuards) {
+    return true;
+  }
+  const char *Value = std::getenv("PIRA_INSTR_RUNTIME_GUARDS");
+  return Value && *Value && std::string(Value) != "0";
+}
+
+Placement getInstrumentationPlacement() {
+  const auto Value = getOptionOrEnv(InstrumentationPlacement, "PIRA_INSTR_PLACEMENT");
+  if (Value.empty() || Value == "early") {
+    return Placement::Early;
+  }
+  if (Value == "post-inline") {
+    return Placement::PostInline;
+  }
+  if (Value == "optimizer-last") {
+    return Placement::OptimizerLast;
+  }
+  std::cerr << "[LLVMInstrumentor] [Error]: Unknown instrumentation placement '" << Value
+            << "', expected early, post-inline or optimizer-last" << std::endl;
+  exit(-1);
+}
+
+double getOverheadBudget() {
+  const auto Value = getOptionOrEnv(OverheadBudgetPercent, "PIRA_INSTR_OVERHEAD_BUDGET");
+  double Budget = 0;
+  if (!Value.empty() && (StringRef(Value).getAsDouble(Budget) || Budget < 0)) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Invalid overhead budget '" << Value << "', expected a percentage"
+              << std::endl;
+    exit(-1);
+  }
+  return Budget;
+}
+
+std::string getOverheadReportFile() { return getOptionOrEnv(OverheadReportFile, "PIRA_INSTR_OVERHEAD_REPORT"); }
+
+std::string getManifestDirectory() { return getOptionOrEnv(ManifestDirectory, "PIRA_INSTR_MANIFEST_DIR"); }
+
+std::string getRemarksDirectory() { return getOptionOrEnv(RemarksDirectory, "PIRA_INSTR_REMARKS_DIR"); }
+
+std::string getFeaturesDirectory() { return getOptionOrEnv(FeaturesDirectory, "PIRA_INSTR_FEATURES_DIR"); }
+
+bool isVerbose() {
+  // Asked for every hook, the options do not change once they are parsed
+  static const bool IsVerbose = [] {
+    if (Verbose) {
+      return true;
+    }
+    const char *Value = std::getenv("PIRA_INSTR_VERBOSE");
+    return Value && *Value && std::string(Value) != "0";
+  }();
+  return IsVerbose;
+}
+
+}  // namespace pira
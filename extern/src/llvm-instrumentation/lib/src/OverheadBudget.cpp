@@ -0,0 +1,175 @@
+//===- OverheadBudget.cpp - Static pruning of too cheap functions ---------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#include "OverheadBudget.h"
+#include "Diagnostics.h"
+#include "Options.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace llvm;
+
+namespace pira {
+
+namespace {
+// Assumed iterations per loop; deeper nesting levels do not add to the estimate
+constexpr double LoopWeight = 8;
+constexpr unsigned MaxLoopDepth = 3;
+// A call, including the least work of the callee
+constexpr double CallWeight = 10;
+
+StringRef getDecisionName(OverheadBudget::Decision D) {
+  switch (D) {
+    case OverheadBudget::Decision::Keep:
+      return "keep";
+    case OverheadBudget::Decision::Drop:
+      return "drop";
+    case OverheadBudget::Decision::Downgrade:
+      return "downgrade";
+  }
+  return "";
+}
+}  // namespace
+
+OverheadBudget::OverheadBudget(Module &M, double Budget, double HookCost)
+    : module(M), budget(Budget), hookCost(HookCost) {
+  estimateCallSites();
+}
+
+void OverheadBudget::estimateCallSites() {
+  for (Function &F : module) {
+    if (F.isDeclaration()) {
+      continue;
+    }
+    DominatorTree DT(F);
+    LoopInfo LI(DT);
+    for (BasicBlock &BB : F) {
+      const unsigned Depth = LI.getLoopDepth(&BB);
+      for (Instruction &I : BB) {
+        auto *Call = dyn_cast<CallBase>(&I);
+        auto *Callee = Call ? Call->getCalledFunction() : nullptr;
+        if (Callee && !Callee->isIntrinsic()) {
+          auto &CallSiteDepth = callSiteDepths[Callee->getName()];
+          CallSiteDepth = std::max(CallSiteDepth, Depth);
+        }
+      }
+    }
+  }
+}
+
+OverheadBudget::Estimate OverheadBudget::estimate(Function &F) const {
+  Estimate E;
+  DominatorTree DT(F);
+  LoopInfo LI(DT);
+  for (BasicBlock &BB : F) {
+    const double Weight = std::pow(LoopWeight, std::min(LI.getLoopDepth(&BB), MaxLoopDepth));
+    for (Instruction &I : BB) {
+      if (isa<DbgInfoIntrinsic>(I) || I.isLifetimeStartOrEnd()) {
+        continue;
+      }
+      auto *Call = dyn_cast<CallBase>(&I);
+      auto *Callee = Call ? Call->getCalledFunction() : nullptr;
+      if (Call && !(Callee && Callee->isIntrinsic())) {
+        E.leaf = false;
+        E.cost += Weight * CallWeight;
+      } else {
+        E.cost += Weight;
+      }
+    }
+  }
+  const auto It = callSiteDepths.find(F.getName());
+  E.callSiteDepth = It != callSiteDepths.end() ? It->second : 0;
+  E.unknownCallers = !F.hasLocalLinkage() || F.hasAddressTaken();
+  return E;
+}
+
+OverheadBudget::Decision OverheadBudget::decide(StringRef Name) {
+  const auto It = estimates.find(Name);
+  if (It != estimates.end()) {
+    return It->second.decision;
+  }
+  Function *F = module.getFunction(Name);
+  if (!F || F->isDeclaration() || Name == "main") {
+    return Decision::Keep;
+  }
+  Estimate E = estimate(*F);
+  // Callers in other modules are only assumed to call in loops for leaf functions, e.g., getters
+  const bool Hot = E.callSiteDepth > 0 || (E.leaf && E.unknownCallers);
+  if (Hot && hookCost * 100 > budget * E.cost) {
+    E.decision = E.leaf ? Decision::Drop : Decision::Downgrade;
+    if (isVerbose()) {
+      std::cerr << "[LLVMInstrumentor] [DEBUG]: Overhead budget: " << getDecisionName(E.decision).str() << " "
+                << Name.str() << std::endl;
+    }
+    reportSkipped(*F, RegionKind::Function, Name,
+                  E.decision == Decision::Drop ? "the hooks exceed the overhead budget"
+                                               : "the hooks exceed the overhead budget, measured at its call sites");
+  }
+  estimates[Name] = E;
+  order.push_back(Name.str());
+  return E.decision;
+}
+
+void OverheadBudget::writeReport() const {
+  const auto File = getOverheadReportFile();
+  if (File.empty()) {
+    return;
+  }
+  // One write per module: the compiler processes of a parallel build append to the same report
+  std::string Buffer;
+  raw_string_ostream Lines(Buffer);
+  for (const auto &Name : order) {
+    const auto &E = estimates.find(Name)->second;
+    if (E.decision == Decision::Keep) {
+      continue;
+    }
+    json::Object Entry{{"module", module.getModuleIdentifier()},
+                       {"function", Name},
+                       {"action", getDecisionName(E.decision)},
+                       {"cost", E.cost},
+                       {"hookCost", hookCost},
+                       {"overhead", hookCost * 100 / E.cost},
+                       {"budget", budget},
+                       {"callSiteDepth", static_cast<int64_t>(E.callSiteDepth)},
+                       {"unknownCallers", E.unknownCallers},
+                       {"leaf", E.leaf}};
+    Lines << json::Value(std::move(Entry)) << "\n";
+  }
+  Lines.flush();
+  if (Buffer.empty()) {
+    return;
+  }
+  std::error_code EC;
+  raw_fd_ostream OS(File, EC, sys::fs::OF_Append);
+  if (EC) {
+    std::cerr << "[LLVMInstrumentor] [Error]: Overhead report (" << File << ") can not be written: " << EC.message()
+              << std::endl;
+    exit(-1);
+  }
+  OS << Buffer;
+}
+
+std::unique_ptr<OverheadBudget> createOverheadBudget(Module &M, double HookCost) {
+  const double Budget = getOverheadBudget();
+  if (Budget <= 0) {
+    return nullptr;
+  }
+  return std::make_unique<OverheadBudget>(M, Budget, HookCost);
+}
+
+}  // namespace pira
@@ -0,0 +1,124 @@
+//===- PiraRuntime.h - Runtime of the inline instrumentation hooks --------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// ABI between the code emitted by the plugin (lib/src/HookEmitter.cpp) and
+// the runtime.
+//
+// Inline timer: the plugin emits one pira_timer_module per instrumented
+// module and a thread-local pointer to the slots of that module. The first
+// exit event of a thread calls __pira_timer_register, all further events
+// update the slots inline. The runtime writes the totals at exit; an MPI
+// library (ImbalanceRuntime.cpp) can read them with pira_timer_visit and
+// reduce them across the ranks instead.
+//
+// Runtime guards: the plugin emits one enable byte per region and a table of
+// pira_guard_entry in the pira_guard_names section. A constructor passes the
+// bounds of the section to __pira_guards_init, which enables the regions
+// selected by the file in PIRA_RUNTIME_FILTER (a whitelist or a Score-P filter
+// file) and disables all others.
+//
+// Region IDs: the plugin emits one ID slot per region and a table of
+// pira_region_entry in the pira_regions section. A constructor passes the
+// bounds of the section to __pira_regions_init, which assigns dense IDs (the
+// same ID for the same name in every module) and fills the slots. The hooks
+// receive the ID. The runtime implements them with the timer of this runtime;
+// a measurement system can define its own __pira_region_enter / exit, which
+// take precedence, and map IDs to names with pira_region_info.
+//
+// Indirect call sites: the callee is only known at run time. The hooks pass
+// the site name ("<caller>:<line>->*") and the called pointer; the runtime
+// maps the pair to a region named after the site with the symbol of the
+// target in place of the "*".
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef PIRA_RUNTIME_H
+#define PIRA_RUNTIME_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PIRA_TIMER_ABI_VERSION 1
+
+/// Clock of the timestamps of a module
+enum pira_timer_clock {
+  PIRA_TIMER_CLOCK_CYCLES = 0,      // llvm.readcyclecounter (TSC)
+  PIRA_TIMER_CLOCK_NANOSECONDS = 1  // __pira_timer_now
+};
+
+typedef struct pira_timer_slot {
+  uint64_t calls;
+  uint64_t ticks;
+} pira_timer_slot;
+
+typedef struct pira_timer_module {
+  uint32_t version;
+  uint32_t clock;
+  uint32_t num_regions;
+  const char *const *region_names;
+  const char *module_name;
+} pira_timer_module;
+
+/// Allocates the slots of the calling thread for module. The slots are never freed, they are reported at exit.
+pira_timer_slot *__pira_timer_register(const pira_timer_module *module);
+
+/// Monotonic time in nanoseconds, used on targets without a cycle counter.
+uint64_t __pira_timer_now(void);
+
+/// Adds a call from an indirect call site to target that took ticks of clock (see pira_timer_clock).
+void __pira_timer_indirect(const char *site, void *target, uint64_t ticks, uint32_t clock);
+
+/// Totals of a region, summed over the threads: the completed calls and their inclusive time in seconds.
+typedef void (*pira_timer_visitor)(const char *name, uint64_t calls, double seconds, void *data);
+
+/// Calls visitor for every region of the inline timer and of the region ID hooks that has calls so far.
+void pira_timer_visit(pira_timer_visitor visitor, void *data);
+
+/// The runtime writes no profile at exit, e.g., because the regions were already reduced across the ranks.
+void pira_timer_disable_output(void);
+
+typedef struct pira_guard_entry {
+  uint8_t *guard;
+  const char *name;
+} pira_guard_entry;
+
+/// Sets the enable bytes of the entries in [start, stop). Without PIRA_RUNTIME_FILTER, all regions stay enabled.
+void __pira_guards_init(const pira_guard_entry *start, const pira_guard_entry *stop);
+
+typedef struct pira_region_entry {
+  uint32_t *id;
+  const char *name;
+  const char *file;
+  uint32_t line;
+} pira_region_entry;
+
+/// Region ID of regions that are not registered
+#define PIRA_INVALID_REGION_ID UINT32_MAX
+
+/// Assigns the IDs of the regions in [start, stop).
+void __pira_regions_init(const pira_region_entry *start, const pira_region_entry *stop);
+
+/// Region ID of a call from an indirect call site to target, registered on first use.
+uint32_t __pira_region_indirect(const char *site, void *target);
+
+/// Region hooks; weak in the runtime.
+void __pira_region_enter(uint32_t id);
+void __pira_region_exit(uint32_t id);
+
+/// Number of registered regions, i.e., the IDs are in [0, pira_region_count()).
+uint32_t pira_region_count(void);
+
+/// Name, file and line of a region (file is "" and line 0 without debug info). Returns 0 for an invalid ID.
+int pira_region_info(uint32_t id, const char **name, const char **file, uint32_t *line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PIRA_RUNTIME_H
@@ -0,0 +1,96 @@
+//===- PiraTrace.h - Binary trace format of the trace runtime -------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// Format of the trace files of libpira_trace (runtime/src/TraceRuntime.cpp),
+// one file per process, in the byte order of the machine that wrote it.
+//
+// The file starts with a pira_trace_header, followed by blocks. Every block
+// is a pira_trace_block and size bytes of payload:
+//  - PIRA_TRACE_BLOCK_THREAD: the first block of a thread, a pira_trace_thread
+//    with the OS thread ID and the cost of recording an event on the thread.
+//    Threads are numbered densely in the order of their first event. In
+//    version 1, the payload is only the uint64_t OS thread ID.
+//  - PIRA_TRACE_BLOCK_EVENTS: events of one thread in the order they
+//    happened, an array of pira_trace_event. The blocks of different threads
+//    interleave in the file.
+//  - PIRA_TRACE_BLOCK_REGION: the name of a region, a pira_trace_region and
+//    name_length bytes of the name (not terminated). Written when the process
+//    exits, after all events.
+//
+// Events carry the timestamp in ticks of the clock in the header, shifted by
+// PIRA_TRACE_EVENT_TIME_SHIFT, and the flags in the low bits. A trace whose
+// header has size 0 was not finished, e.g., because the process crashed; its
+// blocks up to the last complete one are still valid.
+//
+// Every event adds its cost to the measured times: one event to the time of
+// its own region, two events (its enter and exit) to the time of every region
+// it is nested in. Readers subtract the event cost of the thread, measured
+// when the thread recorded its first event, to compensate the overhead.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef PIRA_TRACE_H
+#define PIRA_TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PIRA_TRACE_MAGIC "PIRATRC"
+#define PIRA_TRACE_VERSION 2
+
+typedef struct pira_trace_header {
+  char magic[8];         // PIRA_TRACE_MAGIC
+  uint32_t version;      // PIRA_TRACE_VERSION
+  uint32_t clock;        // pira_timer_clock of PiraRuntime.h
+  int32_t rank;          // Rank given by the MPI launcher, -1 without
+  uint32_t pid;
+  uint64_t size;         // Size of the file, 0 while it is written
+  uint64_t start_ticks;  // Time of the start of the process
+  double tick_seconds;   // Length of a tick, measured over the lifetime of the process for cycles
+} pira_trace_header;
+
+enum pira_trace_block_kind {
+  PIRA_TRACE_BLOCK_THREAD = 1,
+  PIRA_TRACE_BLOCK_EVENTS = 2,
+  PIRA_TRACE_BLOCK_REGION = 3
+};
+
+typedef struct pira_trace_block {
+  uint32_t kind;    // pira_trace_block_kind
+  uint32_t thread;  // Thread of THREAD and EVENTS blocks, 0 otherwise
+  uint64_t size;    // Bytes of payload that follow
+} pira_trace_block;
+
+typedef struct pira_trace_thread {
+  uint64_t os_thread;
+  double event_ticks;  // Ticks between the timestamps of back-to-back events, i.e., the cost of one event
+} pira_trace_thread;
+
+/// The event leaves the region, otherwise it enters it
+#define PIRA_TRACE_EVENT_EXIT 1u
+/// The region is a function address (cyg-profile hooks), otherwise a region ID (region-id hooks)
+#define PIRA_TRACE_EVENT_ADDRESS 2u
+#define PIRA_TRACE_EVENT_TIME_SHIFT 2
+
+typedef struct pira_trace_event {
+  uint64_t time_flags;  // ticks << PIRA_TRACE_EVENT_TIME_SHIFT | flags
+  uint64_t region;
+} pira_trace_event;
+
+typedef struct pira_trace_region {
+  uint64_t region;
+  uint32_t flags;  // PIRA_TRACE_EVENT_ADDRESS for function addresses
+  uint32_t name_length;
+} pira_trace_region;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PIRA_TRACE_H
@@ -0,0 +1,228 @@
+//===- GuardRuntime.cpp - Runtime of the region enable guards -------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// Reads the filter in PIRA_RUNTIME_FILTER once and sets the enable bytes of
+// every instrumented executable and shared library. The filter is either a
+// whitelist with one mangled name per line, or a Score-P filter file with the
+// grammar and the semantics of the plugin: the last matching rule decides, a
+// name that no rule matches is disabled, and patterns without MANGLED also
+// match the demangled name. Call site rules (caller -> callee) are ignored, LOOPS rules
+// select the loop regions, PARALLEL rules the OpenMP parallel regions and
+// caller -> INDIRECT rules the indirect call sites of their functions.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PiraRuntime.h"
+
+#include "FilterParser.h"
+
+#include <cxxabi.h>
+#include <fnmatch.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct Rule {
+  bool include;
+  bool mangled;
+  std::string pattern;
+};
+
+bool hasWildcard(const std::string &Pattern) { return Pattern.find_first_of("*?[\\") != std::string::npos; }
+
+std::string demangle(const char *Name) {
+  if (Name[0] != '_' || Name[1] != 'Z') {
+    return Name;
+  }
+  int Status = 0;
+  char *Demangled = abi::__cxa_demangle(Name, nullptr, nullptr, &Status);
+  if (Status != 0 || !Demangled) {
+    return Name;
+  }
+  std::string Result(Demangled);
+  std::free(Demangled);
+  return Result;
+}
+
+/// Score-P rules in their order, the last matching rule decides.
+class RuleSet {
+ public:
+  void add(Rule R) {
+    const auto Id = rules.size();
+    if (!hasWildcard(R.pattern)) {
+      // The mangled name is always compared; plain patterns may also be a demangled name
+      exactRules[R.pattern] = Id;
+      if (!R.mangled) {
+        demangledRules[R.pattern] = Id;
+      }
+    } else {
+      wildcardRules.push_back(Id);
+    }
+    rules.push_back(std::move(R));
+  }
+
+  /// Whether the last rule that matches Name is an INCLUDE rule.
+  bool includes(const std::string &Name) const {
+    // Exact names are looked up, only wildcard rules behind the last exact match need to be evaluated
+    long Last = -1;
+    auto Exact = exactRules.find(Name);
+    if (Exact != exactRules.end()) {
+      Last = static_cast<long>(Exact->second);
+    }
+    std::string Demangled;
+    for (long I = static_cast<long>(wildcardRules.size()) - 1; I >= 0; --I) {
+      const auto &R = rules[wildcardRules[I]];
+      if (static_cast<long>(wildcardRules[I]) < Last) {
+        break;
+      }
+      bool Matches = fnmatch(R.pattern.c_str(), Name.c_str(), 0) == 0;
+      if (!Matches && !R.mangled) {
+        if (Demangled.empty()) {
+          Demangled = demangle(Name.c_str());
+        }
+        Matches = fnmatch(R.pattern.c_str(), Demangled.c_str(), 0) == 0;
+      }
+      if (Matches) {
+        Last = static_cast<long>(wildcardRules[I]);
+        break;
+      }
+    }
+    if (!demangledRules.empty()) {
+      if (Demangled.empty()) {
+        Demangled = demangle(Name.c_str());
+      }
+      auto Plain = demangledRules.find(Demangled);
+      if (Plain != demangledRules.end() && static_cast<long>(Plain->second) > Last) {
+        Last = static_cast<long>(Plain->second);
+      }
+    }
+    return Last >= 0 && rules[Last].include;
+  }
+
+ private:
+  std::vector<Rule> rules;
+  std::unordered_map<std::string, size_t> exactRules;  // Last rule per exact pattern
+  std::vector<size_t> wildcardRules;
+  std::unordered_map<std::string, size_t> demangledRules;  // Last rule per exact, non-mangled pattern
+};
+
+class RuntimeFilter {
+ public:
+  RuntimeFilter() {
+    const char *FileName = std::getenv("PIRA_RUNTIME_FILTER");
+    if (!FileName || !*FileName) {
+      return;
+    }
+    std::ifstream In(FileName);
+    if (!In) {
+      std::fprintf(stderr, "[PIRA runtime] [Error]: Can not open %s, all regions stay enabled\n", FileName);
+      return;
+    }
+    std::stringstream Content;
+    Content << In.rdbuf();
+    const auto Text = Content.str();
+    if (Text.find("SCOREP_REGION_NAMES_BEGIN") != std::string::npos) {
+      if (!parseScorePFilter(Text)) {
+        return;
+      }
+    } else {
+      std::istringstream Lines(Text);
+      std::string Line;
+      while (std::getline(Lines, Line)) {
+        std::istringstream Tokens(Line);
+        std::string Name;
+        if (Tokens >> Name) {
+          whitelist.insert(Name);
+        }
+      }
+    }
+    active = true;
+  }
+
+  bool isEnabled(const char *Name) const {
+    if (!active) {
+      return true;
+    }
+    // Loops are named <function>:<line>, indirect call sites <function>:<line>->*, parallel regions
+    // <function>:...omp_parallel...; symbol names contain neither. LOOPS, PARALLEL and INDIRECT rules decide by the
+    // function.
+    const std::string Region(Name);
+    const auto Colon = Region.find(':');
+    if (Colon != std::string::npos) {
+      const auto Function = Region.substr(0, Colon);
+      if (Region.find("->") != std::string::npos) {
+        return indirectRules.includes(Function);
+      }
+      return Region.find(":omp_parallel") != std::string::npos ? parallelRules.includes(Function)
+                                                                : loopRules.includes(Function);
+    }
+    return whitelist.count(Region) || functionRules.includes(Region);
+  }
+
+ private:
+  bool parseScorePFilter(const std::string &Text) {
+    std::istringstream Input(Text);
+    std::vector<pira::FilterRule> Rules;
+    std::string Error;
+    if (!pira::parseScorePFilter(Input, Rules, Error)) {
+      std::fprintf(stderr, "[PIRA runtime] [Error]: %s All regions stay enabled\n", Error.c_str());
+      return false;
+    }
+    for (const auto &R : Rules) {
+      const Rule Added{R.include, R.pattern.mangled, R.pattern.text};
+      if (R.isCallSite) {
+        // Only caller -> INDIRECT, the guards of direct call sites belong to the callee
+        if (R.isIndirect) {
+          indirectRules.add(Added);
+        }
+      } else if (R.parallel) {
+        parallelRules.add(Added);
+      } else if (R.loopDepth > 0) {
+        // The depth was applied at compile time
+        loopRules.add(Added);
+      } else {
+        functionRules.add(Added);
+      }
+    }
+    return true;
+  }
+
+  bool active{false};
+  std::unordered_set<std::string> whitelist;
+  RuleSet functionRules;
+  RuleSet loopRules;
+  RuleSet parallelRules;
+  RuleSet indirectRules;
+};
+
+const RuntimeFilter &getFilter() {
+  // Shared by the constructors of all instrumented executables and shared libraries
+  static const RuntimeFilter Filter;
+  return Filter;
+}
+
+}  // namespace
+
+extern "C" {
+
+void __pira_guards_init(const pira_guard_entry *start, const pira_guard_entry *stop) {
+  const auto &Filter = getFilter();
+  for (auto *Entry = start; Entry < stop; ++Entry) {
+    // Tolerate padding between the tables of different modules
+    if (Entry->guard && Entry->name) {
+      *Entry->guard = Filter.isEnabled(Entry->name) ? 1 : 0;
+    }
+  }
+}
+}
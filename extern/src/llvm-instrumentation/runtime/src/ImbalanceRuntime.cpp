@@ -0,0 +1,253 @@
+//===- ImbalanceRuntime.cpp - Reduces the region times across the ranks ---===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// Intercepts MPI_Finalize through the MPI profiling interface. Every rank puts
+// the totals of its regions (see pira_timer_visit) into a hash table of fixed
+// capacity, and one MPI_Reduce with a custom operation merges the tables into
+// the visits and the sum, min and max of the inclusive time of every region
+// across the ranks. Rank 0 writes the summary in the format of
+// pira-profile-aggregate; no rank writes its own profile.
+//
+// The tables are keyed by a hash of the region name and carry a prefix of the
+// name, so that ranks with different regions, e.g., other indirect call
+// targets, reduce correctly. All ranks need the same capacity, i.e., the same
+// PIRA_IMBALANCE_REGIONS. The regions of a full table are dropped and counted.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PiraRuntime.h"
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t DefaultCapacity = 1 << 12;
+// Longer names are truncated, the hash still tells the regions apart
+constexpr size_t NameLength = 112;
+
+struct Header {
+  uint64_t ranks;
+  uint64_t dropped;  // Regions that did not fit into the table of a rank, summed over the ranks
+  uint64_t capacity;
+};
+
+struct Entry {
+  uint64_t hash;  // 0 for an empty entry
+  uint64_t ranks;
+  uint64_t visits;
+  int64_t slowestRank;
+  double sum;
+  double min;
+  double max;
+  char name[NameLength];
+};
+
+uint64_t hashName(const char *Name) {
+  // FNV-1a
+  uint64_t Hash = 14695981039346656037ULL;
+  for (; *Name; ++Name) {
+    Hash = (Hash ^ static_cast<unsigned char>(*Name)) * 1099511628211ULL;
+  }
+  return Hash ? Hash : 1;
+}
+
+/// A header followed by the entries, one contiguous MPI datatype
+class RegionTable {
+ public:
+  explicit RegionTable(uint64_t Capacity) : data(sizeof(Header) + Capacity * sizeof(Entry)) {
+    getHeader(data.data())->capacity = Capacity;
+  }
+
+  char *getData() { return data.data(); }
+  size_t getSize() const { return data.size(); }
+
+  static Header *getHeader(void *Data) { return static_cast<Header *>(Data); }
+  static Entry *getEntries(void *Data) { return reinterpret_cast<Entry *>(static_cast<char *>(Data) + sizeof(Header)); }
+
+  /// The entry of Hash, or the empty entry to insert it, or nullptr if the table is full
+  static Entry *find(void *Data, uint64_t Hash) {
+    const uint64_t Capacity = getHeader(Data)->capacity;
+    Entry *Entries = getEntries(Data);
+    for (uint64_t I = 0; I < Capacity; ++I) {
+      Entry &E = Entries[(Hash + I) & (Capacity - 1)];
+      if (E.hash == Hash || E.hash == 0) {
+        return &E;
+      }
+    }
+    return nullptr;
+  }
+
+  /// Merges the table In into InOut, the reduction operation
+  static void merge(void *In, void *InOut) {
+    getHeader(InOut)->ranks += getHeader(In)->ranks;
+    getHeader(InOut)->dropped += getHeader(In)->dropped;
+    const uint64_t Capacity = getHeader(In)->capacity;
+    const Entry *Entries = getEntries(In);
+    for (uint64_t I = 0; I < Capacity; ++I) {
+      const Entry &From = Entries[I];
+      if (!From.hash) {
+        continue;
+      }
+      Entry *To = find(InOut, From.hash);
+      if (!To) {
+        ++getHeader(InOut)->dropped;
+      } else if (!To->hash) {
+        *To = From;
+      } else {
+        To->ranks += From.ranks;
+        To->visits += From.visits;
+        To->sum += From.sum;
+        To->min = std::min(To->min, From.min);
+        if (From.max > To->max || (From.max == To->max && From.slowestRank < To->slowestRank)) {
+          To->max = From.max;
+          To->slowestRank = From.slowestRank;
+        }
+      }
+    }
+  }
+
+ private:
+  std::vector<char> data;
+};
+
+struct RankRegions {
+  char *table;
+  int rank;
+};
+
+void addRegion(const char *Name, uint64_t Calls, double Seconds, void *Data) {
+  auto *Regions = static_cast<RankRegions *>(Data);
+  const uint64_t Hash = hashName(Name);
+  Entry *E = RegionTable::find(Regions->table, Hash);
+  if (!E) {
+    ++RegionTable::getHeader(Regions->table)->dropped;
+    return;
+  }
+  *E = Entry{Hash, 1, Calls, Regions->rank, Seconds, Seconds, Seconds, {}};
+  std::strncpy(E->name, Name, NameLength - 1);
+}
+
+void reduceTables(void *In, void *InOut, int *Count, MPI_Datatype *Type) {
+  int Size = 0;
+  PMPI_Type_size(*Type, &Size);
+  for (int I = 0; I < *Count; ++I) {
+    RegionTable::merge(static_cast<char *>(In) + I * Size, static_cast<char *>(InOut) + I * Size);
+  }
+}
+
+uint64_t getCapacity() {
+  const char *Value = std::getenv("PIRA_IMBALANCE_REGIONS");
+  if (!Value || !*Value) {
+    return DefaultCapacity;
+  }
+  char *End = nullptr;
+  const auto Number = std::strtoull(Value, &End, 10);
+  if (*End || Number == 0 || (Number & (Number - 1))) {
+    std::fprintf(stderr, "[PIRA runtime] [Warning]: Ignoring PIRA_IMBALANCE_REGIONS=%s, expected a power of 2\n",
+                 Value);
+    return DefaultCapacity;
+  }
+  return Number;
+}
+
+void writeString(std::FILE *Out, const char *String) {
+  std::fputc('"', Out);
+  for (; *String; ++String) {
+    const unsigned char C = *String;
+    if (C == '"' || C == '\\') {
+      std::fprintf(Out, "\\%c", C);
+    } else if (C < 0x20) {
+      std::fprintf(Out, "\\u%04x", C);
+    } else {
+      std::fputc(C, Out);
+    }
+  }
+  std::fputc('"', Out);
+}
+
+/// The summary of pira-profile-aggregate, with the rank of the maximum
+void writeSummary(void *Table) {
+  const char *FileName = std::getenv("PIRA_IMBALANCE_OUTPUT");
+  if (!FileName || !*FileName) {
+    FileName = "pira-imbalance.json";
+  }
+  std::FILE *Out = std::fopen(FileName, "w");
+  if (!Out) {
+    std::fprintf(stderr, "[PIRA runtime] [Error]: Can not open %s\n", FileName);
+    return;
+  }
+  const Header &H = *RegionTable::getHeader(Table);
+  std::vector<const Entry *> Regions;
+  const Entry *Entries = RegionTable::getEntries(Table);
+  for (uint64_t I = 0; I < H.capacity; ++I) {
+    if (Entries[I].hash) {
+      Regions.push_back(&Entries[I]);
+    }
+  }
+  std::sort(Regions.begin(), Regions.end(), [](const Entry *A, const Entry *B) {
+    if (A->sum != B->sum) {
+      return A->sum > B->sum;
+    }
+    return std::strcmp(A->name, B->name) < 0;
+  });
+
+  std::fprintf(Out, "{\"ranks\":%llu,", static_cast<unsigned long long>(H.ranks));
+  if (H.dropped) {
+    std::fprintf(Out, "\"dropped\":%llu,", static_cast<unsigned long long>(H.dropped));
+  }
+  std::fprintf(Out, "\"regions\":[");
+  for (size_t I = 0; I < Regions.size(); ++I) {
+    const Entry &R = *Regions[I];
+    // Ranks that did not visit a region count as 0
+    const double Min = R.ranks < H.ranks ? 0.0 : R.min;
+    std::fprintf(Out, "%s{\"name\":", I ? "," : "");
+    writeString(Out, R.name);
+    std::fprintf(Out,
+                 ",\"ranks\":%llu,\"visits\":%llu,\"slowestRank\":%lld,"
+                 "\"inclusive\":{\"sum\":%.9g,\"min\":%.9g,\"max\":%.9g,\"mean\":%.9g}}",
+                 static_cast<unsigned long long>(R.ranks), static_cast<unsigned long long>(R.visits),
+                 static_cast<long long>(R.slowestRank), R.sum, Min, R.max, R.sum / H.ranks);
+  }
+  std::fprintf(Out, "]}\n");
+  std::fclose(Out);
+}
+
+}  // namespace
+
+extern "C" int MPI_Finalize(void) {
+  int Rank = 0;
+  PMPI_Comm_rank(MPI_COMM_WORLD, &Rank);
+  const uint64_t Capacity = getCapacity();
+  RegionTable Local(Capacity);
+  RankRegions Regions{Local.getData(), Rank};
+  RegionTable::getHeader(Local.getData())->ranks = 1;
+  pira_timer_visit(addRegion, &Regions);
+
+  MPI_Datatype Type;
+  MPI_Op Op;
+  PMPI_Type_contiguous(static_cast<int>(Local.getSize()), MPI_BYTE, &Type);
+  PMPI_Type_commit(&Type);
+  PMPI_Op_create(reduceTables, 1, &Op);
+  // Only the root receives the reduced table
+  RegionTable Global(Rank == 0 ? Capacity : 0);
+  PMPI_Reduce(Local.getData(), Global.getData(), 1, Type, Op, 0, MPI_COMM_WORLD);
+  PMPI_Op_free(&Op);
+  PMPI_Type_free(&Type);
+
+  if (Rank == 0) {
+    writeSummary(Global.getData());
+  }
+  pira_timer_disable_output();
+  return PMPI_Finalize();
+}
@@ -0,0 +1,42 @@
+//===- IndirectCalls.cpp - Regions of indirect call sites -----------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndirectCalls.h"
+
+#include <dlfcn.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+namespace pira {
+
+std::string getSymbolName(void *Address) {
+  Dl_info Info;
+  if (dladdr(Address, &Info) == 0) {
+    char Hex[32];
+    std::snprintf(Hex, sizeof(Hex), "0x%" PRIxPTR, reinterpret_cast<uintptr_t>(Address));
+    return Hex;
+  }
+  if (Info.dli_sname && Info.dli_saddr == Address) {
+    return Info.dli_sname;
+  }
+  const char *Object = Info.dli_fname ? std::strrchr(Info.dli_fname, '/') : nullptr;
+  char Offset[32];
+  std::snprintf(Offset, sizeof(Offset), "+0x%" PRIxPTR,
+                reinterpret_cast<uintptr_t>(Address) - reinterpret_cast<uintptr_t>(Info.dli_fbase));
+  return std::string(Object ? Object + 1 : (Info.dli_fname ? Info.dli_fname : "")) + Offset;
+}
+
+std::string getIndirectRegionName(const char *Site, void *Target) {
+  std::string Name(Site);
+  if (!Name.empty() && Name.back() == '*') {
+    Name.pop_back();
+  }
+  return Name + getSymbolName(Target);
+}
+
+}  // namespace pira
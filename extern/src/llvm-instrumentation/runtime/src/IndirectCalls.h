@@ -0,0 +1,39 @@
+//===- IndirectCalls.h - Regions of indirect call sites -------------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef PIRA_RUNTIME_INDIRECTCALLS_H
+#define PIRA_RUNTIME_INDIRECTCALLS_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace pira {
+
+/// A pair of indirect call site and target, which the hooks map to a region with a per-thread cache.
+struct IndirectCall {
+  const char *site;
+  void *target;
+
+  bool operator==(const IndirectCall &Other) const { return site == Other.site && target == Other.target; }
+};
+
+struct IndirectCallHash {
+  size_t operator()(const IndirectCall &Call) const {
+    return std::hash<const void *>()(Call.site) * 31 + std::hash<void *>()(Call.target);
+  }
+};
+
+/// Symbol at Address, or <object file>+<offset> if it has none (e.g., in an executable linked without -rdynamic).
+std::string getSymbolName(void *Address);
+
+/// Region name of a call from the indirect call site Site ("<caller>:<line>->*") to Target: the "*" is replaced by the
+/// symbol name of Target.
+std::string getIndirectRegionName(const char *Site, void *Target);
+
+}  // namespace pira
+
+#endif  // PIRA_RUNTIME_INDIRECTCALLS_H
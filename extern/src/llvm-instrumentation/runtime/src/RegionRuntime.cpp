@@ -0,0 +1,163 @@
+//===- RegionRuntime.cpp - Runtime of the region ID hooks -----------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// Registers the regions of every instrumented executable and shared library
+// with one walk over its table; no symbol table is read. The regions of
+// indirect call sites are registered on the first call to each target.
+//
+// The default hooks measure the inclusive time per region with a per-thread
+// stack of entry timestamps. The per-thread counters are registered with the
+// timer runtime (TimerRuntime.cpp), which reports them at exit. Regions that
+// are registered later, e.g., by dlopen, make a thread register a new, larger
+// set of counters; the report sums up all of them by name.
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndirectCalls.h"
+#include "PiraRuntime.h"
+
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+struct RegionInfo {
+  const char *name;
+  const char *file;
+  uint32_t line;
+};
+
+class RegionRegistry {
+ public:
+  void registerRegions(const pira_region_entry *Start, const pira_region_entry *Stop) {
+    std::lock_guard<std::mutex> Lock(mutex);
+    for (auto *Entry = Start; Entry < Stop; ++Entry) {
+      // Tolerate padding between the tables of different modules
+      if (!Entry->id || !Entry->name) {
+        continue;
+      }
+      auto It = ids.emplace(Entry->name, static_cast<uint32_t>(regions.size()));
+      if (It.second) {
+        regions.push_back({Entry->name, Entry->file, Entry->line});
+      }
+      *Entry->id = It.first->second;
+    }
+  }
+
+  /// Registers the region of calls from an indirect call site to Target, once per name
+  uint32_t registerIndirect(const char *Site, void *Target) {
+    auto Name = pira::getIndirectRegionName(Site, Target);
+    std::lock_guard<std::mutex> Lock(mutex);
+    auto It = ids.emplace(Name, static_cast<uint32_t>(regions.size()));
+    if (It.second) {
+      // Never freed, the timer runtime reports the names after the registry is destroyed
+      regions.push_back({strdup(Name.c_str()), "", 0});
+    }
+    return It.first->second;
+  }
+
+  uint32_t size() {
+    std::lock_guard<std::mutex> Lock(mutex);
+    return static_cast<uint32_t>(regions.size());
+  }
+
+  bool getInfo(uint32_t Id, RegionInfo &Info) {
+    std::lock_guard<std::mutex> Lock(mutex);
+    if (Id >= regions.size()) {
+      return false;
+    }
+    Info = regions[Id];
+    return true;
+  }
+
+  /// Timer module with the names of all regions registered so far; kept alive until exit
+  const pira_timer_module *createTimerModule() {
+    std::lock_guard<std::mutex> Lock(mutex);
+    auto *Names = new const char *[regions.size()];
+    for (size_t I = 0; I < regions.size(); ++I) {
+      Names[I] = regions[I].name;
+    }
+    auto *Module = new pira_timer_module{PIRA_TIMER_ABI_VERSION, PIRA_TIMER_CLOCK_NANOSECONDS,
+                                         static_cast<uint32_t>(regions.size()), Names, "pira_regions"};
+    return Module;
+  }
+
+ private:
+  std::mutex mutex;
+  std::unordered_map<std::string, uint32_t> ids;
+  std::vector<RegionInfo> regions;
+};
+
+RegionRegistry &getRegistry() {
+  // Function-local, the constructors of instrumented libraries may run before the ones of this library
+  static RegionRegistry Registry;
+  return Registry;
+}
+
+struct ThreadState {
+  pira_timer_slot *slots{nullptr};
+  uint32_t numSlots{0};
+  std::vector<uint64_t> entries;
+  std::unordered_map<pira::IndirectCall, uint32_t, pira::IndirectCallHash> indirectIds;
+};
+
+thread_local ThreadState State;
+
+}  // namespace
+
+extern "C" {
+
+void __pira_regions_init(const pira_region_entry *start, const pira_region_entry *stop) {
+  getRegistry().registerRegions(start, stop);
+}
+
+__attribute__((weak)) void __pira_region_enter(uint32_t id) {
+  if (id != PIRA_INVALID_REGION_ID) {
+    State.entries.push_back(__pira_timer_now());
+  }
+}
+
+__attribute__((weak)) void __pira_region_exit(uint32_t id) {
+  // Exits without entry, e.g., of a region that was entered before it was registered, are dropped
+  if (id == PIRA_INVALID_REGION_ID || State.entries.empty()) {
+    return;
+  }
+  const auto Elapsed = __pira_timer_now() - State.entries.back();
+  State.entries.pop_back();
+  if (id >= State.numSlots) {
+    const auto *Module = getRegistry().createTimerModule();
+    State.slots = __pira_timer_register(Module);
+    State.numSlots = Module->num_regions;
+  }
+  State.slots[id].calls += 1;
+  State.slots[id].ticks += Elapsed;
+}
+
+uint32_t __pira_region_indirect(const char *site, void *target) {
+  auto It = State.indirectIds.find({site, target});
+  if (It == State.indirectIds.end()) {
+    const auto Id = getRegistry().registerIndirect(site, target);
+    It = State.indirectIds.emplace(pira::IndirectCall{site, target}, Id).first;
+  }
+  return It->second;
+}
+
+uint32_t pira_region_count(void) { return getRegistry().size(); }
+
+int pira_region_info(uint32_t id, const char **name, const char **file, uint32_t *line) {
+  RegionInfo Info;
+  if (!getRegistry().getInfo(id, Info)) {
+    return 0;
+  }
+  *name = Info.name;
+  *file = Info.file;
+  *line = Info.line;
+  return 1;
+}
+}
@@ -0,0 +1,217 @@
+//===- TimerRuntime.cpp - Runtime of the inline timer hooks ---------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// Collects the per-thread slots of all instrumented modules and writes one
+// line per region at exit:
+//   region;calls;ticks;seconds
+// Regions with the same name (e.g., inline functions instrumented in several
+// modules, or the calls of one indirect call site to the same target from
+// several threads) are summed up. OpenMP parallel regions additionally get one
+// line per thread, region#<thread>, where the threads are numbered in the
+// order of their first event. The output file is PIRA_TIMER_OUTPUT or
+// pira-timer-<pid>.csv in the working directory. No file is written if the
+// imbalance runtime already reduced the regions at MPI_Finalize.
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndirectCalls.h"
+#include "PiraRuntime.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PIRA_HAS_TSC 1
+#endif
+
+namespace {
+
+/// Number of the calling thread, assigned at its first registration
+thread_local int ThreadNumber = -1;
+
+struct Registration {
+  const pira_timer_module *module;
+  pira_timer_slot *slots;
+  unsigned thread;
+};
+
+struct Totals {
+  uint64_t calls{0};
+  uint64_t ticks{0};
+  double seconds{0};
+};
+
+uint64_t nowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t readCycles() {
+#ifdef PIRA_HAS_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+class TimerRuntime {
+ public:
+  TimerRuntime() : startCycles(readCycles()), startNanoseconds(nowNanoseconds()) {}
+
+  ~TimerRuntime() { report(); }
+
+  pira_timer_slot *registerThread(const pira_timer_module *Module) {
+    if (Module->version != PIRA_TIMER_ABI_VERSION) {
+      std::fprintf(stderr, "[PIRA runtime] [Error]: %s was instrumented with timer ABI version %u, expected %u\n",
+                   Module->module_name, Module->version, PIRA_TIMER_ABI_VERSION);
+      std::abort();
+    }
+    auto *Slots = static_cast<pira_timer_slot *>(std::calloc(Module->num_regions, sizeof(pira_timer_slot)));
+    if (!Slots) {
+      std::fprintf(stderr, "[PIRA runtime] [Error]: Out of memory\n");
+      std::abort();
+    }
+    std::lock_guard<std::mutex> Lock(mutex);
+    if (ThreadNumber < 0) {
+      ThreadNumber = static_cast<int>(numThreads++);
+    }
+    registrations.push_back({Module, Slots, static_cast<unsigned>(ThreadNumber)});
+    return Slots;
+  }
+
+  /// Slot of the calling thread for calls from an indirect call site to Target, a module with one region
+  pira_timer_slot *registerIndirect(const char *Site, void *Target, uint32_t Clock) {
+    auto *Names = new const char *[1] { strdup(pira::getIndirectRegionName(Site, Target).c_str()) };
+    return registerThread(new pira_timer_module{PIRA_TIMER_ABI_VERSION, Clock, 1, Names, "pira_indirect"});
+  }
+
+  /// Calls Visit for the totals of every region with calls, see pira_timer_visit
+  void visit(pira_timer_visitor Visit, void *Data) {
+    std::lock_guard<std::mutex> Lock(mutex);
+    for (const auto &Region : collectRegions()) {
+      if (Region.second.calls) {
+        Visit(Region.first.c_str(), Region.second.calls, Region.second.seconds, Data);
+      }
+    }
+  }
+
+  void disableOutput() {
+    std::lock_guard<std::mutex> Lock(mutex);
+    outputDisabled = true;
+  }
+
+ private:
+  /// Seconds per cycle, measured over the lifetime of the runtime
+  double cycleLength() const {
+    const auto Cycles = readCycles() - startCycles;
+    const auto Nanoseconds = nowNanoseconds() - startNanoseconds;
+    return Cycles ? 1e-9 * Nanoseconds / Cycles : 0.0;
+  }
+
+  /// The totals by region name; called with the mutex held
+  std::map<std::string, Totals> collectRegions() const {
+    const double CycleLength = cycleLength();
+    std::map<std::string, Totals> Regions;
+    auto Add = [](Totals &T, const pira_timer_slot &Slot, double TickLength) {
+      T.calls += Slot.calls;
+      T.ticks += Slot.ticks;
+      T.seconds += TickLength * Slot.ticks;
+    };
+    for (const auto &R : registrations) {
+      const double TickLength = R.module->clock == PIRA_TIMER_CLOCK_CYCLES ? CycleLength : 1e-9;
+      for (uint32_t I = 0; I < R.module->num_regions; ++I) {
+        const std::string Name(R.module->region_names[I]);
+        Add(Regions[Name], R.slots[I], TickLength);
+        // The load of the threads of a parallel region is part of its measurement
+        if (Name.find(":omp_parallel") != std::string::npos) {
+          Add(Regions[Name + "#" + std::to_string(R.thread)], R.slots[I], TickLength);
+        }
+      }
+    }
+    return Regions;
+  }
+
+  void report() {
+    std::lock_guard<std::mutex> Lock(mutex);
+    if (registrations.empty() || outputDisabled) {
+      return;
+    }
+    const auto Regions = collectRegions();
+
+    std::string FileName;
+    if (const char *Output = std::getenv("PIRA_TIMER_OUTPUT")) {
+      FileName = Output;
+    } else {
+      FileName = "pira-timer-" + std::to_string(getpid()) + ".csv";
+    }
+    std::FILE *Out = std::fopen(FileName.c_str(), "w");
+    if (!Out) {
+      std::fprintf(stderr, "[PIRA runtime] [Error]: Can not open %s\n", FileName.c_str());
+      return;
+    }
+    std::fprintf(Out, "region;calls;ticks;seconds\n");
+    for (const auto &Region : Regions) {
+      if (Region.second.calls == 0) {
+        continue;
+      }
+      std::fprintf(Out, "%s;%llu;%llu;%.9f\n", Region.first.c_str(),
+                   static_cast<unsigned long long>(Region.second.calls),
+                   static_cast<unsigned long long>(Region.second.ticks), Region.second.seconds);
+    }
+    std::fclose(Out);
+  }
+
+  std::mutex mutex;
+  std::vector<Registration> registrations;
+  unsigned numThreads{0};
+  bool outputDisabled{false};
+  const uint64_t startCycles;
+  const uint64_t startNanoseconds;
+};
+
+TimerRuntime &getRuntime() {
+  // Function-local, as instrumented constructors of other libraries may register before this library is initialized.
+  // Destroyed after main returns; events of threads that are still running at that point are not reported.
+  static TimerRuntime Runtime;
+  return Runtime;
+}
+
+// Construct early for the cycle calibration, even if the first event happens late
+const TimerRuntime &InitRuntime = getRuntime();
+
+thread_local std::unordered_map<pira::IndirectCall, pira_timer_slot *, pira::IndirectCallHash> IndirectSlots;
+
+}  // namespace
+
+extern "C" {
+
+pira_timer_slot *__pira_timer_register(const pira_timer_module *module) { return getRuntime().registerThread(module); }
+
+uint64_t __pira_timer_now(void) { return nowNanoseconds(); }
+
+void __pira_timer_indirect(const char *site, void *target, uint64_t ticks, uint32_t clock) {
+  auto &Slot = IndirectSlots[{site, target}];
+  if (!Slot) {
+    Slot = getRuntime().registerIndirect(site, target, clock);
+  }
+  Slot->calls += 1;
+  Slot->ticks += ticks;
+}
+
+void pira_timer_visit(pira_timer_visitor visitor, void *data) { getRuntime().visit(visitor, data); }
+
+void pira_timer_disable_output(void) { getRuntime().disableOutput(); }
+}
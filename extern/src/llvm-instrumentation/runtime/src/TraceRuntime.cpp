@@ -0,0 +1,523 @@
+//===- TraceRuntime.cpp - Event trace runtime of the hooks ----------------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// Implements the cyg-profile and the region ID hooks by recording one event
+// per enter and exit, see PiraTrace.h for the format of the trace.
+//
+// Every thread records into a ring buffer of its own, which a background
+// thread drains into the trace file. The hooks take no lock and make no
+// system call: a thread only wakes the drain thread when its buffer is half
+// full, and waits for it when the buffer is full; no event is dropped.
+//
+// When a thread records its first event, it measures the cost of an event on
+// its core and passes it to the readers in its THREAD block, which subtract it
+// from the times of the regions (see PiraTrace.h).
+//
+// The trace file is written through a memory mapping that grows in chunks.
+// There is one file per process, <PIRA_TRACE_OUTPUT>-<rank>.bin, with the
+// rank given by the MPI launcher or else the process ID; the default prefix is
+// pira-trace in the working directory.
+//
+// A child created by fork() records no events: it has no drain thread, and
+// the trace file belongs to the parent.
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndirectCalls.h"
+#include "PiraRuntime.h"
+#include "PiraTrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PIRA_HAS_TSC 1
+#endif
+
+namespace {
+
+constexpr uint64_t DefaultBufferEvents = 1 << 16;
+constexpr uint64_t MinBufferEvents = 1 << 10;
+constexpr uint64_t DefaultFlushMilliseconds = 10;
+// The cost of an event is the fastest of the rounds, each of that many events
+constexpr unsigned CalibrationRounds = 5;
+constexpr uint64_t CalibrationEvents = 256;
+// The mapping of the trace file grows by this size, a multiple of the page size
+constexpr uint64_t ChunkSize = 16 << 20;
+
+uint64_t nowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+#ifdef PIRA_HAS_TSC
+constexpr uint32_t TraceClock = PIRA_TIMER_CLOCK_CYCLES;
+uint64_t readClock() { return __rdtsc(); }
+#else
+constexpr uint32_t TraceClock = PIRA_TIMER_CLOCK_NANOSECONDS;
+uint64_t readClock() { return nowNanoseconds(); }
+#endif
+
+uint64_t getEnvNumber(const char *Name, uint64_t Default) {
+  const char *Value = std::getenv(Name);
+  if (!Value || !*Value) {
+    return Default;
+  }
+  char *End = nullptr;
+  const auto Number = std::strtoull(Value, &End, 10);
+  if (*End || Number == 0) {
+    std::fprintf(stderr, "[PIRA runtime] [Warning]: Ignoring %s=%s, expected a positive number\n", Name, Value);
+    return Default;
+  }
+  return Number;
+}
+
+int32_t getLauncherRank() {
+  for (const char *Name : {"OMPI_COMM_WORLD_RANK", "PMIX_RANK", "PMI_RANK", "MV2_COMM_WORLD_RANK", "SLURM_PROCID"}) {
+    if (const char *Value = std::getenv(Name)) {
+      return static_cast<int32_t>(std::atoi(Value));
+    }
+  }
+  return -1;
+}
+
+/// Events of one thread, written by that thread and read by the drain thread.
+struct ThreadBuffer {
+  ThreadBuffer(uint32_t Thread, uint64_t Capacity)
+      : thread(Thread), capacity(Capacity), events(new pira_trace_event[Capacity]) {}
+
+  const uint32_t thread;
+  const uint64_t capacity;  // A power of two
+  pira_trace_event *events;
+  uint64_t osThread{0};
+  double eventTicks{0};
+  ThreadBuffer *next{nullptr};
+  bool announced{false};  // The drain thread wrote the THREAD block
+  std::atomic<bool> retired{false};
+
+  alignas(64) std::atomic<uint64_t> head{0};  // Next event to record, written by the thread
+  uint64_t cachedTail{0};                      // Tail as last read by the thread
+  alignas(64) std::atomic<uint64_t> tail{0};  // Next event to drain, written by the drain thread
+};
+
+/// The trace file, written through a mapping of one chunk.
+class TraceFile {
+ public:
+  bool open(const std::string &Name, const pira_trace_header &Header) {
+    fd = ::open(Name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || !map(0)) {
+      std::fprintf(stderr, "[PIRA runtime] [Error]: Can not open %s\n", Name.c_str());
+      close();
+      return false;
+    }
+    write(&Header, sizeof(Header));
+    return true;
+  }
+
+  bool isOpen() const { return fd >= 0; }
+
+  void write(const void *Data, uint64_t Size) {
+    const char *Bytes = static_cast<const char *>(Data);
+    while (Size > 0 && isOpen()) {
+      if (position == windowOffset + ChunkSize && !map(windowOffset + ChunkSize)) {
+        std::fprintf(stderr, "[PIRA runtime] [Error]: Can not extend the trace file, the trace is incomplete\n");
+        close();
+        return;
+      }
+      const auto Length = std::min(Size, windowOffset + ChunkSize - position);
+      std::memcpy(window + (position - windowOffset), Bytes, Length);
+      position += Length;
+      Bytes += Length;
+      Size -= Length;
+    }
+  }
+
+  /// Cuts the file to the written size and writes the final header
+  void finish(pira_trace_header Header) {
+    if (!isOpen()) {
+      return;
+    }
+    munmap(window, ChunkSize);
+    window = nullptr;
+    Header.size = position;
+    if (ftruncate(fd, position) != 0 || pwrite(fd, &Header, sizeof(Header), 0) != sizeof(Header)) {
+      std::fprintf(stderr, "[PIRA runtime] [Error]: Can not finish the trace file\n");
+    }
+    close();
+  }
+
+ private:
+  bool map(uint64_t Offset) {
+    if (window) {
+      munmap(window, ChunkSize);
+      window = nullptr;
+    }
+    if (ftruncate(fd, Offset + ChunkSize) != 0) {
+      return false;
+    }
+    void *Mapping = mmap(nullptr, ChunkSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, Offset);
+    if (Mapping == MAP_FAILED) {
+      return false;
+    }
+    window = static_cast<char *>(Mapping);
+    windowOffset = Offset;
+    return true;
+  }
+
+  void close() {
+    if (window) {
+      munmap(window, ChunkSize);
+      window = nullptr;
+    }
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+
+  int fd{-1};
+  char *window{nullptr};
+  uint64_t windowOffset{0};
+  uint64_t position{0};
+};
+
+class TraceRuntime {
+ public:
+  TraceRuntime()
+      : bufferEvents(getBufferEvents()),
+        flushInterval(getEnvNumber("PIRA_TRACE_FLUSH_MS", DefaultFlushMilliseconds)),
+        startTicks(readClock()),
+        startNanoseconds(nowNanoseconds()),
+        drainThread([this] { run(); }) {}
+
+  ThreadBuffer *registerThread(double EventTicks) {
+    if (finished.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    auto *Buffer = new ThreadBuffer(numThreads.fetch_add(1, std::memory_order_relaxed), bufferEvents);
+    Buffer->osThread = static_cast<uint64_t>(syscall(SYS_gettid));
+    Buffer->eventTicks = EventTicks;
+    Buffer->next = buffers.load(std::memory_order_relaxed);
+    while (!buffers.compare_exchange_weak(Buffer->next, Buffer, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    return Buffer;
+  }
+
+  /// Called by the thread of Buffer when it is half full or full. Returns false if the event has to be dropped because
+  /// the trace is already finished.
+  bool makeSpace(ThreadBuffer &Buffer, uint64_t Head) {
+    if (finished.load(std::memory_order_acquire)) {
+      return false;
+    }
+    Buffer.cachedTail = Buffer.tail.load(std::memory_order_acquire);
+    if (Head - Buffer.cachedTail >= Buffer.capacity / 2) {
+      drainWakeup.notify_one();
+    }
+    while (Head - Buffer.cachedTail == Buffer.capacity) {
+      if (finished.load(std::memory_order_acquire)) {
+        return false;
+      }
+      std::this_thread::yield();
+      drainWakeup.notify_one();
+      Buffer.cachedTail = Buffer.tail.load(std::memory_order_acquire);
+    }
+    return true;
+  }
+
+  /// Called in the child after fork(), which copies neither the drain thread nor, if the drain thread held it, a usable
+  /// drain mutex. Drops all further events instead of waiting for the drain thread when a buffer is full.
+  void disableInChild() {
+    forked = true;
+    finished.store(true, std::memory_order_release);
+  }
+
+  /// Drains all buffers and writes the names of the regions. Events of threads that still run afterwards are dropped.
+  void finish() {
+    if (forked) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> Lock(drainMutex);
+      stopping = true;
+    }
+    drainWakeup.notify_one();
+    drainThread.join();
+    drain();
+    finished.store(true, std::memory_order_release);
+    if (!file.isOpen()) {
+      return;
+    }
+    writeRegions();
+    auto Header = createHeader();
+    const auto Nanoseconds = nowNanoseconds() - startNanoseconds;
+    const auto Ticks = readClock() - startTicks;
+    Header.tick_seconds = TraceClock == PIRA_TIMER_CLOCK_CYCLES && Ticks ? 1e-9 * Nanoseconds / Ticks : 1e-9;
+    file.finish(Header);
+  }
+
+ private:
+  static uint64_t getBufferEvents() {
+    const auto Events = std::max(getEnvNumber("PIRA_TRACE_BUFFER_EVENTS", DefaultBufferEvents), MinBufferEvents);
+    uint64_t Capacity = MinBufferEvents;
+    while (Capacity < Events) {
+      Capacity <<= 1;
+    }
+    return Capacity;
+  }
+
+  pira_trace_header createHeader() const {
+    pira_trace_header Header{};
+    std::memcpy(Header.magic, PIRA_TRACE_MAGIC, sizeof(PIRA_TRACE_MAGIC));
+    Header.version = PIRA_TRACE_VERSION;
+    Header.clock = TraceClock;
+    Header.rank = getLauncherRank();
+    Header.pid = static_cast<uint32_t>(getpid());
+    Header.start_ticks = startTicks;
+    return Header;
+  }
+
+  bool openFile() {
+    const auto Header = createHeader();
+    const char *Prefix = std::getenv("PIRA_TRACE_OUTPUT");
+    const auto Name = std::string(Prefix && *Prefix ? Prefix : "pira-trace") + "-" +
+                      std::to_string(Header.rank >= 0 ? Header.rank : static_cast<int64_t>(Header.pid)) + ".bin";
+    return file.open(Name, Header);
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> Lock(drainMutex);
+    while (!stopping) {
+      drainWakeup.wait_for(Lock, flushInterval);
+      drain();
+    }
+  }
+
+  void drain() {
+    for (auto *Buffer = buffers.load(std::memory_order_acquire); Buffer; Buffer = Buffer->next) {
+      if (!Buffer->events) {
+        continue;
+      }
+      // Read before the head: a retired thread records no further events
+      const bool Retired = Buffer->retired.load(std::memory_order_acquire);
+      const auto Head = Buffer->head.load(std::memory_order_acquire);
+      const auto Tail = Buffer->tail.load(std::memory_order_relaxed);
+      if (Head != Tail) {
+        if (!file.isOpen() && !openFile()) {
+          // Keep the threads running, the events are discarded
+          Buffer->tail.store(Head, std::memory_order_release);
+          continue;
+        }
+        if (!Buffer->announced) {
+          const pira_trace_thread Thread{Buffer->osThread, Buffer->eventTicks};
+          writeBlock(PIRA_TRACE_BLOCK_THREAD, Buffer->thread, &Thread, sizeof(Thread));
+          Buffer->announced = true;
+        }
+        writeEvents(*Buffer, Tail, Head);
+        Buffer->tail.store(Head, std::memory_order_release);
+      }
+      if (Retired) {
+        delete[] Buffer->events;
+        Buffer->events = nullptr;
+      }
+    }
+  }
+
+  void writeEvents(const ThreadBuffer &Buffer, uint64_t Tail, uint64_t Head) {
+    const pira_trace_block Block{PIRA_TRACE_BLOCK_EVENTS, Buffer.thread, (Head - Tail) * sizeof(pira_trace_event)};
+    file.write(&Block, sizeof(Block));
+    const auto Mask = Buffer.capacity - 1;
+    const auto First = Tail & Mask;
+    const auto Count = Head - Tail;
+    const auto Contiguous = std::min(Count, Buffer.capacity - First);
+    file.write(Buffer.events + First, Contiguous * sizeof(pira_trace_event));
+    file.write(Buffer.events, (Count - Contiguous) * sizeof(pira_trace_event));
+    for (auto I = Tail; I != Head; ++I) {
+      const auto &Event = Buffer.events[I & Mask];
+      if ((Event.time_flags & (PIRA_TRACE_EVENT_ADDRESS | PIRA_TRACE_EVENT_EXIT)) == PIRA_TRACE_EVENT_ADDRESS) {
+        addresses.insert(Event.region);
+      }
+    }
+  }
+
+  void writeBlock(uint32_t Kind, uint32_t Thread, const void *Payload, uint64_t Size) {
+    const pira_trace_block Block{Kind, Thread, Size};
+    file.write(&Block, sizeof(Block));
+    file.write(Payload, Size);
+  }
+
+  void writeRegion(uint64_t Region, uint32_t Flags, const std::string &Name) {
+    const pira_trace_region Entry{Region, Flags, static_cast<uint32_t>(Name.size())};
+    const pira_trace_block Block{PIRA_TRACE_BLOCK_REGION, 0, sizeof(Entry) + Name.size()};
+    file.write(&Block, sizeof(Block));
+    file.write(&Entry, sizeof(Entry));
+    file.write(Name.data(), Name.size());
+  }
+
+  /// Names of the function addresses seen in enter events and of all registered region IDs
+  void writeRegions() {
+    for (const auto Address : addresses) {
+      writeRegion(Address, PIRA_TRACE_EVENT_ADDRESS, pira::getSymbolName(reinterpret_cast<void *>(Address)));
+    }
+    const auto NumRegions = pira_region_count();
+    for (uint32_t Id = 0; Id < NumRegions; ++Id) {
+      const char *Name = nullptr;
+      const char *File = nullptr;
+      uint32_t Line = 0;
+      if (pira_region_info(Id, &Name, &File, &Line)) {
+        writeRegion(Id, 0, Name);
+      }
+    }
+  }
+
+  const uint64_t bufferEvents;
+  const std::chrono::milliseconds flushInterval;
+  const uint64_t startTicks;
+  const uint64_t startNanoseconds;
+  std::atomic<ThreadBuffer *> buffers{nullptr};
+  std::atomic<uint32_t> numThreads{0};
+  std::atomic<bool> finished{false};
+  bool forked{false};  // This process is a child of the traced process
+  // Owned by the drain thread, by the thread that finishes the trace afterwards
+  TraceFile file;
+  std::unordered_set<uint64_t> addresses;
+  std::mutex drainMutex;
+  std::condition_variable drainWakeup;
+  bool stopping{false};
+  std::thread drainThread;  // Last, starts in the constructor
+};
+
+TraceRuntime &getRuntime() {
+  // Never destroyed: threads may record events after the trace is finished
+  static TraceRuntime *Runtime = new TraceRuntime;
+  return *Runtime;
+}
+
+struct Finalizer {
+  Finalizer() {
+    getRuntime();
+    // Constructs the region registry of the runtime now, so that it is destroyed after the trace is finished
+    pira_region_count();
+    // A child created by fork() has no drain thread
+    pthread_atfork(nullptr, nullptr, [] { getRuntime().disableInChild(); });
+  }
+
+  ~Finalizer() { getRuntime().finish(); }
+};
+
+Finalizer FinishAtExit;
+
+__attribute__((tls_model("initial-exec"))) thread_local ThreadBuffer *CurrentBuffer = nullptr;
+
+/// Retires the buffer of a thread when it exits. Events after that, e.g., of static destructors on the main thread,
+/// are recorded as a new thread with the same OS thread ID.
+struct ThreadExit {
+  ThreadBuffer *buffer{nullptr};
+  ~ThreadExit() {
+    if (buffer) {
+      CurrentBuffer = nullptr;
+      buffer->retired.store(true, std::memory_order_release);
+    }
+  }
+};
+
+thread_local ThreadExit Exit;
+
+inline void store(ThreadBuffer &Buffer, uint64_t Time, uint64_t Region, uint64_t Flags) {
+  const auto Head = Buffer.head.load(std::memory_order_relaxed);
+  // Refresh the tail when the buffer seems full and every half buffer, to wake the drain thread in time
+  if ((Head - Buffer.cachedTail == Buffer.capacity || (Head & (Buffer.capacity / 2 - 1)) == 0) &&
+      !getRuntime().makeSpace(Buffer, Head)) {
+    return;
+  }
+  Buffer.events[Head & (Buffer.capacity - 1)] = {Time << PIRA_TRACE_EVENT_TIME_SHIFT | Flags, Region};
+  Buffer.head.store(Head + 1, std::memory_order_release);
+}
+
+/// An event as recorded by the hooks, into the buffer of the calibration
+__attribute__((noinline)) void recordCalibration(ThreadBuffer &Buffer, uint64_t Flags) {
+  store(Buffer, readClock(), 0, Flags);
+}
+
+/// Ticks of one event on the calling thread. The events stay below half of the buffer, so they never wake the drain
+/// thread.
+double calibrate() {
+  ThreadBuffer Scratch(0, MinBufferEvents);
+  uint64_t Best = UINT64_MAX;
+  for (unsigned Round = 0; Round < CalibrationRounds; ++Round) {
+    Scratch.head.store(0, std::memory_order_relaxed);
+    const auto Start = readClock();
+    for (uint64_t I = 0; I < CalibrationEvents; I += 2) {
+      recordCalibration(Scratch, 0);
+      recordCalibration(Scratch, PIRA_TRACE_EVENT_EXIT);
+    }
+    Best = std::min(Best, readClock() - Start);
+  }
+  delete[] Scratch.events;
+  return static_cast<double>(Best) / CalibrationEvents;
+}
+
+__attribute__((noinline)) ThreadBuffer *registerThread() {
+  auto *Buffer = getRuntime().registerThread(calibrate());
+  if (Buffer) {
+    Exit.buffer = Buffer;
+    CurrentBuffer = Buffer;
+  }
+  return Buffer;
+}
+
+inline void record(uint64_t Region, uint64_t Flags) {
+  auto Time = readClock();
+  auto *Buffer = CurrentBuffer;
+  if (!Buffer) {
+    if (!(Buffer = registerThread())) {
+      return;
+    }
+    // The registration and the calibration are not part of the time of the region
+    Time = readClock();
+  }
+  store(*Buffer, Time, Region, Flags);
+}
+
+}  // namespace
+
+extern "C" {
+
+void __cyg_profile_func_enter(void *fn, void *) {
+  record(reinterpret_cast<uintptr_t>(fn), PIRA_TRACE_EVENT_ADDRESS);
+}
+
+void __cyg_profile_func_exit(void *fn, void *) {
+  record(reinterpret_cast<uintptr_t>(fn), PIRA_TRACE_EVENT_ADDRESS | PIRA_TRACE_EVENT_EXIT);
+}
+
+void __pira_region_enter(uint32_t id) {
+  if (id != PIRA_INVALID_REGION_ID) {
+    record(id, 0);
+  }
+}
+
+void __pira_region_exit(uint32_t id) {
+  if (id != PIRA_INVALID_REGION_ID) {
+    record(id, PIRA_TRACE_EVENT_EXIT);
+  }
+}
+}
@@ -0,0 +1,33 @@
+// RUN: env PIRA_INSTR_OVERHEAD_BUDGET=10 clang++ -Xclang -load -Xclang ../build/lib/instrumentationlib.so -mllvm --score-p-filter=budget.cfg -S -emit-llvm -o - %s | FileCheck %s
+//
+
+int value;
+void work(int);
+
+// A leaf function that is called in a loop is dropped
+// CHECK-LABEL: define dso_local i32 @_Z3getv()
+// CHECK-NOT: call void @__cyg_profile_func_enter
+// CHECK: ret i32
+int get() { return value; }
+
+// Other functions that are called in a loop are downgraded to their call sites outside of loops
+// CHECK-LABEL: define dso_local void @_Z4wrapi(
+// CHECK-NOT: call void @__cyg_profile_func_enter
+// CHECK: ret void
+void wrap(int x) { work(x); }
+
+// CHECK-LABEL: define dso_local i32 @main(
+// CHECK: call void @__cyg_profile_func_enter({{.*}}@main
+// CHECK: call void @__cyg_profile_func_enter({{.*}}@_Z4wrapi
+// CHECK: call void @_Z4wrapi(
+// CHECK: call void @__cyg_profile_func_exit({{.*}}@_Z4wrapi
+// CHECK-NOT: call void @__cyg_profile_func_enter({{.*}}@_Z4wrapi
+// CHECK-NOT: call void @__cyg_profile_func_enter({{.*}}@_Z3getv
+// CHECK: ret i32
+int main(int argc, char **argv) {
+  wrap(argc);
+  for (int i = 0; i < argc; ++i) {
+    wrap(get());
+  }
+  return 0;
+}
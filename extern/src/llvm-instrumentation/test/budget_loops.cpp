@@ -0,0 +1,31 @@
+// RUN: env PIRA_INSTR_OVERHEAD_BUDGET=10 PIRA_INSTR_SCOREP_FILTER=budget_loops.cfg PIRA_INSTR_HOOKS=region-id clang++ -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s
+//
+// The budget decides before the loop hooks are inserted, which would make the leaf function look expensive
+
+int values[16];
+
+// The hot leaf function is dropped, its loop stays instrumented
+// CHECK-LABEL: define {{.*}}i32 @_Z3sumi(
+// CHECK: call void @__pira_region_enter
+// CHECK-NOT: call void @__pira_region_enter
+// CHECK: ret i32
+__attribute__((noinline)) int sum(int n) {
+  int s = 0;
+  for (int i = 0; i < n; ++i) {
+    s += values[i];
+  }
+  return s;
+}
+
+// Dropped, not downgraded: no hooks around the call outside of the loop
+// CHECK-LABEL: define {{.*}}i32 @main(
+// CHECK: call void @__pira_region_enter
+// CHECK-NOT: call void @__pira_region_enter
+// CHECK: ret i32
+int main(int argc, char **argv) {
+  int s = sum(argc);
+  for (int i = 0; i < argc; ++i) {
+    s += sum(i);
+  }
+  return s;
+}
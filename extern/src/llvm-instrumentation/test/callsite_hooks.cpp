@@ -0,0 +1,35 @@
+// RUN: env PIRA_INSTR_SCOREP_FILTER=callsite_hooks.cfg clang++ -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s --check-prefix=CYG
+// RUN: env PIRA_INSTR_SCOREP_FILTER=callsite_hooks.cfg PIRA_INSTR_HOOKS=region-id clang++ -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s --check-prefix=REGION
+//
+// A caller -> * rule on an instrumented function selects the calls of the function, not the ones of its hooks
+// REGION-NOT: c"__pira_region_{{enter|exit}}\00"
+// REGION: @__pira_regions_table = private constant [2 x
+//
+// CYG-LABEL: define {{.*}}i32 @_Z1cv()
+// CYG-NOT: @__cyg_profile_func_{{enter|exit}} to i8*)
+// CYG: call void @__cyg_profile_func_enter(i8* bitcast (i32 ()* @_Z1cv to i8*)
+// CYG-NEXT: call void @__cyg_profile_func_enter(i8* bitcast (i32 ()* @_Z1av to i8*)
+// CYG-NOT: @__cyg_profile_func_{{enter|exit}} to i8*)
+// CYG: call void @__cyg_profile_func_exit(i8* bitcast (i32 ()* @_Z1av to i8*)
+// CYG-NEXT: call void @__cyg_profile_func_exit(i8* bitcast (i32 ()* @_Z1cv to i8*)
+// CYG-NOT: @__cyg_profile_func_{{enter|exit}} to i8*)
+// CYG: ret i32
+//
+// REGION-LABEL: define {{.*}}i32 @_Z1cv()
+// REGION-COUNT-2: call void @__pira_region_enter(
+// REGION-NOT: call void @__pira_region_enter(
+// REGION-COUNT-2: call void @__pira_region_exit(
+// REGION-NOT: call void @__pira_region_{{enter|exit}}(
+// REGION: ret i32
+
+__attribute__((noinline)) int a() {
+  return 3;
+}
+
+__attribute__((noinline)) int c() {
+  return a() + 4;
+}
+
+int main(int argc, char **argv) {
+  return c();
+}
@@ -0,0 +1,35 @@
+// RUN: rm -rf %t && clang++ -O1 -Xclang -load -Xclang ../build/lib/instrumentationlib.so -mllvm --features-dir=%t -S -emit-llvm -o /dev/null %s
+// RUN: cat %t/features.cpp-*.features.json | FileCheck %s
+// RUN: ../build/tools/pira-cg-merge/pira-cg-merge -o - %t | FileCheck %s --check-prefix=CG
+//
+
+// Without a filter, the plugin only writes the features
+// CHECK: "_Z4axpyPdPKdid":{"callees":[],"controlFlowOps":{{[0-9]+}},"file":"{{.*}}features.cpp","floatOps":{{[1-9][0-9]*}}
+// CHECK-SAME: "indirectCalls":0
+// CHECK-SAME: "loopDepth":1,"memoryAccesses":{{[1-9][0-9]*}}
+// CHECK-SAME: "_Z5applyPFvvE":{"callees":[]
+// CHECK-SAME: "indirectCalls":1
+// Functions passed as an argument are callees
+// CHECK-SAME: "main":{"callees":["_Z4axpyPdPKdid","_Z4leafv","_Z5applyPFvvE"]
+
+// CG: "_MetaCG":{"version":"2.0"
+// CG-SAME: "_Z4axpyPdPKdid":{"callees":[],"callers":["main"],{{.*}}"hasBody":true,{{.*}}"loopDepth":1
+// CG-SAME: "_Z4leafv":{"callees":[],"callers":["main"],{{.*}}"hasBody":false
+
+void leaf();
+
+void axpy(double *y, const double *x, int n, double a) {
+  for (int i = 0; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+void apply(void (*f)()) { f(); }
+
+int main(int argc, char **argv) {
+  double x[4] = {1, 2, 3, 4};
+  double y[4] = {};
+  axpy(y, x, 4, argc);
+  apply(leaf);
+  return y[0];
+}
@@ -0,0 +1,48 @@
+// RUN: clang++ -Xclang -load -Xclang ../build/lib/instrumentationlib.so -mllvm --score-p-filter=glob.cfg -S -emit-llvm -o - %s | FileCheck %s
+// The precompiled index has to give the same result
+// RUN: ../build/tools/pira-filter-index/pira-filter-index --score-p-filter=glob.cfg -o %t.idx
+// RUN: clang++ -Xclang -load -Xclang ../build/lib/instrumentationlib.so -mllvm --filter-index=%t.idx -S -emit-llvm -o - %s | FileCheck %s
+//
+namespace Eigen {
+// CHECK-LABEL: define {{.*}}void @_ZN5Eigen3fooEv()
+// CHECK: call void @__cyg_profile_func_enter
+// CHECK: call void @__cyg_profile_func_exit
+void foo() {}
+
+namespace internal {
+// CHECK-LABEL: define {{.*}}void @_ZN5Eigen8internal3bazEv()
+// CHECK-NOT: call void @__cyg_profile_func_enter
+// CHECK: ret void
+void baz() {}
+}  // namespace internal
+}  // namespace Eigen
+
+// Matched against the demangled name
+// CHECK-LABEL: define {{.*}}void @_Z4quuxi(
+// CHECK: call void @__cyg_profile_func_enter
+void quux(int) {}
+
+// CHECK-LABEL: define {{.*}}void @_Z3abcv()
+// CHECK: call void @__cyg_profile_func_enter
+void abc() {}
+
+// CHECK-LABEL: define {{.*}}void @_Z3abdv()
+// CHECK-NOT: call void @__cyg_profile_func_enter
+// CHECK: ret void
+void abd() {}
+
+// CHECK-LABEL: define {{.*}}i32 @main(
+// CHECK-NOT: call void @__cyg_profile_func_enter
+// CHECK: call void @__cyg_profile_func_enter(i8* bitcast (void ()* @_ZN5Eigen3fooEv to i8*)
+// CHECK-NEXT: call void @_ZN5Eigen3fooEv()
+// CHECK: call void @__cyg_profile_func_enter(i8* bitcast (void ()* @_Z3abcv to i8*)
+// CHECK-NEXT: call void @_Z3abcv()
+// CHECK-NOT: call void @__cyg_profile_func_enter
+// CHECK: call void @_Z4quuxi(i32 1)
+// CHECK-NOT: call void @__cyg_profile_func_enter
+int main() {
+  Eigen::foo();
+  abc();
+  quux(1);
+  return 0;
+}
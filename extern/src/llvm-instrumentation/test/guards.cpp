@@ -0,0 +1,27 @@
+// RUN: env PIRA_INSTR_RUNTIME_GUARDS=1 clang++ -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s
+//
+// Without a filter, every function is instrumented behind its enable byte
+// CHECK: @__pira_guard{{.*}} = private global i8 1, section "pira_guards"
+// CHECK: @__pira_guard_names_table = private constant {{.*}} section "pira_guard_names"
+// CHECK: @llvm.global_ctors = {{.*}} @pira.guards_ctor
+//
+// CHECK-LABEL: define {{.*}}void @_Z3foov()
+// CHECK: %pira.guard = load i8, i8* @__pira_guard
+// CHECK: %pira.enabled = icmp ne i8 %pira.guard, 0
+// CHECK: br i1 %pira.enabled
+// CHECK: call void @__cyg_profile_func_enter
+// CHECK: br i1 %pira.enabled
+// CHECK: call void @__cyg_profile_func_exit
+__attribute__((noinline)) void foo() {
+}
+
+// CHECK-LABEL: define {{.*}}i32 @main(
+// CHECK: %pira.enabled = icmp ne i8
+// CHECK: call void @__cyg_profile_func_enter
+int main(int argc, char **argv) {
+  foo();
+  return 0;
+}
+
+// CHECK-LABEL: define {{.*}}@pira.guards_ctor()
+// CHECK: call void @__pira_guards_init({{.*}}@__start_pira_guard_names{{.*}}@__stop_pira_guard_names
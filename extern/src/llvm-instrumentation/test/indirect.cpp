@@ -0,0 +1,40 @@
+// RUN: clang++ -Xclang -load -Xclang ../build/lib/instrumentationlib.so -mllvm --score-p-filter=indirect.cfg -S -emit-llvm -o - %s | FileCheck %s
+// RUN: env PIRA_INSTR_SCOREP_FILTER=indirect.cfg PIRA_INSTR_HOOKS=region-id clang++ -g -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s --check-prefix=REGION
+//
+// REGION: @__pira_region_site = private unnamed_addr constant {{.*}} c"_Z8dispatchPFviEi:25->*\00"
+
+void a(int) {}
+
+// CHECK-LABEL: define {{.*}}void @_Z8dispatchPFviEi(
+// CHECK: %[[FN:[0-9]+]] = load void (i32)*, void (i32)** %f.addr
+// CHECK: %[[ARG:[0-9]+]] = bitcast void (i32)* %[[FN]] to i8*
+// CHECK: call void @__cyg_profile_func_enter(i8* %[[ARG]]
+// CHECK-NEXT: call void %[[FN]](
+// CHECK: call void @__cyg_profile_func_exit(i8* %[[ARG]]
+// CHECK-NOT: call void @__cyg_profile_func_enter
+// CHECK: call void @_Z1ai(
+// CHECK-NOT: call void @__cyg_profile_func_enter
+// CHECK: ret void
+//
+// REGION-LABEL: define {{.*}}void @_Z8dispatchPFviEi(
+// REGION: %pira.region = call i32 @__pira_region_indirect(i8* {{.*}}@__pira_region_site{{.*}}, i8* %{{.*}})
+// REGION: call void @__pira_region_enter(i32 %pira.region)
+// REGION: call void %{{.*}}(
+// REGION: call void @__pira_region_exit(i32 %pira.region)
+void dispatch(void (*f)(int), int x) {
+  f(x);
+  a(x);
+}
+
+// Only the direct call is instrumented
+// CHECK-LABEL: define {{.*}}i32 @main(
+// CHECK: call void @__cyg_profile_func_enter(i8* bitcast (void (void (i32)*, i32)* @_Z8dispatchPFviEi to i8*)
+// CHECK-NEXT: call void @_Z8dispatchPFviEi(
+// CHECK-NOT: call void @__cyg_profile_func_enter
+// CHECK: ret i32
+int main(int argc, char **argv) {
+  void (*f)(int) = argc > 1 ? a : nullptr;
+  dispatch(f, argc);
+  f(argc);
+  return 0;
+}
@@ -0,0 +1,39 @@
+// RUN: env PIRA_INSTR_SCOREP_FILTER=loops.cfg PIRA_INSTR_HOOKS=region-id clang++ -g -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s
+// The cyg-profile hooks identify regions by function address and skip loops
+// RUN: env PIRA_INSTR_SCOREP_FILTER=loops.cfg clang++ -g -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s 2>&1 | FileCheck %s --check-prefix=CYG
+//
+// CHECK-DAG: c"_Z5solvei:20\00"
+// CHECK-DAG: c"_Z5solvei:21\00"
+// CHECK-DAG: c"_Z5solvei:27\00"
+// CHECK: @__pira_regions_table = private constant [3 x
+//
+// CYG: [Warning]: The instrumentation hooks can not instrument loops, skipping the loops of _Z5solvei
+// CYG-NOT: call void @__cyg_profile_func_enter
+
+volatile int sink;
+
+// CHECK-LABEL: define {{.*}}void @_Z5solvei(
+// CHECK-COUNT-3: call void @__pira_region_enter
+// CHECK-NOT: call void @__pira_region_enter
+// CHECK: ret void
+__attribute__((noinline)) void solve(int n) {
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      for (int k = 0; k < n; ++k) {
+        sink = sink + i * j * k;
+      }
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    sink = sink + i;
+  }
+}
+
+// CHECK-LABEL: define {{.*}}i32 @main(
+// CHECK-NOT: call void @__pira_region_enter
+int main(int argc, char **argv) {
+  for (int i = 0; i < argc; ++i) {
+    solve(i);
+  }
+  return 0;
+}
@@ -0,0 +1,19 @@
+// RUN: rm -rf %t && clang++ -Xclang -load -Xclang ../build/lib/instrumentationlib.so -mllvm --filter-list=manifest.filt -mllvm --manifest-dir=%t -S -emit-llvm -o /dev/null %s
+// RUN: cat %t/manifest.cpp-*.json | FileCheck %s
+//
+
+// Only the names of this module are listed, _Z6unusedv of the whitelist is not
+// CHECK: "matched":["_Z3fooi"]
+// CHECK-SAME: "names":["_Z3bari","_Z3fooi","_Z4leafv","main"]
+// CHECK-SAME: "source":"{{.*}}manifest.cpp"
+
+void leaf();
+
+int foo(int x) { return x + 1; }
+
+int bar(int x) {
+  leaf();
+  return foo(x);
+}
+
+int main(int argc, char **argv) { return bar(argc); }
@@ -0,0 +1,20 @@
+// RUN: env PIRA_INSTR_FILTER_LIST=001.filt clang++ -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s
+// RUN: env PIRA_INSTR_FILTER_LIST=001.filt clang++ -O2 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -Xclang -fdebug-pass-manager -S -emit-llvm -o /dev/null %s 2>&1 | FileCheck %s --check-prefix=PASSES
+//
+// The pass runs once, at the pipeline start, not again at the early simplification extension point
+// PASSES: Running pass: {{.*}}FilteringEntryExitInstrumenterPass
+// PASSES-NOT: Running pass: {{.*}}FilteringEntryExitInstrumenterPass
+//
+// CHECK-LABEL: define {{.*}}void @_Z3foov()
+// CHECK: call void @__cyg_profile_func_enter
+// CHECK: call void @__cyg_profile_func_exit
+// CHECK-NOT: call void @__cyg_profile_func_enter
+__attribute__((noinline)) void foo() {
+}
+
+// CHECK-LABEL: define {{.*}}i32 @main(
+// CHECK-NOT: call void @__cyg_profile_func_enter
+int main(int argc, char **argv) {
+  foo();
+  return 0;
+}
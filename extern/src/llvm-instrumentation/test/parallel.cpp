@@ -0,0 +1,39 @@
+// RUN: env PIRA_INSTR_SCOREP_FILTER=parallel.cfg PIRA_INSTR_HOOKS=region-id clang++ -fopenmp -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s
+// RUN: env PIRA_INSTR_SCOREP_FILTER=parallel.cfg PIRA_INSTR_HOOKS=region-id clang++ -g -fopenmp -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s --check-prefix=DEBUG
+// The cyg-profile hooks identify regions by function address and skip parallel regions
+// RUN: env PIRA_INSTR_SCOREP_FILTER=parallel.cfg clang++ -fopenmp -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s 2>&1 | FileCheck %s --check-prefix=CYG
+//
+// CHECK-DAG: c"_Z5solvei:omp_parallel.0\00"
+// CHECK-DAG: c"_Z5solvei:omp_parallel.0.0\00"
+// CHECK-DAG: c"_Z5solvei:omp_parallel.1\00"
+// CHECK: @__pira_regions_table = private constant [3 x
+//
+// DEBUG-DAG: c"_Z5solvei:25:omp_parallel\00"
+// DEBUG-DAG: c"_Z5solvei:28:omp_parallel\00"
+// DEBUG-DAG: c"_Z5solvei:31:omp_parallel\00"
+//
+// CYG: [Warning]: The instrumentation hooks can not instrument parallel regions, skipping a parallel region of _Z5solvei
+// CYG-NOT: call void @__cyg_profile_func_enter
+
+volatile int sink;
+
+// CHECK-LABEL: define {{.*}}void @_Z5solvei(
+// CHECK-NOT: call void @__pira_region_enter
+// CHECK: ret void
+__attribute__((noinline)) void solve(int n) {
+#pragma omp parallel
+  {
+    sink = n;
+#pragma omp parallel
+    { sink = sink + 1; }
+  }
+#pragma omp parallel
+  { sink = sink + n; }
+}
+
+// CHECK-LABEL: define {{.*}}i32 @main(
+// CHECK-NOT: call void @__pira_region_enter
+int main(int argc, char **argv) {
+  solve(argc);
+  return 0;
+}
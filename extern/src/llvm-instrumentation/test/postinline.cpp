@@ -0,0 +1,34 @@
+// RUN: env PIRA_INSTR_FILTER_LIST=postinline.filt PIRA_INSTR_HOOKS=region-id PIRA_INSTR_PLACEMENT=post-inline clang++ -g -O2 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s
+// Early placement: the hooks are inlined together with the body
+// RUN: env PIRA_INSTR_FILTER_LIST=postinline.filt PIRA_INSTR_HOOKS=region-id clang++ -g -O2 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s --check-prefix=EARLY
+//
+// CHECK: @__pira_region_name = private unnamed_addr constant [8 x i8] c"_Z3addi\00"
+// CHECK: @__pira_regions_table = private constant [1 x {{.*}} i32 10 }], section "pira_regions"
+//
+// EARLY: @__pira_regions_table = private constant [1 x {{.*}} i32 10 }], section "pira_regions"
+
+volatile int sink;
+
+void add(int i) {
+  sink = sink + i;
+}
+
+// Every inlined call is a region of its own, the body stays inlined
+// CHECK-LABEL: define {{.*}}i32 @main(
+// CHECK-NOT: call void @_Z3addi
+// CHECK: call void @__pira_region_enter(i32 [[FIRST:%.*]])
+// CHECK: store volatile
+// CHECK: call void @__pira_region_exit(i32 [[FIRST]])
+// CHECK: call void @__pira_region_enter(i32 [[SECOND:%.*]])
+// CHECK: store volatile
+// CHECK: call void @__pira_region_exit(i32 [[SECOND]])
+// CHECK-NOT: call void @__pira_region_enter
+// CHECK: ret i32 0
+//
+// EARLY-LABEL: define {{.*}}i32 @main(
+// EARLY-COUNT-2: call void @__pira_region_enter
+int main(int argc, char **argv) {
+  add(argc);
+  add(2 * argc);
+  return 0;
+}
@@ -0,0 +1,26 @@
+// RUN: env PIRA_INSTR_FILTER_LIST=001.filt PIRA_INSTR_HOOKS=region-id clang++ -g -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s
+//
+// CHECK: @__pira_region_id = private global i32 -1
+// CHECK: @__pira_region_name = private unnamed_addr constant [8 x i8] c"_Z3foov\00"
+// CHECK: @__pira_region_file = private unnamed_addr constant {{.*}}regions.cpp\00"
+// CHECK: @__pira_regions_table = private constant {{.*}} i32 15 }], section "pira_regions"
+// CHECK: @llvm.global_ctors = {{.*}} @pira.regions_ctor
+//
+// CHECK-LABEL: define {{.*}}void @_Z3foov()
+// CHECK: %pira.region = load i32, i32* @__pira_region_id
+// CHECK: call void @__pira_region_enter(i32 %pira.region)
+// CHECK: call void @__pira_region_exit(i32 %pira.region)
+// CHECK-NOT: call void @__cyg_profile_func_enter
+
+__attribute__((noinline)) void foo() {
+}
+
+// CHECK-LABEL: define {{.*}}i32 @main(
+// CHECK-NOT: call void @__pira_region_enter
+int main(int argc, char **argv) {
+  foo();
+  return 0;
+}
+
+// CHECK-LABEL: define {{.*}}@pira.regions_ctor()
+// CHECK: call void @__pira_regions_init({{.*}}@__start_pira_regions{{.*}}@__stop_pira_regions
@@ -0,0 +1,24 @@
+// RUN: env PIRA_INSTR_SCOREP_FILTER=budget.cfg PIRA_INSTR_OVERHEAD_BUDGET=10 clang++ -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -Rpass=pira-instrumentation -Rpass-missed=pira-instrumentation -S -emit-llvm -o /dev/null %s 2>&1 | FileCheck %s
+// The hooks are only logged on request
+// RUN: env PIRA_INSTR_SCOREP_FILTER=budget.cfg PIRA_INSTR_VERBOSE=1 clang++ -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o /dev/null %s 2>&1 | FileCheck %s --check-prefix=VERBOSE
+// RUN: env PIRA_INSTR_SCOREP_FILTER=budget.cfg clang++ -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o /dev/null %s 2>&1 | FileCheck %s --check-prefix=QUIET --allow-empty
+//
+// CHECK-DAG: remark: skipped function _Z3getv: the hooks exceed the overhead budget [-Rpass-missed=pira-instrumentation]
+// CHECK-DAG: remark: instrumented function main [-Rpass=pira-instrumentation]
+//
+// VERBOSE: [LLVMInstrumentor] [DEBUG]: Running on main
+//
+// QUIET-NOT: [DEBUG]
+
+int value;
+
+// A leaf function that is called in a loop is dropped by the budget
+__attribute__((noinline)) int get() { return value; }
+
+int main(int argc, char **argv) {
+  int sum = 0;
+  for (int i = 0; i < argc; ++i) {
+    sum += get();
+  }
+  return sum;
+}
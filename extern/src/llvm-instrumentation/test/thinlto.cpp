@@ -0,0 +1,20 @@
+// REQUIRES: thinlto-backend
+// The bitcode is compiled without the plugin, only the ThinLTO backend pipeline instruments it.
+// RUN: clang++ -O1 -flto=thin -c -o %t.bc %s
+// RUN: llvm-dis %t.bc -o - | FileCheck %s --check-prefix=BITCODE
+// RUN: env PIRA_INSTR_FILTER_LIST=001.filt opt -load-pass-plugin ../build/lib/instrumentationlib.so -passes='thinlto<O2>' -S -o - %t.bc | FileCheck %s
+//
+// BITCODE-NOT: call void @__cyg_profile_func_enter
+//
+// CHECK-LABEL: define {{.*}}void @_Z3foov()
+// CHECK: call void @__cyg_profile_func_enter
+// CHECK: call void @__cyg_profile_func_exit
+// CHECK: attributes {{.*}}"pira-instrumented"
+__attribute__((noinline)) void foo() {
+  asm volatile("" ::: "memory");
+}
+
+int main(int argc, char **argv) {
+  foo();
+  return 0;
+}
@@ -0,0 +1,21 @@
+// RUN: env PIRA_INSTR_FILTER_LIST=001.filt PIRA_INSTR_HOOKS=inline-timer clang++ -O1 -fexperimental-new-pass-manager -fpass-plugin=../build/lib/instrumentationlib.so -S -emit-llvm -o - %s | FileCheck %s
+// REQUIRES: x86_64
+//
+// CHECK: @__pira_timer_module = private global {{.*}} { i32 1, i32 0, i32 1,
+// CHECK: @__pira_timer_slots = private thread_local(initialexec) global
+//
+// CHECK-LABEL: define {{.*}}void @_Z3foov()
+// CHECK: call i64 @llvm.readcyclecounter()
+// CHECK: call i64 @llvm.readcyclecounter()
+// CHECK: load {{.*}} @__pira_timer_slots
+// CHECK: call {{.*}} @__pira_timer_register(
+// CHECK-NOT: call void @__cyg_profile_func_enter
+__attribute__((noinline)) void foo() {
+}
+
+// CHECK-LABEL: define {{.*}}i32 @main(
+// CHECK-NOT: call i64 @llvm.readcyclecounter()
+int main(int argc, char **argv) {
+  foo();
+  return 0;
+}
@@ -0,0 +1,328 @@
+//===- PiraCGMerge.cpp - Builds the call graph from the function features -===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// Usage: pira-cg-merge [-j <threads>] [-o <call graph>] <features or directory>...
+//
+// Reads the static features that the plugin wrote per module with
+// -features-dir (*.features.json, see Features.h) in parallel, and writes the
+// whole-program call graph in the MetaCG format version 2, which PGIS reads
+// with --metacg-format 2. This replaces the separate run of the MetaCG
+// collector over all sources.
+//
+// A function defined in several modules, e.g., an inline function, is one
+// node with the union of its callees and the maximum of its features. Callees
+// without a definition, e.g., library functions, are nodes without a body.
+// The indirect calls are not resolved, the graph has no edges for them.
+// If any features file can not be read, nothing is written.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+
+static cl::list<std::string> Inputs(cl::Positional, cl::desc("<features or directory>..."), cl::OneOrMore);
+static cl::opt<std::string> OutputFile("o", cl::desc("Output call graph"), cl::value_desc("filename"), cl::init("-"));
+static cl::opt<unsigned> Jobs("j", cl::desc("Number of threads, 0 for all cores"), cl::init(0));
+
+namespace {
+
+std::mutex ErrorMutex;
+
+void reportError(const std::string &File, const std::string &Message) {
+  std::lock_guard<std::mutex> Lock(ErrorMutex);
+  std::cerr << "[pira-cg-merge] [Error]: " << File << ": " << Message << std::endl;
+}
+
+/// The counters of a function in the features, see Features.h
+enum Counter { Instructions, LoopDepth, FloatOps, IntOps, ControlFlowOps, MemoryAccesses, NumCounters };
+const char *const CounterKeys[NumCounters] = {"instructions", "loopDepth",      "floatOps",
+                                              "intOps",       "controlFlowOps", "memoryAccesses"};
+
+struct Node {
+  bool hasBody{false};
+  std::string file;
+  bool systemInclude{false};
+  int64_t counters[NumCounters] = {};
+  StringSet<> callees;
+
+  void merge(const Node &Other) {
+    if (!Other.hasBody) {
+      return;
+    }
+    if (!hasBody) {
+      hasBody = true;
+      file = Other.file;
+      systemInclude = Other.systemInclude;
+    }
+    for (size_t I = 0; I < NumCounters; ++I) {
+      counters[I] = std::max(counters[I], Other.counters[I]);
+    }
+    for (const auto &Callee : Other.callees) {
+      callees.insert(Callee.getKey());
+    }
+  }
+};
+
+class CallGraph {
+ public:
+  bool read(const std::string &Name) {
+    auto Buffer = MemoryBuffer::getFile(Name);
+    if (!Buffer) {
+      reportError(Name, "can not be read: " + Buffer.getError().message());
+      return false;
+    }
+    auto Parsed = json::parse((*Buffer)->getBuffer());
+    if (!Parsed) {
+      reportError(Name, "is not JSON: " + toString(Parsed.takeError()));
+      return false;
+    }
+    const auto *Root = Parsed->getAsObject();
+    const auto *Functions = Root ? Root->getObject("functions") : nullptr;
+    if (!Functions) {
+      reportError(Name, "has no functions");
+      return false;
+    }
+    for (const auto &Entry : *Functions) {
+      const auto *Features = Entry.second.getAsObject();
+      if (!Features) {
+        reportError(Name, "function " + Entry.first.str() + " has no features");
+        return false;
+      }
+      Node Function;
+      Function.hasBody = true;
+      Function.file = Features->getString("file").getValueOr("").str();
+      Function.systemInclude = Features->getBoolean("systemInclude").getValueOr(false);
+      for (size_t I = 0; I < NumCounters; ++I) {
+        Function.counters[I] = Features->getInteger(CounterKeys[I]).getValueOr(0);
+      }
+      if (const auto *Callees = Features->getArray("callees")) {
+        for (const auto &Callee : *Callees) {
+          if (auto CalleeName = Callee.getAsString()) {
+            Function.callees.insert(*CalleeName);
+          }
+        }
+      }
+      nodes[Entry.first].merge(Function);
+    }
+    return true;
+  }
+
+  void merge(const CallGraph &Other) {
+    for (const auto &Entry : Other.nodes) {
+      nodes[Entry.getKey()].merge(Entry.getValue());
+    }
+  }
+
+  size_t getNumFunctions() const { return nodes.size(); }
+
+  void write(raw_ostream &OS) {
+    // Callees without a definition in any module
+    std::vector<std::string> External;
+    for (const auto &Entry : nodes) {
+      for (const auto &Callee : Entry.getValue().callees) {
+        if (!nodes.count(Callee.getKey())) {
+          External.push_back(Callee.getKey().str());
+        }
+      }
+    }
+    for (const auto &Name : External) {
+      nodes[Name];
+    }
+    StringMap<std::vector<StringRef>> Callers;
+    for (const auto &Entry : nodes) {
+      for (const auto &Callee : Entry.getValue().callees) {
+        Callers[Callee.getKey()].push_back(Entry.getKey());
+      }
+    }
+    std::vector<StringRef> Names;
+    Names.reserve(nodes.size());
+    for (const auto &Entry : nodes) {
+      Names.push_back(Entry.getKey());
+    }
+    std::sort(Names.begin(), Names.end());
+
+    json::OStream J(OS);
+    J.object([&] {
+      J.attributeObject("_MetaCG", [&] {
+        J.attribute("version", "2.0");
+        J.attributeObject("generator", [&] {
+          J.attribute("name", "pira-cg-merge");
+          J.attribute("version", "1.0");
+        });
+      });
+      J.attributeObject("_CG", [&] {
+        for (const auto Name : Names) {
+          const auto &Function = nodes.find(Name)->getValue();
+          std::vector<StringRef> Callees;
+          for (const auto &Callee : Function.callees) {
+            Callees.push_back(Callee.getKey());
+          }
+          std::sort(Callees.begin(), Callees.end());
+          auto &FunctionCallers = Callers[Name];
+          std::sort(FunctionCallers.begin(), FunctionCallers.end());
+          J.attributeObject(Name, [&] {
+            writeNames(J, "callees", Callees);
+            writeNames(J, "callers", FunctionCallers);
+            J.attribute("doesOverride", false);
+            J.attribute("hasBody", Function.hasBody);
+            J.attribute("isVirtual", false);
+            J.attributeArray("overriddenBy", [] {});
+            J.attributeArray("overrides", [] {});
+            if (Function.hasBody) {
+              writeMetaData(J, Function);
+            }
+          });
+        }
+      });
+    });
+    OS << "\n";
+  }
+
+ private:
+  static void writeNames(json::OStream &J, StringRef Key, const std::vector<StringRef> &Names) {
+    J.attributeArray(Key, [&] {
+      for (const auto Name : Names) {
+        J.value(Name);
+      }
+    });
+  }
+
+  /// The features under the keys of the MetaCG metadata
+  static void writeMetaData(json::OStream &J, const Node &Function) {
+    J.attributeObject("meta", [&] {
+      J.attributeObject("fileProperties", [&] {
+        J.attribute("origin", Function.file);
+        J.attribute("systemInclude", Function.systemInclude);
+      });
+      J.attribute("loopDepth", Function.counters[LoopDepth]);
+      J.attribute("numStatements", Function.counters[Instructions]);
+      J.attributeObject("numOperations", [&] {
+        J.attribute("numberOfControlFlowOps", Function.counters[ControlFlowOps]);
+        J.attribute("numberOfFloatOps", Function.counters[FloatOps]);
+        J.attribute("numberOfIntOps", Function.counters[IntOps]);
+        J.attribute("numberOfMemoryAccesses", Function.counters[MemoryAccesses]);
+      });
+    });
+  }
+
+  StringMap<Node> nodes;
+};
+
+/// The inputs, with the features within directories
+std::vector<std::string> collectInputs() {
+  std::vector<std::string> Files;
+  for (const auto &Input : Inputs) {
+    if (!sys::fs::is_directory(Input)) {
+      Files.push_back(Input);
+      continue;
+    }
+    std::error_code EC;
+    for (sys::fs::directory_iterator It(Input, EC), End; It != End && !EC; It.increment(EC)) {
+      const StringRef Path = It->path();
+      if (Path.endswith(".features.json")) {
+        Files.push_back(Path.str());
+      }
+    }
+    if (EC) {
+      reportError(Input, "can not be listed: " + EC.message());
+    }
+  }
+  std::sort(Files.begin(), Files.end());
+  return Files;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "PIRA call graph merger\n");
+
+  const auto Files = collectInputs();
+  if (Files.empty()) {
+    std::cerr << "[pira-cg-merge] [Error]: No function features found." << std::endl;
+    return 1;
+  }
+  unsigned NumWorkers = Jobs ? Jobs : std::max(1U, std::thread::hardware_concurrency());
+  NumWorkers = std::min<size_t>(NumWorkers, Files.size());
+
+  std::vector<CallGraph> Partial(NumWorkers);
+  std::atomic<size_t> Next{0};
+  std::atomic<size_t> Failed{0};
+  std::vector<std::thread> Workers;
+  for (unsigned W = 0; W < NumWorkers; ++W) {
+    Workers.emplace_back([&, W] {
+      for (size_t I = Next++; I < Files.size(); I = Next++) {
+        if (!Partial[W].read(Files[I])) {
+          ++Failed;
+        }
+      }
+    });
+  }
+  for (auto &Worker : Workers) {
+    Worker.join();
+  }
+  for (unsigned W = 1; W < NumWorkers; ++W) {
+    Partial[0].merge(Partial[W]);
+  }
+
+  // A partial graph would replace the complete one of an earlier run
+  if (Failed) {
+    std::cerr << "[pira-cg-merge] [Error]: " << Failed << " of " << Files.size()
+              << " files could not be read, not writing " << OutputFile << std::endl;
+    return 1;
+  }
+
+  if (OutputFile == "-") {
+    Partial[0].write(outs());
+    outs().flush();
+  } else {
+    // Write to a temporary file and rename it: a failed write keeps the previous call graph
+    SmallString<128> TempFile;
+    int FD;
+    if (auto EC = sys::fs::createUniqueFile(OutputFile + ".%%%%%%", FD, TempFile)) {
+      std::cerr << "[pira-cg-merge] [Error]: Can not create " << OutputFile << ": " << EC.message() << std::endl;
+      return 1;
+    }
+    {
+      raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      Partial[0].write(OS);
+      OS.close();
+      if (OS.has_error()) {
+        std::cerr << "[pira-cg-merge] [Error]: Writing " << TempFile.c_str() << " failed." << std::endl;
+        OS.clear_error();
+        sys::fs::remove(TempFile);
+        return 1;
+      }
+    }
+    if (auto EC = sys::fs::rename(TempFile, OutputFile)) {
+      std::cerr << "[pira-cg-merge] [Error]: Can not create " << OutputFile << ": " << EC.message() << std::endl;
+      sys::fs::remove(TempFile);
+      return 1;
+    }
+  }
+
+  std::cerr << "[pira-cg-merge] [Info]: " << Files.size() << " modules, " << Partial[0].getNumFunctions()
+            << " functions" << std::endl;
+  return 0;
+}
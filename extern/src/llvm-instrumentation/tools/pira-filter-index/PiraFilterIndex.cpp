@@ -0,0 +1,113 @@
+//===- PiraFilterIndex.cpp - Compiles a filter into a filter index --------===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// Usage: pira-filter-index [-filter-list=<file>] [-score-p-filter=<file>] -o <index>
+//
+// Exact symbol names (whitelist entries, MANGLED patterns without wildcards)
+// are stored with the decision of the complete filter, so that the plugin does
+// not need to evaluate any rule for them. All other rules are stored as they
+// are and compiled by the plugin when it maps the index.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Filter.h"
+#include "FilterIndex.h"
+#include "Options.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <iostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace llvm;
+using namespace pira;
+
+static cl::opt<std::string> OutputFile("o", cl::desc("Output filter index"), cl::value_desc("filename"),
+                                       cl::Required);
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "PIRA filter index compiler\n");
+
+  const auto WhitelistFileName = getWhitelistFile();
+  const auto ScorePFileName = getScorePFilterFile();
+  if (WhitelistFileName.empty() && ScorePFileName.empty()) {
+    std::cerr << "[pira-filter-index] [Error]: Neither -filter-list nor -score-p-filter given." << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> Whitelist;
+  std::vector<FilterRule> Rules;
+  if (!WhitelistFileName.empty()) {
+    readWhitelistFile(WhitelistFileName, Whitelist);
+  }
+  if (!ScorePFileName.empty()) {
+    readScorePFilterFile(ScorePFileName, Rules);
+  }
+  const InstrumentationFilter Filter(Whitelist, Rules);
+
+  // Split into exact names, which go to the hash tables, and the remaining rules
+  FilterIndexWriter Writer;
+  StringMap<uint32_t> Functions;
+  std::set<std::pair<std::string, std::string>> CallSites;
+  for (const auto &Name : Whitelist) {
+    Functions.insert({Name, 0});
+  }
+  size_t NumRules = 0;
+  for (const auto &Rule : Rules) {
+    if (!Rule.isCallSite && Rule.loopDepth == 0 && !Rule.parallel && Rule.pattern.isExactSymbol()) {
+      Functions.insert({Rule.pattern.text, 0});
+    } else if (Rule.isCallSite && !Rule.isIndirect && Rule.pattern.isExactSymbol() && Rule.callee.isExactSymbol()) {
+      Functions[Rule.pattern.text] |= index::HasCallSites;
+      CallSites.insert({Rule.pattern.text, Rule.callee.text});
+    } else {
+      Writer.addRule(Rule);
+      ++NumRules;
+    }
+  }
+  for (const auto &F : Functions) {
+    Writer.addFunction(F.getKey(), F.getValue() | (Filter.isFiltered(F.getKey()) ? index::Instrument : 0U));
+  }
+  for (const auto &CS : CallSites) {
+    const auto CallerRules = Filter.getCallSiteRules(CS.first);
+    Writer.addCallSite(CS.first, CS.second, Filter.isCallSiteFiltered(CS.first, CallerRules, CS.second));
+  }
+
+  // Write to a temporary file and rename it: compiler processes may map the previous index right now
+  SmallString<128> TempFile;
+  int FD;
+  if (auto EC = sys::fs::createUniqueFile(OutputFile + ".%%%%%%", FD, TempFile)) {
+    std::cerr << "[pira-filter-index] [Error]: Can not create " << OutputFile << ": " << EC.message() << std::endl;
+    return 1;
+  }
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    Writer.write(OS);
+    OS.close();
+    if (OS.has_error()) {
+      std::cerr << "[pira-filter-index] [Error]: Writing " << TempFile.c_str() << " failed." << std::endl;
+      OS.clear_error();
+      sys::fs::remove(TempFile);
+      return 1;
+    }
+  }
+  if (auto EC = sys::fs::rename(TempFile, OutputFile)) {
+    std::cerr << "[pira-filter-index] [Error]: Can not create " << OutputFile << ": " << EC.message() << std::endl;
+    sys::fs::remove(TempFile);
+    return 1;
+  }
+
+  std::cout << "[pira-filter-index] [Info]: " << Functions.size() << " functions, " << CallSites.size()
+            << " call sites, " << NumRules << " rules" << std::endl;
+  return 0;
+}
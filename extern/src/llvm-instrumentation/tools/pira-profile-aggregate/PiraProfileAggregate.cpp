@@ -0,0 +1,534 @@
+//===- PiraProfileAggregate.cpp - Summarizes the profiles of all ranks ----===//
+//
+// This file is shipped as part of the PIRA project
+//
+//===----------------------------------------------------------------------===//
+//
+// Usage: pira-profile-aggregate [-j <threads>] [-o <summary>] <file or directory>...
+//
+// Reads the traces of the trace runtime (*.bin, see PiraTrace.h) and the
+// profiles of the timer runtime (*.csv), one file per rank, in parallel.
+// Every worker reduces the profile of a rank into its own summary right away,
+// so the memory grows with the number of regions and workers, not with the
+// number of ranks. The summary has one entry per region with the visits and
+// the sum, min, max and mean across the ranks of its inclusive and exclusive
+// time in seconds. Ranks that did not visit a region count as 0 for the min
+// and the mean. The timer profiles have no exclusive time; the exclusive time
+// of a region is only reported if all ranks that visited it were traced.
+//
+// For traced regions, the summary additionally holds both times with the
+// overhead of the hooks subtracted, using the event cost that every thread
+// measured (see PiraTrace.h): a region loses one event per visit and two
+// events per visit of a region nested in it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PiraTrace.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace llvm;
+
+static cl::list<std::string> Inputs(cl::Positional, cl::desc("<trace, profile or directory>..."), cl::OneOrMore);
+static cl::opt<std::string> OutputFile("o", cl::desc("Output summary"), cl::value_desc("filename"), cl::init("-"));
+static cl::opt<unsigned> Jobs("j", cl::desc("Number of threads, 0 for all cores"), cl::init(0));
+
+namespace {
+
+std::mutex ErrorMutex;
+
+void reportError(const std::string &File, const std::string &Message) {
+  std::lock_guard<std::mutex> Lock(ErrorMutex);
+  std::cerr << "[pira-profile-aggregate] [Error]: " << File << ": " << Message << std::endl;
+}
+
+void reportWarning(const std::string &File, const std::string &Message) {
+  std::lock_guard<std::mutex> Lock(ErrorMutex);
+  std::cerr << "[pira-profile-aggregate] [Warning]: " << File << ": " << Message << std::endl;
+}
+
+/// Totals of a region in one rank, summed over its threads
+struct RegionTotals {
+  uint64_t visits{0};
+  double inclusive{0};
+  double exclusive{0};
+  double compensatedInclusive{0};
+  double compensatedExclusive{0};
+  bool hasExclusive{false};
+};
+
+using RankProfile = StringMap<RegionTotals>;
+
+struct Statistic {
+  double sum{0};
+  double min{std::numeric_limits<double>::infinity()};
+  double max{0};
+
+  void add(double Value) {
+    sum += Value;
+    min = std::min(min, Value);
+    max = std::max(max, Value);
+  }
+
+  void merge(const Statistic &Other) {
+    sum += Other.sum;
+    min = std::min(min, Other.min);
+    max = std::max(max, Other.max);
+  }
+};
+
+struct RegionSummary {
+  uint64_t ranks{0};  // Ranks that visited the region
+  uint64_t exclusiveRanks{0};
+  uint64_t visits{0};
+  Statistic inclusive;
+  Statistic exclusive;
+  Statistic compensatedInclusive;
+  Statistic compensatedExclusive;
+};
+
+class Summary {
+ public:
+  void addRank(const RankProfile &Profile) {
+    ++ranks;
+    for (const auto &Entry : Profile) {
+      const auto &Totals = Entry.getValue();
+      auto &Region = regions[Entry.getKey()];
+      ++Region.ranks;
+      Region.visits += Totals.visits;
+      Region.inclusive.add(Totals.inclusive);
+      if (Totals.hasExclusive) {
+        ++Region.exclusiveRanks;
+        Region.exclusive.add(Totals.exclusive);
+        Region.compensatedInclusive.add(Totals.compensatedInclusive);
+        Region.compensatedExclusive.add(Totals.compensatedExclusive);
+      }
+    }
+  }
+
+  void merge(const Summary &Other) {
+    ranks += Other.ranks;
+    for (const auto &Entry : Other.regions) {
+      const auto &From = Entry.getValue();
+      auto &Region = regions[Entry.getKey()];
+      Region.ranks += From.ranks;
+      Region.exclusiveRanks += From.exclusiveRanks;
+      Region.visits += From.visits;
+      Region.inclusive.merge(From.inclusive);
+      Region.exclusive.merge(From.exclusive);
+      Region.compensatedInclusive.merge(From.compensatedInclusive);
+      Region.compensatedExclusive.merge(From.compensatedExclusive);
+    }
+  }
+
+  uint64_t getNumRanks() const { return ranks; }
+
+  void write(raw_ostream &OS) const {
+    // Most expensive regions first
+    std::vector<const StringMapEntry<RegionSummary> *> Sorted;
+    for (const auto &Entry : regions) {
+      Sorted.push_back(&Entry);
+    }
+    std::sort(Sorted.begin(), Sorted.end(), [](const auto *A, const auto *B) {
+      if (A->getValue().inclusive.sum != B->getValue().inclusive.sum) {
+        return A->getValue().inclusive.sum > B->getValue().inclusive.sum;
+      }
+      return A->getKey() < B->getKey();
+    });
+
+    json::OStream J(OS);
+    J.object([&] {
+      J.attribute("ranks", static_cast<int64_t>(ranks));
+      J.attributeArray("regions", [&] {
+        for (const auto *Entry : Sorted) {
+          const auto &Region = Entry->getValue();
+          J.object([&] {
+            J.attribute("name", Entry->getKey());
+            J.attribute("ranks", static_cast<int64_t>(Region.ranks));
+            J.attribute("visits", static_cast<int64_t>(Region.visits));
+            writeStatistic(J, "inclusive", Region.inclusive, Region.ranks);
+            if (Region.exclusiveRanks == Region.ranks) {
+              writeStatistic(J, "exclusive", Region.exclusive, Region.ranks);
+              J.attributeObject("compensated", [&] {
+                writeStatistic(J, "inclusive", Region.compensatedInclusive, Region.ranks);
+                writeStatistic(J, "exclusive", Region.compensatedExclusive, Region.ranks);
+              });
+            }
+          });
+        }
+      });
+    });
+    OS << "\n";
+  }
+
+ private:
+  void writeStatistic(json::OStream &J, StringRef Name, const Statistic &S, uint64_t RegionRanks) const {
+    J.attributeObject(Name, [&] {
+      J.attribute("sum", S.sum);
+      J.attribute("min", RegionRanks < ranks ? 0.0 : S.min);
+      J.attribute("max", S.max);
+      J.attribute("mean", S.sum / ranks);
+    });
+  }
+
+  uint64_t ranks{0};
+  StringMap<RegionSummary> regions;
+};
+
+/// A file of one rank, mapped read-only
+class InputFile {
+ public:
+  bool open(const std::string &Name) {
+    uint64_t Size = 0;
+    if (sys::fs::file_size(Name, Size)) {
+      reportError(Name, "can not be read");
+      return false;
+    }
+    if (Size == 0) {
+      return true;
+    }
+    auto FD = sys::fs::openNativeFileForRead(Name);
+    if (!FD) {
+      consumeError(FD.takeError());
+      reportError(Name, "can not be opened");
+      return false;
+    }
+    std::error_code EC;
+    region = std::make_unique<sys::fs::mapped_file_region>(*FD, sys::fs::mapped_file_region::readonly, Size, 0, EC);
+    sys::fs::closeFile(*FD);
+    if (EC) {
+      reportError(Name, "can not be mapped: " + EC.message());
+      return false;
+    }
+    return true;
+  }
+
+  StringRef getData() const { return region ? StringRef(region->const_data(), region->size()) : StringRef(); }
+
+ private:
+  std::unique_ptr<sys::fs::mapped_file_region> region;
+};
+
+/// Times of a trace in ticks, by region key
+class TraceReader {
+ public:
+  bool read(const std::string &Name, StringRef Data, RankProfile &Profile) {
+    pira_trace_header Header;
+    if (Data.size() < sizeof(Header)) {
+      reportError(Name, "is not a trace");
+      return false;
+    }
+    std::memcpy(&Header, Data.data(), sizeof(Header));
+    if (std::memcmp(Header.magic, PIRA_TRACE_MAGIC, sizeof(PIRA_TRACE_MAGIC)) != 0 ||
+        Header.version == 0 || Header.version > PIRA_TRACE_VERSION) {
+      reportError(Name, "is not a trace or of another version");
+      return false;
+    }
+    if (Header.size == 0 || Header.tick_seconds <= 0) {
+      reportError(Name, "the trace was not finished");
+      return false;
+    }
+    if (Header.size > Data.size()) {
+      reportError(Name, "the trace is truncated");
+      return false;
+    }
+
+    uint64_t Offset = sizeof(Header);
+    while (Offset + sizeof(pira_trace_block) <= Header.size) {
+      pira_trace_block Block;
+      std::memcpy(&Block, Data.data() + Offset, sizeof(Block));
+      Offset += sizeof(Block);
+      if (Block.size > Header.size - Offset) {
+        reportError(Name, "block exceeds the trace");
+        return false;
+      }
+      const char *Payload = Data.data() + Offset;
+      switch (Block.kind) {
+        case PIRA_TRACE_BLOCK_THREAD:
+          readThread(threads[Block.thread], Payload, Block.size);
+          break;
+        case PIRA_TRACE_BLOCK_EVENTS:
+          readEvents(threads[Block.thread], Payload, Block.size / sizeof(pira_trace_event));
+          break;
+        case PIRA_TRACE_BLOCK_REGION:
+          readRegion(Payload, Block.size);
+          break;
+        default:
+          break;
+      }
+      Offset += Block.size;
+    }
+    for (auto &Thread : threads) {
+      closeOpenFrames(Thread.second);
+    }
+    if (mismatches) {
+      reportWarning(Name, std::to_string(mismatches) + " exit events without matching enter event");
+    }
+
+    for (const auto &Entry : totals) {
+      auto &Totals = Profile[getName(Entry.first)];
+      Totals.visits += Entry.second.visits;
+      Totals.inclusive += Header.tick_seconds * Entry.second.inclusive;
+      Totals.exclusive += Header.tick_seconds * Entry.second.exclusive;
+      Totals.compensatedInclusive += Header.tick_seconds * Entry.second.compensatedInclusive;
+      Totals.compensatedExclusive += Header.tick_seconds * Entry.second.compensatedExclusive;
+      Totals.hasExclusive = true;
+    }
+    return true;
+  }
+
+ private:
+  /// Region ID or function address, and PIRA_TRACE_EVENT_ADDRESS for addresses
+  using Key = std::pair<uint64_t, uint32_t>;
+
+  struct Frame {
+    Key key;
+    uint64_t start;
+    uint64_t children;
+    double compensatedChildren;
+    uint64_t nested;  // Frames nested in this one, at any depth
+  };
+
+  struct ThreadState {
+    std::vector<Frame> stack;
+    DenseMap<Key, unsigned> active;  // Open frames per region, recursive calls add their inclusive time only once
+    uint64_t last{0};
+    double eventTicks{0};  // Not measured in traces of version 1
+  };
+
+  struct Ticks {
+    uint64_t visits{0};
+    uint64_t inclusive{0};
+    uint64_t exclusive{0};
+    double compensatedInclusive{0};
+    double compensatedExclusive{0};
+  };
+
+  static void readThread(ThreadState &Thread, const char *Payload, uint64_t Size) {
+    pira_trace_thread Info;
+    if (Size >= sizeof(Info)) {
+      std::memcpy(&Info, Payload, sizeof(Info));
+      Thread.eventTicks = std::max(0.0, Info.event_ticks);
+    }
+  }
+
+  void readEvents(ThreadState &Thread, const char *Payload, uint64_t Count) {
+    for (uint64_t I = 0; I < Count; ++I) {
+      pira_trace_event Event;
+      std::memcpy(&Event, Payload + I * sizeof(Event), sizeof(Event));
+      const Key K{Event.region, static_cast<uint32_t>(Event.time_flags & PIRA_TRACE_EVENT_ADDRESS)};
+      const uint64_t Time = Event.time_flags >> PIRA_TRACE_EVENT_TIME_SHIFT;
+      Thread.last = Time;
+      if (!(Event.time_flags & PIRA_TRACE_EVENT_EXIT)) {
+        Thread.stack.push_back({K, Time, 0, 0, 0});
+        ++Thread.active[K];
+        ++totals[K].visits;
+      } else if (Thread.stack.empty() || Thread.stack.back().key != K) {
+        ++mismatches;
+      } else {
+        closeFrame(Thread, Time);
+      }
+    }
+  }
+
+  void closeFrame(ThreadState &Thread, uint64_t Time) {
+    const auto F = Thread.stack.back();
+    Thread.stack.pop_back();
+    const uint64_t Duration = Time - F.start;
+    auto &T = totals[F.key];
+    T.exclusive += Duration - std::min(Duration, F.children);
+    // The events of the frame add one event to its duration, every nested frame adds its enter and exit event
+    const double Compensated = std::max(0.0, Duration - Thread.eventTicks * (1 + 2 * F.nested));
+    T.compensatedExclusive += std::max(0.0, Compensated - F.compensatedChildren);
+    if (--Thread.active[F.key] == 0) {
+      T.inclusive += Duration;
+      T.compensatedInclusive += Compensated;
+    }
+    if (!Thread.stack.empty()) {
+      auto &Parent = Thread.stack.back();
+      Parent.children += Duration;
+      Parent.compensatedChildren += Compensated;
+      Parent.nested += 1 + F.nested;
+    }
+  }
+
+  /// Regions that are still open at the end of the trace, e.g., of threads that ran when the process exited
+  void closeOpenFrames(ThreadState &Thread) {
+    while (!Thread.stack.empty()) {
+      closeFrame(Thread, Thread.last);
+    }
+  }
+
+  void readRegion(const char *Payload, uint64_t Size) {
+    pira_trace_region Region;
+    if (Size < sizeof(Region)) {
+      return;
+    }
+    std::memcpy(&Region, Payload, sizeof(Region));
+    if (Region.name_length <= Size - sizeof(Region)) {
+      names[{Region.region, Region.flags & PIRA_TRACE_EVENT_ADDRESS}] =
+          std::string(Payload + sizeof(Region), Region.name_length);
+    }
+  }
+
+  std::string getName(const Key &K) const {
+    const auto It = names.find(K);
+    if (It != names.end()) {
+      return It->second;
+    }
+    std::string Name;
+    raw_string_ostream OS(Name);
+    if (K.second) {
+      OS << "0x";
+      OS.write_hex(K.first);
+    } else {
+      OS << "region " << K.first;
+    }
+    return OS.str();
+  }
+
+  std::unordered_map<uint32_t, ThreadState> threads;
+  DenseMap<Key, Ticks> totals;
+  DenseMap<Key, std::string> names;
+  uint64_t mismatches{0};
+};
+
+/// region;calls;ticks;seconds of the timer runtime
+bool readTimerProfile(const std::string &Name, StringRef Data, RankProfile &Profile) {
+  SmallVector<StringRef, 0> Lines;
+  Data.split(Lines, '\n', -1, false);
+  for (size_t I = 0; I < Lines.size(); ++I) {
+    const auto Line = Lines[I].rtrim('\r');
+    if (I == 0 && Line.startswith("region;")) {
+      continue;
+    }
+    // The region name may contain ';', the numbers do not
+    StringRef Region, Calls, Ticks, Seconds;
+    std::tie(Region, Seconds) = Line.rsplit(';');
+    std::tie(Region, Ticks) = Region.rsplit(';');
+    std::tie(Region, Calls) = Region.rsplit(';');
+    uint64_t Visits = 0;
+    double Time = 0;
+    if (Region.empty() || Calls.getAsInteger(10, Visits) || Seconds.getAsDouble(Time)) {
+      reportError(Name, "line " + std::to_string(I + 1) + " is not region;calls;ticks;seconds");
+      return false;
+    }
+    auto &Totals = Profile[Region];
+    Totals.visits += Visits;
+    Totals.inclusive += Time;
+  }
+  return true;
+}
+
+bool readRank(const std::string &Name, RankProfile &Profile) {
+  InputFile File;
+  if (!File.open(Name)) {
+    return false;
+  }
+  const auto Data = File.getData();
+  if (Data.startswith(StringRef(PIRA_TRACE_MAGIC, sizeof(PIRA_TRACE_MAGIC)))) {
+    return TraceReader().read(Name, Data, Profile);
+  }
+  return readTimerProfile(Name, Data, Profile);
+}
+
+/// The inputs, with the traces and profiles within directories
+std::vector<std::string> collectInputs() {
+  std::vector<std::string> Files;
+  for (const auto &Input : Inputs) {
+    if (!sys::fs::is_directory(Input)) {
+      Files.push_back(Input);
+      continue;
+    }
+    std::error_code EC;
+    for (sys::fs::directory_iterator It(Input, EC), End; It != End && !EC; It.increment(EC)) {
+      const StringRef Path = It->path();
+      if (Path.endswith(".bin") || Path.endswith(".csv")) {
+        Files.push_back(Path.str());
+      }
+    }
+    if (EC) {
+      reportError(Input, "can not be listed: " + EC.message());
+    }
+  }
+  std::sort(Files.begin(), Files.end());
+  return Files;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  InitLLVM X(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "PIRA profile aggregator\n");
+
+  const auto Files = collectInputs();
+  if (Files.empty()) {
+    std::cerr << "[pira-profile-aggregate] [Error]: No traces or profiles found." << std::endl;
+    return 1;
+  }
+  unsigned NumWorkers = Jobs ? Jobs : std::max(1U, std::thread::hardware_concurrency());
+  NumWorkers = std::min<size_t>(NumWorkers, Files.size());
+
+  std::vector<Summary> Partial(NumWorkers);
+  std::atomic<size_t> Next{0};
+  std::atomic<size_t> Failed{0};
+  std::vector<std::thread> Workers;
+  for (unsigned W = 0; W < NumWorkers; ++W) {
+    Workers.emplace_back([&, W] {
+      for (size_t I = Next++; I < Files.size(); I = Next++) {
+        RankProfile Profile;
+        if (readRank(Files[I], Profile)) {
+          Partial[W].addRank(Profile);
+        } else {
+          ++Failed;
+        }
+      }
+    });
+  }
+  for (auto &Worker : Workers) {
+    Worker.join();
+  }
+  for (unsigned W = 1; W < NumWorkers; ++W) {
+    Partial[0].merge(Partial[W]);
+  }
+
+  std::error_code EC;
+  raw_fd_ostream OS(OutputFile, EC, sys::fs::OF_None);
+  if (EC) {
+    std::cerr << "[pira-profile-aggregate] [Error]: Can not create " << OutputFile << ": " << EC.message() << std::endl;
+    return 1;
+  }
+  Partial[0].write(OS);
+  OS.close();
+  if (OS.has_error()) {
+    std::cerr << "[pira-profile-aggregate] [Error]: Writing " << OutputFile << " failed." << std::endl;
+    OS.clear_error();
+    return 1;
+  }
+
+  std::cerr << "[pira-profile-aggregate] [Info]: " << Partial[0].getNumRanks() << " ranks";
+  if (Failed) {
+    std::cerr << ", " << Failed << " files skipped";
+  }
+  std::cerr << std::endl;
+  return Failed ? 1 : 0;
+}
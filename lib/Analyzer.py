@@ -100,9 +100,15 @@ class Analyzer:
           L.get_logger().log('Analyzer::analyze_local: command finished', level='debug')
 
         else:
+          if InvocCfg.get_instance().use_call_graph_from_build():
+            tracker.f_track('Call graph merge', self.merge_call_graph, target_config.get_place(),
+                            benchmark, analyzer_dir, flavor, benchmark_name)
           tracker.f_track('Initial analysis', self.run_analyzer_command_no_instr, command,
                           analyzer_dir, flavor, benchmark_name)
 
+        if InvocCfg.get_instance().get_overhead_budget() > 0:
+          self.apply_overhead_report(instr_files)
+
         U.copy_file(instr_files, numbered_instr_file)
         self.tear_down(build, exp_dir)
         return instr_files
@@ -114,6 +120,45 @@ class Analyzer:
   def set_up(self):
     pass
 
+  @staticmethod
+  def merge_call_graph(build_dir: str, benchmark: str, analyzer_dir: str, flavor: str,
+                       benchmark_name: str) -> None:
+    """
+    Replaces the call graph of the analyzer by the one merged from the function features that the
+    instrumentation plugin wrote during the vanilla build. Keeps the existing call graph if there are
+    no features or the merge fails.
+    """
+    features_dir = U.build_features_dir(build_dir, benchmark, flavor)
+    if not U.get_function_features_files(features_dir):
+      L.get_logger().log('Analyzer::merge_call_graph: No function features in ' + features_dir +
+                         ', using the existing call graph',
+                         level='warn')
+      return
+    ipcg_file = U.get_ipcg_file_name(analyzer_dir, benchmark_name, flavor)
+    try:
+      U.shell(U.build_call_graph_merge_command(features_dir, ipcg_file))
+      L.get_logger().log('Analyzer::merge_call_graph: Call graph ' + ipcg_file + ' merged from ' +
+                         features_dir)
+    except Exception as e:
+      L.get_logger().log('Analyzer::merge_call_graph: Merging the call graph failed, using the '
+                         'existing call graph: ' + str(e),
+                         level='warn')
+
+  @staticmethod
+  def apply_overhead_report(instr_file: str) -> None:
+    """
+    Removes the functions that the overhead budget dropped in the last build from the selection.
+    Downgraded functions stay selected, the plugin instruments their call sites instead.
+    """
+    report_file = U.build_overhead_report_path(instr_file)
+    if not U.is_file(report_file):
+      return
+    actions = U.read_overhead_report(report_file)
+    dropped = [function for function, action in actions.items() if action == 'drop']
+    removed = U.remove_functions_from_instr_file(instr_file, dropped)
+    L.get_logger().log('Analyzer::apply_overhead_report: Removed ' + str(removed) +
+                       ' functions that exceed the overhead budget')
+
   def tear_down(self, old_dir, exp_dir):
     isdirectory_good = U.check_provided_directory(exp_dir)
     if isdirectory_good:
@@ -6,7 +6,7 @@ Description:
 
 import time
 import json
-from typing import Type, Tuple, Dict, Union, List, Any
+from typing import Type, Tuple, Dict, Union, List, Any, Callable
 
 import lib.Logging as L
 import lib.Utility as U
@@ -69,6 +69,8 @@ class BatchSystemInterface:
   For many of the interfaces functions, a key is needed. You may use U.generate_random_string() to generate one.
   A key is used to reference a batch system job. This means, since these keys are used to obtain the results
   for timed commands, only one timed command per job can be added. But this should be enough for PIRA.
+  An exception are command arrays: one job that runs a list of commands, referenced by one key and the
+  ids of its tasks.
   See individual *Backend classes for more detail.
   """
 
@@ -89,6 +91,7 @@ class BatchSystemInterface:
     self.preparation_commands = {}
     self.timed_commands = {}
     self.teardown_commands = {}
+    self.array_commands = {}
     self.job_id_map = {}
     self.results = {}
 
@@ -159,6 +162,36 @@ class BatchSystemInterface:
     self.job_id_map[key] = None
     self.results[(key, None)] = None
 
+  def add_timed_command_array(self,
+                              key: str,
+                              cmds: List[str],
+                              preparation_cmds: List[str] = None) -> None:
+    """
+    Add a list of commands to be timed, that are dispatched together as one job, e.g., the
+    scaling points of an experiment. Each command may have a preparation command, e.g., to set
+    its own Score-P experiment directory.
+
+    Any implementation is expected to put a key-value pair of the key and the tuple of both
+    lists in the self.array_commands map, to add the None-placeholder to the self.job_id_map,
+    and the None-placeholders for all tasks of the job to the self.results map, keyed by tuples
+    of (key, task id). The task ids of a command are returned by get_array_task_ids.
+
+    :param key: A key (see class docstring).
+    :param cmds: The commands.
+    :param preparation_cmds: None, or a preparation command per command.
+    """
+    self.array_commands[key] = (cmds, preparation_cmds)
+    self.job_id_map[key] = None
+    for index in range(len(cmds)):
+      self.results[(key, index)] = None
+
+  def get_array_task_ids(self, key: str, index: int) -> List[Any]:
+    """
+    Returns the ids of the tasks that run the command at index of the command array referenced by
+    the key. Use them as repetitions for get_results.
+    """
+    return [index]
+
   def dispatch(self, key: str) -> Any:
     """
     Start execution(s) by dispatching the job details referenced by the key
@@ -202,6 +235,24 @@ class BatchSystemInterface:
     """
     pass
 
+  def wait_for_results(self, on_result: Callable[[str, Any], None]) -> None:
+    """
+    Wait until the results are ready, like wait, but call on_result with the key and
+    repetition of every result, as soon as it is available.
+
+    Any implementation is expected to call on_result exactly once for every result of a dispatched
+    job, after it was put in the self.results map. This basic implementation waits for all of
+    them.
+
+    :param on_result: The function to call per result.
+    :return: None.
+    """
+    self.wait()
+    dispatched = [key for key, job_id in self.job_id_map.items() if job_id is not None]
+    for (key, repetition), result in self.results.items():
+      if key in dispatched and result is not None:
+        on_result(key, repetition)
+
   def get_results(self, key: str, repetition: int) -> Tuple[float, str]:
     """
     Get the results (runtime, output), for a job/key.
@@ -222,6 +273,7 @@ class BatchSystemInterface:
     self.preparation_commands = {}
     self.timed_commands = {}
     self.teardown_commands = {}
+    self.array_commands = {}
     # clean up the runtime files
     U.remove_file_with_pattern(U.get_default_pira_dir(), "pira-slurm-.*")
 
@@ -230,6 +282,8 @@ class SlurmBackend(BatchSystemInterface):
   """
   Backend for the SLURM batch system runner.
   """
+  # Consecutive failed queries of the queue after which waiting for results gives up
+  MAX_FAILED_QUEUE_QUERIES = 10
 
   def __init__(self,
                backend_type: BatchSystemBackendType = BatchSystemBackendType.SLURM,
@@ -239,6 +293,11 @@ class SlurmBackend(BatchSystemInterface):
     Constructor
     """
     super(SlurmBackend, self).__init__(backend_type, interface_type, timing_type)
+    # Results that were collected while waiting, and that were not readable when their task had
+    # left the queue
+    self.collected_results = set()
+    self.missing_results = set()
+    self.failed_queue_queries = 0
 
   def get_interfaces(self) -> Type[SlurmInterfaces]:
     """
@@ -277,6 +336,82 @@ class SlurmBackend(BatchSystemInterface):
     # add command once
     self.timed_commands[key] = cmd
 
+  def cleanup(self) -> None:
+    """
+    Cleanup variables for the next run.
+    """
+    super().cleanup()
+    self.collected_results = set()
+    self.missing_results = set()
+    self.failed_queue_queries = 0
+
+  def get_array_size(self, num_commands: int) -> int:
+    """
+    Number of tasks of a command array: the repetitions given by the job array in the config,
+    for each command.
+    """
+    repetitions = len(
+        range(self.config.job_array_start, self.config.job_array_end + 1,
+              self.config.job_array_step))
+    return num_commands * repetitions
+
+  def add_timed_command_array(self,
+                              key: str,
+                              cmds: List[str],
+                              preparation_cmds: List[str] = None) -> None:
+    """
+    Add commands that run in one job array. The job array of the config gives the repetitions of
+    each command, the tasks of the first command come first.
+    """
+    self.array_commands[key] = (cmds, preparation_cmds)
+    self.job_id_map[key] = None
+    for index in range(len(cmds)):
+      for task_id in self.get_array_task_ids(key, index):
+        self.results[(key, task_id)] = None
+
+  def get_array_task_ids(self, key: str, index: int) -> List[int]:
+    """
+    Returns the Slurm array task ids of the command at index.
+    """
+    repetitions = self.get_array_size(1)
+    first = self.config.job_array_start + index * repetitions * self.config.job_array_step
+    return list(
+        range(first, first + repetitions * self.config.job_array_step, self.config.job_array_step))
+
+  def get_timed_command(self, key: str, cmd: str) -> str:
+    """
+    Wraps the command with the timing method in use.
+    """
+    if self.timing_type == BatchSystemTimingType.SUBPROCESS:
+      return f"python3 {U.get_pira_code_dir()}/lib/BatchSystemTimer.py {key} $SLURM_ARRAY_JOB_ID " \
+             f"$SLURM_ARRAY_TASK_ID {U.get_default_pira_dir()} '{cmd}'"
+    elif self.timing_type == BatchSystemTimingType.OS_TIME:
+      if cmd.startswith("mpirun"):
+        # /usr/bin/time crashed on mpi targets when command is not in quotes
+        return f"/usr/bin/time --format=%e '{cmd}'"
+      # but local commands seem to crash with it when in quotes
+      return f"/usr/bin/time --format=%e {cmd}"
+    L.get_logger().log("SlurmBackend::get_timed_command: Invalid timing_type. Exiting.",
+                       level="error")
+    U.exit(1)
+
+  def get_array_command(self, key: str) -> str:
+    """
+    A single line shell command, that runs the command of the array task: a case over the
+    index of the command that the task id belongs to.
+    """
+    cmds, preparation_cmds = self.array_commands[key]
+    repetitions = self.get_array_size(1)
+    index = f"$(( ($SLURM_ARRAY_TASK_ID - {self.config.job_array_start}) / " \
+            f"{self.config.job_array_step} / {repetitions} ))"
+    cases = []
+    for i, cmd in enumerate(cmds):
+      case = self.get_timed_command(key, cmd)
+      if preparation_cmds and preparation_cmds[i]:
+        case = f"{preparation_cmds[i]}; {case}"
+      cases.append(f"{i}) {case} ;;")
+    return f"case {index} in {' '.join(cases)} esac"
+
   def dispatch(self, key: str) -> int:
     """
     Submits the job referenced by key to the cluster via SLURM.
@@ -290,31 +425,38 @@ class SlurmBackend(BatchSystemInterface):
     # pass commands to the config
     if key in self.preparation_commands:
       self.generator.add_command(self.preparation_commands[key])
-    if key not in self.timed_commands:
+    if key not in self.timed_commands and key not in self.array_commands:
       L.get_logger().log(f"SlurmBackend::dispatch: There is no command to be added for key {key}.",
                          level="error")
     # add the timing with the command
-    if self.timing_type == BatchSystemTimingType.SUBPROCESS:
-      cmd = f"python3 {U.get_pira_code_dir()}/lib/BatchSystemTimer.py {key} $SLURM_ARRAY_JOB_ID " \
-            f"$SLURM_ARRAY_TASK_ID {U.get_default_pira_dir()} '{self.timed_commands[key]}'"
-      self.generator.add_command(cmd)
-      L.get_logger().log(f"SlurmBackend::dispatch: Added command '{cmd}'", level="debug")
-    elif self.timing_type == BatchSystemTimingType.OS_TIME:
-      if self.timed_commands[key].startswith("mpirun"):
-        # /usr/bin/time crashed on mpi targets when command is not in quotes
-        self.generator.add_command(f"/usr/bin/time --format=%e '{self.timed_commands[key]}'")
-      else:
-        # but local commands seem to crash with it when in quotes
-        self.generator.add_command(f"/usr/bin/time --format=%e {self.timed_commands[key]}")
-      L.get_logger().log(
-          f"SlurmBackend::dispatch: Added command '/usr/bin/time --format="
-          f"%e {self.timed_commands[key]}'",
-          level="debug")
+    if key in self.array_commands:
+      cmd = self.get_array_command(key)
     else:
-      L.get_logger().log("SlurmBackend::dispatch: Invalid timing_type. Exiting.", level="error")
-      U.exit(1)
+      cmd = self.get_timed_command(key, self.timed_commands[key])
+    self.generator.add_command(cmd)
+    L.get_logger().log(f"SlurmBackend::dispatch: Added command '{cmd}'", level="debug")
     if key in self.teardown_commands:
       self.generator.add_command(self.teardown_commands[key])
+    # a command array spans the repetitions of all its commands
+    array_end = self.config.job_array_end
+    if key in self.array_commands:
+      num_tasks = self.get_array_size(len(self.array_commands[key][0]))
+      self.config.job_array_end = self.config.job_array_start + (num_tasks -
+                                                                 1) * self.config.job_array_step
+    try:
+      job_id = self.submit()
+    finally:
+      self.config.job_array_end = array_end
+    # add job id to map for further processing
+    self.job_id_map[key] = job_id
+    L.get_logger().log(f"SlurmBackend::dispatch: Dispatched batch job {job_id}.", level="info")
+    return job_id
+
+  def submit(self) -> int:
+    """
+    Submits the commands of the generator, with the interface in use.
+    :return: The job_id.
+    """
     # dispatch for different methods
     if self.interface == SlurmInterfaces.PYSLURM:
       try:
@@ -326,12 +468,12 @@ class SlurmBackend(BatchSystemInterface):
       job_opts = self.generator.get_pyslurm_args()
       job_id = job_controller.submit_batch_job(job_opts)
       job_id = int(job_id)
-      L.get_logger().log(f"SlurmBackend::dispatch: Dispatched job {job_id} to slurm via PySlurm.",
+      L.get_logger().log(f"SlurmBackend::submit: Dispatched job {job_id} to slurm via PySlurm.",
                          level="debug")
       del job_controller
     elif self.interface == SlurmInterfaces.SBATCH_WAIT:
       L.get_logger().log(
-          f"SlurmBackend::dispatch: Starting execution of repetitions via sbatch --wait...",
+          f"SlurmBackend::submit: Starting execution of repetitions via sbatch --wait...",
           level="debug")
       job_id = self.generator.sbatch(script_path=self.config.slurm_script_file,
                                      active=True,
@@ -340,14 +482,11 @@ class SlurmBackend(BatchSystemInterface):
       # sbatch it
       job_id = self.generator.sbatch(script_path=self.config.slurm_script_file, active=True)
       L.get_logger().log(
-          f"SlurmBackend::dispatch: Sbatch'ed jobscript {self.config.slurm_script_file} via systems sbatch.",
+          f"SlurmBackend::submit: Sbatch'ed jobscript {self.config.slurm_script_file} via systems sbatch.",
           level="debug")
     else:
-      L.get_logger().log(f"SlurmBackend::dispatch: Interface is None. Exiting.", level="error")
-      raise RuntimeError("SlurmBackend::dispatch: Interface is None. Exiting.")
-    # add job id to map for further processing
-    self.job_id_map[key] = job_id
-    L.get_logger().log(f"SlurmBackend::dispatch: Dispatched batch job {job_id}.", level="info")
+      L.get_logger().log(f"SlurmBackend::submit: Interface is None. Exiting.", level="error")
+      raise RuntimeError("SlurmBackend::submit: Interface is None. Exiting.")
     return job_id
 
   def wait(self) -> None:
@@ -392,6 +531,70 @@ class SlurmBackend(BatchSystemInterface):
     # After waiting: Read/obtain the results, and populate the result dict with it
     self.populate_result_dict()
 
+  def wait_for_results(self, on_result: Callable[[str, Any], None]) -> None:
+    """
+    Waits for all dispatched jobs to finish, and passes the results of array tasks on as soon as
+    they are finished. Only the 'os' interface polls, the others block until all jobs finished.
+    """
+    if self.interface != SlurmInterfaces.OS:
+      super().wait_for_results(on_result)
+      return
+    dispatched = [key for key, job_id in self.job_id_map.items() if job_id is not None]
+    while True:
+      for key, repetition in self.collect_finished():
+        on_result(key, repetition)
+      if all(result_key in self.collected_results for result_key in self.results.keys()
+             if result_key[0] in dispatched):
+        break
+      time.sleep(self.config.check_interval)
+
+  def collect_finished(self) -> List[Tuple[str, int]]:
+    """
+    Reads the results of the tasks of dispatched jobs that left the queue since the last call.
+    Gives up after MAX_FAILED_QUEUE_QUERIES consecutive failed queries of the queue.
+    :return: The (key, repetition) tuples of the new results.
+    """
+    key_job_map = {key: value for key, value in self.job_id_map.items() if value is not None}
+    queued = self.generator.get_queued_array_tasks(list(key_job_map.values()))
+    if queued is None:
+      # squeue failed, try again later
+      self.failed_queue_queries += 1
+      if self.failed_queue_queries >= self.MAX_FAILED_QUEUE_QUERIES:
+        L.get_logger().log(
+            f"SlurmBackend::collect_finished: Querying the queue failed "
+            f"{self.failed_queue_queries} times in a row. Exiting.",
+            level="error")
+        raise RuntimeError("SlurmBackend::collect_finished: Querying the queue failed. Exiting.")
+      return []
+    self.failed_queue_queries = 0
+    finished = []
+    for key, repetition in self.results.keys():
+      if (key, repetition) in self.collected_results or key not in key_job_map:
+        continue
+      job_id = key_job_map[key]
+      if (str(job_id), str(repetition)) in queued:
+        continue
+      # The results of a task that just finished may not be visible on a shared file system yet
+      first_miss = (key, repetition) not in self.missing_results
+      if first_miss and not self.has_result(job_id, key, repetition):
+        self.missing_results.add((key, repetition))
+        continue
+      self.results[(key, repetition)] = self.read_result(job_id, key, repetition)
+      self.collected_results.add((key, repetition))
+      finished.append((key, repetition))
+    return finished
+
+  def get_result_file(self, job_id: int, key: str, repetition: int) -> str:
+    """
+    The file that holds the result of a task, depending on the timing method.
+    """
+    if self.timing_type == BatchSystemTimingType.SUBPROCESS:
+      return f"{U.get_default_pira_dir()}/pira-slurm-{job_id}-{key}-{repetition}.json"
+    return f"{self.config.std_err_path}.{job_id}_{repetition}"
+
+  def has_result(self, job_id: int, key: str, repetition: int) -> bool:
+    return U.is_file(self.get_result_file(job_id, key, repetition))
+
   def populate_result_dict(self) -> None:
     """
     Read the output and runtime from the run methods' results.
@@ -407,57 +610,53 @@ class SlurmBackend(BatchSystemInterface):
       L.get_logger().log("SlurmBackend::populate_result_dict: Timing method is: " +
                          str(self.timing_type),
                          level="debug")
-      if self.timing_type == BatchSystemTimingType.SUBPROCESS:
-        # for all repetitions of the job_key
-        for key, repetition in [(k, r) for (k, r) in self.results.keys() if k == job_key]:
+      # for all repetitions of the job_key
+      for key, repetition in [(k, r) for (k, r) in self.results.keys() if k == job_key]:
+        self.results[(key, repetition)] = self.read_result(job_id, key, repetition)
+
+  def read_result(self, job_id: int, key: str, repetition: int) -> Union[None, Tuple[float, str]]:
+    """
+    Read the output and runtime of one repetition of a job.
+    :return: The tuple of (runtime, output), or None if the result file is incomplete.
+    """
+    result_file = self.get_result_file(job_id, key, repetition)
+    if self.timing_type == BatchSystemTimingType.SUBPROCESS:
+      try:
+        with open(result_file, "r") as f:
           try:
-            with open(f"{U.get_default_pira_dir()}/pira-slurm-{job_id}-{key}-{repetition}.json",
-                      "r") as f:
-              try:
-                result_dict = json.load(f)
-                self.results[(key,
-                              repetition)] = float(result_dict["elapsed"]), result_dict["output"]
-              except KeyError:
-                L.get_logger().log(
-                    f"SlurmBackend::populate_result_dict: Failed to read results for "
-                    f"key {key}, repetition {repetition} from json result file.",
-                    level="error")
-          except FileNotFoundError:
+            result_dict = json.load(f)
+            return float(result_dict["elapsed"]), result_dict["output"]
+          except KeyError:
             L.get_logger().log(
-                f"SlurmBackend::populate_result_dict: Opening runtime json "
-                f"file failed: {U.get_default_pira_dir()}/pira-"
-                f"slurm-{job_id}-{key}-{repetition}.json. Exiting.",
+                f"SlurmBackend::read_result: Failed to read results for "
+                f"key {key}, repetition {repetition} from json result file.",
                 level="error")
-            raise RuntimeError(
-                f"SlurmBackend::populate_result_dict: Reading runtime from runtime json "
-                f"file failed: {U.get_default_pira_dir()}/pira-"
-                f"slurm-{job_id}-{key}-{repetition}.json. Exiting.")
-      elif self.timing_type == BatchSystemTimingType.OS_TIME:
-        # for all repetitions of the job_key
-        for key, repetition in [(k, r) for (k, r) in self.results.keys() if k == job_key]:
+            return None
+      except FileNotFoundError:
+        L.get_logger().log(
+            f"SlurmBackend::read_result: Opening runtime json file failed: {result_file}. Exiting.",
+            level="error")
+        raise RuntimeError(f"SlurmBackend::read_result: Reading runtime from runtime json "
+                           f"file failed: {result_file}. Exiting.")
+    elif self.timing_type == BatchSystemTimingType.OS_TIME:
+      try:
+        with open(result_file, "r") as f:
+          lines = f.readlines()
           try:
-            with open(f"{self.config.std_err_path}.{job_id}_{repetition}", "r") as f:
-              lines = f.readlines()
-              try:
-                runtime = float(lines[-1].strip())
-              except (ValueError, IndexError):
-                L.get_logger().log(
-                    f"SlurmBackend::populate_result_dict: Reading runtime from out-file "
-                    f"failed: {self.config.std_out_path}.{job_id}_{repetition}. Exiting.",
-                    level="error")
-                raise RuntimeError(
-                    f"SlurmBackend::populate_result_dict: Reading runtime from out-file "
-                    f"failed: {self.config.std_out_path}.{job_id}_{repetition}. Exiting.")
-              self.results[(key, repetition)] = runtime, "\n".join(lines[:-1])
-          except FileNotFoundError:
+            runtime = float(lines[-1].strip())
+          except (ValueError, IndexError):
             L.get_logger().log(
-                f"SlurmBackend::populate_result_dict: Opening out-file "
-                f"failed: {self.config.std_err_path}.{job_id}_{repetition}. Exiting.",
+                f"SlurmBackend::read_result: Reading runtime from out-file "
+                f"failed: {result_file}. Exiting.",
                 level="error")
-            raise RuntimeError(
-                f"SlurmBackend::populate_result_dict: Opening "
-                f"out-file failed: {self.config.std_err_path}.{job_id}_{repetition}. Exiting.")
-      else:
-        L.get_logger().log(f"SlurmBackend::populate_result_dict: Timing type is None. Exiting.",
+            raise RuntimeError(f"SlurmBackend::read_result: Reading runtime from out-file "
+                               f"failed: {result_file}. Exiting.")
+          return runtime, "\n".join(lines[:-1])
+      except FileNotFoundError:
+        L.get_logger().log(f"SlurmBackend::read_result: Opening out-file failed: {result_file}.",
                            level="error")
-        raise RuntimeError("SlurmBackend::populate_result_dict: Timing type is None. Exiting.")
+        raise RuntimeError(
+            f"SlurmBackend::read_result: Opening out-file failed: {result_file}. Exiting.")
+    else:
+      L.get_logger().log(f"SlurmBackend::read_result: Timing type is None. Exiting.", level="error")
+      raise RuntimeError("SlurmBackend::read_result: Timing type is None. Exiting.")
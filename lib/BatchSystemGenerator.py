@@ -8,7 +8,7 @@ import math
 import os
 import subprocess
 import time
-from typing import Optional, List, Union, Dict
+from typing import Optional, List, Union, Dict, Set, Tuple
 
 import lib.Logging as L
 import lib.Utility as U
@@ -634,6 +634,31 @@ class SlurmGenerator(BatchSystemGenerator):
       del map, log
     return finished
 
+  def get_queued_array_tasks(self, job_ids: List[int]) -> Optional[Set[Tuple[str, str]]]:
+    """
+    Returns the tasks of the jobs that are pending or running, as tuples of (job id, array task id).
+    Pending tasks of job arrays are listed one by one; the task id of a job that is no array is
+    "N/A".
+    :param job_ids: The job ids to check for.
+    :return: The set of tuples, or None if squeue failed.
+    """
+    if not job_ids:
+      return set()
+    # Not with --jobs: squeue fails for the ids of jobs that Slurm already purged
+    sq = subprocess.run(["squeue", "--array", "--noheader", "--format=%F %K"],
+                        stdout=subprocess.PIPE,
+                        stderr=subprocess.DEVNULL)
+    if sq.returncode != 0:
+      L.get_logger().log("SlurmGenerator::get_queued_array_tasks: squeue failed.", level="warn")
+      return None
+    job_ids = {str(job_id) for job_id in job_ids}
+    tasks = set()
+    for line in sq.stdout.decode("utf-8").splitlines():
+      fields = line.split()
+      if len(fields) == 2 and fields[0] in job_ids:
+        tasks.add((fields[0], fields[1]))
+    return tasks
+
   def wait(self, job_id: int = None, job_ids: List[int] = None) -> None:
     """
     Wait for the SLURM job given by job_id, or for the list of SLURM jobs given by job_ids to finish.
@@ -60,8 +60,10 @@ class BatchSystemTimer:
     Export results to the json file.
     """
     filename = f"{self.export_path}/pira-slurm-{self.job_id}-{self.key}-{self.job_array_id}.json"
-    with open(filename, "w") as f:
+    # PIRA reads the results while other tasks of the array still run, it must not see partial files
+    with open(filename + ".tmp", "w") as f:
       json.dump(res, f, indent=4)
+    os.replace(filename + ".tmp", filename)
 
 
 if __name__ == "__main__":
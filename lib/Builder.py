@@ -12,6 +12,7 @@ from lib.Configuration import TargetConfig, InvocationConfig
 from lib.Measurement import ScorepSystemHelper
 from lib.Exception import PiraException
 
+import json
 import typing
 
 
@@ -36,6 +37,7 @@ class Builder:
     self.build_instr = instrument
     self.instrumentation_file = instr_file
     self.error = None
+    self._build_state = None
 
   def build(self) -> None:
     try:
@@ -103,6 +105,94 @@ class Builder:
     L.get_logger().log('Builder::construct_pira_keywords Returning.', level='debug')
     return kwargs
 
+  def use_incremental_rebuild(self) -> bool:
+    invoc_cfg = InvocationConfig.get_instance()
+    return invoc_cfg.use_incremental_rebuild() and invoc_cfg.is_compile_time_filtering()
+
+  def get_manifest_dir(self) -> str:
+    return U.build_manifest_dir(self.directory, self.target_config.get_target(),
+                                self.target_config.get_flavor())
+
+  def prepare_incremental_build(self, kwargs) -> bool:
+    """
+    Lets the instrumentation plugin write a manifest per translation unit. If the previous build was
+    instrumented with the same settings, touches the sources whose instrumentation changes with the
+    new instrumentation file, so that the build system recompiles only those.
+    Returns whether the clean step can be skipped.
+    """
+    manifest_dir = self.get_manifest_dir()
+    state_file = U.build_manifest_state_path(manifest_dir)
+    U.set_env('PIRA_INSTR_MANIFEST_DIR', manifest_dir)
+
+    names = U.read_instr_file_names(self.instrumentation_file)
+    settings = U.get_env_with_prefix('PIRA_INSTR_')
+    settings['CC'] = kwargs['CC']
+    settings['CXX'] = kwargs['CXX']
+    self._build_state = {'names': sorted(names), 'settings': settings}
+
+    previous_state = json.loads(U.read_file(state_file)) if U.is_file(state_file) else None
+    # Not valid until this build succeeded
+    U.remove_file(state_file)
+    if previous_state is None or previous_state['settings'] != settings:
+      L.get_logger().log('Builder::prepare_incremental_build: No previous build with the same '
+                         'settings, rebuilding everything.')
+      U.remove_dir(manifest_dir)
+      U.make_dirs(manifest_dir)
+      return False
+
+    changed_names = names.symmetric_difference(previous_state['names'])
+    manifests = U.read_instrumentation_manifests(manifest_dir)
+    sources = U.get_sources_to_rebuild(manifests, changed_names)
+    missing = [source for source in sources if not U.is_file(source)]
+    if missing:
+      L.get_logger().log('Builder::prepare_incremental_build: Sources ' + ', '.join(missing) +
+                         ' do not exist, rebuilding everything.',
+                         level='warn')
+      U.remove_dir(manifest_dir)
+      U.make_dirs(manifest_dir)
+      return False
+
+    # The recompiled translation units write new manifests
+    for manifest_file, manifest in manifests:
+      if manifest['source'] in sources:
+        U.remove_file(manifest_file)
+    for source in sources:
+      U.touch_file(source)
+    units = {manifest['source'] for _, manifest in manifests}
+    L.get_logger().log('Builder::prepare_incremental_build: ' + str(len(changed_names)) +
+                       ' changed names, recompiling ' + str(len(sources)) + ' of ' +
+                       str(len(units)) + ' translation units.')
+    return True
+
+  def get_remarks_dir(self) -> str:
+    return U.build_remarks_dir(self.directory, self.target_config.get_target(),
+                               self.target_config.get_flavor())
+
+  def get_features_dir(self) -> str:
+    return U.build_features_dir(self.directory, self.target_config.get_target(),
+                                self.target_config.get_flavor())
+
+  def write_instrumentation_report(self, iteration: int) -> str:
+    """
+    Combines the remarks that the instrumentation plugin wrote per translation unit into the report
+    of the iteration. Returns the report file.
+    """
+    report = U.summarize_instrumentation_remarks(
+        U.read_instrumentation_remarks(self.get_remarks_dir()))
+    report['iteration'] = iteration
+    report_file = U.build_instrumentation_report_path(self.instrumentation_file, iteration)
+    U.write_file(report_file, json.dumps(report, indent=2))
+    L.get_logger().log('[INSTRUMENTED] $' + str(iteration) + '$ ' +
+                       str(sum(report['instrumented'].values())),
+                       level='perf')
+    L.get_logger().log('[SKIPPED] $' + str(iteration) + '$ ' + str(sum(report['skipped'].values())),
+                       level='perf')
+    return report_file
+
+  def finish_incremental_build(self) -> None:
+    manifest_dir = self.get_manifest_dir()
+    U.write_file(U.build_manifest_state_path(manifest_dir), json.dumps(self._build_state))
+
   def check_build_prerequisites(self) -> None:
     return
     ScorepSystemHelper.check_build_prerequisites()
@@ -130,12 +220,41 @@ class Builder:
         L.get_logger().log('Builder::build_flavors: Runtime filtering enabled.')
         self.target_config.set_instr_file(self.instrumentation_file)
 
+      if InvocationConfig.get_instance().use_runtime_guards():
+        L.get_logger().log('Builder::build_flavors: Runtime guards enabled.')
+        U.set_env('PIRA_INSTR_RUNTIME_GUARDS', '1')
+
+      overhead_budget = InvocationConfig.get_instance().get_overhead_budget()
+      if overhead_budget > 0 and self.instrumentation_file is not None:
+        report_file = U.build_overhead_report_path(self.instrumentation_file)
+        L.get_logger().log('Builder::build_flavors: Overhead budget of ' + str(overhead_budget) +
+                           '%, report in ' + report_file)
+        # The plugin appends to the report, start a new one with every build
+        U.remove_file(report_file)
+        U.set_env('PIRA_INSTR_OVERHEAD_BUDGET', str(overhead_budget))
+        U.set_env('PIRA_INSTR_OVERHEAD_REPORT', report_file)
+
+      if InvocationConfig.get_instance().use_instrumentation_report():
+        L.get_logger().log('Builder::build_flavors: Instrumentation remarks in ' +
+                           self.get_remarks_dir())
+        U.set_env('PIRA_INSTR_REMARKS_DIR', self.get_remarks_dir())
+
+      # The call graph is built from the vanilla build only
+      U.unset_env('PIRA_INSTR_FEATURES_DIR')
+
       build_functor = f_man.get_or_load_functor(build, benchmark, flavor, 'build')
       kwargs = self.construct_pira_instr_kwargs()
       ScorepSystemHelper.prepare_MPI_filtering(self.instrumentation_file)
 
     else:
       L.get_logger().log('Builder::build_flavors: No instrumentation', level='debug')
+      if self.use_incremental_rebuild():
+        # The objects of the next instrumented build can not be reused
+        U.remove_dir(self.get_manifest_dir())
+      if InvocationConfig.get_instance().use_call_graph_from_build():
+        L.get_logger().log('Builder::build_flavors: Function features in ' +
+                           self.get_features_dir())
+        U.set_env('PIRA_INSTR_FEATURES_DIR', self.get_features_dir())
       build_functor = f_man.get_or_load_functor(build, benchmark, flavor, 'basebuild')
       kwargs = self.construct_pira_kwargs()
 
@@ -149,12 +268,25 @@ class Builder:
         ''' The build command uses CC and CXX to pass flags that are needed by PIRA for the given toolchain. '''
         build_command = build_functor.passive(benchmark, **kwargs)
         clean_command = clean_functor.passive(benchmark, **kwargs)
-        L.get_logger().log('Builder::build_flavors: Clean in ' + benchmark + '\n  Using ' +
-                           clean_command,
-                           level='debug')
-        U.shell(clean_command)
+        incremental = self.build_instr and self.use_incremental_rebuild()
+        if incremental and self.prepare_incremental_build(kwargs):
+          L.get_logger().log('Builder::build_flavors: Incremental build, skipping the clean step',
+                             level='debug')
+        else:
+          L.get_logger().log('Builder::build_flavors: Clean in ' + benchmark + '\n  Using ' +
+                             clean_command,
+                             level='debug')
+          U.shell(clean_command)
+          if self.build_instr:
+            # Every translation unit writes its remarks again
+            U.remove_dir(self.get_remarks_dir())
+          elif InvocationConfig.get_instance().use_call_graph_from_build():
+            # Every translation unit writes its features again
+            U.remove_dir(self.get_features_dir())
         L.get_logger().log('Builder::build_flavors: Building: ' + build_command, level='debug')
         U.shell(build_command)
+        if incremental:
+          self.finish_incremental_build()
 
       except Exception as e:
         L.get_logger().log('Builder::build_flavors: ' + str(e), level='error')
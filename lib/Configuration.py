@@ -33,6 +33,7 @@ class PiraItem:
     self._functor_base_path = None
     self._mode = None
     self._run_options = None
+    self._resources = (0, 0)
 
   def __str__(self):
     return '[PiraItem] ' + self._name
@@ -67,6 +68,9 @@ class PiraItem:
   def get_run_options(self):
     return self._run_options
 
+  def get_resources(self) -> typing.Tuple[int, float]:
+    return self._resources
+
   def set_base_path(self, path: str) -> None:
     self._base_path = path
 
@@ -88,6 +92,9 @@ class PiraItem:
   def set_run_options(self, run_opts) -> None:
     self._run_options = run_opts
 
+  def set_resources(self, cores: int, memory: float) -> None:
+    self._resources = (cores, memory)
+
 
 class PiraConfigII:
 
@@ -197,6 +204,11 @@ class PiraConfigAdapter:
     io = self.get_item_w_name(build, item)
     return io.get_run_options().as_list()
 
+  def get_resources(self, build, item) -> typing.Tuple[int, float]:
+    """ The cores and the memory in GiB that the item declares, 0 if it declares none """
+    io = self.get_item_w_name(build, item)
+    return io.get_resources()
+
   def is_empty(self) -> bool:
     return self._pcii.is_empty()
 
@@ -302,6 +314,10 @@ class PiraConfig:
   def get_args(self, b: str, it: str) -> typing.List[typing.List[str]]:
     return [self.items[b][it]['args']]
 
+  def get_resources(self, b: str, it: str) -> typing.Tuple[int, float]:
+    # Version 1 configurations declare no resources
+    return (0, 0)
+
   def get_cleaner_path(self, b: str, i: str) -> str:
     return self.items[b][i]['builders']
 
@@ -503,8 +519,24 @@ class InvocationConfig:
       self._slurm_config_path = cmdline_args.slurm_config
       self._config_version = cmdline_args.config_version
       self._config_path = cmdline_args.config
+      self._runtime_guards = cmdline_args.runtime_guards
+      self._overhead_budget = cmdline_args.overhead_budget
+      self._incremental_rebuild = cmdline_args.incremental_rebuild
+      self._local_concurrency = cmdline_args.local_concurrency
+      self._cores_per_run = cmdline_args.cores_per_run
+      self._interference_tolerance = cmdline_args.interference_tolerance
+      self._confidence_width = cmdline_args.confidence_width
+      self._min_repetitions = cmdline_args.min_repetitions
+      self._overlap_builds = cmdline_args.overlap_builds
+      self._reuse_baseline = cmdline_args.reuse_baseline
+      self._instrumentation_report = cmdline_args.instrumentation_report
+      self._call_graph_from_build = cmdline_args.call_graph_from_build
+      self._concurrent_targets = cmdline_args.concurrent_targets
+      self._core_budget = cmdline_args.core_budget
+      self._memory_budget = cmdline_args.memory_budget
       self._compile_time_filtering = not (cmdline_args.runtime_filter or
-                                          (cmdline_args.hybrid_filter_iters != 0))
+                                          (cmdline_args.hybrid_filter_iters != 0)
+                                          or self._runtime_guards)
       self._pira_iters = cmdline_args.iterations
       self._repetitions = cmdline_args.repetitions
       self._hybrid_filter_iters = cmdline_args.hybrid_filter_iters
@@ -519,6 +551,8 @@ class InvocationConfig:
     if self.is_hybrid_filtering():
       cf_str = 'hybrid filtering: rebuilding every ' + str(
           self.get_hybrid_filter_iters()) + ' iterations'
+    if self.use_runtime_guards():
+      cf_str = 'runtime guards: building once'
     if self.is_compile_time_filtering():
       cf_str = 'compiletime filtering'
     return 'Running PIRA in ' + cf_str + ' with configuration\n ' + str(self.get_path_to_cfg())
@@ -535,6 +569,21 @@ class InvocationConfig:
                                config=U.get_default_config_file(),
                                runtime_filter=False,
                                hybrid_filter_iters=0,
+                               runtime_guards=False,
+                               overhead_budget=0,
+                               incremental_rebuild=False,
+                               local_concurrency=1,
+                               cores_per_run=0,
+                               interference_tolerance=10,
+                               confidence_width=0,
+                               min_repetitions=2,
+                               overlap_builds=False,
+                               reuse_baseline=False,
+                               instrumentation_report=False,
+                               call_graph_from_build=False,
+                               concurrent_targets=1,
+                               core_budget=0,
+                               memory_budget=0,
                                iterations=4,
                                repetitions=5,
                                export=False,
@@ -555,6 +604,21 @@ class InvocationConfig:
       instance._pira_iters = 4
       instance._repetitions = 3
       instance._hybrid_filter_iters = 0
+      instance._runtime_guards = False
+      instance._overhead_budget = 0
+      instance._incremental_rebuild = False
+      instance._local_concurrency = 1
+      instance._cores_per_run = 0
+      instance._interference_tolerance = 10
+      instance._confidence_width = 0
+      instance._min_repetitions = 2
+      instance._overlap_builds = False
+      instance._reuse_baseline = False
+      instance._instrumentation_report = False
+      instance._call_graph_from_build = False
+      instance._concurrent_targets = 1
+      instance._core_budget = 0
+      instance._memory_budget = 0
       instance._export = False
       instance._export_runtime_only = False
       instance._lide = False
@@ -594,9 +658,51 @@ class InvocationConfig:
     if args.get('config_version') != None:
       instance._config_version = args['config_version']
 
+    if args.get('runtime_guards') != None:
+      instance._runtime_guards = args['runtime_guards']
+
+    if args.get('overhead_budget') != None:
+      instance._overhead_budget = args['overhead_budget']
+
+    if args.get('incremental_rebuild') != None:
+      instance._incremental_rebuild = args['incremental_rebuild']
+
+    if args.get('local_concurrency') != None:
+      instance._local_concurrency = args['local_concurrency']
+
+    if args.get('cores_per_run') != None:
+      instance._cores_per_run = args['cores_per_run']
+
+    if args.get('interference_tolerance') != None:
+      instance._interference_tolerance = args['interference_tolerance']
+
+    if args.get('confidence_width') != None:
+      instance._confidence_width = args['confidence_width']
+
+    if args.get('min_repetitions') != None:
+      instance._min_repetitions = args['min_repetitions']
+
+    if args.get('overlap_builds') != None:
+      instance._overlap_builds = args['overlap_builds']
+    if args.get('reuse_baseline') != None:
+      instance._reuse_baseline = args['reuse_baseline']
+    if args.get('instrumentation_report') != None:
+      instance._instrumentation_report = args['instrumentation_report']
+    if args.get('call_graph_from_build') != None:
+      instance._call_graph_from_build = args['call_graph_from_build']
+    if args.get('concurrent_targets') != None:
+      instance._concurrent_targets = args['concurrent_targets']
+    if args.get('core_budget') != None:
+      instance._core_budget = args['core_budget']
+    if args.get('memory_budget') != None:
+      instance._memory_budget = args['memory_budget']
+
     if args.get('hybrid_filter_iters') != None and args.get('runtime_filter') != None:
       instance._compile_time_filtering = not (args['runtime_filter'] or
-                                              (args['hybrid_filter_iters'] != 0))
+                                              (args['hybrid_filter_iters'] != 0)
+                                              or instance._runtime_guards)
+    elif instance._runtime_guards:
+      instance._compile_time_filtering = False
 
     if args.get('iterations') != None:
       instance._pira_iters = args['iterations']
@@ -637,6 +743,59 @@ class InvocationConfig:
   def is_hybrid_filtering(self) -> bool:
     return not self.get_hybrid_filter_iters() == 0
 
+  def use_runtime_guards(self) -> bool:
+    return self._runtime_guards
+
+  def get_overhead_budget(self) -> float:
+    return self._overhead_budget
+
+  def use_incremental_rebuild(self) -> bool:
+    return self._incremental_rebuild
+
+  def get_local_concurrency(self) -> int:
+    return self._local_concurrency
+
+  def get_cores_per_run(self) -> int:
+    return self._cores_per_run
+
+  def get_interference_tolerance(self) -> float:
+    return self._interference_tolerance
+
+  def use_adaptive_repetitions(self) -> bool:
+    return self._confidence_width > 0
+
+  def get_confidence_width(self) -> float:
+    return self._confidence_width
+
+  def get_min_repetitions(self) -> int:
+    """ The fewest repetitions, the number of repetitions is the maximum with adaptive repetitions """
+    if not self.use_adaptive_repetitions():
+      return self._repetitions
+    return max(1, min(self._min_repetitions, self._repetitions))
+
+  def overlap_builds(self) -> bool:
+    return self._overlap_builds
+
+  def reuse_baseline(self) -> bool:
+    return self._reuse_baseline
+
+  def use_instrumentation_report(self) -> bool:
+    return self._instrumentation_report
+
+  def use_call_graph_from_build(self) -> bool:
+    return self._call_graph_from_build
+
+  def get_concurrent_targets(self) -> int:
+    return self._concurrent_targets
+
+  def get_core_budget(self) -> int:
+    """ Cores for the targets that run concurrently, 0 for all cores that PIRA may use """
+    return self._core_budget
+
+  def get_memory_budget(self) -> float:
+    """ Memory in GiB for the targets that run concurrently, 0 for the physical memory """
+    return self._memory_budget
+
   def get_pira_iters(self) -> int:
     return self._pira_iters
 
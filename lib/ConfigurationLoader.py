@@ -206,6 +206,7 @@ class SimplifiedConfigurationLoader:
     flavors = item_tree[item_key]['flavors']
     functors_base_path = item_tree[item_key]['functors']
     mode = item_tree[item_key]['mode']
+    resources = item_tree[item_key].get('resources', {})
 
     run_opts = self.get_parameter(item_tree, item_key)
 
@@ -222,6 +223,7 @@ class SimplifiedConfigurationLoader:
     pira_item.set_functors_base_path(functors_base_path)
     pira_item.set_mode(mode)
     pira_item.set_run_options(run_options)
+    pira_item.set_resources(int(resources.get('cores', 0)), float(resources.get('memory', 0)))
 
     return pira_item
 
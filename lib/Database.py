@@ -14,6 +14,8 @@ import lib.tables as T
 from lib.Exception import PiraException
 
 import sqlite3 as db
+import time
+import typing
 
 
 class DBException(PiraException):
@@ -34,11 +36,11 @@ class DBManager:
     Takes care of the actual database connection.
     """
 
-    def __init__(self, name):
+    def __init__(self, name, timeout: float = 5.0):
       self.conn = None
       self.cursor = None
       try:
-        self.conn = db.connect(name)
+        self.conn = db.connect(name, timeout=timeout)
       except Exception:
         raise DBException('Error in creating the database / connection')
 
@@ -119,6 +121,45 @@ class DBManager:
 
       return db_item_id
 
+    def create_run_history(self) -> None:
+      self.create_table(T.create_run_history_table)
+      self.create_table(T.create_run_history_index)
+
+    def insert_run_series(
+        self, series: typing.List[typing.Tuple[str, str, int, typing.List[float]]]) -> None:
+      """
+      Stores measurement series in the run history, all of them in one transaction.
+
+      :series: tuples of run key, kind ('baseline' or 'profile'), iteration and the runtimes
+      """
+      self.create_run_history()
+      created = time.time()
+      rows = []
+      for run_key, kind, iteration, runtimes in series:
+        series_id = U.generate_random_string()
+        for repetition, runtime in enumerate(runtimes):
+          rows.append((run_key, series_id, kind, iteration, repetition, runtime, created))
+      sql = ''' INSERT INTO RunHistory(Run_Key,Series_ID,Kind,Iteration,Repetition,Runtime,Created)
+                VALUES(?,?,?,?,?,?,?) '''
+      with self.conn:
+        self.cursor.executemany(sql, rows)
+
+    def get_latest_run_series(self, run_key: str, kind: str) -> typing.List[float]:
+      """
+      Returns the runtimes of the latest series of run key and kind, empty if there is none.
+      """
+      self.create_run_history()
+      self.cursor.execute(
+          ''' SELECT Series_ID FROM RunHistory WHERE Run_Key=? AND Kind=?
+              ORDER BY Created DESC, rowid DESC LIMIT 1 ''', (run_key, kind))
+      row = self.cursor.fetchone()
+      if row is None:
+        return []
+      self.cursor.execute(
+          ''' SELECT Runtime FROM RunHistory WHERE Run_Key=? AND Series_ID=?
+              ORDER BY Repetition ''', (run_key, row[0]))
+      return [row[0] for row in self.cursor.fetchall()]
+
     def enter_run_data(self, unique_id: str, item_name: str, iteration_no: int,
                        is_instrumented_run: bool, path_to_cube: str, runtime: float,
                        db_item_id) -> None:
@@ -130,10 +171,24 @@ class DBManager:
   db_ext = 'sqlite'
 
   instance = None
+  # Connections of the parent process in a forked one, see reopen
+  inherited = []
 
   def __init__(self, dbname):
     if not DBManager.instance:
       DBManager.instance = DBManager.DBImpl(dbname)
 
+  @staticmethod
+  def reopen(dbname):
+    """
+    Opens a connection of its own in a forked process. The inherited connection stays open and
+    unused, closing it in the child is not safe for the parent. Processes that write at the same
+    time wait up to a minute for each other.
+    """
+    if DBManager.instance:
+      DBManager.inherited.append(DBManager.instance)
+    DBManager.instance = DBManager.DBImpl(dbname, timeout=60.0)
+    return DBManager(dbname)
+
   def __getattr__(self, name):
     return getattr(self.instance, name)
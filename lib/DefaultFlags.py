@@ -64,8 +64,14 @@ class BackendDefaults:
     def get_wrap_so_file(self) -> str:
       return os.path.join(self.pira_dir, 'PIRA_MPI_Filter.so')
 
+    def get_MPI_filter_file(self) -> str:
+      # One per process, the targets that run concurrently measure different MPI functions
+      return os.path.join(self.pira_dir, 'pira-mpi-filter-' + str(os.getpid()) + '.txt')
+
     def get_MPI_wrap_LD_PRELOAD(self) -> str:
-      return 'LD_PRELOAD=' + self.get_wrap_so_file()
+      # The filter library reads the measured MPI functions from PIRA_MPI_FILTER
+      filter_env = 'PIRA_MPI_FILTER=' + self.get_MPI_filter_file()
+      return filter_env + ' LD_PRELOAD=' + self.get_wrap_so_file()
 
   instance = None
 
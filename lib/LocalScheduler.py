@@ -0,0 +1,178 @@
+"""
+File: LocalScheduler.py
+License: Part of the PIRA project. Licensed under BSD 3 clause license. See LICENSE.txt file at https://github.com/tudasc/pira
+Description: Runs independent measurement runs concurrently on disjoint, pinned core sets of the local machine.
+"""
+
+import lib.Logging as L
+from lib.Exception import PiraException
+
+import glob
+import os
+import subprocess
+import time
+import typing
+
+
+class LocalSchedulerException(PiraException):
+
+  def __init__(self, message):
+    super().__init__(message)
+
+
+class LocalJob:
+  """
+  One invocation of the target: the shell command, and the environment variables that differ from
+  the environment of PIRA.
+  """
+
+  def __init__(self, command: str, cwd: str, env: typing.Dict[str, str] = None) -> None:
+    self.command = command
+    self.cwd = cwd
+    self.env = env if env is not None else {}
+    self.runtime = .0
+    self.cores = []
+
+
+def parse_cpu_list(cpu_list: str) -> typing.List[int]:
+  """ Parses a Linux cpu list, e.g., '0-3,8,10-11' """
+  cores = []
+  for part in cpu_list.strip().split(','):
+    if not part:
+      continue
+    if '-' in part:
+      first, last = part.split('-')
+      cores += range(int(first), int(last) + 1)
+    else:
+      cores.append(int(part))
+  return cores
+
+
+def get_numa_nodes() -> typing.List[typing.List[int]]:
+  """
+  Returns the cores that PIRA may use, grouped by NUMA node. Without NUMA information, all cores
+  form one node.
+  """
+  available = os.sched_getaffinity(0)
+  nodes = []
+  for node_file in sorted(glob.glob('/sys/devices/system/node/node*/cpulist')):
+    with open(node_file) as f:
+      cores = [c for c in parse_cpu_list(f.read()) if c in available]
+    if cores:
+      nodes.append(cores)
+  if not nodes:
+    nodes = [sorted(available)]
+  return nodes
+
+
+def partition_cores(nodes: typing.List[typing.List[int]], slots: int,
+                    cores_per_run: int) -> typing.List[typing.List[int]]:
+  """
+  Splits the cores into at most slots disjoint sets of cores_per_run cores (0: as many as divide
+  the cores evenly). Sets do not span NUMA nodes as long as the nodes are large enough.
+  """
+  num_cores = sum(len(cores) for cores in nodes)
+  if cores_per_run <= 0:
+    cores_per_run = max(1, num_cores // slots)
+
+  core_sets = []
+  leftover = []
+  for cores in nodes:
+    whole_sets = len(cores) // cores_per_run
+    for i in range(whole_sets):
+      core_sets.append(cores[i * cores_per_run:(i + 1) * cores_per_run])
+    leftover += cores[whole_sets * cores_per_run:]
+  # Sets from the remaining cores of several nodes
+  while len(leftover) >= cores_per_run:
+    core_sets.append(leftover[:cores_per_run])
+    leftover = leftover[cores_per_run:]
+  return core_sets[:slots]
+
+
+class LocalScheduler:
+  """
+  Runs jobs concurrently, every job pinned to a set of cores that no other running job uses.
+  The children of a job, e.g., the processes of mpirun, inherit its cores. Memory is allocated on
+  the NUMA node of the cores by the first-touch policy of the OS.
+  """
+
+  def __init__(self, max_concurrent: int, cores_per_run: int = 0) -> None:
+    if max_concurrent < 1:
+      raise LocalSchedulerException('LocalScheduler: At least one job has to run at a time')
+    self._core_sets = partition_cores(get_numa_nodes(), max_concurrent, cores_per_run)
+    if not self._core_sets:
+      raise LocalSchedulerException('LocalScheduler: Not enough cores for ' + str(cores_per_run) +
+                                    ' cores per run')
+    if len(self._core_sets) < max_concurrent:
+      L.get_logger().log('LocalScheduler: Only ' + str(len(self._core_sets)) +
+                         ' disjoint core sets, running at most as many jobs at a time',
+                         level='warn')
+
+  def get_max_concurrent(self) -> int:
+    return len(self._core_sets)
+
+  def get_core_sets(self) -> typing.List[typing.List[int]]:
+    return self._core_sets
+
+  def run(self, jobs: typing.List[LocalJob]) -> typing.List[LocalJob]:
+    """
+    Runs the jobs and sets their wall time. Returns once all of them have finished; raises if one
+    of them failed.
+    """
+    free_sets = list(self._core_sets)
+    pending = list(jobs)
+    running = {}
+    failed = []
+
+    while pending or running:
+      while pending and free_sets:
+        job = pending.pop(0)
+        job.cores = free_sets.pop(0)
+        env = dict(os.environ)
+        env.update(job.env)
+        L.get_logger().log('LocalScheduler::run: Running on cores ' + str(job.cores) + ': ' +
+                           job.command,
+                           level='debug')
+        # Forked from this thread only, which makes setting the affinity in the child safe
+        cores = job.cores
+        process = subprocess.Popen(job.command,
+                                   shell=True,
+                                   cwd=job.cwd,
+                                   env=env,
+                                   stdout=subprocess.DEVNULL,
+                                   stderr=subprocess.DEVNULL,
+                                   preexec_fn=lambda: os.sched_setaffinity(0, cores))
+        running[process.pid] = (process, job, time.perf_counter())
+
+      pid, status = os.waitpid(-1, 0)
+      if pid not in running:
+        continue
+      process, job, start = running.pop(pid)
+      job.runtime = time.perf_counter() - start
+      # Set, so that the Popen object does not wait for the reaped process
+      if os.WIFSIGNALED(status):
+        process.returncode = -os.WTERMSIG(status)
+      else:
+        process.returncode = os.WEXITSTATUS(status)
+      free_sets.append(job.cores)
+      if process.returncode != 0:
+        L.get_logger().log('LocalScheduler::run: Job failed with exit code ' +
+                           str(process.returncode) + ': ' + job.command,
+                           level='error')
+        failed.append(job)
+
+    if failed:
+      raise LocalSchedulerException('LocalScheduler::run: ' + str(len(failed)) + ' of ' +
+                                    str(len(jobs)) + ' jobs failed')
+    return jobs
+
+
+def check_interference(reference: float, concurrent: typing.List[float], tolerance: float) -> bool:
+  """
+  Compares the runtimes of concurrent runs with the one of a serial run of the same
+  configuration. Returns whether their mean exceeds the reference by more than tolerance percent.
+  """
+  if not concurrent or reference <= 0:
+    return False
+  mean = sum(concurrent) / len(concurrent)
+  return (mean - reference) / reference * 100 > tolerance
@@ -10,6 +10,7 @@ import lib.DefaultFlags as D
 from lib.Configuration import PiraConfig, TargetConfig, InstrumentConfig, InvocationConfig
 from lib.Exception import PiraException
 
+import fcntl
 import typing
 import os
 import re
@@ -23,6 +24,30 @@ class MeasurementSystemException(PiraException):
     super().__init__(message)
 
 
+# Two-sided 95% quantiles of Student's t-distribution for 1 to 30 degrees of freedom
+T_QUANTILES_95 = [
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160,
+    2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056,
+    2.052, 2.048, 2.045, 2.042
+]
+
+
+def get_relative_confidence_width(values: typing.List[float]) -> float:
+  """
+  Returns the width of the 95% confidence interval of the mean of values, in percent of the mean.
+  Infinite for less than two values.
+  """
+  if len(values) < 2:
+    return float('inf')
+  mean = stat.mean(values)
+  if mean == .0:
+    return .0 if stat.stdev(values) == .0 else float('inf')
+  degrees = len(values) - 1
+  t = T_QUANTILES_95[degrees - 1] if degrees <= len(T_QUANTILES_95) else 1.960
+  half_width = t * stat.stdev(values) / len(values)**0.5
+  return 2 * half_width / abs(mean) * 100
+
+
 class RunResultSeries:
 
   # rt is runtime, reps is the number of repetitions for one input data set, and num_data_sets is the number of different input data sets.
@@ -31,6 +56,8 @@ class RunResultSeries:
     self.rt_values = []
     self.reps = reps
     self.num_data_sets = num_data_sets
+    # Repetitions per data set, if they differ (adaptive repetitions); empty otherwise
+    self.data_set_reps = []
 
   def is_multi_value(self):
     return False
@@ -40,10 +67,25 @@ class RunResultSeries:
     self.rt_values.append(rt)
 
   def add_from(self, other) -> None:
-    assert (other.reps == self.reps)
+    if self.data_set_reps or other.data_set_reps or other.reps != self.reps:
+      # Data sets with different numbers of repetitions
+      self.data_set_reps = self.get_data_set_reps() + other.get_data_set_reps()
     for rt in other.rt_values:
       self.rt_values.append(rt)
 
+  def get_data_set_reps(self) -> typing.List[int]:
+    if self.data_set_reps:
+      return list(self.data_set_reps)
+    return [self.reps] * (len(self.rt_values) // self.reps) if self.reps else []
+
+  def get_range(self, pos: int, data_set: int) -> typing.Tuple[int, int]:
+    """ Indices of the repetitions of the data set, starting at pos """
+    if self.data_set_reps:
+      start_idx = pos + sum(self.data_set_reps[:data_set])
+      return start_idx, start_idx + self.data_set_reps[data_set]
+    start_idx = pos + data_set * self.reps
+    return start_idx, start_idx + self.reps
+
   def get_num_data_sets(self) -> int:
     return self.num_data_sets
 
@@ -54,24 +96,21 @@ class RunResultSeries:
     # [ 1 1 1, 2 2 2 ]
     if data_set > self.num_data_sets:
       raise RuntimeError('Trying to access out-of-bounds data set')
-    start_idx = pos + data_set * self.reps
-    end_idx = start_idx + self.reps
+    start_idx, end_idx = self.get_range(pos, data_set)
     L.get_logger().log('Computing mean for values: ' + str(self.rt_values[start_idx:end_idx]) +
                        ' [pos: ' + str(pos) + ' | data_set: ' + str(data_set) + ' => start_idx: ' +
                        str(start_idx) + ' <> ' + str(end_idx))
     return stat.mean(self.rt_values[start_idx:end_idx])
 
   def get_median(self, pos: int = 0, data_set: int = 0) -> float:
-    start_idx = pos + data_set * self.reps
-    end_idx = start_idx + self.reps
+    start_idx, end_idx = self.get_range(pos, data_set)
     L.get_logger().log('Computing median for values: ' + str(self.rt_values[start_idx:end_idx]))
     return stat.median(self.rt_values[start_idx:end_idx])
 
   def get_stdev(self, pos: int = 0, data_set: int = 0) -> float:
     # prevent calculation of stdev on a single data point (self.reps == 1)
-    if self.reps > 1:
-      start_idx = pos + data_set * self.reps
-      end_idx = start_idx + self.reps
+    start_idx, end_idx = self.get_range(pos, data_set)
+    if end_idx - start_idx > 1:
       L.get_logger().log('Computing stdev for values: ' + str(self.rt_values[start_idx:end_idx]))
       return stat.stdev(self.rt_values[start_idx:end_idx])
     else:
@@ -87,6 +126,8 @@ class RunResultSeries:
     return (self.get_median(pos) / base_median) - 1
 
   def get_all_averages(self) -> typing.List[float]:
+    if self.data_set_reps:
+      return [self.get_average(data_set=d) for d in range(len(self.data_set_reps))]
     if len(self.rt_values) % self.reps != 0:
       raise RuntimeError('number of runtime values must be cleanly divisable by num reps.')
     num_averages = len(self.rt_values) / self.reps
@@ -219,6 +260,8 @@ class ScorepSystemHelper:
     if not compile_time_filter:
       scorep_filter_file = self.prepare_scorep_filter_file(target_config.get_instr_file())
       self.set_filter_file(scorep_filter_file)
+      if InvocationConfig.get_instance().use_runtime_guards():
+        self.set_runtime_guard_filter(scorep_filter_file)
 
     self._set_up(target_config.get_build(), target_config.get_target(), target_config.get_flavor(),
                  instrumentation_config.get_instrumentation_iteration(),
@@ -314,6 +357,14 @@ class ScorepSystemHelper:
     self.cur_filter_file = file_name
     U.set_env('SCOREP_FILTERING_FILE', self.cur_filter_file)
 
+  def set_runtime_guard_filter(self, file_name: str) -> None:
+    L.get_logger().log(
+        'ScorepMeasurementSystem::set_runtime_guard_filter: File for runtime guards = ' + file_name)
+    if not U.is_valid_file_name(file_name):
+      raise MeasurementSystemException('Runtime guard filter file not valid.')
+
+    U.set_env('PIRA_RUNTIME_FILTER', file_name)
+
   def append_scorep_footer(self, input_str: str) -> str:
     return input_str + '\nSCOREP_REGION_NAMES_END\n'
 
@@ -394,27 +445,10 @@ class ScorepSystemHelper:
           'ScorepMeasurementSystem::check_build_prerequisites: Missing ' + scorep_init_file_name)
 
   @classmethod
-  def prepare_MPI_filtering(cls, filter_file: str) -> None:
-    # Find which MPI functions to filter
-    # Get all MPI functions (our filter_file is a WHITELIST)
-    default_provider = D.BackendDefaults()
-    mpi_funcs_dump = os.path.join(default_provider.instance.get_pira_dir(), 'mpi_funcs.dump')
-    U.shell('wrap.py -d > ' + mpi_funcs_dump)
-    all_MPI_functions_decls = U.read_file(mpi_funcs_dump).split('\n')
-    all_MPI_functions = []
-    for fd in all_MPI_functions_decls:
-      name = fd[fd.find(' '):fd.find('(')]
-      all_MPI_functions.append(name.strip())
-
-    MPI_functions_to_filter = []
-    file_content = U.read_file(filter_file).split('\n')
-    # We always want to measure some functions to ensure Score-P works correctly
-    always_measure = [
-        'MPI_Init', 'MPI_Finalize', 'MPI_Comm_group', 'MPI_Comm_dup', 'MPI_Comm_create_group',
-        'MPI_Comm_split', 'MPI_Comm_free', 'MPI_Group_free'
-    ]
-    file_content.extend(always_measure)
-    for l in file_content:
+  def get_MPI_whitelist(cls, filter_file: str) -> typing.List[str]:
+    """ Returns the MPI functions that the filter file marks for instrumentation """
+    names = []
+    for l in U.read_file(filter_file).split('\n'):
       # Match MPI functions which have been marked for instrumentation
       # Example: (MPI_Barrier is representative for all MPI functions here)
       #   MPI_Barrier                             => match to 'MPI_Barrier'
@@ -424,31 +458,37 @@ class ScorepSystemHelper:
       #   INCLUDE SomeFunction -> MPI_Barrier     => match to 'MPI_Barrier'
       #   INCLUDE MPI_Barrier -> SomeFunction     => no match
       match_object = re.match(r'^.*(MPI_\S+)\s*?$', l)
-      if match_object:
-        mpi_func_name = match_object.group(1)
-        L.get_logger().log('ScorepSystemHelper::prepare_MPI_filtering: Remove ' + mpi_func_name)
-        # prevent double removal
-        if mpi_func_name in all_MPI_functions:
-          all_MPI_functions.remove(mpi_func_name)
-
-    # Generate the .c file using the mpi wrap.py script
-    L.get_logger().log('ScorepSystemHelper::prepare_MPI_filtering: About to filter ' +
-                       str(len(all_MPI_functions)) + ' MPI functions')
-    wrap_script = '{{fn PIRA_Filter'
-    for mpi_func in all_MPI_functions:
-      wrap_script += ' ' + mpi_func
-
-    wrap_script += '}}\n{{callfn}}\n{{endfn}}'
+      if match_object and match_object.group(1) not in names:
+        names.append(match_object.group(1))
+    return names
+
+  @classmethod
+  def build_MPI_filter_library(cls) -> None:
+    """
+    Generates and compiles the MPI filter library from resources/pira-mpi-filter.w, unless it is
+    up to date. The library reads the measured MPI functions at MPI_Init, so it is built only once.
+    """
     default_provider = D.BackendDefaults()
-    wrap_file = default_provider.get_wrap_w_file()
-    if U.check_file(wrap_file):
-      U.remove_file(wrap_file)
-    U.write_file(wrap_file, wrap_script)
-
-    wrap_c_path = default_provider.get_wrap_c_file()
-    wrap_command = 'wrap.py -o ' + wrap_c_path + ' ' + wrap_file
-    U.shell(wrap_command)
-    # Compile it to .so file
-    compile_mpi_wrapper_command = 'mpicc -shared -fPIC -o ' + default_provider.get_wrap_so_file(
-    ) + ' ' + wrap_c_path
-    U.shell(compile_mpi_wrapper_command)
+    template = os.path.join(U.get_pira_code_dir(), 'resources', 'pira-mpi-filter.w')
+    so_file = default_provider.get_wrap_so_file()
+    # Targets that run concurrently build it once
+    with open(so_file + '.lock', 'w') as lock:
+      fcntl.flock(lock, fcntl.LOCK_EX)
+      if U.is_file(so_file) and os.path.getmtime(so_file) >= os.path.getmtime(template):
+        return
+
+      L.get_logger().log('ScorepSystemHelper::build_MPI_filter_library: Building ' + so_file)
+      wrap_file = default_provider.get_wrap_w_file()
+      U.copy_file(template, wrap_file)
+      wrap_c_path = default_provider.get_wrap_c_file()
+      U.shell('wrap.py -o ' + wrap_c_path + ' ' + wrap_file)
+      U.shell('mpicc -shared -fPIC -o ' + so_file + ' ' + wrap_c_path + ' -ldl')
+
+  @classmethod
+  def prepare_MPI_filtering(cls, filter_file: str) -> None:
+    # Our filter_file is a WHITELIST, the MPI functions in it are measured, all others are filtered
+    cls.build_MPI_filter_library()
+    MPI_functions = cls.get_MPI_whitelist(filter_file)
+    L.get_logger().log('ScorepSystemHelper::prepare_MPI_filtering: Measuring ' +
+                       str(len(MPI_functions)) + ' MPI functions')
+    U.write_file(D.BackendDefaults().get_MPI_filter_file(), '\n'.join(MPI_functions) + '\n')
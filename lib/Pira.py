@@ -11,6 +11,7 @@ import lib.TimeTracking as T
 import lib.Database as D
 import lib.Exporter as E
 import lib.Checker as C
+import lib.TargetScheduler as TS
 from lib.DefaultFlags import BackendDefaults
 from lib.RunnerFactory import PiraRunnerFactory
 from lib.ConfigurationLoader import SimplifiedConfigurationLoader as SCLoader, BatchSystemConfigurationLoader
@@ -27,8 +28,11 @@ import sys
 import os
 
 
-def execute_with_config(runner: Runner, analyzer: A, target_config: TargetConfig,
-                        csv_config: CSVConfig) -> None:
+def execute_with_config(runner: Runner,
+                        analyzer: A,
+                        target_config: TargetConfig,
+                        csv_config: CSVConfig,
+                        vanilla_built: bool = False) -> None:
   try:
     instrument = False
     was_rebuilt = True
@@ -37,10 +41,13 @@ def execute_with_config(runner: Runner, analyzer: A, target_config: TargetConfig
     rr_exporter = E.PiraRuntimeExporter()
 
     # Build without any instrumentation
-    L.get_logger().log('Building vanilla version for baseline measurements', level='info')
-    vanilla_builder = BU(target_config, instrument)
     tracker = T.TimeTracker()
-    tracker.m_track('Vanilla Build', vanilla_builder, 'build')
+    if vanilla_built:
+      L.get_logger().log('Vanilla version was built while the previous target ran', level='info')
+    else:
+      L.get_logger().log('Building vanilla version for baseline measurements', level='info')
+      vanilla_builder = BU(target_config, instrument)
+      tracker.m_track('Vanilla Build', vanilla_builder, 'build')
 
     # Run without instrumentation for baseline
     L.get_logger().log('Running baseline measurements', level='info')
@@ -74,6 +81,8 @@ def execute_with_config(runner: Runner, analyzer: A, target_config: TargetConfig
         instrument = True
         instr_builder = BU(target_config, instrument, instr_file)
         tracker.m_track('Instrument Build', instr_builder, 'build')
+        if InvocationConfig.get_instance().use_instrumentation_report():
+          instr_builder.write_instrumentation_report(iteration)
 
       # Run Phase
       L.get_logger().log('Running profiling measurements', level='info')
@@ -127,7 +136,119 @@ def do_rebuild(build_name: str,
   tracker.m_track(build_name, builder, 'build')
 
 
+def get_prebuild_task(target_config: TargetConfig,
+                      prebuilt: typing.Set[typing.Tuple]) -> typing.Callable[[], None]:
+  """
+  Returns a task that builds the vanilla version of the target, to run while the batch jobs of the
+  previous target are queued. Adds the target to prebuilt, if the build succeeded.
+  """
+
+  def prebuild() -> None:
+    L.get_logger().log('Building vanilla version of ' + target_config.get_target() + ' in ' +
+                       target_config.get_flavor() + ' while the batch jobs are queued',
+                       level='info')
+    try:
+      tracker = T.TimeTracker()
+      tracker.m_track('Vanilla Build', BU(target_config, False), 'build')
+      prebuilt.add(
+          (target_config.get_build(), target_config.get_target(), target_config.get_flavor()))
+    except Exception as e:
+      L.get_logger().log('Pira::prebuild: Building ahead failed, building again later: ' + str(e),
+                         level='warn')
+
+  return prebuild
+
+
+def create_runner(configuration: PiraConfig, use_extra_p: bool,
+                  extrap_config: ExtrapConfig) -> typing.Tuple[Runner, A]:
+  """ Returns the runner of the invocation and the analyzer that reads the profiles of its sink """
+  invoc_cfg = InvocationConfig.get_instance()
+  analyzer = A(configuration)
+
+  runner_factory = PiraRunnerFactory(configuration)
+  if invoc_cfg.get_slurm_config_path() is not None:
+    # setup slurm config
+    slurm_config_loader = BatchSystemConfigurationLoader(invoc_cfg)
+    slurm_config = slurm_config_loader.get_config()
+    # get slurm runners
+    runner = runner_factory.get_simple_slurm_runner(slurm_config,
+                                                    slurm_config_loader.get_batch_interface())
+    if use_extra_p:
+      L.get_logger().log('Running with Extra-P runner')
+      runner = runner_factory.get_scalability_slurm_runner(
+          slurm_config, slurm_config_loader.get_batch_interface(), extrap_config)
+  else:
+    # get local runners
+    runner = runner_factory.get_simple_local_runner()
+    if use_extra_p:
+      L.get_logger().log('Running with Extra-P runner')
+      runner = runner_factory.get_scalability_runner(extrap_config)
+  if runner.has_sink():
+    analyzer.set_profile_sink(runner.get_sink())
+  return runner, analyzer
+
+
+def get_pipeline_task(configuration: PiraConfig, build: str, item: str, flavor: str,
+                      csv_config: CSVConfig, use_extra_p: bool,
+                      extrap_config: ExtrapConfig) -> typing.Callable[[], None]:
+  """
+  Returns the refinement of one target, to run in a process of its own. The runner and the
+  analyzer are created in that process, so that the local runs are pinned within its cores.
+  """
+
+  def pipeline() -> None:
+    db_file = os.path.join(U.get_home_dir(), D.DBManager.db_name + '.' + D.DBManager.db_ext)
+    dbm = D.DBManager.reopen(db_file)
+    dbm.create_cursor()
+    db_item_id = dbm.prep_db_for_build_item_in_flavor(configuration, build, item, flavor)
+    t_config = TargetConfig(configuration.get_place(build), build, item, flavor, db_item_id)
+    runner, analyzer = create_runner(configuration, use_extra_p, extrap_config)
+    execute_with_config(runner, analyzer, t_config, csv_config)
+
+  return pipeline
+
+
+def run_targets_concurrently(configuration: PiraConfig, dbm: D.DBManager, targets: typing.List,
+                             csv_config: CSVConfig, use_extra_p: bool,
+                             extrap_config: ExtrapConfig) -> None:
+  """
+  Runs the refinement of every (build, item, flavor) target in a process of its own, as many at a
+  time as the core and memory budgets admit. Raises once all of them have finished, if one of them failed.
+  """
+  invoc_cfg = InvocationConfig.get_instance()
+  total_time = T.TimeTracker()
+  for build in configuration.get_builds():
+    dbm.insert_data_application((U.generate_random_string(), build, '', ''))
+
+  pipelines = []
+  for build, item, flavor in targets:
+    cores, memory = configuration.get_resources(build, item)
+    pipelines.append(
+        TS.Pipeline(
+            build + ':' + item + ':' + flavor, configuration.get_place(build),
+            get_pipeline_task(configuration, build, item, flavor, csv_config, use_extra_p,
+                              extrap_config), cores, memory))
+
+  scheduler = TS.TargetScheduler(invoc_cfg.get_concurrent_targets(), invoc_cfg.get_core_budget(),
+                                 invoc_cfg.get_memory_budget())
+  L.get_logger().log('Running ' + str(len(pipelines)) + ' targets, up to ' +
+                     str(scheduler.get_max_concurrent()) + ' at a time on ' +
+                     str(scheduler.get_num_cores()) + ' cores',
+                     level='info')
+  try:
+    scheduler.run(pipelines)
+  except TS.TargetSchedulerException as e:
+    raise RuntimeError(str(e))
+  finally:
+    total_time.stop()
+    L.get_logger().log('PIRA total runtime: {}'.format(total_time.get_time()), level='perf')
+
+
 def needs_rebuild(iteration: int) -> bool:
+  if InvocationConfig.get_instance().use_runtime_guards():
+    # The runtime sets the enable guards from the current whitelist, one build is enough
+    return iteration == 0
+
   hybrid_filtering = InvocationConfig.get_instance().is_hybrid_filtering()
   hybrid_filter_iters = InvocationConfig.get_instance().get_hybrid_filter_iters()
   compile_time_filtering = InvocationConfig.get_instance().is_compile_time_filtering()
@@ -143,6 +264,9 @@ def process_args_for_extrap(cmdline_args) -> typing.Tuple[bool, ExtrapConfig]:
     extrap_config = ExtrapConfig(cmdline_args.extrap_dir, cmdline_args.extrap_prefix, '')
 
     num_reps = cmdline_args.repetitions
+    if cmdline_args.confidence_width > 0:
+      # The Extra-P configuration lists the repetitions that every data point has
+      num_reps = min(cmdline_args.min_repetitions, num_reps)
     if num_reps < 5:
       L.get_logger().log('At least 5 repetitions are recommended for Extra-P modelling.',
                          level='warn')
@@ -155,6 +279,22 @@ def process_args_for_extrap(cmdline_args) -> typing.Tuple[bool, ExtrapConfig]:
   return use_extra_p, extrap_config
 
 
+def process_args_for_concurrent_targets(cmdline_args) -> None:
+  """
+  Targets that run concurrently would share the Extra-P profile directory, and the Slurm script
+  and result files in the PIRA directory. Rejects them together with Extra-P or a batch system.
+  """
+  if cmdline_args.concurrent_targets <= 1:
+    return
+  if cmdline_args.extrap_dir != '':
+    L.get_logger().log('--concurrent-targets can not be used with Extra-P modelling.',
+                       level='error')
+    raise RuntimeError('--concurrent-targets can not be used with Extra-P modelling.')
+  if cmdline_args.slurm_config is not None:
+    L.get_logger().log('--concurrent-targets can not be used with a batch system.', level='error')
+    raise RuntimeError('--concurrent-targets can not be used with a batch system.')
+
+
 def process_args_for_csv(cmdline_args):
   csv_dir = cmdline_args.csv_dir
   csv_dialect = cmdline_args.csv_dialect
@@ -167,6 +307,7 @@ def main(cmdline_args) -> None:
   invoc_cfg = InvocationConfig(cmdline_args)
   L.get_logger().log(str(invoc_cfg), level='info')
   use_extra_p, extrap_config = process_args_for_extrap(cmdline_args)
+  process_args_for_concurrent_targets(cmdline_args)
   home_dir = U.get_cwd()
   U.set_home_dir(home_dir)
   U.make_dir(invoc_cfg.get_pira_dir())
@@ -193,28 +334,22 @@ def main(cmdline_args) -> None:
     F.FunctorManager(configuration)
     dbm = D.DBManager(D.DBManager.db_name + '.' + D.DBManager.db_ext)
     dbm.create_cursor()
-    analyzer = A(configuration)
 
-    runner_factory = PiraRunnerFactory(configuration)
-    if is_batch_system_run:
-      # setup slurm config
-      slurm_config_loader = BatchSystemConfigurationLoader(invoc_cfg)
-      slurm_config = slurm_config_loader.get_config()
-      # get slurm runners
-      runner = runner_factory.get_simple_slurm_runner(slurm_config,
-                                                      slurm_config_loader.get_batch_interface())
-      if use_extra_p:
-        L.get_logger().log('Running with Extra-P runner')
-        runner = runner_factory.get_scalability_slurm_runner(
-            slurm_config, slurm_config_loader.get_batch_interface(), extrap_config)
-    else:
-      # get local runners
-      runner = runner_factory.get_simple_local_runner()
-      if use_extra_p:
-        L.get_logger().log('Running with Extra-P runner')
-        runner = runner_factory.get_scalability_runner(extrap_config)
-    if runner.has_sink():
-      analyzer.set_profile_sink(runner.get_sink())
+    targets = [(build, item, flavor) for build in configuration.get_builds()
+               for item in configuration.get_items(build)
+               if configuration.has_local_flavors(build, item)
+               for flavor in configuration.get_flavors(build, item)]
+
+    if invoc_cfg.get_concurrent_targets() > 1:
+      run_targets_concurrently(configuration, dbm, targets, csv_config, use_extra_p, extrap_config)
+      U.change_cwd(home_dir)
+      return
+
+    runner, analyzer = create_runner(configuration, use_extra_p, extrap_config)
+
+    # With batch jobs, the next target can be built while the jobs of the current one are queued
+    overlap_builds = is_batch_system_run and invoc_cfg.overlap_builds()
+    prebuilt = set()
 
     # A build/place is a top-level directory
     for build in configuration.get_builds():
@@ -237,8 +372,19 @@ def main(cmdline_args) -> None:
             # Create configuration object for the item currently processed.
             place = configuration.get_place(build)
             t_config = TargetConfig(place, build, item, flavor, db_item_id)
+
+            index = targets.index((build, item, flavor))
+            if overlap_builds and index + 1 < len(targets):
+              next_build, next_item, next_flavor = targets[index + 1]
+              next_place = configuration.get_place(next_build)
+              # Building in the same directory would replace the executable of the queued jobs
+              if next_place != place:
+                runner.set_idle_task(
+                    get_prebuild_task(
+                        TargetConfig(next_place, next_build, next_item, next_flavor, ''), prebuilt))
             # Execute it given the generated target description
-            execute_with_config(runner, analyzer, t_config, csv_config)
+            vanilla_built = (build, item, flavor) in prebuilt
+            execute_with_config(runner, analyzer, t_config, csv_config, vanilla_built)
 
         # If global flavor
         else:
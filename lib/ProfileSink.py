@@ -103,15 +103,23 @@ class ExtrapProfileSink(ProfileSinkBase):
     self._iteration = -1
     self._repetition = 0
     self._total_reps = InvocationConfig.get_instance().get_num_repetitions()
+    # Repetitions per iteration and parameter value; adaptive repetitions stop at different counts
+    self._reps = {}
     self._VALUE = ()
 
   def has_config_output(self):
     return True
 
+  def get_reps(self) -> int:
+    """ The number of repetitions that exist for every iteration and parameter value """
+    if not self._reps:
+      return self._total_reps
+    return min(self._reps.values())
+
   def output_config(self, benchmark, output_dir):
     L.get_logger().log('ExtrapProfileSink::output_config:\ndir: ' + self._base_dir + '\nprefix: ' +
                        self._prefix + '\npostfix: ' + self._postfix + '\nreps: ' +
-                       str(self._total_reps) + '\nNiter: ' + str(self._iteration + 1))
+                       str(self.get_reps()) + '\nNiter: ' + str(self._iteration + 1))
     s = ''
     for p in self._params:
       s += p + ', '
@@ -121,7 +129,7 @@ class ExtrapProfileSink(ProfileSinkBase):
         'dir': self._base_dir,
         'prefix': self._prefix,
         'postfix': self._postfix,
-        'reps': int(self._total_reps),
+        'reps': int(self.get_reps()),
         'iter': int(self._iteration + 1),
         'params': self._params
     })
@@ -216,5 +224,6 @@ class ExtrapProfileSink(ProfileSinkBase):
     self._VALUE = target_config.get_args_for_invocation()
     src_cube_name = self.check_and_prepare(exp_dir, target_config, instr_config)
     self._sink_target = self.get_extrap_dir_name(target_config, self._iteration)
+    self._reps[(self._iteration, self.get_param_mapping(target_config))] = self._repetition + 1
 
     self.do_copy(src_cube_name, self._sink_target)
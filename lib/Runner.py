@@ -14,6 +14,8 @@ import lib.FunctorManagement as F
 import lib.Measurement as M
 import lib.DefaultFlags as D
 import lib.ProfileSink as S
+import lib.LocalScheduler as LS
+import lib.Database as DB
 from lib.Configuration import PiraConfig, TargetConfig, InstrumentConfig, InvocationConfig
 from lib.BatchSystemBackends import BatchSystemInterface, SlurmBackend, SlurmInterfaces
 from lib.BatchSystemGenerator import SlurmGenerator
@@ -41,6 +43,69 @@ class Runner:
   def get_sink(self):
     return self._sink
 
+  def needs_repetition(self, runtimes: typing.List[float]) -> bool:
+    return len(runtimes) < self.get_num_repetitions()
+
+  def get_run_history(self):
+    """ The run history in the database of PIRA, None if no database is open """
+    return DB.DBManager.instance
+
+  def get_run_keys(self,
+                   target_config: TargetConfig,
+                   args,
+                   instr_file: str = None) -> typing.List[str]:
+    """
+    Returns the key per arg under which the run history stores its runs: a digest of the executables
+    in the target directory, the run command, the args and the instrumentation file.
+    """
+    if self.get_run_history() is None:
+      return [None] * len(args)
+    executables = U.get_executables_digest(target_config.get_place())
+    instrumentation = ''
+    if instr_file is not None and U.check_file(instr_file):
+      instrumentation = U.read_file(instr_file)
+    run_keys = []
+    for arg in args:
+      target_config.set_args_for_invocation(arg)
+      run_keys.append(
+          U.get_run_key(executables=executables,
+                        command=self.get_run_command(target_config),
+                        args=str(arg),
+                        place=target_config.get_place(),
+                        instrumentation=instrumentation))
+    return run_keys
+
+  def get_cached_baselines(self, run_keys: typing.List[str]) -> typing.List[typing.List[float]]:
+    """
+    With --reuse-baseline, returns the baseline runtimes per run key from the run history. Keys
+    without enough repetitions in their latest series get no runtimes and have to be measured.
+    """
+    history = self.get_run_history()
+    if history is None or not InvocationConfig.get_instance().reuse_baseline():
+      return [[] for _ in run_keys]
+    cached = []
+    for run_key in run_keys:
+      runtimes = history.get_latest_run_series(run_key, 'baseline')[:self.get_num_repetitions()]
+      if not runtimes or self.needs_repetition(runtimes):
+        runtimes = []
+      else:
+        L.get_logger().log('Runner::get_cached_baselines: Reusing ' + str(len(runtimes)) +
+                           ' baseline runtimes of run ' + run_key)
+      cached.append(runtimes)
+    return cached
+
+  def record_runs(self,
+                  kind: str,
+                  run_keys: typing.List[str],
+                  runtimes: typing.List[typing.List[float]],
+                  iteration: int = None) -> None:
+    """ Stores the runtimes per run key in the run history """
+    history = self.get_run_history()
+    if history is None or not run_keys:
+      return
+    history.insert_run_series([(run_key, kind, iteration, arg_runtimes)
+                               for run_key, arg_runtimes in zip(run_keys, runtimes)])
+
 
 class LocalBaseRunner(Runner):
   """
@@ -74,13 +139,7 @@ class LocalBaseRunner(Runner):
 
     try:
       U.change_cwd(target_config.get_place())
-
-      invoke_arguments = target_config.get_args_for_invocation()
-      kwargs['args'] = invoke_arguments
-      if invoke_arguments is not None:
-        L.get_logger().log('LocalBaseRunner::run: (args) ' + str(invoke_arguments))
-
-      command = run_functor.passive(target_config.get_target(), **kwargs)
+      command = self.get_run_command(target_config)
       _, runtime = U.shell(command, time_invoc=True)
       L.get_logger().log('LocalBaseRunner::run::passive_invocation -> Returned runtime: ' +
                          str(runtime),
@@ -93,44 +152,217 @@ class LocalBaseRunner(Runner):
     # TODO: Insert the data into the database
     return runtime
 
+  def get_run_command(self, target_config: TargetConfig) -> str:
+    """ Returns the command of the passive run functor for the current invocation arguments """
+    functor_manager = F.FunctorManager()
+    run_functor = functor_manager.get_or_load_functor(target_config.get_build(),
+                                                      target_config.get_target(),
+                                                      target_config.get_flavor(), 'run')
+    default_provider = D.BackendDefaults()
+    kwargs = default_provider.get_default_kwargs()
+    kwargs['util'] = U
+    kwargs['LD_PRELOAD'] = default_provider.get_MPI_wrap_LD_PRELOAD()
+
+    invoke_arguments = target_config.get_args_for_invocation()
+    kwargs['args'] = invoke_arguments
+    if invoke_arguments is not None:
+      L.get_logger().log('LocalBaseRunner::get_run_command: (args) ' + str(invoke_arguments))
+
+    return run_functor.passive(target_config.get_target(), **kwargs)
+
 
 class LocalRunner(LocalBaseRunner):
   """
   The LocalRunner invokes the target application with the first argument string given in the config.
   For scalability studies, i.e., iterate over all given input sizes, use the LocalScalingRunner.
+  With a local concurrency above one, the repetitions run concurrently on disjoint core sets.
+  With adaptive repetitions, the runner stops repeating once the runtime is known precisely enough.
   """
 
   def __init__(self, configuration: PiraConfig, sink):
     """ Runner are initialized once with a PiraConfiguration """
     super().__init__(configuration, sink)
-    self._num_repetitions = InvocationConfig.get_instance().get_num_repetitions()
+    invoc_cfg = InvocationConfig.get_instance()
+    self._num_repetitions = invoc_cfg.get_num_repetitions()
+    self._scheduler = None
+    if invoc_cfg.get_local_concurrency() > 1:
+      self._scheduler = LS.LocalScheduler(invoc_cfg.get_local_concurrency(),
+                                          invoc_cfg.get_cores_per_run())
 
   def get_num_repetitions(self) -> int:
     return self._num_repetitions
 
-  def do_baseline_run(self, target_config: TargetConfig) -> M.RunResult:
-    L.get_logger().log('LocalRunner::do_baseline_run')
-    accu_runtime = .0
+  def needs_repetition(self, runtimes: typing.List[float]) -> bool:
+    """
+    Whether another repetition is needed: below the minimum, or with adaptive repetitions, until the
+    confidence interval of the runtimes is narrow enough or the maximum is reached.
+    """
+    invoc_cfg = InvocationConfig.get_instance()
+    if len(runtimes) >= self.get_num_repetitions():
+      return False
+    if len(runtimes) < invoc_cfg.get_min_repetitions():
+      return True
+    width = M.get_relative_confidence_width(runtimes)
+    if width <= invoc_cfg.get_confidence_width():
+      L.get_logger().log('LocalRunner::needs_repetition: Confidence interval of ' + str(width) +
+                         '% of the mean after ' + str(len(runtimes)) + ' repetitions')
+      return False
+    return True
 
-    if not target_config.has_args_for_invocation():
-      L.get_logger().log(
-          'LocalRunner::do_baseline_run: BEGIN not target_config.has_args_for_invocation()')
-      # This runner only takes into account the first argument string (if not already set)
-      args = self._config.get_args(target_config.get_build(), target_config.get_target())
-      L.get_logger().log('LocalRunner::do_baseline_run: args: ' + str(args))
-      target_config.set_args_for_invocation(args[0])
-      L.get_logger().log(
-          'LocalRunner::do_baseline_run: END not target_config.has_args_for_invocation()')
+  def is_concurrent(self, target_config: TargetConfig) -> bool:
+    if self._scheduler is None or self._scheduler.get_max_concurrent() < 2:
+      return False
+    functor_manager = F.FunctorManager()
+    run_functor = functor_manager.get_or_load_functor(target_config.get_build(),
+                                                      target_config.get_target(),
+                                                      target_config.get_flavor(), 'run')
+    # Active functors invoke the target themselves
+    return not run_functor.get_method()['active']
+
+  def run_repetitions(
+      self,
+      target_config: TargetConfig,
+      instrument_config: InstrumentConfig,
+      arg_cfgs,
+      scorep_helper: M.ScorepSystemHelper = None) -> typing.List[typing.List[float]]:
+    """
+    Runs the repetitions for every argument string, returns their runtimes per argument string.
+    For profile runs (scorep_helper given), every profile is passed to the sink.
+    """
+    if self.is_concurrent(target_config):
+      return self.run_repetitions_concurrently(target_config, instrument_config, arg_cfgs,
+                                               scorep_helper)
+
+    runtimes = []
+    for arg_cfg in arg_cfgs:
+      target_config.set_args_for_invocation(arg_cfg)
+      arg_runtimes = []
+      while self.needs_repetition(arg_runtimes):
+        L.get_logger().log('LocalRunner::run_repetitions: Running iteration ' +
+                           str(len(arg_runtimes)),
+                           level='debug')
+        arg_runtimes.append(self.run(target_config, instrument_config))
+        if scorep_helper is not None:
+          # Enable further processing of the resulting profile
+          self._sink.process(scorep_helper.get_exp_dir(), target_config, instrument_config)
+      runtimes.append(arg_runtimes)
+    return runtimes
+
+  def run_repetitions_concurrently(
+      self,
+      target_config: TargetConfig,
+      instrument_config: InstrumentConfig,
+      arg_cfgs,
+      scorep_helper: M.ScorepSystemHelper = None) -> typing.List[typing.List[float]]:
+    """
+    The first repetition of the first argument string runs alone as reference, all other runs
+    concurrently: first the minimum number of repetitions, then rounds of one more repetition for
+    every argument string that needs one. If the concurrent repetitions of the same argument string
+    are slower than the tolerance allows, the following measurements run serially again.
+    Profile runs write to a Score-P experiment directory each; the profiles are passed to the sink
+    per argument string, the one of the reference last, and remain in the usual directory.
+    """
+    invoc_cfg = InvocationConfig.get_instance()
+    commands = []
+    for arg_cfg in arg_cfgs:
+      target_config.set_args_for_invocation(arg_cfg)
+      commands.append(self.get_run_command(target_config))
+    arg_jobs = [[] for _ in arg_cfgs]
+    jobs = []
+
+    def add_job(index: int) -> LS.LocalJob:
+      env = {}
+      if scorep_helper is not None and jobs:
+        env['SCOREP_EXPERIMENT_DIRECTORY'] = scorep_helper.get_exp_dir() + '-run' + str(len(jobs))
+      job = LS.LocalJob(commands[index], target_config.get_place(), env)
+      arg_jobs[index].append(job)
+      jobs.append(job)
+      return job
+
+    def next_batch() -> typing.List[LS.LocalJob]:
+      return [
+          add_job(index) for index in range(len(arg_cfgs))
+          if self.needs_repetition([job.runtime for job in arg_jobs[index]])
+      ]
+
+    reference = add_job(0)
+    L.get_logger().log('LocalRunner::run_repetitions_concurrently: Serial reference run',
+                       level='debug')
+    self._scheduler.run([reference])
+    batch = [
+        add_job(index) for index in range(len(arg_cfgs))
+        for _ in range(len(arg_jobs[index]), invoc_cfg.get_min_repetitions())
+    ] or next_batch()
+    while batch:
+      L.get_logger().log('LocalRunner::run_repetitions_concurrently: Running ' + str(len(batch)) +
+                         ' runs on up to ' + str(self._scheduler.get_max_concurrent()) +
+                         ' core sets',
+                         level='debug')
+      self._scheduler.run(batch)
+      batch = next_batch()
+
+    concurrent = [job.runtime for job in arg_jobs[0][1:]]
+    if LS.check_interference(reference.runtime, concurrent, invoc_cfg.get_interference_tolerance()):
+      L.get_logger().log('LocalRunner::run_repetitions_concurrently: Concurrent runs took ' +
+                         str(sum(concurrent) / len(concurrent)) +
+                         's on average, the serial reference ' + str(reference.runtime) +
+                         's. Running the following measurements serially.',
+                         level='warn')
+      self._scheduler = None
+
+    runtimes = []
+    for index, arg_cfg in enumerate(arg_cfgs):
+      runtimes.append([job.runtime for job in arg_jobs[index]])
+      if scorep_helper is None:
+        continue
+      target_config.set_args_for_invocation(arg_cfg)
+      ordered_jobs = arg_jobs[index]
+      if index == 0:
+        ordered_jobs = ordered_jobs[1:] + ordered_jobs[:1]
+      for job in ordered_jobs:
+        exp_dir = job.env.get('SCOREP_EXPERIMENT_DIRECTORY', scorep_helper.get_exp_dir())
+        self._sink.process(exp_dir, target_config, instrument_config)
+
+    for job in jobs:
+      if 'SCOREP_EXPERIMENT_DIRECTORY' in job.env:
+        U.remove_dir(job.env['SCOREP_EXPERIMENT_DIRECTORY'])
+    return runtimes
+
+  def run_baseline_repetitions(self, target_config: TargetConfig,
+                               arg_cfgs) -> typing.List[typing.List[float]]:
+    """
+    Runs the baseline repetitions for every argument string, except for those whose runtimes the run
+    history holds with --reuse-baseline. Returns the runtimes per argument string.
+    """
+    run_keys = self.get_run_keys(target_config, arg_cfgs)
+    runtimes = self.get_cached_baselines(run_keys)
+    missing = [i for i, arg_runtimes in enumerate(runtimes) if not arg_runtimes]
+    if missing:
+      measured = self.run_repetitions(target_config, InstrumentConfig(),
+                                      [arg_cfgs[i] for i in missing])
+      for i, arg_runtimes in zip(missing, measured):
+        runtimes[i] = arg_runtimes
+      self.record_runs('baseline', [run_keys[i] for i in missing], measured)
+    return runtimes
+
+  def set_up_profile_run(
+      self, target_config: TargetConfig,
+      instr_iteration: int) -> typing.Tuple[M.ScorepSystemHelper, InstrumentConfig]:
+    L.get_logger().log('LocalRunner::set_up_profile_run: Received instrumentation file: ' +
+                       target_config.get_instr_file(),
+                       level='debug')
+    scorep_helper = M.ScorepSystemHelper(self._config)
+    instrument_config = InstrumentConfig(True, instr_iteration)
+    scorep_helper.set_up(target_config, instrument_config)
+    return scorep_helper, instrument_config
 
+  def get_baseline_series(self, runtimes: typing.List[float]) -> M.RunResultSeries:
     # TODO Better evaluation of the obtained timings.
-    time_series = M.RunResultSeries(reps=self.get_num_repetitions())
-    for y in range(0, self.get_num_repetitions()):
-      L.get_logger().log('LocalRunner::do_baseline_run: Running iteration ' + str(y), level='debug')
-      l_runtime = self.run(target_config, InstrumentConfig())
-      accu_runtime += l_runtime
-      time_series.add_values(l_runtime, self.get_num_repetitions())
+    time_series = M.RunResultSeries(reps=len(runtimes))
+    for l_runtime in runtimes:
+      time_series.add_values(l_runtime, len(runtimes))
 
-    run_result = M.RunResult(accu_runtime, self.get_num_repetitions())
+    run_result = M.RunResult(sum(runtimes), len(runtimes))
     L.get_logger().log('[Vanilla][RUNTIME] Vanilla avg: ' + str(run_result.get_average()) + '\n',
                        level='perf')
     L.get_logger().log('[Vanilla][RTSeries] Average: ' + str(time_series.get_average()),
@@ -143,31 +375,13 @@ class LocalRunner(LocalBaseRunner):
 
     return time_series
 
-  def do_profile_run(self, target_config: TargetConfig, instr_iteration: int) -> M.RunResult:
-    L.get_logger().log('LocalRunner::do_profile_run: Received instrumentation file: ' +
-                       target_config.get_instr_file(),
-                       level='debug')
-    scorep_helper = M.ScorepSystemHelper(self._config)
-    instrument_config = InstrumentConfig(True, instr_iteration)
-    scorep_helper.set_up(target_config, instrument_config)
-    runtime = .0
+  def get_profile_series(self, runtimes: typing.List[float],
+                         instr_iteration: int) -> M.RunResultSeries:
+    time_series = M.RunResultSeries(reps=len(runtimes))
+    for l_runtime in runtimes:
+      time_series.add_values(l_runtime, len(runtimes))
 
-    if not target_config.has_args_for_invocation():
-      # This runner only takes into account the first argument string (if not already set)
-      args = self._config.get_args(target_config.get_build(), target_config.get_target())
-      target_config.set_args_for_invocation(args[0])
-
-    time_series = M.RunResultSeries(reps=self.get_num_repetitions())
-    for y in range(0, self._num_repetitions):
-      L.get_logger().log('LocalRunner::do_profile_run: Running instrumentation iteration ' + str(y),
-                         level='debug')
-      l_runtime = self.run(target_config, instrument_config)
-      runtime += l_runtime
-      time_series.add_values(l_runtime, self.get_num_repetitions())
-      # Enable further processing of the resulting profile
-      self._sink.process(scorep_helper.get_exp_dir(), target_config, instrument_config)
-
-    run_result = M.RunResult(runtime, self.get_num_repetitions())
+    run_result = M.RunResult(sum(runtimes), len(runtimes))
     L.get_logger().log('[Instrument][RUNTIME] $' + str(instr_iteration) + '$ ' +
                        str(run_result.get_average()),
                        level='perf')
@@ -180,12 +394,45 @@ class LocalRunner(LocalBaseRunner):
 
     return time_series
 
+  def do_baseline_run(self, target_config: TargetConfig) -> M.RunResult:
+    L.get_logger().log('LocalRunner::do_baseline_run')
+
+    if not target_config.has_args_for_invocation():
+      L.get_logger().log(
+          'LocalRunner::do_baseline_run: BEGIN not target_config.has_args_for_invocation()')
+      # This runner only takes into account the first argument string (if not already set)
+      args = self._config.get_args(target_config.get_build(), target_config.get_target())
+      L.get_logger().log('LocalRunner::do_baseline_run: args: ' + str(args))
+      target_config.set_args_for_invocation(args[0])
+      L.get_logger().log(
+          'LocalRunner::do_baseline_run: END not target_config.has_args_for_invocation()')
+
+    runtimes = self.run_baseline_repetitions(target_config,
+                                             [target_config.get_args_for_invocation()])
+    return self.get_baseline_series(runtimes[0])
+
+  def do_profile_run(self, target_config: TargetConfig, instr_iteration: int) -> M.RunResult:
+    scorep_helper, instrument_config = self.set_up_profile_run(target_config, instr_iteration)
+
+    if not target_config.has_args_for_invocation():
+      # This runner only takes into account the first argument string (if not already set)
+      args = self._config.get_args(target_config.get_build(), target_config.get_target())
+      target_config.set_args_for_invocation(args[0])
+
+    args = [target_config.get_args_for_invocation()]
+    runtimes = self.run_repetitions(target_config, instrument_config, args, scorep_helper)
+    self.record_runs('profile',
+                     self.get_run_keys(target_config, args, target_config.get_instr_file()),
+                     runtimes, instr_iteration)
+    return self.get_profile_series(runtimes[0], instr_iteration)
+
 
 class LocalScalingRunner(LocalRunner):
   """
   The LocalScalingRunner performs measurements related to Extra-P modelling. 
   The arguments given in the configuration are treated as the different input sizes, i.e.,
   the first string is the smallest input configuration, the second is the next larger configuration, etc.
+  With a local concurrency above one, the runs of all input sizes run concurrently.
   """
 
   def __init__(self, configuration: PiraConfig, sink):
@@ -199,11 +446,13 @@ class LocalScalingRunner(LocalRunner):
     # TODO: How to handle multiple MeasurementResult items? We get a vector of these after this function.
     #run_result = M.RunResult()
     run_result = M.RunResultSeries(reps=self.get_num_repetitions(), num_data_sets=5)
-    for arg_cfg in args:
-      # Call the runner method with the correct arguments.
-      target_config.set_args_for_invocation(arg_cfg)
-      rr = super().do_profile_run(target_config, instr_iteration)
-      run_result.add_from(rr)
+    scorep_helper, instrument_config = self.set_up_profile_run(target_config, instr_iteration)
+    runtimes = self.run_repetitions(target_config, instrument_config, args, scorep_helper)
+    for arg_runtimes in runtimes:
+      run_result.add_from(self.get_profile_series(arg_runtimes, instr_iteration))
+    self.record_runs('profile',
+                     self.get_run_keys(target_config, args, target_config.get_instr_file()),
+                     runtimes, instr_iteration)
 
     # At this point we have all the data we need to construct an Extra-P model
 
@@ -214,10 +463,8 @@ class LocalScalingRunner(LocalRunner):
     args = self._config.get_args(target_config.get_build(), target_config.get_target())
     #run_result = M.RunResult()
     run_result = M.RunResultSeries(reps=self.get_num_repetitions(), num_data_sets=5)
-    for arg_cfg in args:
-      target_config.set_args_for_invocation(arg_cfg)
-      rr = super().do_baseline_run(target_config)
-      run_result.add_from(rr)
+    for runtimes in self.run_baseline_repetitions(target_config, args):
+      run_result.add_from(self.get_baseline_series(runtimes))
 
     return run_result
 
@@ -232,6 +479,26 @@ class SlurmBaseRunner(Runner):
     super().__init__(configuration, sink)
     self._slurm_config = slurm_configuration
     self.batch_interface = batch_interface
+    self._idle_task = None
+
+  def set_idle_task(self, task: typing.Callable[[], None]) -> None:
+    """
+    Sets a task to run once while the next dispatched jobs are queued, e.g., building the next target.
+    """
+    self._idle_task = task
+
+  def run_idle_task(self) -> None:
+    if self._idle_task is None:
+      return
+    task = self._idle_task
+    self._idle_task = None
+    L.get_logger().log('SlurmBaseRunner::run_idle_task: Running idle task while jobs are queued',
+                       level='debug')
+    cwd = U.get_cwd()
+    try:
+      task()
+    finally:
+      U.change_cwd(cwd)
 
   def add_run_command(self, target_config: TargetConfig,
                       instrument_config: InstrumentConfig) -> str:
@@ -239,6 +506,27 @@ class SlurmBaseRunner(Runner):
     Prepares the command and adds it via the batch interface.
     Returns a key to identify the results after batch system jobs ran.
     """
+    command = self.get_run_command(target_config)
+    # We add the command to the batch config via the interface here. We have to care
+    # about telling the interface to run everything later, and care about retrieving
+    # to results by "key" later to return them.
+    key = U.generate_random_string()
+    L.get_logger().log("SlurmBaseRunner::add_run_command: Using key to reference results: " + key,
+                       level="debug")
+
+    # Repetition not used, determined by the slurm config
+    self.batch_interface.add_timed_command(key=key, cmd=command)
+    L.get_logger().log(
+        f"SlurmBaseRunner::add_run_command: Added command via batch interface: {command}",
+        level="debug")
+
+    # TODO: Insert the data into the database
+    return key
+
+  def get_run_command(self, target_config: TargetConfig) -> str:
+    """
+    Returns the command of the run functor for the arguments of the target config.
+    """
     functor_manager = F.FunctorManager()
     run_functor = functor_manager.get_or_load_functor(target_config.get_build(),
                                                       target_config.get_target(),
@@ -247,11 +535,10 @@ class SlurmBaseRunner(Runner):
     kwargs = default_provider.get_default_kwargs()
     kwargs['util'] = U
     kwargs['LD_PRELOAD'] = default_provider.get_MPI_wrap_LD_PRELOAD()
-    runtime = .0
 
     if run_functor.get_method()['active']:
       L.get_logger().log(
-          'SlurmBaseRunner::add_run_command: Active running is not possible while '
+          'SlurmBaseRunner::get_run_command: Active running is not possible while '
           'dispatching to a cluster. Exiting.',
           level='error')
       raise RuntimeError('Active running is not possible while dispatching to a cluster.')
@@ -263,30 +550,14 @@ class SlurmBaseRunner(Runner):
 
       kwargs['args'] = invoke_arguments
       if invoke_arguments is not None:
-        L.get_logger().log('SlurmBaseRunner::add_run_command: (args) ' + str(invoke_arguments),
+        L.get_logger().log('SlurmBaseRunner::get_run_command: (args) ' + str(invoke_arguments),
                            level="debug")
 
-      command = run_functor.passive(target_config.get_target(), **kwargs)
-
-      # We add the command to the batch config via the interface here. We have to care
-      # about telling the interface to run everything later, and care about retrieving
-      # to results by "key" later to return them.
-      key = U.generate_random_string()
-      L.get_logger().log("SlurmBaseRunner::add_run_command: Using key to reference results: " + key,
-                         level="debug")
-
-      # Repetition not used, determined by the slurm config
-      self.batch_interface.add_timed_command(key=key, cmd=command)
-      L.get_logger().log(
-          f"SlurmBaseRunner::add_run_command: Added command via batch interface: {command}",
-          level="debug")
+      return run_functor.passive(target_config.get_target(), **kwargs)
 
     except Exception as e:
-      L.get_logger().log('SlurmBaseRunner::add_run_command: Exception\n' + str(e), level='error')
-      raise RuntimeError('SlurmBaseRunner::add_run_command: Caught exception. ' + str(e))
-
-    # TODO: Insert the data into the database
-    return key
+      L.get_logger().log('SlurmBaseRunner::get_run_command: Exception\n' + str(e), level='error')
+      raise RuntimeError('SlurmBaseRunner::get_run_command: Caught exception. ' + str(e))
 
   def dispatch(self, key: str) -> int:
     """
@@ -301,6 +572,7 @@ class SlurmBaseRunner(Runner):
     """
     Wait for the execution of commands to finish.
     """
+    self.run_idle_task()
     L.get_logger().log(f"SlurmBaseRunner::run: Waiting for added commands to finish.",
                        level="debug")
     self.batch_interface.wait()
@@ -372,6 +644,9 @@ class SlurmRunner(SlurmBaseRunner):
 
     self.collect_run(command_result_map, time_series, scorep_helper, target_config,
                      instrument_config, instr_iteration)
+    run_keys = self.get_run_keys(target_config, [target_config.get_args_for_invocation()],
+                                 target_config.get_instr_file())
+    self.record_runs('profile', run_keys, [time_series.rt_values], instr_iteration)
 
     # cleanup for the next iteration
     self.batch_interface.cleanup()
@@ -399,13 +674,21 @@ class SlurmRunner(SlurmBaseRunner):
           'SlurmRunner::do_baseline_run: END not target_config.has_args_for_invocation()',
           level="debug")
 
+    run_keys = self.get_run_keys(target_config, [target_config.get_args_for_invocation()])
+    cached = self.get_cached_baselines(run_keys)[0]
+    time_series = M.RunResultSeries(reps=self.get_num_repetitions())
+    if cached:
+      for runtime in cached:
+        time_series.add_values(runtime, self.get_num_repetitions())
+      return time_series
+
     self.dispatch_run(target_config, InstrumentConfig(), command_result_map)
 
     self.wait_run()
 
     # TODO Better evaluation of the obtained timings.
-    time_series = M.RunResultSeries(reps=self.get_num_repetitions())
     self.collect_run(command_result_map, time_series)
+    self.record_runs('baseline', run_keys, [time_series.rt_values])
 
     # cleanup for the next iteration
     self.batch_interface.cleanup()
@@ -519,21 +802,11 @@ class SlurmScalingRunner(SlurmRunner):
   The arguments given in the configuration are treated as the different input sizes, i.e.,
   the first string is the smallest input configuration, the second is the next larger configuration, etc.
 
-  About the "interface" option in scalability experiments:
-  Dispatching a scalability experiment, means dispatching
-  multiple jobs to the same time. This way the may run in parallel. If self.force_sequential is set
-  dependencies between the jobs will be added, SLURM will take care that they actually run sequential.
-  So in summary: First dispatch each job, wait for them all to finish, and gather all their results.
-  But this brings some problems with the "interface" option along:
-  1) We need to make sure that we do use a non-blocking dispatch method - otherwise it will block until
-     finished in the dispatch loop, which means it will be sequential again. So, valid is "pyslurm", and "os",
-     but not "sbatch-wait".
-  2) We need to make sure that we do use a non-blocking wait function for each job, since we now need to
-     wait for a set of multiple jobs. Sadly, "pyslurm" as well as "sbatch-wait" (see bevor), are blocking.
-     The only method which can handle waiting for a group of jobs at the moment is to use "os" (Since it
-     is pulling and not handling the blocking of to sbatch or pyslurm).
-  That's because we're manipulating the batch interfaces "interface" option before these steps here, to adhere
-  to these rules.
+  All input sizes and their repetitions are dispatched as one job array, the tasks of the first
+  input size come first. If self.force_sequential is set, SLURM runs one task of the array at a time.
+  With the "os" interface, the results are collected while the array runs: the profiles of an input
+  size are processed as soon as all of its repetitions finished. The other interfaces block until the
+  whole array finished.
   """
 
   def __init__(self, configuration: PiraConfig, slurm_configuration: SlurmConfig,
@@ -549,33 +822,12 @@ class SlurmScalingRunner(SlurmRunner):
     """
     Slurm profile scaling run.
     """
-    L.get_logger().log('SlurmScalingRunner::do_baseline_run', level="debug")
-
-    # saving the batch interface from the config, to restore it later
-    config_batch_interface = self.batch_interface.interface
-
+    L.get_logger().log('SlurmScalingRunner::do_profile_run', level="debug")
     args = self._config.get_args(target_config.get_build(), target_config.get_target())
 
-    # List of command_result_maps for all args
-    cmd_maps = []
-    # list to save the job_ids
-    jobs = []
-
-    # check if interface for dispatching adheres to rule 1), see class docstring
-    if self.batch_interface.interface == SlurmInterfaces.SBATCH_WAIT:
-      L.get_logger().log(
-          "SlurmScalingRunner::do_profile_run: Interface 'sbatch-wait' is a blocking "
-          "dispatch interface, which cannot be used with scaling experiments."
-          " Downgrading to 'os'.",
-          level="warn")
-      self.batch_interface.interface = SlurmInterfaces.OS
-
     # map to save setup for the score-p related stuff
     tool_map = {}
-
-    # dispatch job for each arg
     for i, arg in enumerate(args):
-      # setup args for invocation
       target_config.set_args_for_invocation(arg)
       # set up score-p related stuff upfront (needs to be initialized bevor the target runs)
       L.get_logger().log('SlurmScalingRunner::do_profile_run: Received instrumentation file: ' +
@@ -588,55 +840,14 @@ class SlurmScalingRunner(SlurmRunner):
       # the results individually later in this iteration
       scorep_helper.set_up(target_config, instrument_config, arg)
       tool_map[i] = (scorep_helper, instrument_config)
-      # List of tupels (iteration number, key)
-      command_result_map: typing.List[typing.Tuple[int, str]] = []
-      # if force sequential: add dependency to job_id before
-      if self.force_sequential and i > 0:
-        self.batch_interface.generator.config.dependencies = f"afterok:{jobs[i - 1]}"
-      else:
-        self.batch_interface.generator.config.dependencies = ""
-      # set scorep_var_export to split repetitions
-      job_id = self.dispatch_run(target_config,
-                                 InstrumentConfig(),
-                                 command_result_map,
-                                 scorep_var_export=True)
-      jobs.append(job_id)
-      cmd_maps.append(command_result_map)
-
-    # waiting needs to be done with non-blocking wait 'os' - rule 2), see class docstring
-    if self.batch_interface.interface != SlurmInterfaces.OS:
-      L.get_logger().log(
-          f"SlurmScalingRunner::do_profile_run: {str(self.batch_interface.interface)} is a blocking "
-          "wait interface, which cannot be used with scaling experiments."
-          " Downgrading to 'os'.",
-          level="warn")
-      self.batch_interface.interface = SlurmInterfaces.OS
-    # wait for the group of all jobs to finish
-    self.wait_run()
-
-    run_result = M.RunResultSeries(reps=self.get_num_repetitions(), num_data_sets=5)
-    for i, (cmd_map, arg) in enumerate(zip(cmd_maps, args)):
-      # args overwrite each other, so we have to do this also before evaluating, to process for the correct args
-      target_config.set_args_for_invocation(arg)
-      # get score-p related helpers again, were set up in dispatch loop
-      scorep_helper = tool_map[i][0]
-      instrument_config = tool_map[i][1]
-      # init timing saving container and read results
-      time_series = M.RunResultSeries(reps=self.get_num_repetitions())
-      # set append_repetition to read from repetition cube-dirs - opponent to scorep_var_export from above
-      self.collect_run(cmd_map,
-                       time_series,
-                       scorep_helper,
-                       target_config,
-                       instrument_config,
-                       instr_iteration,
-                       append_repetition=True)
-      run_result.add_from(time_series)
-
-    self.batch_interface.cleanup()
-    # restore the batch interface
-    self.batch_interface.interface = config_batch_interface
 
+    # every task writes to the experiment dir of its arg, suffixed by its task id
+    exp_dirs = [tool_map[i][0].get_exp_dir() for i in range(len(args))]
+    key = self.dispatch_array_run(target_config, args, exp_dirs)
+    run_result = self.collect_array_run(key, target_config, args, tool_map, instr_iteration)
+    self.record_runs('profile',
+                     self.get_run_keys(target_config, args, target_config.get_instr_file()),
+                     self.get_runtimes_per_arg(run_result), instr_iteration)
     return run_result
 
   def do_baseline_run(self, target_config: TargetConfig) -> RunResultSeries:
@@ -644,58 +855,112 @@ class SlurmScalingRunner(SlurmRunner):
     Slurm baseline scaling run.
     """
     L.get_logger().log('SlurmScalingRunner::do_baseline_run', level="debug")
-
-    # saving the batch interface from the config, to restore it later
-    config_batch_interface = self.batch_interface.interface
-
     args = self._config.get_args(target_config.get_build(), target_config.get_target())
+    run_keys = self.get_run_keys(target_config, args)
+    cached = self.get_cached_baselines(run_keys)
+    if all(cached):
+      run_result = M.RunResultSeries(reps=self.get_num_repetitions(), num_data_sets=5)
+      for runtimes in cached:
+        for runtime in runtimes:
+          run_result.add_values(runtime, self.get_num_repetitions())
+      return run_result
+
+    # One job array for all args, even if some are in the run history
+    key = self.dispatch_array_run(target_config, args)
+    run_result = self.collect_array_run(key, target_config, args)
+    self.record_runs('baseline', run_keys, self.get_runtimes_per_arg(run_result))
+    return run_result
 
-    # List of command_result_maps for all args
-    cmd_maps = []
-    jobs = []
-
-    # check if interface for dispatching adheres to rule 1), see class docstring
-    if self.batch_interface.interface == SlurmInterfaces.SBATCH_WAIT:
-      L.get_logger().log(
-          "SlurmScalingRunner::do_baseline_run: Interface 'sbatch-wait' is a blocking "
-          "dispatch interface, which cannot be used with scaling experiments. "
-          "Downgrading to 'os'.",
-          level="warn")
-      self.batch_interface.interface = SlurmInterfaces.OS
-    # dispatch job for each arg
-    for i, arg in enumerate(args):
-      # setup args for invocation
+  def get_runtimes_per_arg(self, run_result: RunResultSeries) -> typing.List[typing.List[float]]:
+    runtimes = []
+    start = 0
+    for reps in run_result.get_data_set_reps():
+      runtimes.append(run_result.rt_values[start:start + reps])
+      start += reps
+    return runtimes
+
+  def dispatch_array_run(self,
+                         target_config: TargetConfig,
+                         args,
+                         exp_dirs: typing.List[str] = None) -> str:
+    """
+    Dispatches the repetitions of all args as one job array.
+    :param exp_dirs: For profile runs, the Score-P experiment directory per arg.
+    :return: The key of the job array.
+    """
+    commands = []
+    for arg in args:
       target_config.set_args_for_invocation(arg)
-      # List of tupels (iteration number, key)
-      command_result_map: typing.List[typing.Tuple[int, str]] = []
-      # if force sequential: add dependency to job_id before
-      if self.force_sequential and i > 0:
-        self.batch_interface.generator.config.dependencies = f"afterok:{jobs[i-1]}"
-      else:
-        self.batch_interface.generator.config.dependencies = ""
-      job_id = self.dispatch_run(target_config, InstrumentConfig(), command_result_map)
-      jobs.append(job_id)
-      cmd_maps.append(command_result_map)
+      commands.append(self.get_run_command(target_config))
+    preparation_commands = None
+    if exp_dirs is not None:
+      preparation_commands = [
+          f"export SCOREP_EXPERIMENT_DIRECTORY={exp_dir}-$SLURM_ARRAY_TASK_ID"
+          for exp_dir in exp_dirs
+      ]
+    key = U.generate_random_string()
+    self.batch_interface.add_timed_command_array(key, commands, preparation_commands)
+    self.batch_interface.generator.config.dependencies = ""
+    L.get_logger().log(
+        f"SlurmScalingRunner::dispatch_array_run: Dispatching {len(commands)} args with "
+        f"{self.get_num_repetitions()} repetitions each as one job array",
+        level="debug")
+    self.dispatch(key)
+    return key
 
-    # waiting needs to be done with non-blocking wait 'os' - rule 2)s
-    if self.batch_interface.interface != SlurmInterfaces.OS:
-      L.get_logger().log(
-          f"SlurmScalingRunner::do_baseline_run: {str(self.batch_interface.interface)} is a blocking "
-          "wait interface, which cannot be used with scaling experiments."
-          " Downgrading to 'os'.",
-          level="warn")
-      self.batch_interface.interface = SlurmInterfaces.OS
-    # wait for the group of all jobs to finish
-    self.wait_run()
+  def collect_array_run(self,
+                        key: str,
+                        target_config: TargetConfig,
+                        args,
+                        tool_map=None,
+                        instr_iteration: int = None) -> RunResultSeries:
+    """
+    Waits for the job array and collects the results of each arg, as soon as all of its
+    repetitions finished.
+    """
+    cmd_maps = []
+    task_args = {}
+    for i in range(len(args)):
+      task_ids = self.batch_interface.get_array_task_ids(key, i)
+      # List of tupels (task id, key)
+      cmd_maps.append([(task_id, key) for task_id in task_ids])
+      for task_id in task_ids:
+        task_args[task_id] = i
+    pending = [len(cmd_map) for cmd_map in cmd_maps]
+    time_series = [None] * len(args)
+
+    def on_result(result_key: str, task_id: int) -> None:
+      i = task_args[task_id]
+      pending[i] -= 1
+      if pending[i] > 0:
+        return
+      L.get_logger().log(f"SlurmScalingRunner::collect_array_run: Arg {i} finished", level="debug")
+      # args overwrite each other, so we have to do this also before evaluating, to process for the correct args
+      target_config.set_args_for_invocation(args[i])
+      time_series[i] = M.RunResultSeries(reps=self.get_num_repetitions())
+      if tool_map is None:
+        self.collect_run(cmd_maps[i], time_series[i])
+      else:
+        # get score-p related helpers again, were set up before dispatching
+        scorep_helper, instrument_config = tool_map[i]
+        # read from the repetition cube-dirs of the task ids
+        self.collect_run(cmd_maps[i],
+                         time_series[i],
+                         scorep_helper,
+                         target_config,
+                         instrument_config,
+                         instr_iteration,
+                         append_repetition=True)
+
+    # the job array is queued now, time for other work
+    self.run_idle_task()
+    self.batch_interface.wait_for_results(on_result)
 
     run_result = M.RunResultSeries(reps=self.get_num_repetitions(), num_data_sets=5)
-    for map in cmd_maps:
-      time_series = M.RunResultSeries(reps=self.get_num_repetitions())
-      self.collect_run(map, time_series)
-      run_result.add_from(time_series)
+    for i, series in enumerate(time_series):
+      if series is None:
+        raise RuntimeError(f"SlurmScalingRunner::collect_array_run: No results for arg {i}.")
+      run_result.add_from(series)
 
     self.batch_interface.cleanup()
-    # restore the batch interface
-    self.batch_interface.interface = config_batch_interface
-
     return run_result
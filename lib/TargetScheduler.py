@@ -0,0 +1,237 @@
+"""
+File: TargetScheduler.py
+License: Part of the PIRA project. Licensed under BSD 3 clause license. See LICENSE.txt file at https://github.com/tudasc/pira
+Description: Runs the refinement pipelines of independent targets concurrently within core and memory budgets.
+"""
+
+import lib.Logging as L
+import lib.LocalScheduler as LS
+from lib.Exception import PiraException
+
+import json
+import os
+import sys
+import tempfile
+import time
+import typing
+
+
+class TargetSchedulerException(PiraException):
+
+  def __init__(self, message):
+    super().__init__(message)
+
+
+class Pipeline:
+  """
+  The build/run/analyze cycle of one target: a task that runs in a process of its own, so that
+  its working directory, environment variables and measurement system settings do not affect the
+  others. It declares the cores and the memory in GiB it needs, 0 if it declares none.
+  """
+
+  def __init__(self,
+               name: str,
+               place: str,
+               task: typing.Callable[[], None],
+               cores: int = 0,
+               memory: float = 0) -> None:
+    self.name = name
+    self.place = place
+    self.task = task
+    self.cores = cores
+    self.memory = memory
+    self.assigned_cores = []
+    self.runtime = .0
+    self.failed = False
+
+
+def get_physical_memory() -> float:
+  """ The physical memory in GiB, 0 if it is not known """
+  try:
+    return os.sysconf('SC_PAGE_SIZE') * os.sysconf('SC_PHYS_PAGES') / 2**30
+  except (ValueError, OSError):
+    return 0
+
+
+def limit_cores(nodes: typing.List[typing.List[int]], budget: int) -> typing.List[typing.List[int]]:
+  """ The first budget cores (0: all), grouped by NUMA node as in nodes """
+  if budget <= 0:
+    return [list(cores) for cores in nodes]
+  limited = []
+  for cores in nodes:
+    if budget <= 0:
+      break
+    limited.append(list(cores[:budget]))
+    budget -= len(limited[-1])
+  return limited
+
+
+def take_cores(free_nodes: typing.List[typing.List[int]], count: int) -> typing.List[int]:
+  """
+  Removes count cores from the free cores per NUMA node and returns them: from the node with the
+  fewest free cores that has enough of them, otherwise from the nodes with the most free cores.
+  """
+  fitting = [cores for cores in free_nodes if len(cores) >= count]
+  if fitting:
+    node = min(fitting, key=len)
+    taken = node[:count]
+    del node[:count]
+    return taken
+  taken = []
+  for node in sorted(free_nodes, key=len, reverse=True):
+    num = min(count - len(taken), len(node))
+    taken += node[:num]
+    del node[:num]
+    if len(taken) == count:
+      break
+  return taken
+
+
+def return_cores(free_nodes: typing.List[typing.List[int]], nodes: typing.List[typing.List[int]],
+                 cores: typing.List[int]) -> None:
+  """ Puts the cores back into the free cores of their NUMA node """
+  for free, node in zip(free_nodes, nodes):
+    free += [core for core in cores if core in node]
+    free.sort()
+
+
+class TargetScheduler:
+  """
+  Runs pipelines concurrently, each in a forked process pinned to cores that no other running
+  pipeline uses, as long as their cores and their declared memory fit into the budgets. Pipelines
+  without declared cores get an even share of the cores. Pipelines of the same place, i.e., build
+  directory, run one after another, as they build into the same directory. The memory is a
+  declaration the scheduler plans with, it is not enforced.
+  """
+
+  def __init__(self, max_concurrent: int, core_budget: int = 0, memory_budget: float = 0) -> None:
+    if max_concurrent < 1:
+      raise TargetSchedulerException('TargetScheduler: At least one target has to run at a time')
+    self._nodes = limit_cores(LS.get_numa_nodes(), core_budget)
+    self._num_cores = sum(len(cores) for cores in self._nodes)
+    if core_budget > self._num_cores:
+      L.get_logger().log('TargetScheduler: Only ' + str(self._num_cores) +
+                         ' cores available, using them as the core budget',
+                         level='warn')
+    self._max_concurrent = max_concurrent
+    self._memory_budget = memory_budget if memory_budget > 0 else get_physical_memory()
+
+  def get_max_concurrent(self) -> int:
+    return self._max_concurrent
+
+  def get_num_cores(self) -> int:
+    return self._num_cores
+
+  def get_memory_budget(self) -> float:
+    return self._memory_budget
+
+  def get_demand(self, pipeline: Pipeline) -> typing.Tuple[int, float]:
+    """ The cores and the memory of the pipeline, at most the budgets, so that it can run alone """
+    cores = pipeline.cores
+    if cores <= 0:
+      cores = max(1, self._num_cores // self._max_concurrent)
+    if cores > self._num_cores:
+      L.get_logger().log('TargetScheduler: ' + pipeline.name + ' declares ' + str(cores) +
+                         ' cores, more than the budget of ' + str(self._num_cores),
+                         level='warn')
+      cores = self._num_cores
+    memory = pipeline.memory
+    if self._memory_budget > 0 and memory > self._memory_budget:
+      L.get_logger().log('TargetScheduler: ' + pipeline.name + ' declares ' + str(memory) +
+                         ' GiB, more than the budget of ' + str(self._memory_budget) + ' GiB',
+                         level='warn')
+      memory = self._memory_budget
+    return cores, memory
+
+  def run(self, pipelines: typing.List[Pipeline]) -> typing.List[Pipeline]:
+    """
+    Starts the pipelines in their order, a later one first if an earlier one does not fit yet, and
+    sets their wall time. Returns once all of them have finished; raises if one of them failed.
+    """
+    demands = {id(pipeline): self.get_demand(pipeline) for pipeline in pipelines}
+    free_nodes = [list(cores) for cores in self._nodes]
+    free_memory = self._memory_budget
+    pending = list(pipelines)
+    running = {}
+
+    while pending or running:
+      for pipeline in list(pending):
+        if len(running) >= self._max_concurrent:
+          break
+        cores, memory = demands[id(pipeline)]
+        if pipeline.place in [p.place for p, _, _, _ in running.values()]:
+          continue
+        if sum(len(free) for free in free_nodes) < cores or (self._memory_budget > 0
+                                                             and memory > free_memory + 1e-9):
+          continue
+        pending.remove(pipeline)
+        pipeline.assigned_cores = take_cores(free_nodes, cores)
+        free_memory -= memory
+        log_fd, log_file = tempfile.mkstemp(prefix='pira-pipeline-', suffix='.json')
+        os.close(log_fd)
+        L.get_logger().log('TargetScheduler::run: Running ' + pipeline.name + ' on cores ' +
+                           str(pipeline.assigned_cores),
+                           level='info')
+        pid = self.start(pipeline, log_file)
+        running[pid] = (pipeline, memory, log_file, time.perf_counter())
+
+      pid, status = os.waitpid(-1, 0)
+      if pid not in running:
+        continue
+      pipeline, memory, log_file, start = running.pop(pid)
+      pipeline.runtime = time.perf_counter() - start
+      pipeline.failed = not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0
+      return_cores(free_nodes, self._nodes, pipeline.assigned_cores)
+      free_memory += memory
+      self.collect_log(log_file)
+      L.get_logger().log('[PIPELINE] ' + pipeline.name + ' ' + str(pipeline.runtime), level='perf')
+      if pipeline.failed:
+        L.get_logger().log('TargetScheduler::run: ' + pipeline.name + ' failed', level='error')
+
+    failed = [pipeline.name for pipeline in pipelines if pipeline.failed]
+    if failed:
+      raise TargetSchedulerException('TargetScheduler::run: ' + str(len(failed)) + ' of ' +
+                                     str(len(pipelines)) + ' targets failed: ' + ', '.join(failed))
+    return pipelines
+
+  @staticmethod
+  def start(pipeline: Pipeline, log_file: str) -> int:
+    # Output that is still buffered would be written by both processes
+    sys.stdout.flush()
+    sys.stderr.flush()
+    pid = os.fork()
+    if pid != 0:
+      return pid
+
+    # The child never returns: the caller's cleanup, e.g., dumping the tape, belongs to the parent
+    exit_code = 1
+    logger = L.get_logger()
+    logger.tape = []
+    logger.perf_tape = []
+    try:
+      os.sched_setaffinity(0, pipeline.assigned_cores)
+      pipeline.task()
+      exit_code = 0
+    except BaseException as e:
+      L.get_logger().log('TargetScheduler: ' + pipeline.name + ' failed: ' + str(e), level='error')
+    finally:
+      try:
+        with open(log_file, 'w') as f:
+          json.dump({'tape': logger.tape, 'perf': logger.perf_tape}, f)
+      finally:
+        sys.stdout.flush()
+        sys.stderr.flush()
+        os._exit(exit_code)
+
+  @staticmethod
+  def collect_log(log_file: str) -> None:
+    """ Adds the tape and the performance log of a finished pipeline to the ones of PIRA """
+    try:
+      with open(log_file) as f:
+        log = json.load(f)
+      L.get_logger().tape += log['tape']
+      L.get_logger().perf_tape += log['perf']
+    except (OSError, ValueError, KeyError):
+      L.get_logger().log('TargetScheduler::collect_log: No log in ' + log_file, level='warn')
+    if os.path.exists(log_file):
+      os.remove(log_file)
@@ -11,6 +11,8 @@ sys.path.append('..')
 import lib.Logging as L
 from lib.Exception import PiraException
 
+import hashlib
+import json
 import os
 import subprocess
 import filecmp
@@ -293,6 +295,15 @@ def set_env(env_var: str, val) -> None:
   os.environ[env_var] = val
 
 
+def unset_env(env_var: str) -> None:
+  L.get_logger().log('Utility::unset_env: Removing ' + env_var, level='debug')
+  os.environ.pop(env_var, None)
+
+
+def get_env_with_prefix(prefix: str) -> typing.Dict[str, str]:
+  return {k: v for k, v in os.environ.items() if k.startswith(prefix)}
+
+
 def generate_random_string() -> str:
   return ''.join(choice(ascii_uppercase) for i in range(12))
 
@@ -436,6 +447,340 @@ def build_instr_file_path(analyzer_dir: str, flavor: str, benchmark_name: str) -
   return analyzer_dir + "/" + 'out/instrumented-' + benchmark_name + '_' + flavor + '.txt'
 
 
+def build_overhead_report_path(instr_file: str) -> str:
+  return os.path.splitext(instr_file)[0] + '-overhead.jsonl'
+
+
+def read_overhead_report(report_file: str) -> typing.Dict[str, str]:
+  """
+  Reads the report of the overhead budget of the instrumentation plugin, one JSON object per line.
+  Returns the action ('drop' or 'downgrade') per function; a function that is compiled into
+  several objects keeps the action of its last entry.
+  """
+  actions = {}
+  for line in read_file(report_file).splitlines():
+    if line.strip():
+      entry = json.loads(line)
+      actions[entry['function']] = entry['action']
+  return actions
+
+
+def remove_functions_from_instr_file(instr_file: str, functions: typing.Iterable[str]) -> int:
+  """
+  Removes the functions from the INCLUDE rules of the Score-P filter file of the instrumentation.
+  Loop, parallel region and call site rules of the functions stay. A rule without patterns left
+  is removed with its keywords, lines that become empty are removed.
+  Returns the number of removed patterns.
+  """
+  functions = set(functions)
+  lines = read_file(instr_file).splitlines()
+  removed_tokens = []
+  removed = 0
+  for rule in parse_scorep_filter(lines):
+    if not rule['include'] or any(modifier != 'MANGLED' for modifier in rule['modifiers']):
+      continue
+    dropped = [
+        pattern for pattern in rule['patterns']
+        if not pattern['call_site'] and pattern['name'] in functions
+    ]
+    if not dropped:
+      continue
+    removed += len(dropped)
+    for pattern in dropped:
+      removed_tokens += pattern['tokens']
+    if len(dropped) == len(rule['patterns']):
+      removed_tokens += rule['keywords']
+  if removed == 0:
+    return 0
+
+  kept = []
+  for line_nr, line in enumerate(lines):
+    spans = sorted(((start, end) for _, nr, start, end in removed_tokens if nr == line_nr),
+                   reverse=True)
+    if not spans:
+      kept.append(line)
+      continue
+    for start, end in spans:
+      line = line[:start] + line[end:]
+    if line.strip():
+      kept.append(line.rstrip())
+  write_file(instr_file, '\n'.join(kept) + '\n')
+  return removed
+
+
+def build_manifest_dir(build_dir: str, benchmark_name: str, flavor: str) -> str:
+  return os.path.join(build_dir, '.pira-manifests-' + benchmark_name + '_' + flavor)
+
+
+def build_manifest_state_path(manifest_dir: str) -> str:
+  return os.path.join(manifest_dir, 'build.state')
+
+
+def parse_scorep_filter(lines: typing.List[str]) -> typing.List[dict]:
+  """
+  Parses the rules of a Score-P filter file like the instrumentation plugin does, but skips
+  malformed parts instead of rejecting the file.
+  Returns one dict per INCLUDE or EXCLUDE rule with include, its modifiers (MANGLED, LOOPS[=<depth>],
+  PARALLEL), its keyword tokens and its patterns. Every pattern has its name, which is the mangled
+  name of the 'name MANGLED mangled' form, the name of its callee for call site rules ('caller ->
+  callee', None for INDIRECT), and its tokens. Tokens are tuples of text, line, start and end column.
+  """
+  tokens = []
+  for line_nr, line in enumerate(lines):
+    for match in re.finditer(r'#|[^ \t\r#]+', line):
+      if match.group() == '#':
+        break
+      tokens.append((match.group(), line_nr, match.start(), match.end()))
+
+  def is_keyword(text: str) -> bool:
+    return text in ('SCOREP_REGION_NAMES_BEGIN', 'SCOREP_REGION_NAMES_END', 'INCLUDE', 'EXCLUDE',
+                    'MANGLED', 'LOOPS', 'PARALLEL', '->') or text.startswith('LOOPS=')
+
+  def read_name(pos: int) -> typing.Tuple[str, list, int]:
+    name = tokens[pos][0]
+    name_tokens = [tokens[pos]]
+    pos += 1
+    if pos + 1 < len(tokens) and tokens[pos][0] == 'MANGLED' and not is_keyword(tokens[pos + 1][0]):
+      name = tokens[pos + 1][0]
+      name_tokens += tokens[pos:pos + 2]
+      pos += 2
+    return name, name_tokens, pos
+
+  rules = []
+  rule = None
+  pos = 0
+  while pos < len(tokens):
+    text = tokens[pos][0]
+    if text in ('INCLUDE', 'EXCLUDE'):
+      rule = {
+          'include': text == 'INCLUDE',
+          'modifiers': [],
+          'keywords': [tokens[pos]],
+          'patterns': []
+      }
+      rules.append(rule)
+    elif rule is not None and not rule['patterns'] and (text in ('MANGLED', 'LOOPS', 'PARALLEL')
+                                                        or text.startswith('LOOPS=')):
+      rule['modifiers'].append(text)
+      rule['keywords'].append(tokens[pos])
+    elif rule is not None and not is_keyword(text):
+      name, pattern_tokens, pos = read_name(pos)
+      call_site = pos + 1 < len(tokens) and tokens[pos][0] == '->'
+      callee = None
+      if call_site:
+        pattern_tokens.append(tokens[pos])
+        if tokens[pos + 1][0] == 'INDIRECT':
+          pattern_tokens.append(tokens[pos + 1])
+          pos += 2
+        else:
+          callee, callee_tokens, pos = read_name(pos + 1)
+          pattern_tokens += callee_tokens
+      rule['patterns'].append({
+          'name': name,
+          'call_site': call_site,
+          'callee': callee,
+          'tokens': pattern_tokens
+      })
+      continue
+    else:
+      # SCOREP_REGION_NAMES_BEGIN / END, or a malformed part
+      rule = None
+    pos += 1
+  return rules
+
+
+def read_instr_file_names(instr_file: str) -> typing.Set[str]:
+  """
+  Returns the names in the Score-P filter file of the instrumentation: the patterns of the
+  function rules, and the callers and callees of the call site rules ('caller -> callee').
+  """
+  names = set()
+  for rule in parse_scorep_filter(read_file(instr_file).splitlines()):
+    for pattern in rule['patterns']:
+      names.add(pattern['name'])
+      if pattern['callee'] is not None:
+        names.add(pattern['callee'])
+  return names
+
+
+def read_instrumentation_manifests(manifest_dir: str) -> typing.List[typing.Tuple[str, dict]]:
+  """
+  Reads the manifests that the instrumentation plugin wrote per translation unit.
+  Returns the file and the content of every manifest.
+  """
+  manifests = []
+  for f in sorted(os.listdir(manifest_dir)):
+    if f.endswith('.json'):
+      manifest_file = os.path.join(manifest_dir, f)
+      manifests.append((manifest_file, json.loads(read_file(manifest_file))))
+  return manifests
+
+
+def get_sources_to_rebuild(manifests: typing.List[typing.Tuple[str, dict]],
+                           changed_names: typing.Set[str]) -> typing.Set[str]:
+  """
+  Returns the sources of the translation units whose instrumentation depends on one of the names
+  that were added to or removed from the instrumentation file.
+  """
+  return {
+      manifest['source']
+      for _, manifest in manifests if not changed_names.isdisjoint(manifest['names'])
+  }
+
+
+def build_remarks_dir(build_dir: str, benchmark_name: str, flavor: str) -> str:
+  return os.path.join(build_dir, '.pira-remarks-' + benchmark_name + '_' + flavor)
+
+
+def build_instrumentation_report_path(instr_file: str, iteration: int) -> str:
+  return os.path.splitext(instr_file)[0] + '-report-' + str(iteration) + '.json'
+
+
+def parse_yaml_scalar(value: str) -> str:
+  """ Unquotes a scalar of the YAML remarks of LLVM """
+  value = value.strip()
+  if len(value) > 1 and value[0] == value[-1] == "'":
+    return value[1:-1].replace("''", "'")
+  if len(value) > 1 and value[0] == value[-1] == '"':
+    return json.loads(value)
+  return value
+
+
+def parse_instrumentation_remarks(content: str) -> typing.List[dict]:
+  """
+  Parses the YAML remarks that LLVM writes, as far as the instrumentation plugin uses them.
+  Returns one dict per remark with its type ('Passed' or 'Missed'), Pass, Name, Function, the
+  File and Line of its location, and the named arguments, e.g., Kind, Region and Reason.
+  """
+  remarks = []
+  remark = None
+  debug_loc = None
+  for line in content.splitlines():
+    if line.startswith('--- !'):
+      remark = {'type': line[5:].strip()}
+      remarks.append(remark)
+      continue
+    if line.startswith('...'):
+      remark = None
+    if remark is None:
+      continue
+    # Flow mappings of locations may be wrapped
+    if line.startswith('DebugLoc:'):
+      debug_loc = line[len('DebugLoc:'):]
+    elif debug_loc is not None:
+      debug_loc += ' ' + line.strip()
+    if debug_loc is not None:
+      if '}' in debug_loc:
+        for field in debug_loc.strip().strip('{}').split(','):
+          key, _, value = field.partition(':')
+          if key.strip() in ('File', 'Line'):
+            remark[key.strip()] = parse_yaml_scalar(value)
+        debug_loc = None
+      continue
+    if line.startswith('  - '):
+      key, _, value = line[4:].partition(':')
+      if key != 'String':
+        remark[key] = parse_yaml_scalar(value)
+    elif not line.startswith(' ') and ':' in line:
+      key, _, value = line.partition(':')
+      if key != 'Args':
+        remark[key] = parse_yaml_scalar(value)
+  return remarks
+
+
+def read_instrumentation_remarks(remarks_dir: str) -> typing.List[dict]:
+  """
+  Reads the remarks that the instrumentation plugin wrote per translation unit.
+  """
+  remarks = []
+  if not check_provided_directory(remarks_dir):
+    return remarks
+  for f in sorted(os.listdir(remarks_dir)):
+    if f.endswith('.opt.yaml'):
+      remarks += parse_instrumentation_remarks(read_file(os.path.join(remarks_dir, f)))
+  return remarks
+
+
+def summarize_instrumentation_remarks(remarks: typing.List[dict]) -> dict:
+  """
+  Combines the remarks of a build into the instrumentation report: the number of instrumented
+  regions per kind and of skipped regions per reason, and the regions themselves. Regions that
+  several translation units report, e.g., inline functions, count once.
+  """
+  instrumented = set()
+  skipped = set()
+  for remark in remarks:
+    location = (remark.get('File', ''), int(remark.get('Line', 0)))
+    region = (remark.get('Function', ''), remark.get('Kind', ''), remark.get('Region', ''))
+    if remark['type'] == 'Passed':
+      instrumented.add(region + location)
+    elif remark['type'] == 'Missed':
+      skipped.add(region + location + (remark.get('Reason', ''), ))
+
+  keys = ['function', 'kind', 'region', 'file', 'line']
+  report = {'instrumented': {}, 'skipped': {}, 'regions': [], 'skipped_regions': []}
+  for entry in sorted(instrumented):
+    report['instrumented'][entry[1]] = report['instrumented'].get(entry[1], 0) + 1
+    report['regions'].append(dict(zip(keys, entry)))
+  for entry in sorted(skipped):
+    report['skipped'][entry[5]] = report['skipped'].get(entry[5], 0) + 1
+    report['skipped_regions'].append(dict(zip(keys + ['reason'], entry)))
+  return report
+
+
+def build_features_dir(build_dir: str, benchmark_name: str, flavor: str) -> str:
+  return os.path.join(build_dir, '.pira-features-' + benchmark_name + '_' + flavor)
+
+
+def get_function_features_files(features_dir: str) -> typing.List[str]:
+  """
+  Returns the function features that the instrumentation plugin wrote per translation unit.
+  """
+  if not check_provided_directory(features_dir):
+    return []
+  return [
+      os.path.join(features_dir, f) for f in sorted(os.listdir(features_dir))
+      if f.endswith('.features.json')
+  ]
+
+
+def build_call_graph_merge_command(features_dir: str, ipcg_file: str) -> str:
+  return 'pira-cg-merge -o ' + ipcg_file + ' ' + features_dir
+
+
+def get_executables_digest(directory: str) -> str:
+  """
+  Returns a digest of the ELF executables and shared libraries below directory, i.e., of the build
+  that a run invokes. Hidden directories, e.g., the build manifests, are skipped.
+  """
+  digest = hashlib.sha256()
+  for root, dirs, files in os.walk(directory):
+    dirs[:] = sorted(d for d in dirs if not d.startswith('.'))
+    for f in sorted(files):
+      path = os.path.join(root, f)
+      if os.path.islink(path) or not os.path.isfile(path):
+        continue
+      if not (os.access(path, os.X_OK) or f.endswith('.so') or '.so.' in f):
+        continue
+      with open(path, 'rb') as binary:
+        if binary.read(4) != b'\x7fELF':
+          continue
+        digest.update(os.path.relpath(path, directory).encode() + b'\0')
+        binary.seek(0)
+        for chunk in iter(lambda: binary.read(1 << 20), b''):
+          digest.update(chunk)
+  return digest.hexdigest()
+
+
+def get_run_key(**fields) -> str:
+  """ Returns a digest of everything that determines the result of a run """
+  return hashlib.sha256(json.dumps(fields, sort_keys=True).encode()).hexdigest()
+
+
+def touch_file(path: str) -> None:
+  os.utime(path)
+
+
 def build_numbered_instr_file_path(analyzer_dir: str, flavor: str, benchmark_name: str,
                                    iteration_number: int) -> str:
   return analyzer_dir + "/" + 'out/instrumented-' + benchmark_name + '_' + flavor + '_it-' + str(
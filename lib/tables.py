@@ -43,3 +43,16 @@ create_experiment_table = """ CREATE TABLE IF NOT EXISTS Experiment (
                                         Item_ID text NOT NULL,
                                         FOREIGN KEY(Item_ID) REFERENCES Items(ItemID)
                                     ); """
+
+create_run_history_table = """ CREATE TABLE IF NOT EXISTS RunHistory (
+                                        Run_Key text NOT NULL,
+                                        Series_ID text NOT NULL,
+                                        Kind text NOT NULL,
+                                        Iteration INTEGER,
+                                        Repetition INTEGER NOT NULL,
+                                        Runtime REAL NOT NULL,
+                                        Created REAL NOT NULL
+                                    ); """
+
+create_run_history_index = """ CREATE INDEX IF NOT EXISTS RunHistory_Key
+                                        ON RunHistory(Run_Key, Kind, Created); """
@@ -83,6 +83,90 @@ experimental_group.add_argument('--hybrid-filter-iters',
                                 help='Do compiletime-filtering after x iterations',
                                 default=0,
                                 type=int)
+experimental_group.add_argument(
+    '--runtime-guards',
+    help='Build once with per-function enable guards and select the functions at runtime',
+    default=False,
+    action='store_true')
+experimental_group.add_argument(
+    '--overhead-budget',
+    help='Do not instrument functions whose hooks cost more than this percentage of a call '
+    '(static estimate)',
+    type=float,
+    default=0)
+experimental_group.add_argument(
+    '--incremental-rebuild',
+    help='Rebuild only the translation units whose instrumentation changes between iterations '
+    '(compile-time filtering with make-like builds)',
+    default=False,
+    action='store_true')
+experimental_group.add_argument(
+    '--local-concurrency',
+    help='Run up to this many local repetitions and scaling points at a time, each pinned to its '
+    'own cores',
+    default=1,
+    type=int)
+experimental_group.add_argument(
+    '--cores-per-run',
+    help='Cores per concurrent local run (default: the cores divided evenly)',
+    default=0,
+    type=int)
+experimental_group.add_argument(
+    '--interference-tolerance',
+    help='Slowdown in percent of concurrent local runs over a serial reference run, above which '
+    'PIRA runs serially again',
+    default=10,
+    type=float)
+experimental_group.add_argument(
+    '--confidence-width',
+    help='Stop repeating local measurements once the 95%% confidence interval of the runtime is '
+    'narrower than this percentage of the mean; --repetitions is the maximum (default 0: off)',
+    default=0,
+    type=float)
+experimental_group.add_argument('--min-repetitions',
+                                help='Fewest repetitions with --confidence-width',
+                                default=2,
+                                type=int)
+experimental_group.add_argument(
+    '--overlap-builds',
+    help='Build the next target while the batch jobs of the current one are queued, if it is in '
+    'another directory',
+    default=False,
+    action='store_true')
+experimental_group.add_argument(
+    '--reuse-baseline',
+    help='Reuse the baseline runtimes of an earlier invocation for unchanged executables and args',
+    default=False,
+    action='store_true')
+experimental_group.add_argument(
+    '--instrumentation-report',
+    help='Write a report of the regions that the instrumentation plugin instrumented and skipped per '
+    'iteration',
+    default=False,
+    action='store_true')
+experimental_group.add_argument(
+    '--call-graph-from-build',
+    help='Build the call graph for the analysis from the function features that the instrumentation '
+    'plugin writes during the vanilla build',
+    default=False,
+    action='store_true')
+experimental_group.add_argument(
+    '--concurrent-targets',
+    help='Refine up to this many (build, item, flavor) targets at a time, each in a process of its '
+    'own within the core and memory budgets; not with Extra-P or a batch system',
+    default=1,
+    type=int)
+experimental_group.add_argument(
+    '--core-budget',
+    help='Cores for the concurrent targets (default 0: all cores PIRA may use)',
+    default=0,
+    type=int)
+experimental_group.add_argument(
+    '--memory-budget',
+    help='Memory in GiB for the concurrent targets, as declared by their items (default 0: the '
+    'physical memory)',
+    default=0,
+    type=float)
 experimental_group.add_argument('--export',
                                 help='Export performance models to IPCG file.',
                                 default=False,
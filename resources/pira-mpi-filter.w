@@ -0,0 +1,95 @@
+/*
+ * File: pira-mpi-filter.w
+ * License: Part of the PIRA project. Licensed under BSD 3 clause license. See LICENSE.txt file at https://github.com/tudasc/pira
+ * Description: Template of the MPI filter library for LLNL's wrap.py. PIRA generates and compiles it once; the
+ * library is loaded with LD_PRELOAD.
+ *
+ * Every wrapped MPI function has a dense ID. At MPI_Init, the library reads the names of the measured MPI functions
+ * from the file in PIRA_MPI_FILTER into a bitmap, one name per line. Calls of measured functions are forwarded to the
+ * next definition, i.e., the wrapper of Score-P; all other calls go to the PMPI function directly. Without a filter
+ * file, all functions are measured.
+ *
+ * MPI_Init, MPI_Init_thread, MPI_Finalize and the communicator and group management are always measured, Score-P
+ * needs them to work correctly. MPI_Pcontrol is variadic and not wrapped.
+ */
+
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum pira_mpi_function {
+{{forallfn fn_name MPI_Init MPI_Init_thread MPI_Finalize MPI_Comm_group MPI_Comm_dup MPI_Comm_create_group MPI_Comm_split MPI_Comm_free MPI_Group_free MPI_Pcontrol}}
+  PIRA_MPI_{{fn_name}},
+{{endforallfn}}
+  PIRA_MPI_NUM_FUNCTIONS
+};
+
+static const char *pira_mpi_function_names[] = {
+{{forallfn fn_name MPI_Init MPI_Init_thread MPI_Finalize MPI_Comm_group MPI_Comm_dup MPI_Comm_create_group MPI_Comm_split MPI_Comm_free MPI_Group_free MPI_Pcontrol}}
+  "{{fn_name}}",
+{{endforallfn}}
+};
+
+static uint64_t pira_mpi_measured[(PIRA_MPI_NUM_FUNCTIONS + 63) / 64];
+
+#define PIRA_MPI_IS_MEASURED(id) ((pira_mpi_measured[(id) / 64] >> ((id) % 64)) & 1u)
+
+static void pira_mpi_filter_measure(int id) { pira_mpi_measured[id / 64] |= (uint64_t)1 << (id % 64); }
+
+static void pira_mpi_filter_read(void) {
+  const char *filter_file = getenv("PIRA_MPI_FILTER");
+  FILE *filter = filter_file ? fopen(filter_file, "r") : NULL;
+  if (!filter) {
+    for (int id = 0; id < PIRA_MPI_NUM_FUNCTIONS; ++id) {
+      pira_mpi_filter_measure(id);
+    }
+    return;
+  }
+
+  memset(pira_mpi_measured, 0, sizeof(pira_mpi_measured));
+  char line[1024];
+  while (fgets(line, sizeof(line), filter)) {
+    line[strcspn(line, " \t\r\n")] = '\0';
+    for (int id = 0; id < PIRA_MPI_NUM_FUNCTIONS; ++id) {
+      if (strcmp(line, pira_mpi_function_names[id]) == 0) {
+        pira_mpi_filter_measure(id);
+        break;
+      }
+    }
+  }
+  fclose(filter);
+}
+
+/* Calls the next definition of the function, the PMPI function if there is none */
+{{fn fn_name MPI_Init MPI_Init_thread}}
+  pira_mpi_filter_read();
+  typedef {{ret_type}} (*pira_next_t)({{formals}});
+  static pira_next_t pira_next = NULL;
+  if (!pira_next) {
+    pira_next = (pira_next_t)dlsym(RTLD_NEXT, "{{fn_name}}");
+  }
+  if (pira_next) {
+    {{ret_val}} = pira_next({{args}});
+  } else {
+    {{callfn}}
+  }
+{{endfn}}
+
+{{fnall fn_name MPI_Init MPI_Init_thread MPI_Finalize MPI_Comm_group MPI_Comm_dup MPI_Comm_create_group MPI_Comm_split MPI_Comm_free MPI_Group_free MPI_Pcontrol}}
+  typedef {{ret_type}} (*pira_next_t)({{formals}});
+  static pira_next_t pira_next = NULL;
+  if (PIRA_MPI_IS_MEASURED(PIRA_MPI_{{fn_name}})) {
+    if (!pira_next) {
+      pira_next = (pira_next_t)dlsym(RTLD_NEXT, "{{fn_name}}");
+    }
+    if (pira_next) {
+      {{ret_val}} = pira_next({{args}});
+    } else {
+      {{callfn}}
+    }
+  } else {
+    {{callfn}}
+  }
+{{endfnall}}
@@ -4,8 +4,12 @@ License: Part of the PIRA project. Licensed under BSD 3 clause license. See LICE
 Description: Tests for the BatchSystemBackends modules.
 """
 
+import os
+import subprocess
 import unittest
 from lib.BatchSystemBackends import *
+from lib.Configuration import InvocationConfig, TargetConfig
+from lib.Runner import SlurmScalingRunner
 
 
 class BatchSystemInterfaceTests(unittest.TestCase):
@@ -276,3 +280,166 @@ class SlurmBackendTest(unittest.TestCase):
 
 
 
+
+
+class MockSlurmGenerator(SlurmGenerator):
+  """
+  Local mock of SLURM: runs the tasks of the submitted job arrays with bash, one task per squeue
+  query and the last task first.
+  """
+
+  def __init__(self, slurm_config: SlurmConfig) -> None:
+    super().__init__(slurm_config)
+    self.queued = []
+    self.scripts = []
+
+  def sbatch(self, script_path=None, active=False, wait=False, load_modules=False):
+    self.to_slurm_options()
+    job_id = 1000 + len(self.scripts)
+    script = ";".join(self.commands)
+    self.scripts.append((self.slurm_options["--array"], script))
+    first, rest = self.slurm_options["--array"].split("-")
+    last, step = rest.split(":")
+    for task_id in reversed(range(int(first), int(last) + 1, int(step))):
+      self.queued.append((job_id, task_id, script))
+    return job_id
+
+  def get_queued_array_tasks(self, job_ids):
+    if self.queued:
+      job_id, task_id, script = self.queued.pop(0)
+      env = dict(os.environ)
+      env["SLURM_ARRAY_JOB_ID"] = str(job_id)
+      env["SLURM_ARRAY_TASK_ID"] = str(task_id)
+      subprocess.run(["bash", "-c", script], env=env, check=True, stdout=subprocess.DEVNULL)
+    return {(str(job_id), str(task_id)) for job_id, task_id, _ in self.queued if job_id in job_ids}
+
+
+class SlurmBackendArrayTest(unittest.TestCase):
+  """
+  Tests for command arrays of the SlurmBackend, against the local mock of SLURM.
+  """
+
+  def setUp(self) -> None:
+    self.si = SlurmBackend(backend_type=BatchSystemBackendType.SLURM,
+                           interface_type=SlurmInterfaces.OS,
+                           timing_type=BatchSystemTimingType.SUBPROCESS)
+    # three repetitions per command
+    self.slurm_conf = SlurmConfig(job_array_start=0, job_array_end=2, check_interval_in_seconds=0)
+    self.generator = MockSlurmGenerator(self.slurm_conf)
+    self.si.configure(self.slurm_conf, self.generator)
+    self.key = U.generate_random_string()
+
+  def tearDown(self) -> None:
+    self.si.cleanup()
+
+  def test_add_timed_command_array(self):
+    self.si.add_timed_command_array(self.key, ["a.exe", "b.exe"])
+    self.assertEqual(self.si.get_array_task_ids(self.key, 0), [0, 1, 2])
+    self.assertEqual(self.si.get_array_task_ids(self.key, 1), [3, 4, 5])
+    self.assertEqual(sorted(r for _, r in self.si.results.keys()), [0, 1, 2, 3, 4, 5])
+
+  def test_array_command(self):
+    self.si.timing_type = BatchSystemTimingType.OS_TIME
+    self.si.add_timed_command_array(self.key, ["a.exe", "b.exe"], ["export X=1", "export X=2"])
+    self.assertEqual(
+        self.si.get_array_command(self.key),
+        "case $(( ($SLURM_ARRAY_TASK_ID - 0) / 1 / 3 )) in "
+        "0) export X=1; /usr/bin/time --format=%e a.exe ;; "
+        "1) export X=2; /usr/bin/time --format=%e b.exe ;; esac")
+
+  def test_dispatch_array(self):
+    self.si.add_timed_command_array(self.key, ["true", "true"])
+    self.si.dispatch(self.key)
+    # one submission for all commands, the config keeps the repetitions
+    self.assertEqual(len(self.generator.scripts), 1)
+    self.assertEqual(self.generator.scripts[0][0], "0-5:1")
+    self.assertEqual(self.slurm_conf.job_array_end, 2)
+
+  def test_wait_for_results(self):
+    self.si.add_timed_command_array(self.key, ["echo first", "echo second"])
+    self.si.dispatch(self.key)
+    collected = []
+    self.si.wait_for_results(lambda key, task_id: collected.append(task_id))
+    # every task once, in the order they finished
+    self.assertEqual(collected, [5, 4, 3, 2, 1, 0])
+    self.assertEqual(self.si.get_results(self.key, 0)[1], "first\n")
+    self.assertEqual(self.si.get_results(self.key, 4)[1], "second\n")
+
+
+class SlurmQueueTest(unittest.TestCase):
+  """
+  Tests the queries of the queue by the SlurmGenerator and the SlurmBackend, against a local squeue
+  script that fails like squeue for purged job ids.
+  """
+
+  def setUp(self) -> None:
+    self.bin_dir = U.get_tempdir() + '/pira-squeue-' + U.generate_random_string()
+    U.make_dirs(self.bin_dir)
+    self.path = os.environ['PATH']
+    U.set_env('PATH', self.bin_dir + ':' + self.path)
+    self.slurm_conf = SlurmConfig(job_array_start=0, job_array_end=1, check_interval_in_seconds=0)
+    self.generator = SlurmGenerator(self.slurm_conf)
+
+  def tearDown(self) -> None:
+    U.set_env('PATH', self.path)
+    U.remove_dir(self.bin_dir)
+
+  def write_squeue(self, output: str, exit_code: int) -> None:
+    squeue = self.bin_dir + '/squeue'
+    U.write_file(
+        squeue, '#!/bin/bash\n'
+        'if [[ "$*" == *--jobs=* ]]; then echo "Invalid job id specified" >&2; exit 1; fi\n'
+        f'printf "{output}"\nexit {exit_code}\n')
+    os.chmod(squeue, 0o755)
+
+  def test_get_queued_array_tasks(self):
+    # Job 18 finished and was purged, job 99 belongs to another run
+    self.write_squeue('17 0\\n17 1\\n99 N/A\\n', 0)
+    self.assertEqual({('17', '0'), ('17', '1')}, self.generator.get_queued_array_tasks([17, 18]))
+    self.assertEqual(set(), self.generator.get_queued_array_tasks([18]))
+
+  def test_failing_squeue(self):
+    self.write_squeue('', 1)
+    self.assertIsNone(self.generator.get_queued_array_tasks([17]))
+    si = SlurmBackend(backend_type=BatchSystemBackendType.SLURM,
+                      interface_type=SlurmInterfaces.OS,
+                      timing_type=BatchSystemTimingType.SUBPROCESS)
+    si.configure(self.slurm_conf, self.generator)
+    key = U.generate_random_string()
+    si.add_timed_command_array(key, ['true'])
+    si.job_id_map[key] = 17
+    # Transient failures are retried, but not forever
+    with self.assertRaises(RuntimeError):
+      si.wait_for_results(lambda key, task_id: None)
+    self.assertEqual(SlurmBackend.MAX_FAILED_QUEUE_QUERIES, si.failed_queue_queries)
+
+
+class SlurmScalingRunnerArrayTest(unittest.TestCase):
+  """
+  Tests the job array of the SlurmScalingRunner against the local mock of SLURM.
+  """
+
+  class ArgsConfig:
+
+    def get_args(self, build, target):
+      return ["small", "large"]
+
+  def setUp(self) -> None:
+    InvocationConfig.create_from_kwargs({'config': 'input/unit_input_004.json', 'repetitions': 3})
+    self.slurm_conf = SlurmConfig(job_array_start=0, job_array_end=2, check_interval_in_seconds=0)
+    backend = SlurmBackend(interface_type=SlurmInterfaces.OS)
+    self.runner = SlurmScalingRunner(self.ArgsConfig(), self.slurm_conf, backend, None)
+    self.generator = MockSlurmGenerator(self.slurm_conf)
+    backend.configure(self.slurm_conf, self.generator)
+    self.runner.get_run_command = lambda target_config: 'echo ' + str(
+        target_config.get_args_for_invocation())
+
+  def test_baseline_run(self):
+    idle_runs = []
+    self.runner.set_idle_task(lambda: idle_runs.append(len(self.generator.queued)))
+    rr = self.runner.do_baseline_run(TargetConfig('/tmp', '/tmp', 'item', 'flavor', ''))
+    # one job array, the idle task ran while all of its tasks were queued
+    self.assertEqual(len(self.generator.scripts), 1)
+    self.assertEqual(idle_runs, [6])
+    self.assertEqual(rr.get_data_set_reps(), [3, 3])
+    self.assertEqual(len(rr.rt_values), 6)
@@ -234,6 +234,13 @@ class TestSimplifiedConfigLoader(unittest.TestCase):
     # FIXME correct asserted args
     self.assertListEqual([tuple(x) for x in args], [('param1', 'val1'), ('param1', 'val2'), ('param1', 'val3')])
 
+  def test_config_resources(self):
+    InvocationConfig.create_from_kwargs({'config' : './input/unit_input_005.json'})
+    cfg = self.loader.load_conf()
+    b = '/this/is/my/home'
+    self.assertEqual((0, 0), cfg.get_resources(b, 'item01'))
+    self.assertEqual((4, 2.5), cfg.get_resources(b, 'item02'))
+
   def test_config_linear_mapper(self):
     InvocationConfig.create_from_kwargs({'config' : './input/unit_input_003.json'})
     cfg = self.loader.load_conf()
@@ -65,6 +65,19 @@ class TestDatabaseManip(unittest.TestCase):
     self.dbm.create_table(T.create_experiment_table)
     # XXX Add actual asserts
 
+  def test_run_history_latest_series(self):
+    self.dbm.insert_run_series([('key-a', 'baseline', None, [3.0, 1.0, 2.0]),
+                                ('key-b', 'baseline', None, [5.0])])
+    self.dbm.insert_run_series([('key-a', 'baseline', None, [4.0, 6.0])])
+    self.assertEqual(self.dbm.get_latest_run_series('key-a', 'baseline'), [4.0, 6.0])
+    self.assertEqual(self.dbm.get_latest_run_series('key-b', 'baseline'), [5.0])
+
+  def test_run_history_kind_and_missing_key(self):
+    self.dbm.insert_run_series([('key-c', 'profile', 2, [1.5, 2.5])])
+    self.assertEqual(self.dbm.get_latest_run_series('key-c', 'profile'), [1.5, 2.5])
+    self.assertEqual(self.dbm.get_latest_run_series('key-c', 'baseline'), [])
+    self.assertEqual(self.dbm.get_latest_run_series('key-missing', 'baseline'), [])
+
 
 if __name__ == '__main__':
   unittest.main()
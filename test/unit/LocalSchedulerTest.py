@@ -0,0 +1,54 @@
+"""
+File: LocalSchedulerTest.py
+License: Part of the PIRA project. Licensed under BSD 3 clause license. See LICENSE.txt file at https://github.com/tudasc/pira
+Description: Tests for the concurrent execution of local runs.
+"""
+
+import lib.LocalScheduler as LS
+import lib.Utility as U
+import unittest
+import os
+
+
+class TestLocalScheduler(unittest.TestCase):
+
+  def test_parse_cpu_list(self):
+    self.assertEqual([0, 1, 2, 3, 8, 10, 11], LS.parse_cpu_list('0-3,8,10-11\n'))
+    self.assertEqual([5], LS.parse_cpu_list('5'))
+
+  def test_partition_cores(self):
+    nodes = [[0, 1, 2, 3], [4, 5, 6, 7]]
+    self.assertEqual([[0, 1], [2, 3], [4, 5], [6, 7]], LS.partition_cores(nodes, 4, 0))
+    self.assertEqual([[0, 1, 2, 3]], LS.partition_cores(nodes, 1, 4))
+    self.assertEqual([[0, 1], [2, 3], [4, 5]], LS.partition_cores(nodes, 3, 0))
+    # Sets stay within a node as long as possible
+    self.assertEqual([[0, 1, 2], [4, 5, 6]], LS.partition_cores(nodes, 3, 3))
+    self.assertEqual([[0, 1], [3, 4], [2, 5]], LS.partition_cores([[0, 1, 2], [3, 4, 5]], 3, 2))
+    self.assertEqual([], LS.partition_cores(nodes, 2, 16))
+
+  def test_check_interference(self):
+    self.assertFalse(LS.check_interference(1.0, [1.05, 1.08], 10))
+    self.assertTrue(LS.check_interference(1.0, [1.2, 1.1], 10))
+    self.assertFalse(LS.check_interference(1.0, [], 10))
+
+  def test_run_pinned(self):
+    scheduler = LS.LocalScheduler(1, 1)
+    self.assertEqual(1, scheduler.get_max_concurrent())
+    out_file = os.path.join(U.get_tempdir(), 'pira-local-scheduler-test.txt')
+    jobs = [
+        LS.LocalJob('echo $PIRA_TEST_VALUE > ' + out_file, U.get_tempdir(),
+                    {'PIRA_TEST_VALUE': 'pinned'}),
+        LS.LocalJob('true', U.get_tempdir())
+    ]
+    scheduler.run(jobs)
+    self.assertEqual('pinned\n', U.read_file(out_file))
+    self.assertEqual(1, len(jobs[0].cores))
+    self.assertGreater(jobs[0].runtime, 0)
+    U.remove_file(out_file)
+
+    with self.assertRaises(LS.LocalSchedulerException):
+      scheduler.run([LS.LocalJob('false', U.get_tempdir())])
+
+
+if __name__ == '__main__':
+  unittest.main()
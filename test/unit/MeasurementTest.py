@@ -3,6 +3,7 @@ File: MeasurementTest.py
 License: Part of the PIRA project. Licensed under BSD 3 clause license. See LICENSE.txt file at https://github.com/tudasc/pira
 Description: Tests for the argument mapping
 """
+import ctypes
 import shutil
 import os
 import unittest
@@ -50,6 +51,44 @@ class TestRunResult(unittest.TestCase):
     self.assertEqual(rr.compute_overhead(rr2, 1), 0.5)
     self.assertEqual(rr.compute_overhead(rr2, 2), 0.5)
 
+class TestRunResultSeries(unittest.TestCase):
+  """
+  Tests the RunResultSeries class with data sets of different numbers of repetitions
+  """
+  def test_confidence_width(self):
+    self.assertEqual(M.get_relative_confidence_width([1.0]), float('inf'))
+    self.assertEqual(M.get_relative_confidence_width([2.0, 2.0, 2.0]), 0.0)
+    # mean 2, stdev 1, t(2) = 4.303
+    self.assertAlmostEqual(M.get_relative_confidence_width([1.0, 2.0, 3.0]),
+                           2 * 4.303 / 3**0.5 / 2 * 100, places=3)
+
+  def test_same_reps(self):
+    rrs = M.RunResultSeries(reps=2, num_data_sets=5)
+    for values in ([1.0, 3.0], [4.0, 6.0]):
+      s = M.RunResultSeries(reps=2)
+      s.add_values(values[0], 2)
+      s.add_values(values[1], 2)
+      rrs.add_from(s)
+
+    self.assertEqual(rrs.data_set_reps, [])
+    self.assertEqual(rrs.get_average(data_set=1), 5.0)
+    self.assertEqual(rrs.get_all_averages(), [2.0, 5.0])
+
+  def test_different_reps(self):
+    rrs = M.RunResultSeries(reps=4, num_data_sets=5)
+    for values in ([1.0, 3.0], [4.0, 5.0, 9.0], [7.0, 7.0]):
+      s = M.RunResultSeries(reps=len(values))
+      for v in values:
+        s.add_values(v, len(values))
+      rrs.add_from(s)
+
+    self.assertEqual(rrs.get_data_set_reps(), [2, 3, 2])
+    self.assertEqual(rrs.get_average(data_set=0), 2.0)
+    self.assertEqual(rrs.get_average(data_set=1), 6.0)
+    self.assertEqual(rrs.get_median(data_set=1), 5.0)
+    self.assertEqual(rrs.get_stdev(data_set=2), 0.0)
+    self.assertEqual(rrs.get_all_averages(), [2.0, 6.0, 7.0])
+
 class TestScorepHelper(unittest.TestCase):
   """
   Tests the ScorepSystemHelper class and, currently, also the DefaultFlags.
@@ -117,6 +156,62 @@ class TestScorepHelper(unittest.TestCase):
     self.assertEqual('', s_mh.cur_base_name)
     self.assertEqual('', s_mh.cur_exp_directory)
 
+  def test_scorep_mh_set_up_runtime_guards(self):
+    invoc_cfg = InvocationConfig.get_instance()
+    invoc_cfg._runtime_guards = True
+    invoc_cfg._compile_time_filtering = False
+    try:
+      U.make_dir(self.cubes_dir)
+      instr_file = os.path.join(self.cubes_dir, 'instrumented-item01.txt')
+      U.write_file(instr_file, '_Z3foov\nmain\n')
+      self.target_cfg.set_instr_file(instr_file)
+      s_mh = M.ScorepSystemHelper(self.cfg)
+      s_mh.set_up(self.target_cfg, self.instr_cfg)
+
+      filter_file = os.path.join(self.cubes_dir, 'scorep_filter_file.txt')
+      self.assertEqual(filter_file, os.environ['PIRA_RUNTIME_FILTER'])
+      self.assertEqual(filter_file, s_mh.cur_filter_file)
+      self.assertIn('INCLUDE MANGLED _Z3foov', U.read_file(filter_file))
+
+      # The whitelisted names after the first are continuation lines of the INCLUDE rule
+      runtime = os.path.join(U.get_pira_code_dir(), 'extern', 'src', 'llvm-instrumentation', 'build',
+                             'runtime', 'libpira_rt.so')
+      if not U.is_file(runtime):
+        self.skipTest('The runtime of the enable guards is not built')
+
+      class GuardEntry(ctypes.Structure):
+        _fields_ = [('guard', ctypes.POINTER(ctypes.c_uint8)), ('name', ctypes.c_char_p)]
+
+      names = [b'_Z3foov', b'main', b'_Z3barv']
+      guards = (ctypes.c_uint8 * len(names))(*[1] * len(names))
+      entries = (GuardEntry * len(names))(*[
+          GuardEntry(ctypes.cast(ctypes.byref(guards, i), ctypes.POINTER(ctypes.c_uint8)), name)
+          for i, name in enumerate(names)
+      ])
+      guards_init = getattr(ctypes.CDLL(runtime), '__pira_guards_init')
+      guards_init(entries, ctypes.byref(entries, ctypes.sizeof(entries)))
+      self.assertListEqual([1, 1, 0], list(guards))
+    finally:
+      invoc_cfg._runtime_guards = False
+      invoc_cfg._compile_time_filtering = True
+      os.environ.pop('PIRA_RUNTIME_FILTER', None)
+
+  def test_build_MPI_filter_library_up_to_date(self):
+    # The template is found in the PIRA checkout, PIRA may be started from any directory
+    home_dir = U.home_directory
+    so_file = D.BackendDefaults().get_wrap_so_file()
+    try:
+      U.make_dirs(os.path.dirname(so_file))
+      U.set_home_dir(self.cubes_dir)
+      U.write_file(so_file, '')
+      M.ScorepSystemHelper.build_MPI_filter_library()
+      self.assertEqual('', U.read_file(so_file))
+    finally:
+      U.set_home_dir(home_dir)
+      for f in [so_file, so_file + '.lock']:
+        if U.is_file(f):
+          os.remove(f)
+
   def test_scorep_mh_dir_invalid(self):
     s_mh = M.ScorepSystemHelper(self.cfg)
     s_mh.set_up(self.target_cfg, self.instr_cfg)
@@ -148,6 +243,17 @@ class TestScorepHelper(unittest.TestCase):
     cpp = kw_dict['CXX']
     self.assertEqual('\"clang++\"', cpp)
 
+  def test_get_MPI_whitelist(self):
+    filter_file = os.path.join(U.get_default_pira_dir(), 'test-mpi-whitelist.txt')
+    U.write_file(
+        filter_file, '\n'.join([
+            'main', 'MPI_Barrier', 'INCLUDE MPI_Send', 'INCLUDE foo -> MPI_Recv',
+            'INCLUDE MPI_Bcast -> foo', 'MPI_Barrier'
+        ]))
+    self.assertEqual(M.ScorepSystemHelper.get_MPI_whitelist(filter_file),
+                     ['MPI_Barrier', 'MPI_Send', 'MPI_Recv'])
+    os.remove(filter_file)
+
 
 if __name__ == '__main__':
   unittest.main()
@@ -0,0 +1,104 @@
+"""
+File: TargetSchedulerTest.py
+License: Part of the PIRA project. Licensed under BSD 3 clause license. See LICENSE.txt file at https://github.com/tudasc/pira
+Description: Tests for the concurrent refinement of targets.
+"""
+
+import lib.Logging as L
+import lib.Pira as P
+import lib.TargetScheduler as TS
+import lib.Utility as U
+import argparse
+import unittest
+import os
+
+
+class TestTargetScheduler(unittest.TestCase):
+
+  def test_limit_cores(self):
+    nodes = [[0, 1, 2, 3], [4, 5, 6, 7]]
+    self.assertEqual(nodes, TS.limit_cores(nodes, 0))
+    self.assertEqual([[0, 1, 2]], TS.limit_cores(nodes, 3))
+    self.assertEqual([[0, 1, 2, 3], [4, 5]], TS.limit_cores(nodes, 6))
+    self.assertEqual(nodes, TS.limit_cores(nodes, 16))
+
+  def test_take_and_return_cores(self):
+    nodes = [[0, 1, 2, 3], [4, 5, 6, 7]]
+    free = [list(cores) for cores in nodes]
+    self.assertEqual([0, 1, 2], TS.take_cores(free, 3))
+    # The node with the fewest free cores that has enough
+    self.assertEqual([3], TS.take_cores(free, 1))
+    # Spans the nodes only if none has enough
+    self.assertEqual([4, 5], TS.take_cores(free, 2))
+    TS.return_cores(free, nodes, [3, 0])
+    self.assertEqual([[0, 3], [6, 7]], free)
+    self.assertEqual([0, 3, 6], TS.take_cores(free, 3))
+    TS.return_cores(free, nodes, [6, 3, 0, 4, 5])
+    self.assertEqual([[0, 3], [4, 5, 6, 7]], free)
+
+  def test_demand(self):
+    scheduler = TS.TargetScheduler(2, 1, 8)
+    self.assertEqual(1, scheduler.get_num_cores())
+    self.assertEqual((1, 0), scheduler.get_demand(TS.Pipeline('a', '/a', lambda: None)))
+    # Pipelines that declare more than the budgets still run, alone
+    self.assertEqual((1, 8), scheduler.get_demand(TS.Pipeline('b', '/b', lambda: None, 4, 16)))
+
+  def test_run(self):
+    out_dir = os.path.join(U.get_tempdir(), 'pira-target-scheduler-test')
+    U.make_dir(out_dir)
+
+    def get_task(name: str):
+
+      def task() -> None:
+        # Process-global state of one pipeline does not reach the others
+        U.set_env('PIRA_TEST_TARGET', name)
+        os.chdir(out_dir)
+        L.get_logger().log('[TEST] ' + name, level='perf')
+        U.write_file(name + '.txt',
+                     os.environ['PIRA_TEST_TARGET'] + ' ' + str(sorted(os.sched_getaffinity(0))))
+
+      return task
+
+    cwd = os.getcwd()
+    scheduler = TS.TargetScheduler(2, 1, 4)
+    pipelines = [
+        TS.Pipeline('a', '/a', get_task('a'), 1, 2),
+        TS.Pipeline('b', '/a', get_task('b'), 1, 2),
+        TS.Pipeline('c', '/c', get_task('c'), 0, 4)
+    ]
+    scheduler.run(pipelines)
+    self.assertEqual(cwd, os.getcwd())
+    self.assertNotIn('PIRA_TEST_TARGET', os.environ)
+    for pipeline in pipelines:
+      self.assertFalse(pipeline.failed)
+      self.assertGreater(pipeline.runtime, 0)
+      self.assertEqual(1, len(pipeline.assigned_cores))
+      self.assertEqual(pipeline.name + ' ' + str(pipeline.assigned_cores),
+                       U.read_file(os.path.join(out_dir, pipeline.name + '.txt')))
+      self.assertIn('[PERF] [TEST] ' + pipeline.name, L.get_logger().perf_tape)
+
+    def fail() -> None:
+      raise RuntimeError('failing target')
+
+    with self.assertRaises(TS.TargetSchedulerException):
+      scheduler.run([TS.Pipeline('d', '/d', fail), TS.Pipeline('e', '/e', get_task('e'))])
+    U.remove_dir(out_dir)
+
+  def test_concurrent_targets_args(self):
+    P.process_args_for_concurrent_targets(
+        argparse.Namespace(concurrent_targets=2, extrap_dir='', slurm_config=None))
+    # The targets would share the Extra-P profile directory and the Slurm job files
+    with self.assertRaises(RuntimeError):
+      P.process_args_for_concurrent_targets(
+          argparse.Namespace(concurrent_targets=2, extrap_dir='/extrap', slurm_config=None))
+    with self.assertRaises(RuntimeError):
+      P.process_args_for_concurrent_targets(
+          argparse.Namespace(concurrent_targets=2, extrap_dir='', slurm_config='batchsystem.json'))
+    P.process_args_for_concurrent_targets(
+        argparse.Namespace(concurrent_targets=1,
+                           extrap_dir='/extrap',
+                           slurm_config='batchsystem.json'))
+
+
+if __name__ == '__main__':
+  unittest.main()
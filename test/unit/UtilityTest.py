@@ -142,6 +142,126 @@ class TestUtility(unittest.TestCase):
     self.assertTrue(U.check_file(f"{os.path.dirname(__file__)}/Atestc.txt"))
     U.remove_file(f"{os.path.dirname(__file__)}/Atestc.txt")
 
+  def test_overhead_report(self):
+    instr_file = f"{U.get_tempdir()}/instrumented-bench_flav.txt"
+    report_file = U.build_overhead_report_path(instr_file)
+    self.assertEqual(f"{U.get_tempdir()}/instrumented-bench_flav-overhead.jsonl", report_file)
+    U.write_file(
+        instr_file, "SCOREP_REGION_NAMES_BEGIN\nEXCLUDE *\nINCLUDE main MANGLED main\n"
+        "INCLUDE get() MANGLED _Z3getv\nINCLUDE MANGLED _Z4loopv _Z3getv\n"
+        "INCLUDE LOOPS MANGLED _Z3getv\nINCLUDE MANGLED _Z5solvev -> _Z3getv\n"
+        "SCOREP_REGION_NAMES_END\n")
+    U.write_file(
+        report_file, '{"module":"a.cpp","function":"_Z3getv","action":"drop"}\n'
+        '{"module":"a.cpp","function":"_Z4loopv","action":"downgrade"}\n')
+    actions = U.read_overhead_report(report_file)
+    self.assertEqual({'_Z3getv': 'drop', '_Z4loopv': 'downgrade'}, actions)
+    self.assertEqual(2, U.remove_functions_from_instr_file(instr_file, ['_Z3getv']))
+    self.assertEqual(
+        "SCOREP_REGION_NAMES_BEGIN\nEXCLUDE *\nINCLUDE main MANGLED main\n"
+        "INCLUDE MANGLED _Z4loopv\nINCLUDE LOOPS MANGLED _Z3getv\n"
+        "INCLUDE MANGLED _Z5solvev -> _Z3getv\nSCOREP_REGION_NAMES_END\n", U.read_file(instr_file))
+    self.assertEqual({'*', 'main', '_Z4loopv', '_Z3getv', '_Z5solvev'},
+                     U.read_instr_file_names(instr_file))
+    self.assertEqual(0, U.remove_functions_from_instr_file(instr_file, ['_Z3getv']))
+    U.remove_file(instr_file)
+    U.remove_file(report_file)
+
+  def test_instrumentation_remarks(self):
+    remarks_dir = U.build_remarks_dir(U.get_tempdir(), 'bench', 'flav')
+    self.assertEqual(f"{U.get_tempdir()}/.pira-remarks-bench_flav", remarks_dir)
+    U.remove_dir(remarks_dir)
+    U.make_dirs(remarks_dir)
+    remark = ("--- !{}\nPass:            pira-instrumentation\nName:            {}\n"
+              "DebugLoc:        {{ File: a.cpp, Line: {}, Column: 0 }}\n"
+              "Function:        {}\nArgs:\n  - String:          '{} '\n  - Kind:            {}\n"
+              "  - String:          ' '\n  - Region:          '{}'\n{}...\n")
+    function = remark.format('Passed', 'Instrumented', 3, '_Z3foov', 'instrumented', 'function',
+                             '_Z3foov', '')
+    loop = remark.format('Passed', 'Instrumented', 5, '_Z3foov', 'instrumented', 'loop',
+                         '_Z3foov:5', '')
+    reason = "  - String:          ': '\n  - Reason:          the hooks exceed the overhead budget\n"
+    skipped = remark.format('Missed', 'Skipped', 9, '_Z3getv', 'skipped', 'function', '_Z3getv',
+                            reason)
+    U.write_file(f"{remarks_dir}/a.cpp-1.opt.yaml", function + loop + skipped)
+    # An inline function instrumented in a second translation unit counts once
+    U.write_file(f"{remarks_dir}/b.cpp-2.opt.yaml", function)
+    U.write_file(f"{remarks_dir}/ignored.json", '{}')
+
+    remarks = U.read_instrumentation_remarks(remarks_dir)
+    self.assertEqual(4, len(remarks))
+    self.assertEqual(
+        {
+            'type': 'Missed',
+            'Pass': 'pira-instrumentation',
+            'Name': 'Skipped',
+            'File': 'a.cpp',
+            'Line': '9',
+            'Function': '_Z3getv',
+            'Kind': 'function',
+            'Region': '_Z3getv',
+            'Reason': 'the hooks exceed the overhead budget'
+        }, remarks[2])
+
+    report = U.summarize_instrumentation_remarks(remarks)
+    self.assertEqual({'function': 1, 'loop': 1}, report['instrumented'])
+    self.assertEqual({'the hooks exceed the overhead budget': 1}, report['skipped'])
+    self.assertEqual(['_Z3foov', '_Z3foov:5'], [r['region'] for r in report['regions']])
+    self.assertEqual(9, report['skipped_regions'][0]['line'])
+    self.assertEqual([], U.read_instrumentation_remarks(remarks_dir + '-missing'))
+    U.remove_dir(remarks_dir)
+
+    instr_file = f"{U.get_tempdir()}/instrumented-bench_flav.txt"
+    self.assertEqual(f"{U.get_tempdir()}/instrumented-bench_flav-report-2.json",
+                     U.build_instrumentation_report_path(instr_file, 2))
+
+  def test_function_features(self):
+    features_dir = U.build_features_dir(U.get_tempdir(), 'bench', 'flav')
+    self.assertEqual(f"{U.get_tempdir()}/.pira-features-bench_flav", features_dir)
+    U.remove_dir(features_dir)
+    self.assertEqual([], U.get_function_features_files(features_dir))
+    U.make_dirs(features_dir)
+    U.write_file(f"{features_dir}/b.cpp-2.features.json", '{"functions":{}}')
+    U.write_file(f"{features_dir}/a.cpp-1.features.json", '{"functions":{}}')
+    U.write_file(f"{features_dir}/a.cpp-1.json", '{}')
+    self.assertEqual(
+        [f"{features_dir}/a.cpp-1.features.json", f"{features_dir}/b.cpp-2.features.json"],
+        U.get_function_features_files(features_dir))
+    self.assertEqual('pira-cg-merge -o /pgis/bench_flav.mcg ' + features_dir,
+                     U.build_call_graph_merge_command(features_dir, '/pgis/bench_flav.mcg'))
+    U.remove_dir(features_dir)
+
+  def test_instrumentation_manifests(self):
+    manifest_dir = U.build_manifest_dir(U.get_tempdir(), 'bench', 'flav')
+    self.assertEqual(f"{U.get_tempdir()}/.pira-manifests-bench_flav", manifest_dir)
+    U.remove_dir(manifest_dir)
+    U.make_dirs(manifest_dir)
+    U.write_file(
+        f"{manifest_dir}/a.cpp-1.json",
+        '{"matched":["_Z3foov"],"module":"a.cpp","names":["_Z3foov","main"],"source":"/a.cpp"}\n')
+    U.write_file(
+        f"{manifest_dir}/b.cpp-2.json",
+        '{"matched":[],"module":"b.cpp","names":["_Z3barv","_Z3bazv"],"source":"/b.cpp"}\n')
+    U.write_file(U.build_manifest_state_path(manifest_dir), '{}')
+    manifests = U.read_instrumentation_manifests(manifest_dir)
+    self.assertEqual([f"{manifest_dir}/a.cpp-1.json", f"{manifest_dir}/b.cpp-2.json"],
+                     [f for f, _ in manifests])
+    self.assertEqual(set(), U.get_sources_to_rebuild(manifests, {'_Z3quxv'}))
+    self.assertEqual({'/b.cpp'}, U.get_sources_to_rebuild(manifests, {'_Z3bazv'}))
+    self.assertEqual({'/a.cpp', '/b.cpp'},
+                     U.get_sources_to_rebuild(manifests, {'_Z3foov', '_Z3barv'}))
+    U.remove_dir(manifest_dir)
+
+    instr_file = f"{U.get_tempdir()}/instrumented-bench_flav.txt"
+    U.write_file(
+        instr_file, "SCOREP_REGION_NAMES_BEGIN\nEXCLUDE *\nINCLUDE main MANGLED main\n"
+        "INCLUDE foo() MANGLED _Z3foov # hot\nINCLUDE MANGLED _Z3bazv\n  _Z3quxv\n"
+        "INCLUDE LOOPS=2 MANGLED _Z5solvev\nINCLUDE MANGLED main -> _Z3barv\n"
+        "INCLUDE MANGLED _Z5solvev -> INDIRECT\nSCOREP_REGION_NAMES_END\n")
+    self.assertEqual({'*', 'main', '_Z3foov', '_Z3bazv', '_Z3quxv', '_Z5solvev', '_Z3barv'},
+                     U.read_instr_file_names(instr_file))
+    U.remove_file(instr_file)
+
   def test_json_to_canonic(self):
     json_loads = {
       "a": "astring",